@@ -20,6 +20,12 @@
 #include "hvr_irregular_matrix.h"
 #include "hvr_buffered_msgs.h"
 #include "hvr_buffered_changes.h"
+#include "hvr_progress_queue.h"
+
+#include <pthread.h>
+#ifdef MULTITHREADED
+#include <omp.h>
+#endif
 
 /*
  * High-level workflow of the HOOVER runtime:
@@ -47,6 +53,12 @@
  * given a list of all vertices it has edges with (neighbors, n_neighbors).
  * Based on these updates, the HOOVER programmer can then choose to couple with
  * some other PEs by setting elements in couple_with.
+ *
+ * When built with -DMULTITHREADED, hvr_update_metadata_func is called on
+ * several local vertices at once from OpenMP threads. It may then observe
+ * either the old or the new attributes of a local neighbor updated in the same
+ * iteration, and the IDs of vertices it creates are no longer deterministic.
+ * Set OMP_NUM_THREADS=1 to retain the serial behavior.
  */
 typedef void (*hvr_update_metadata_func)(hvr_vertex_t *vert,
         hvr_set_t *couple_with, hvr_ctx_t ctx);
@@ -83,7 +95,9 @@ typedef int (*hvr_should_terminate_func)(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
 
 /*
  * API for checking if this PE might have any vertices that interact with
- * vertices on another PE. This callback function must be thread safe.
+ * vertices on another PE. This callback function must be thread safe. The
+ * partitions returned for a partition are assumed to stay the same for as long
+ * as this PE has vertices in (or near) that partition.
  */
 typedef void (*hvr_might_interact_func)(const hvr_partition_t partition,
         hvr_partition_t *interacting_partitions,
@@ -106,35 +120,205 @@ typedef hvr_partition_t (*hvr_actor_to_partition)(const hvr_vertex_t *actor,
 typedef hvr_edge_type_t (*hvr_should_have_edge)(const hvr_vertex_t *target,
         const hvr_vertex_t *candidate, hvr_ctx_t ctx);
 
+/*
+ * Optional, vectorizable form of should_have_edge which decides the edges
+ * between target and up to HVR_EDGE_BATCH_SIZE candidates at once. Candidate
+ * features are passed feature-major: candidate_values[f][i] is feature f of
+ * the i-th candidate. out_edges[i] must be set to should_have_edge(target,
+ * candidate i), i.e. relative to target. See hvr_set_should_have_edge_batch.
+ */
+#define HVR_EDGE_BATCH_SIZE 256
+typedef void (*hvr_should_have_edge_batch)(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        hvr_edge_type_t *out_edges, hvr_ctx_t ctx);
+
+/*
+ * Optional API for computing the payload of an edge between two vertices that
+ * should_have_edge decided should be connected (e.g. an edge weight). Like
+ * should_have_edge, this must be symmetric: edge_payload(A, B) must equal
+ * edge_payload(B, A).
+ */
+typedef hvr_edge_payload_t (*hvr_edge_payload_func)(const hvr_vertex_t *target,
+        const hvr_vertex_t *candidate, hvr_ctx_t ctx);
+
+/*
+ * API for extracting the coordinates of a vertex used to narrow the set of
+ * candidate neighbors evaluated with should_have_edge. See
+ * hvr_set_edge_search_key.
+ */
+#define HVR_MAX_SEARCH_KEY_DIMS 3
+typedef void (*hvr_edge_search_key_func)(const hvr_vertex_t *vert,
+        double *out_key, hvr_ctx_t ctx);
+
+/*
+ * Optional refinement of partitions into child partitions, which the runtime
+ * uses to split partitions that become hot. child_partition maps a vertex in
+ * partition to one of the n_children children of that partition.
+ * children_might_interact must return non-zero if any vertex in child
+ * child_a of partition_a might have an edge with any vertex in child child_b
+ * of partition_b (given that the two partitions might interact). See
+ * hvr_set_partition_refinement.
+ */
+typedef unsigned (*hvr_child_partition_func)(const hvr_vertex_t *vert,
+        hvr_partition_t partition, hvr_ctx_t ctx);
+typedef int (*hvr_children_might_interact_func)(hvr_partition_t partition_a,
+        unsigned child_a, hvr_partition_t partition_b, unsigned child_b,
+        hvr_ctx_t ctx);
+
+/*
+ * Load metrics published by each PE for the migration policy. iter_time_us is
+ * the duration of the PE's last completed iteration. Metrics are read from
+ * remote PEs without synchronization, and so may be slightly stale.
+ */
+typedef struct _hvr_pe_load_t {
+    uint64_t n_local_vertices;
+    uint64_t iter_time_us;
+    hvr_time_t iter;
+} hvr_pe_load_t;
+
+/*
+ * Optional policy for rebalancing local vertices across PEs, called every
+ * HVR_MIGRATION_INTERVAL iterations with the loads of all PEs (indexed by PE)
+ * and an iterator over local vertices. It may call hvr_vertex_migrate on any
+ * of those vertices. See hvr_set_migration_policy.
+ */
+typedef void (*hvr_migration_policy_func)(const hvr_pe_load_t *loads,
+        hvr_vertex_iter_t *iter, hvr_ctx_t ctx);
+
+/*
+ * Optional priority for a local vertex that needs processing, evaluated at the
+ * start of each update phase. Vertices are passed to update_metadata in
+ * decreasing order of priority. See hvr_set_vertex_priority.
+ */
+typedef unsigned (*hvr_vertex_priority_func)(hvr_vertex_t *vert,
+        hvr_ctx_t ctx);
+
+/*
+ * Result of hvr_vertex_await_mirror.
+ */
+typedef enum _hvr_mirror_status_t {
+    // The vertex is cached locally and was returned
+    HVR_MIRROR_READY = 0,
+    // Not cached yet, the waiting vertex is updated again once it is
+    HVR_MIRROR_PENDING,
+    // The vertex no longer exists
+    HVR_MIRROR_MISSING
+} hvr_mirror_status_t;
+
 /*
  * All message definitions.
  */
+
+/*
+ * A non-zero is_invalidation tells the receiver to drop its copy of vert, and
+ * says why. HVR_PARTITION_INVALIDATION is sent to subscribers of a partition
+ * vert has moved out of, and does not end a subscription to vert itself.
+ * HVR_DELETE_INVALIDATION and HVR_MIGRATION_INVALIDATION mean vert no longer
+ * exists under this ID. For a migration, its explicit edges are dropped along
+ * with it, as the new owner recreates them under the vertex's new ID.
+ */
+#define HVR_PARTITION_INVALIDATION 1
+#define HVR_DELETE_INVALIDATION 2
+#define HVR_MIGRATION_INVALIDATION 3
 typedef struct _hvr_vertex_update_t {
     hvr_vertex_t vert;
     uint8_t is_invalidation;
 } hvr_vertex_update_t;
 
+/*
+ * is_forward is HVR_EDGE_REDIRECTED for an edge create sent to the previous
+ * owner of target after target migrated, which that PE redirects to target's
+ * new ID. The new owner creates the edge and sends it back to src's owner.
+ */
+#define HVR_EDGE_REDIRECTED 2
 typedef struct _hvr_edge_create_msg_t {
     hvr_vertex_t src;
     hvr_vertex_id_t target;
     hvr_edge_type_t edge;
+    hvr_edge_payload_t payload;
     int is_forward;
 } hvr_edge_create_msg_t;
 
+/*
+ * Sent by a producer to a new subscriber of partition, which can then pull
+ * the producer's vertices in that partition from logical positions
+ * [start, start + count) of the producer's snapshot ring.
+ */
+typedef struct _hvr_partition_snapshot_msg_t {
+    int pe;
+    hvr_partition_t partition;
+    uint64_t start;
+    uint64_t count;
+} hvr_partition_snapshot_msg_t;
+
+/*
+ * Partition snapshots travel with vertex and edge updates so that they are
+ * applied in the order the producer sent them relative to those updates.
+ */
 typedef struct _hvr_update_msg_t {
     union {
         hvr_vertex_update_t vert_update;
         hvr_edge_create_msg_t edge_update;
+        hvr_partition_snapshot_msg_t snapshot;
     } payload;
     uint8_t is_vert_update;
+    uint8_t is_snapshot;
+    // Set by send_to_vertex_update_mailbox, fits in the tail padding
+    int src_pe;
 } hvr_update_msg_t;
 
+// Position of an update staged by process_vertex_updates in deterministic mode
+typedef struct _hvr_staged_update_t {
+    int src_pe;
+    unsigned index;
+} hvr_staged_update_t;
+
+/*
+ * entered is 1 for a subscription, 0 for an unsubscription, and
+ * PARTITION_SUB_RESEND if a subscriber could not use the snapshot published
+ * for it and needs all vertices in the partition sent to it.
+ */
+#define PARTITION_SUB_RESEND 2
 typedef struct _hvr_partition_member_change_t {
     int pe;
     hvr_partition_t partition;
     int entered;
 } hvr_partition_member_change_t;
 
+/*
+ * Messages used to push changes in the producers of a partition to its
+ * subscribers, rather than having subscribers poll the producer registry. Each
+ * partition's subscribers are tracked by the PE owning its row of the
+ * registry. Subscribers (un)register with the owner, producers tell the owner
+ * when they start or stop producing, and the owner notifies subscribers.
+ */
+typedef enum _hvr_producer_change_type_t {
+    // Subscriber -> owner
+    PRODUCER_CHANGE_SUBSCRIBE = 0,
+    PRODUCER_CHANGE_UNSUBSCRIBE,
+    // Producer -> owner
+    PRODUCER_CHANGE_STARTED,
+    PRODUCER_CHANGE_STOPPED,
+    // Owner -> subscriber
+    PRODUCER_CHANGE_NOTIFY_STARTED,
+    PRODUCER_CHANGE_NOTIFY_STOPPED
+} hvr_producer_change_type_t;
+
+typedef struct _hvr_producer_change_msg_t {
+    /*
+     * The subscriber for (UN)SUBSCRIBE, otherwise the producer that started or
+     * stopped producing.
+     */
+    int pe;
+    hvr_partition_t partition;
+    int type;
+} hvr_producer_change_msg_t;
+
+typedef struct _hvr_producer_change_outbox_entry_t {
+    hvr_producer_change_msg_t msg;
+    int target_pe;
+} hvr_producer_change_outbox_entry_t;
+
 typedef struct _hvr_vertex_subscription_t {
     int pe;
     hvr_vertex_id_t vert;
@@ -168,9 +352,82 @@ typedef struct _inter_vert_msg_t {
     hvr_vertex_t payload;
 } inter_vert_msg_t;
 
+/*
+ * Transfers a local vertex and its explicit edges to a new owning PE. The
+ * neighbors of edges are identified by vertex ID.
+ */
+#define HVR_MAX_MIGRATED_EDGES 64
+typedef struct _hvr_migrated_edge_t {
+    hvr_vertex_id_t neighbor;
+    hvr_edge_type_t edge;
+    hvr_edge_payload_t payload;
+} hvr_migrated_edge_t;
+
+typedef struct _hvr_migration_msg_t {
+    hvr_vertex_t vert;
+    unsigned n_edges;
+    hvr_migrated_edge_t edges[HVR_MAX_MIGRATED_EDGES];
+} hvr_migration_msg_t;
+
+typedef struct _hvr_pending_migration_t {
+    hvr_vertex_id_t id;
+    int target_pe;
+} hvr_pending_migration_t;
+
+/*
+ * A local vertex waiting in hvr_vertex_await_mirror for a remote vertex to be
+ * cached on this PE.
+ */
+typedef struct _hvr_mirror_await_t {
+    hvr_vertex_id_t waiter;
+    // The ID waiter asked for, and the vertex's current ID if it migrated
+    hvr_vertex_id_t requested;
+    hvr_vertex_id_t awaited;
+    // Set once we have subscribed to awaited
+    int subscribed;
+    // Set once waiter has been marked for processing
+    int woken;
+    // Set once awaited turned out to no longer exist
+    int missing;
+} hvr_mirror_await_t;
+
+// Value of a forwarding entry while its vertex is still in flight
+#define HVR_FORWARDING_PENDING (HVR_INVALID_VERTEX_ID - 1)
+
 typedef struct _hvr_partition_list_t {
     hvr_map_t map;
     hvr_partition_t n_partitions;
+    // Whether membership is reflected in the per-partition distance histograms
+    int track_distances;
+
+    /*
+     * Optional uniform grid over the search keys of all vertices in this list,
+     * mapping from cell to the first vertex in that cell.
+     */
+    int has_grid;
+    hvr_map_t grid;
+
+    /*
+     * Optional splitting of hot partitions into child partitions. Partitions
+     * are split once they hold at least split_threshold vertices and are
+     * scanned during edge discovery. The vertices of a split partition are
+     * also chained into per-child lists, mapping from (partition * n_children
+     * + child) to the first vertex in that child. A split partition is merged
+     * back once it holds fewer than merge_threshold vertices, or goes a whole
+     * refinement interval without being scanned. counts and traffic track the
+     * number of vertices in and scanned from each partition, and
+     * refine_list the partitions that are split or are candidates for it.
+     */
+    int has_children;
+    unsigned n_children;
+    hvr_map_t children;
+    unsigned *counts;
+    unsigned *traffic;
+    uint8_t *split_state;
+    hvr_partition_t *refine_list;
+    size_t n_refine_list;
+    unsigned split_threshold;
+    unsigned merge_threshold;
 } hvr_partition_list_t;
 
 #include "hvr_partition_list.h"
@@ -180,6 +437,23 @@ typedef struct _hvr_partition_list_t {
  * so we don't have file scope variables. Enables the possibility in the future
  * of multiple HOOVER problems running on the same PE.
  */
+/*
+ * Deferred work on the adjacency of a hub vertex. The hub's row is walked in
+ * neighbor offset order starting at next. If the hub is updated again while
+ * its work is pending, the walk continues but wraps around to the start of
+ * the row and stops at end (the cursor position at the time of the latest
+ * update), so every edge is visited at least once after every update.
+ */
+typedef struct _hvr_hub_work_t {
+    hvr_vertex_id_t id;
+    hvr_vertex_id_t offset;
+    hvr_vertex_id_t next;
+    hvr_vertex_id_t end;
+    uint8_t wrapped;
+    uint8_t recheck_edges;
+    uint8_t mark_downstream;
+} hvr_hub_work_t;
+
 typedef struct _hvr_internal_ctx_t {
     // Has the HOOVER runtime been initialized?
     int initialized;
@@ -206,8 +480,6 @@ typedef struct _hvr_internal_ctx_t {
     // Sets of the partitions that have been live in a recent time window.
     hvr_set_t *subscribed_partitions;
     hvr_set_t *produced_partitions;
-    hvr_set_t *new_subscribed_partitions;
-    hvr_set_t *new_produced_partitions;
 
     // User callbacks
     hvr_update_metadata_func update_metadata;
@@ -215,6 +487,9 @@ typedef struct _hvr_internal_ctx_t {
     hvr_update_coupled_val_func update_coupled_val;
     hvr_actor_to_partition actor_to_partition;
     hvr_should_have_edge should_have_edge;
+    hvr_should_have_edge_batch should_have_edge_batch;
+    hvr_edge_payload_func edge_payload;
+    hvr_edge_search_key_func search_key;
     hvr_start_time_step start_time_step;
     hvr_should_terminate_func should_terminate;
 
@@ -285,7 +560,14 @@ typedef struct _hvr_internal_ctx_t {
      */
     hvr_partition_list_t mirror_partition_lists;
 
-    uint8_t *partition_min_dist_from_local_vert;
+    /*
+     * Histogram of dist_from_local_vert over the mirrored vertices in each
+     * partition, with n_dist_hist_buckets = max_graph_traverse_depth + 1
+     * buckets per partition. The last bucket counts every vertex at least
+     * max_graph_traverse_depth away, so larger distances are not distinguished.
+     */
+    unsigned *partition_dist_hist;
+    unsigned n_dist_hist_buckets;
 
     // Counter for which graph IDs have already been allocated
     hvr_graph_id_t allocated_graphs;
@@ -312,10 +594,90 @@ typedef struct _hvr_internal_ctx_t {
 
     hvr_map_t producer_info;
     hvr_map_t dead_info;
+    // Backing storage for the values in producer_info and dead_info
+    hvr_dist_bitvec_subcopy_pool_t producer_info_pool;
+    hvr_dist_bitvec_subcopy_pool_t dead_info_pool;
+
+    /*
+     * Subscriptions started by the current call to update_partition_window,
+     * whose registry rows have not been fetched yet.
+     */
+    hvr_dist_bitvec_size_t *new_sub_partitions;
+    hvr_dist_bitvec_local_subcopy_t **new_sub_producer_info;
+    hvr_dist_bitvec_local_subcopy_t **new_sub_dead_info;
+    unsigned n_new_subs;
 
     hvr_time_t *next_producer_info_check;
     hvr_time_t *curr_producer_info_interval;
 
+    /*
+     * Set by HVR_PUSH_PRODUCER_CHANGES. For partitions whose registry row this
+     * PE owns, registry_subs maps partition -> subscribed PEs (# partitions x
+     * # PEs). producer_changes holds the changes in this PE's own producer
+     * status made on the current iteration, to be sent to registry owners.
+     *
+     * Subscriptions whose registry row is owned by a terminated PE are still
+     * polled, as are all subscriptions once after a PE terminates if
+     * poll_subscriptions_for_dead_pes is set.
+     */
+    int push_producer_changes;
+    int poll_subscriptions_for_dead_pes;
+
+    /*
+     * If HVR_PARTITION_SNAPSHOT_SIZE is set, producers publish copies of their
+     * vertices in a partition to snapshot_ring (symmetric, that many vertices)
+     * for new subscribers to pull, rather than pushing them through
+     * vertex_update_mailbox. Positions in the ring increase monotonically and
+     * are wrapped by snapshot_capacity. snapshot_head (symmetric) is the
+     * position after the last one reserved, and is advanced before the
+     * reserved positions are written so that readers can detect overwrites.
+     * snapshot_recv_in_progress is set while a pulled snapshot in
+     * snapshot_recv_buf is being applied.
+     */
+    uint64_t snapshot_capacity;
+    hvr_vertex_t *snapshot_ring;
+    uint64_t *snapshot_head;
+    hvr_vertex_t *snapshot_recv_buf;
+    int snapshot_recv_in_progress;
+    hvr_mailbox_t producer_change_mailbox;
+    hvr_sparse_arr_t registry_subs;
+    hvr_producer_change_msg_t *producer_changes;
+    unsigned n_producer_changes;
+    /*
+     * Producer changes to send whose target's mailbox was full, in order, in a
+     * circular buffer of HVR_PRODUCER_CHANGE_OUTBOX entries. Retried every
+     * iteration rather than blocking on the target.
+     */
+    hvr_producer_change_outbox_entry_t *producer_change_outbox;
+    unsigned producer_change_outbox_capacity;
+    unsigned producer_change_outbox_head;
+    unsigned n_producer_change_outbox;
+
+    /*
+     * Set by HVR_MIGRATION_INTERVAL. Once a local vertex has been migrated to
+     * another PE, forwarding (symmetric, one entry per vertex cache slot) holds
+     * the ID it was given there, so that messages and lookups using its old ID
+     * can be redirected. An entry is only meaningful while its slot is not
+     * reused by another local vertex. load (symmetric) is this PE's published
+     * hvr_pe_load_t, gathered from all PEs into all_loads for the policy.
+     * Messages and edge creates for vertices whose migration is still in
+     * flight are held in forward_retries and edge_forward_retries.
+     */
+    hvr_time_t migration_interval;
+    hvr_migration_policy_func migration_policy;
+    hvr_vertex_id_t *forwarding;
+    hvr_pe_load_t *load;
+    hvr_pe_load_t *all_loads;
+    hvr_mailbox_t migration_mailbox;
+    hvr_pending_migration_t *pending_migrations;
+    unsigned n_pending_migrations;
+    unsigned max_pending_migrations;
+    inter_vert_msg_t *forward_retries;
+    unsigned n_forward_retries;
+    unsigned max_forward_retries;
+    hvr_edge_create_msg_t *edge_forward_retries;
+    unsigned n_edge_forward_retries;
+
     /*
      * Mapping from partition -> remote PE subscribing to each partition
      * Dimensions: (# partitions x # PEs)
@@ -342,23 +704,93 @@ typedef struct _hvr_internal_ctx_t {
 
 #define MAX_MODIFICATIONS 65536
     hvr_vertex_id_t edge_buffer[MAX_MODIFICATIONS];
+    hvr_edge_payload_t edge_payload_buffer[MAX_MODIFICATIONS];
+    /*
+     * Used when recomputing distances from local vertices, which happens
+     * while callers walk the edges they linearized into edge_buffer.
+     */
+    hvr_vertex_id_t dist_edge_buffer[MAX_MODIFICATIONS];
 
     hvr_dist_bitvec_t partition_producers;
     hvr_dist_bitvec_t terminated_pes;
+    // Producer registry updates made while updating the partition window
+    hvr_dist_bitvec_batch_t partition_producers_batch;
 
     hvr_partition_t *interacting;
 
+    /*
+     * If might_interact is declared pure, its results are cached in CSR form:
+     * the interacting_cache_len[p] partitions that might interact with p start
+     * at interacting_cache[interacting_cache_start[p]]. interacting_cache_start
+     * is UINT32_MAX for partitions that have not been cached yet.
+     */
+    int might_interact_is_pure;
+    uint32_t *interacting_cache_start;
+    uint32_t *interacting_cache_len;
+    hvr_partition_t *interacting_cache;
+    size_t interacting_cache_used;
+    size_t interacting_cache_capacity;
+
+    /*
+     * If search_key is set, edge discovery only considers vertices whose keys
+     * fall in grid cells (of width search_radius) adjacent to the updated
+     * vertex's. search_partitions is scratch space for the interacting
+     * partitions of the vertex being updated.
+     */
+    unsigned search_key_dims;
+    double search_radius;
+    hvr_set_t *search_partitions;
+
+    /*
+     * If set, hot partitions in the partition lists are split into children
+     * and cold ones merged back every partition_refine_interval iterations.
+     * Only used when there is no search grid.
+     */
+    hvr_child_partition_func child_partition;
+    hvr_children_might_interact_func children_might_interact;
+    hvr_time_t partition_refine_interval;
+
+    /*
+     * Candidates gathered for the next call to should_have_edge_batch, with
+     * their features transposed into batch_values.
+     */
+    double batch_values[HVR_MAX_VECTOR_SIZE][HVR_EDGE_BATCH_SIZE];
+    hvr_vertex_cache_node_t *batch_nodes[HVR_EDGE_BATCH_SIZE];
+    hvr_edge_type_t batch_edges[HVR_EDGE_BATCH_SIZE];
+    unsigned n_batched;
+
     hvr_vertex_t *recently_created;
 
     hvr_buffered_msgs_t buffered_msgs;
 
-    hvr_partition_t *new_producer_partitions_list;
-    hvr_partition_t *new_subscriber_partitions_list;
+    /*
+     * The partition window is maintained incrementally. Any partition whose
+     * local or mirrored partition list became empty or non-empty, or whose
+     * distance from local vertices crossed max_graph_traverse_depth, since the
+     * last window update is queued as dirty.
+     */
+    hvr_set_t *dirty_partitions;
+    hvr_partition_t *dirty_partitions_list;
+    size_t n_dirty_partitions;
+
+    /*
+     * Partitions whose interacting partitions this PE subscribes to, and the
+     * partitions each was interacting with when it became a source.
+     * Dimensions: (# partitions x # partitions)
+     */
+    hvr_set_t *source_partitions;
+    hvr_sparse_arr_t source_interacting;
+    // Number of source partitions interacting with each partition
+    unsigned *partition_sub_refcount;
+
+    // Partitions whose refcount changed during the current window update
+    hvr_set_t *touched_partitions;
+    hvr_partition_t *touched_partitions_list;
 
-    hvr_partition_t *prev_producer_partitions_list;
-    size_t n_prev_producer_partitions;
-    hvr_partition_t *prev_subscriber_partitions_list;
-    size_t n_prev_subscriber_partitions;
+    // Current subscriptions, and each subscribed partition's index in the list
+    hvr_partition_t *subscriber_partitions_list;
+    size_t n_subscriber_partitions;
+    size_t *subscriber_partitions_index;
 
     size_t max_active_partitions;
 
@@ -380,8 +812,221 @@ typedef struct _hvr_internal_ctx_t {
     uint64_t vertex_update_mailbox_nmsgs;
     uint64_t vertex_update_mailbox_nmsgs_total;
     uint64_t vertex_update_mailbox_nattempts;
+
+    /*
+     * Vertices with more than hub_degree_threshold edges (0 disables this) are
+     * treated as hubs. Re-checking a hub's existing edges and marking its
+     * downstream neighbors is deferred to pending_hubs and spread across
+     * iterations, at most hub_edges_per_iter edges per iteration.
+     */
+    unsigned hub_degree_threshold;
+    unsigned hub_edges_per_iter;
+    hvr_hub_work_t *pending_hubs;
+    unsigned n_pending_hubs;
+    unsigned max_pending_hubs;
+
+    /*
+     * If HVR_PROGRESS_THREAD is set to 1, a separate thread drains
+     * vertex_update_mailbox into progress_queue so that remote senders are not
+     * stalled while this PE is busy in user callbacks. process_vertex_updates
+     * then consumes from progress_queue rather than from the mailbox.
+     */
+    int progress_thread_enabled;
+    pthread_t progress_pthread;
+    volatile int progress_thread_stop;
+    hvr_progress_queue_t progress_queue;
+    void *progress_recv_buf;
+    size_t progress_recv_buf_size;
+    /*
+     * If HVR_ASYNC_ITERATIONS is set, a PE that is not coupled with any other
+     * PE skips the coupling protocol in update_coupled_values as well as the
+     * global barriers at the start of hvr_body, and advances through
+     * iterations without coordinating with other PEs.
+     */
+    int async_iterations;
+
+    // Number of times progress_queue filled up under the progress thread
+    volatile unsigned long long progress_queue_stalls;
+
+    /*
+     * If HVR_PIPELINE_CHUNK is set, update_vertices sends the updates to each
+     * changed vertex as soon as it is updated rather than in
+     * send_vertex_updates, flushing them and processing incoming updates after
+     * every pipeline_chunk sends. The remaining fields are per-iteration
+     * counters reported in the profiling output.
+     */
+    unsigned pipeline_chunk;
+    unsigned pipeline_n_unflushed;
+    unsigned pipeline_n_sent;
+    unsigned pipeline_n_recvd;
+    unsigned long long pipeline_time_sending;
+    unsigned long long pipeline_time;
+
+    /*
+     * If HVR_IDLE_ITERATIONS is set, a PE which is not coupled with any other
+     * PE and has gone idle_iterations iterations without updating, sending, or
+     * receiving anything stops iterating until a message arrives in one of
+     * its mailboxes or idle_timeout_us elapses. While waiting it polls its
+     * mailboxes with an exponential backoff capped at idle_max_backoff_us.
+     * idle_time is a per-iteration counter reported in the profiling output.
+     */
+    unsigned idle_iterations;
+    unsigned n_empty_iterations;
+    unsigned long long idle_timeout_us;
+    unsigned long long idle_max_backoff_us;
+    unsigned long long idle_time;
+
+    /*
+     * If a vertex priority is registered, update_vertices gathers the vertices
+     * that need processing into frontier ordered by decreasing priority, using
+     * priority_scratch to bucket them by priority. At most
+     * max_updates_per_iter of them are updated per iteration (all if 0), and
+     * the rest stay marked for the next iteration.
+     */
+    hvr_vertex_priority_func vertex_priority;
+    unsigned n_priority_buckets;
+    unsigned max_updates_per_iter;
+    unsigned *priority_bucket_counts;
+    struct _hvr_frontier_entry_t *frontier;
+    struct _hvr_frontier_entry_t *priority_scratch;
+
+    /*
+     * A slot per local vertex offset in which update_metadata can keep how far
+     * it got between resumptions (see hvr_vertex_resume_state), allocated on
+     * first use.
+     */
+    uint64_t *resume_state;
+    /*
+     * Local vertices waiting for remote vertices to be cached on this PE (see
+     * hvr_vertex_await_mirror), at most max_mirror_awaits of them at a time.
+     * update_vertices subscribes to the awaited vertices and marks the waiting
+     * ones for processing once they arrive.
+     */
+    hvr_mirror_await_t *mirror_awaits;
+    unsigned n_mirror_awaits;
+    unsigned max_mirror_awaits;
+
+    /*
+     * If HVR_DETERMINISTIC is set, process_vertex_updates stages the updates it
+     * drains (up to HVR_DETERMINISTIC_MAX_UPDATES) in staged_updates and
+     * applies them ordered by sending PE, each PE's updates in the order they
+     * were sent, rather than in the order their batches won the race into the
+     * mailbox. Nested calls (made while sending blocks on a full mailbox)
+     * stage above n_staged_updates. Messages buffered for local vertices are
+     * also polled in a canonical order. Which updates have arrived by the time
+     * they are drained still depends on timing unless HVR_STRICT is also set,
+     * in which case every PE waits at a barrier between sending and receiving
+     * and drains all it was sent, so that runs repeat exactly as long as no
+     * mailbox fills up.
+     */
+    int deterministic;
+    hvr_update_msg_t *staged_updates;
+    hvr_staged_update_t *staged_order;
+    unsigned n_staged_updates;
+    unsigned max_staged_updates;
+
+#ifdef MULTITHREADED
+    /*
+     * With more than one OpenMP thread, update_vertices calls update_metadata
+     * on the vertices in frontier in parallel. Each thread buffers its
+     * changes and messages in its own entry of threads, and those are applied
+     * in thread order once all threads finish. While in_parallel_update is
+     * set, cache_lock protects the vertex cache from concurrent creates.
+     */
+    int nthreads;
+    volatile int in_parallel_update;
+    struct _hvr_thread_state_t *threads;
+    unsigned max_thread_msgs;
+    pthread_rwlock_t cache_lock;
+
+    /*
+     * If HVR_PARALLEL_EDGE_MIN_PARTITIONS is set, create_new_edges scans the
+     * interacting partitions of an updated vertex in parallel whenever there
+     * are at least that many of them. Each thread collects the edges it finds
+     * in its found_edges, and they are applied serially afterwards.
+     * should_have_edge must then be thread safe.
+     */
+    unsigned parallel_edge_min_partitions;
+    unsigned max_thread_edges;
+    unsigned *partition_n_scanned;
+#endif
 } hvr_internal_ctx_t;
 
+/*
+ * A local vertex waiting to be updated in this iteration. id and old_part are
+ * saved before update_metadata runs so that vertices deleted while others
+ * are updated can be detected afterwards. priority is only used while
+ * gathering vertices by priority.
+ */
+typedef struct _hvr_frontier_entry_t {
+    hvr_vertex_t *vert;
+    hvr_vertex_id_t id;
+    hvr_partition_t old_part;
+    unsigned priority;
+} hvr_frontier_entry_t;
+
+#ifdef MULTITHREADED
+
+typedef struct _hvr_found_edge_t {
+    hvr_vertex_cache_node_t *node;
+    // Relative to node
+    hvr_edge_type_t edge;
+} hvr_found_edge_t;
+
+typedef struct _hvr_thread_state_t {
+    hvr_buffered_changes_t buffered_changes;
+    hvr_set_t *to_couple_with;
+    inter_vert_msg_t *msgs;
+    unsigned n_msgs;
+
+    hvr_vertex_id_t edge_buffer[MAX_MODIFICATIONS];
+    hvr_edge_payload_t edge_payload_buffer[MAX_MODIFICATIONS];
+    void *neighbors_list_pool;
+    mspace neighbors_list_tracker;
+
+    hvr_found_edge_t *found_edges;
+    unsigned n_found_edges;
+} hvr_thread_state_t;
+#endif
+
+// Where changes buffered by the calling thread should be stored
+static inline hvr_buffered_changes_t *hvr_current_buffered_changes(
+        hvr_internal_ctx_t *ctx) {
+#ifdef MULTITHREADED
+    if (ctx->in_parallel_update) {
+        return &ctx->threads[omp_get_thread_num()].buffered_changes;
+    }
+#endif
+    return &ctx->buffered_changes;
+}
+
+/*
+ * Guard accesses to the vertex cache map while update_metadata may be running
+ * on several threads. exclusive should be set by callers that modify it.
+ */
+#ifdef MULTITHREADED
+static inline void hvr_lock_vertex_cache(int exclusive,
+        hvr_internal_ctx_t *ctx) {
+    if (ctx->in_parallel_update) {
+        if (exclusive) {
+            pthread_rwlock_wrlock(&ctx->cache_lock);
+        } else {
+            pthread_rwlock_rdlock(&ctx->cache_lock);
+        }
+    }
+}
+
+static inline void hvr_unlock_vertex_cache(hvr_internal_ctx_t *ctx) {
+    if (ctx->in_parallel_update) {
+        pthread_rwlock_unlock(&ctx->cache_lock);
+    }
+}
+#else
+static inline void hvr_lock_vertex_cache(int, hvr_internal_ctx_t *) { }
+
+static inline void hvr_unlock_vertex_cache(hvr_internal_ctx_t *) { }
+#endif
+
 /*
  * Information on the execution of a problem after it completes which is
  * returned to the caller.
@@ -445,6 +1090,130 @@ extern void hvr_create_edge_with_vertex_id(hvr_vertex_t *base,
 extern void hvr_create_edge_with_vertex(hvr_vertex_t *base,
         hvr_vertex_t *neighbor, hvr_edge_type_t edge, hvr_ctx_t in_ctx);
 
+extern void hvr_create_edge_with_payload(hvr_vertex_t *base,
+        hvr_vertex_id_t neighbor, hvr_edge_type_t edge,
+        hvr_edge_payload_t payload, hvr_ctx_t in_ctx);
+
+/*
+ * Register a callback used to attach payloads to implicitly created edges.
+ * Should be called after hvr_init and before hvr_body.
+ */
+extern void hvr_set_edge_payload_func(hvr_edge_payload_func edge_payload,
+        hvr_ctx_t in_ctx);
+
+/*
+ * Register a batched equivalent of the should_have_edge passed to hvr_init,
+ * which is then used in its place during edge discovery. The two must agree.
+ * Should be called after hvr_init and before hvr_body.
+ */
+extern void hvr_set_should_have_edge_batch(
+        hvr_should_have_edge_batch should_have_edge_batch, hvr_ctx_t in_ctx);
+
+/*
+ * Declare that should_have_edge(a, b) always returns NO_EDGE if the keys
+ * produced by search_key for a and b differ by more than radius in any of
+ * their ndims dimensions. Edge discovery then only evaluates should_have_edge
+ * for vertices in nearby cells of a uniform grid over those keys, rather than
+ * for every vertex in every interacting partition. Should be called after
+ * hvr_init and before hvr_body.
+ */
+extern void hvr_set_edge_search_key(hvr_edge_search_key_func search_key,
+        unsigned ndims, double radius, hvr_ctx_t in_ctx);
+
+/*
+ * Allow the runtime to split partitions holding many vertices into n_children
+ * child partitions, defined by child_partition, so that edge discovery only
+ * scans the children of a hot partition that children_might_interact allows.
+ * Has no effect if hvr_set_edge_search_key is also used. Should be called
+ * after hvr_init and before hvr_body.
+ */
+extern void hvr_set_partition_refinement(unsigned n_children,
+        hvr_child_partition_func child_partition,
+        hvr_children_might_interact_func children_might_interact,
+        hvr_ctx_t in_ctx);
+
+/*
+ * Declare that the results of might_interact depend only on the partition
+ * passed to it, allowing the runtime to cache them. Should be called after
+ * hvr_init and before hvr_body.
+ */
+extern void hvr_declare_might_interact_pure(hvr_ctx_t in_ctx);
+
+/*
+ * Register a policy for migrating vertices between PEs to balance load. Only
+ * has an effect if HVR_MIGRATION_INTERVAL is set. Should be called after
+ * hvr_init and before hvr_body.
+ */
+extern void hvr_set_migration_policy(hvr_migration_policy_func policy,
+        hvr_ctx_t in_ctx);
+
+/*
+ * Update the vertices that need processing in each iteration in decreasing
+ * order of the priority returned by priority, e.g. the magnitude of the change
+ * in their inputs. Priorities of HVR_PRIORITY_BUCKETS (default 64) or more are
+ * treated as equal. If max_updates_per_iter is non-zero, only that many
+ * vertices with the highest priority are updated per iteration and the rest
+ * are deferred to later iterations. With multiple OpenMP threads, each thread
+ * takes the next vertices in priority order as it finishes its previous ones.
+ * Should be called after hvr_init and before hvr_body.
+ */
+extern void hvr_set_vertex_priority(hvr_vertex_priority_func priority,
+        unsigned max_updates_per_iter, hvr_ctx_t in_ctx);
+
+/*
+ * Request that a local vertex be moved to target_pe at the end of the current
+ * update phase, along with its attributes and explicit edges. Its new owner
+ * assigns it a new ID, and subscribers re-discover it there. Requires
+ * HVR_MIGRATION_INTERVAL to be set, and may only be called from the callbacks
+ * in which vertices can be created. Returns 1 if the migration was queued, or
+ * 0 if the vertex has more than HVR_MAX_MIGRATED_EDGES explicit edges.
+ */
+extern int hvr_vertex_migrate(hvr_vertex_t *vert, int target_pe,
+        hvr_ctx_t in_ctx);
+
+/*
+ * Called from update_metadata to split long-running work on a local vertex
+ * across iterations. The vertex is treated as updated once update_metadata
+ * returns, so any changes made to it so far are sent out as usual, and
+ * update_metadata is called on it again on the next iteration, after this PE
+ * has exchanged updates with other PEs and updated its other vertices. The
+ * application is responsible for keeping track of how far it got, e.g. in a
+ * table indexed by vertex ID.
+ */
+extern void hvr_vertex_yield(hvr_vertex_t *vert, hvr_ctx_t in_ctx);
+
+/*
+ * Return a slot, initially zero, in which update_metadata can keep how far it
+ * got on the local vertex vert between the calls that hvr_vertex_yield or
+ * hvr_vertex_await_mirror resume it on. The slot is reset when a new vertex is
+ * created in its place, and does not move with a migrated vertex.
+ */
+extern uint64_t *hvr_vertex_resume_state(hvr_vertex_t *vert, hvr_ctx_t in_ctx);
+
+/*
+ * Called from update_metadata on the local vertex vert to get the vertex id,
+ * which may not be cached on this PE yet. If it is, it is stored in *out and
+ * HVR_MIRROR_READY is returned. Otherwise, this PE subscribes to it at the
+ * start of the next update phase and HVR_MIRROR_PENDING is returned, and
+ * update_metadata is called on vert again once the vertex arrives (following
+ * it if it migrates) or turns out to no longer exist, at which point calling
+ * hvr_vertex_await_mirror again for id returns HVR_MIRROR_READY or
+ * HVR_MIRROR_MISSING. Meanwhile this PE keeps exchanging updates and updating
+ * its other vertices. At most HVR_MAX_MIRROR_AWAITS (default 1024) waits may
+ * be pending on a PE.
+ */
+extern hvr_mirror_status_t hvr_vertex_await_mirror(hvr_vertex_t *vert,
+        hvr_vertex_id_t id, hvr_vertex_t **out, hvr_ctx_t in_ctx);
+
+/*
+ * Follow the forwarding entries left by migrations to find the current ID of
+ * a vertex. Returns id itself if the vertex has not moved (or is still in
+ * flight), and HVR_INVALID_VERTEX_ID if its slot is known to now hold a
+ * different vertex.
+ */
+extern hvr_vertex_id_t hvr_resolve_vertex_id(hvr_vertex_id_t id,
+        hvr_ctx_t in_ctx);
+
 extern hvr_vertex_t *hvr_get_vertex(hvr_vertex_id_t id, hvr_ctx_t in_ctx);
 
 extern void hvr_send_msg(hvr_vertex_id_t dst, hvr_vertex_t *msg,
@@ -464,10 +1233,26 @@ extern void send_updates_to_all_subscribed_pes(
         unsigned long long *time_sending,
         hvr_internal_ctx_t *ctx);
 
+// Not for application use
+extern void hvr_partition_window_mark_dirty(hvr_partition_t p,
+        hvr_internal_ctx_t *ctx);
+
+// Not for application use
+extern void hvr_partition_dist_hist_insert(const hvr_vertex_t *vert,
+        hvr_partition_t p, hvr_internal_ctx_t *ctx);
+
+// Not for application use
+extern void hvr_partition_dist_hist_remove(const hvr_vertex_t *vert,
+        hvr_internal_ctx_t *ctx);
+
+// Not for application use
+extern void remove_hub_work(hvr_vertex_id_t offset, hvr_internal_ctx_t *ctx);
+
 static inline hvr_partition_t wrap_actor_to_partition(const hvr_vertex_t *vec,
         hvr_internal_ctx_t *ctx) {
     hvr_partition_t partition = ctx->actor_to_partition(vec, ctx);
-    assert(partition < ctx->n_partitions);
+    assert(partition < ctx->n_partitions ||
+            partition == HVR_INVALID_PARTITION);
     return partition;
 }
 
@@ -7,6 +7,7 @@ typedef struct _hvr_buffered_edge_create_t {
     hvr_vertex_id_t base_id;
     hvr_vertex_id_t neighbor_id;
     hvr_edge_type_t edge;
+    hvr_edge_payload_t payload;
 } hvr_buffered_edge_create_t;
 
 typedef struct _hvr_buffered_vertex_delete_t {
@@ -34,7 +35,7 @@ void hvr_buffered_changes_init(size_t nallocated,
 
 void hvr_buffered_changes_edge_create(hvr_vertex_id_t base_id,
         hvr_vertex_id_t neighbor_id, hvr_edge_type_t edge,
-        hvr_buffered_changes_t *changes);
+        hvr_edge_payload_t payload, hvr_buffered_changes_t *changes);
 
 void hvr_buffered_changes_delete_vertex(hvr_vertex_id_t to_delete,
         hvr_buffered_changes_t *changes);
@@ -19,12 +19,22 @@ typedef struct _hvr_buffered_msgs_t {
     hvr_buffered_msgs_node_t **buffered;
     size_t nvertices;
 
+    /*
+     * If set, the messages buffered for each vertex are sorted by their
+     * contents before the first of them is polled, so that they are polled in
+     * the same order regardless of the order in which they arrived. unsorted
+     * flags the vertices with messages inserted since their last sort.
+     * Otherwise, the most recently inserted message is polled first.
+     */
+    int ordered;
+    unsigned char *unsorted;
+
     void *pool;
     size_t pool_size;
     mspace allocator;
 } hvr_buffered_msgs_t;
 
-void hvr_buffered_msgs_init(size_t nvertices, size_t pool_size,
+void hvr_buffered_msgs_init(size_t nvertices, size_t pool_size, int ordered,
         hvr_buffered_msgs_t *b);
 
 void hvr_buffered_msgs_insert(size_t i, hvr_vertex_t *payload,
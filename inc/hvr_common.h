@@ -78,6 +78,13 @@ typedef struct _hvr_vertex_update_t hvr_vertex_update_t;
 
 typedef hvr_vertex_id_t hvr_edge_info_t;
 
+/*
+ * Optional fixed-size payload attached to an edge by the application (e.g. an
+ * edge weight or timestamp). Payloads are stored inline in the adjacency rows
+ * of hvr_irr_matrix and are 0 for edges created without one.
+ */
+typedef uint32_t hvr_edge_payload_t;
+
 static inline hvr_edge_type_t flip_edge_direction(hvr_edge_type_t dir) {
     switch (dir) {
         case (DIRECTED_IN):
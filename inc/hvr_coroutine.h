@@ -0,0 +1,160 @@
+#ifndef _HVR_COROUTINE_H
+#define _HVR_COROUTINE_H
+
+/*
+ * Optional C++20 wrappers for writing long-running per-vertex work in
+ * update_metadata as a coroutine that co_awaits the runtime, instead of
+ * stepping through hvr_vertex_resume_state by hand. For example:
+ *
+ *   static hvr_vertex_task_t work(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+ *       hvr_vertex_t *other = co_await hvr_await_mirror(vert, id, ctx);
+ *       ...
+ *       co_await hvr_yield_iteration(vert, ctx);
+ *       ...
+ *   }
+ *
+ *   static void update_metadata(hvr_vertex_t *vert, hvr_set_t *couple_with,
+ *           hvr_ctx_t ctx) {
+ *       hvr_vertex_run_task(vert, work, ctx);
+ *   }
+ *
+ * A suspended coroutine's frame is kept in its vertex's resume state, which
+ * the coroutine must therefore not use itself. Requests to couple with other
+ * PEs must be made from update_metadata, not from inside the coroutine.
+ */
+
+#if __cplusplus >= 202002L
+
+#include <coroutine>
+#include <stdlib.h>
+
+#include "hoover.h"
+
+struct _hvr_await_mirror_t;
+
+typedef struct _hvr_vertex_task_t {
+    struct promise_type {
+        /*
+         * Set while suspended waiting on a mirror, which is checked again
+         * before resuming in case the vertex was updated for another reason.
+         */
+        struct _hvr_await_mirror_t *waiting_on = NULL;
+
+        _hvr_vertex_task_t get_return_object() {
+            return _hvr_vertex_task_t{
+                std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        // Run until the first co_await within update_metadata
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        // Keep the frame so that hvr_vertex_run_task can see it finished
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { abort(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+} hvr_vertex_task_t;
+
+typedef hvr_vertex_task_t (*hvr_vertex_task_func)(hvr_vertex_t *vert,
+        hvr_ctx_t ctx);
+
+static_assert(sizeof(void *) <= sizeof(uint64_t),
+        "coroutine frames are kept in a vertex's resume state");
+
+/*
+ * co_await to resume on the next iteration, after this PE has exchanged
+ * updates with other PEs and updated its other vertices.
+ */
+typedef struct _hvr_yield_iteration_t {
+    hvr_vertex_t *vert;
+    hvr_ctx_t ctx;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const {
+        hvr_vertex_yield(vert, ctx);
+    }
+    void await_resume() const noexcept { }
+} hvr_yield_iteration_t;
+
+static inline hvr_yield_iteration_t hvr_yield_iteration(hvr_vertex_t *vert,
+        hvr_ctx_t ctx) {
+    return hvr_yield_iteration_t{vert, ctx};
+}
+
+/*
+ * co_await for the vertex id to be cached on this PE (see
+ * hvr_vertex_await_mirror). Evaluates to the vertex, or NULL if it no longer
+ * exists.
+ */
+typedef struct _hvr_await_mirror_t {
+    hvr_vertex_t *vert;
+    hvr_vertex_id_t id;
+    hvr_ctx_t ctx;
+    hvr_vertex_t *mirror;
+    hvr_mirror_status_t status;
+
+    bool await_ready() {
+        status = hvr_vertex_await_mirror(vert, id, &mirror, ctx);
+        return status != HVR_MIRROR_PENDING;
+    }
+    void await_suspend(std::coroutine_handle<hvr_vertex_task_t::promise_type>
+            handle) noexcept {
+        handle.promise().waiting_on = this;
+    }
+    hvr_vertex_t *await_resume() const noexcept { return mirror; }
+} hvr_await_mirror_t;
+
+static inline hvr_await_mirror_t hvr_await_mirror(hvr_vertex_t *vert,
+        hvr_vertex_id_t id, hvr_ctx_t ctx) {
+    return hvr_await_mirror_t{vert, id, ctx, NULL, HVR_MIRROR_PENDING};
+}
+
+/*
+ * Called from update_metadata to start task on the local vertex vert, or to
+ * resume the task already suspended on it.
+ */
+static inline void hvr_vertex_run_task(hvr_vertex_t *vert,
+        hvr_vertex_task_func task, hvr_ctx_t ctx) {
+    uint64_t *state = hvr_vertex_resume_state(vert, ctx);
+    std::coroutine_handle<hvr_vertex_task_t::promise_type> handle;
+    if (*state == 0) {
+        handle = task(vert, ctx).handle;
+    } else {
+        handle = std::coroutine_handle<hvr_vertex_task_t::promise_type>::
+            from_address((void *)*state);
+        hvr_await_mirror_t *await = handle.promise().waiting_on;
+        if (await) {
+            await->status = hvr_vertex_await_mirror(vert, await->id,
+                    &await->mirror, ctx);
+            if (await->status == HVR_MIRROR_PENDING) {
+                return;
+            }
+            handle.promise().waiting_on = NULL;
+        }
+        handle.resume();
+    }
+
+    if (handle.done()) {
+        handle.destroy();
+        *state = 0;
+    } else {
+        *state = (uint64_t)handle.address();
+    }
+}
+
+/*
+ * Free the frame of a task suspended on the local vertex vert, e.g. before
+ * deleting vert.
+ */
+static inline void hvr_vertex_cancel_task(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    uint64_t *state = hvr_vertex_resume_state(vert, ctx);
+    if (*state != 0) {
+        std::coroutine_handle<hvr_vertex_task_t::promise_type>::from_address(
+                (void *)*state).destroy();
+        *state = 0;
+    }
+}
+
+#endif // __cplusplus >= 202002L
+
+#endif // _HVR_COROUTINE_H
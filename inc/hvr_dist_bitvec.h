@@ -42,6 +42,29 @@ typedef struct _hvr_dist_bitvec_t {
     size_t pool_size;
 } hvr_dist_bitvec_t;
 
+/*
+ * Set and clear operations on a distributed bitvector, buffered locally and
+ * applied together by hvr_dist_bitvec_batch_flush. Operations that hit the
+ * same word are combined into a single remote atomic OR and/or AND, all
+ * remote atomics are issued before a single fence, and the sequence number of
+ * each touched row is only incremented once per flush. When the same bit is
+ * both set and cleared in a batch, the last operation wins.
+ */
+typedef struct _hvr_dist_bitvec_batch_op_t {
+    hvr_dist_bitvec_size_t coord0;
+    hvr_dist_bitvec_size_t coord1;
+    // Position of this operation in the batch, used to order conflicts
+    unsigned index;
+    int is_set;
+} hvr_dist_bitvec_batch_op_t;
+
+typedef struct _hvr_dist_bitvec_batch_t {
+    hvr_dist_bitvec_t *vec;
+    hvr_dist_bitvec_batch_op_t *ops;
+    unsigned n_ops;
+    unsigned capacity;
+} hvr_dist_bitvec_batch_t;
+
 // A local (not symmetric) copy of the values for a single row of the bitvector.
 typedef struct _hvr_dist_bitvec_local_subcopy_t {
     // The row coordinate of this local copy
@@ -53,8 +76,26 @@ typedef struct _hvr_dist_bitvec_local_subcopy_t {
     hvr_dist_bitvec_size_t dim1_length_in_words;
 
     uint64_t seq_no;
+
+    // Link in the free list of the pool this copy came from, if any
+    struct _hvr_dist_bitvec_local_subcopy_t *next_free;
 } hvr_dist_bitvec_local_subcopy_t;
 
+/*
+ * A pool of local subcopies (and their backing data) which is grown a slab of
+ * subcopies at a time and recycles released subcopies, for users that create
+ * and destroy many subcopies of the same bitvector.
+ */
+typedef struct _hvr_dist_bitvec_subcopy_pool_t {
+    hvr_dist_bitvec_size_t dim1;
+    hvr_dist_bitvec_size_t dim1_length_in_words;
+    hvr_dist_bitvec_local_subcopy_t *free_list;
+    size_t slab_size;
+    size_t n_allocated;
+    // Most recently allocated slab, whose first word links to the previous one
+    void *slabs;
+} hvr_dist_bitvec_subcopy_pool_t;
+
 void hvr_dist_bitvec_init(hvr_dist_bitvec_size_t dim0,
         hvr_dist_bitvec_size_t dim1, hvr_dist_bitvec_t *vec);
 
@@ -64,6 +105,23 @@ void hvr_dist_bitvec_set(hvr_dist_bitvec_size_t coord0,
 void hvr_dist_bitvec_clear(hvr_dist_bitvec_size_t coord0,
         hvr_dist_bitvec_size_t coord1, hvr_dist_bitvec_t *vec);
 
+/*
+ * A batch which fills up is flushed automatically. capacity may be overridden
+ * with HVR_DIST_BITVEC_BATCH_SIZE.
+ */
+void hvr_dist_bitvec_batch_init(hvr_dist_bitvec_t *vec, unsigned capacity,
+        hvr_dist_bitvec_batch_t *batch);
+
+void hvr_dist_bitvec_batch_set(hvr_dist_bitvec_size_t coord0,
+        hvr_dist_bitvec_size_t coord1, hvr_dist_bitvec_batch_t *batch);
+
+void hvr_dist_bitvec_batch_clear(hvr_dist_bitvec_size_t coord0,
+        hvr_dist_bitvec_size_t coord1, hvr_dist_bitvec_batch_t *batch);
+
+void hvr_dist_bitvec_batch_flush(hvr_dist_bitvec_batch_t *batch);
+
+void hvr_dist_bitvec_batch_destroy(hvr_dist_bitvec_batch_t *batch);
+
 size_t hvr_dist_bitvec_mem_used(hvr_dist_bitvec_t *vec);
 
 int hvr_dist_bitvec_owning_pe(hvr_dist_bitvec_size_t coord0,
@@ -75,12 +133,46 @@ void hvr_dist_bitvec_my_chunk(hvr_dist_bitvec_size_t *lower,
 void hvr_dist_bitvec_local_subcopy_init(hvr_dist_bitvec_t *vec,
         hvr_dist_bitvec_local_subcopy_t *out);
 
+/*
+ * slab_size is the number of subcopies allocated at once, and may be
+ * overridden with HVR_DIST_BITVEC_SLAB_SIZE.
+ */
+void hvr_dist_bitvec_subcopy_pool_init(hvr_dist_bitvec_t *vec,
+        size_t slab_size, hvr_dist_bitvec_subcopy_pool_t *pool);
+
+// Returns an empty subcopy, not yet associated with any row
+hvr_dist_bitvec_local_subcopy_t *hvr_dist_bitvec_subcopy_pool_acquire(
+        hvr_dist_bitvec_subcopy_pool_t *pool);
+
+void hvr_dist_bitvec_subcopy_pool_release(hvr_dist_bitvec_local_subcopy_t *c,
+        hvr_dist_bitvec_subcopy_pool_t *pool);
+
+// Frees every slab, including any subcopies still acquired from the pool
+void hvr_dist_bitvec_subcopy_pool_destroy(hvr_dist_bitvec_subcopy_pool_t *pool);
+
 void hvr_dist_bitvec_copy_locally(hvr_dist_bitvec_size_t coord0,
         hvr_dist_bitvec_t *vec, hvr_dist_bitvec_local_subcopy_t *out);
 
+/*
+ * Equivalent to calling hvr_dist_bitvec_copy_locally(coord0s[i], vec, outs[i])
+ * for each i < n, but the rows owned by each PE are read with a single get
+ * covering all of them, as are their sequence numbers. The number of round
+ * trips does not depend on n. coord0s may be in any order.
+ */
+void hvr_dist_bitvec_copy_rows_locally(const hvr_dist_bitvec_size_t *coord0s,
+        unsigned n, hvr_dist_bitvec_t *vec,
+        hvr_dist_bitvec_local_subcopy_t **outs);
+
 int hvr_dist_bitvec_local_subcopy_contains(hvr_dist_bitvec_size_t coord1,
         hvr_dist_bitvec_local_subcopy_t *vec);
 
+// Update a local copy in place, e.g. in response to a notification
+void hvr_dist_bitvec_local_subcopy_set(hvr_dist_bitvec_size_t coord1,
+        hvr_dist_bitvec_local_subcopy_t *vec);
+
+void hvr_dist_bitvec_local_subcopy_clear(hvr_dist_bitvec_size_t coord1,
+        hvr_dist_bitvec_local_subcopy_t *vec);
+
 void hvr_dist_bitvec_local_subcopy_copy(
         hvr_dist_bitvec_local_subcopy_t *dst,
         hvr_dist_bitvec_local_subcopy_t *src);
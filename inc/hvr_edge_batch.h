@@ -0,0 +1,43 @@
+/* For license: see LICENSE.txt file at top-level */
+
+#ifndef _HVR_EDGE_BATCH_H
+#define _HVR_EDGE_BATCH_H
+
+#include "hvr_common.h"
+#include "hvr_vertex.h"
+
+/*
+ * Reference implementations of hvr_should_have_edge_batch kernels, for use by
+ * applications whose edge predicate is a simple geometric test.
+ *
+ * Candidate values are laid out feature-major (candidate_values[f][i] is
+ * feature f of candidate i) so that the same feature of consecutive candidates
+ * can be loaded with a single vector load.
+ */
+
+/*
+ * Sets out_edges[i] to BIDIRECTIONAL if the Euclidean distance between the
+ * first ndims features of target and of candidate i is <= threshold, and to
+ * NO_EDGE otherwise. Uses AVX2 when the CPU it runs on supports it, whatever
+ * flags the library was built with, and produces the same results as the
+ * scalar loop in either case.
+ */
+void hvr_euclidean_edges_batch(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges);
+
+// The scalar loop used when AVX2 is not available
+void hvr_euclidean_edges_batch_scalar(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges);
+
+/*
+ * The AVX2 kernel, followed by the scalar loop for the last n_candidates % 4
+ * candidates. Returns 0 without touching out_edges if the CPU or compiler does
+ * not support AVX2.
+ */
+int hvr_euclidean_edges_batch_avx2(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges);
+
+#endif
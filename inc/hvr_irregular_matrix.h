@@ -9,14 +9,21 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
-#include "hvr_avl_tree.h"
+#include "hvr_ordered_set.h"
 
+/*
+ * Each row of the matrix is an ordered set keyed on neighbor offset. Because
+ * the key already identifies the neighbor, the stored value does not repeat
+ * it: the top bits hold the edge and creation type (in the same positions as
+ * in hvr_edge_info_t) and the low 32 bits hold the edge's payload.
+ * hvr_irr_matrix_linearize reconstructs full hvr_edge_info_t values.
+ */
 typedef struct _hvr_irr_matrix_t {
-    struct hvr_avl_node **edges;
+    hvr_ordered_set_node_t **edges;
     size_t nvertices;
     uint64_t nedges;
 
-    hvr_avl_node_allocator allocator;
+    hvr_ordered_set_allocator_t allocator;
 } hvr_irr_matrix_t;
 
 void hvr_irr_matrix_init(size_t nvertices, size_t pool_size,
@@ -26,16 +33,41 @@ void hvr_irr_matrix_get(hvr_vertex_id_t i, hvr_vertex_id_t j,
         const hvr_irr_matrix_t *m, hvr_edge_type_t *out_edge_type,
         hvr_edge_create_type_t *out_creation_type);
 
+hvr_edge_payload_t hvr_irr_matrix_get_payload(hvr_vertex_id_t i,
+        hvr_vertex_id_t j, const hvr_irr_matrix_t *m);
+
+/*
+ * Updating the edge type of an existing edge with hvr_irr_matrix_set preserves
+ * its payload, newly created edges have a payload of 0.
+ */
 void hvr_irr_matrix_set(hvr_vertex_id_t i, hvr_vertex_id_t j, hvr_edge_type_t e,
         hvr_edge_create_type_t creation_type, hvr_irr_matrix_t *m,
         int known_no_edge);
 
-struct hvr_avl_node *hvr_irr_matrix_tree(hvr_vertex_id_t i,
+void hvr_irr_matrix_set_with_payload(hvr_vertex_id_t i, hvr_vertex_id_t j,
+        hvr_edge_type_t e, hvr_edge_create_type_t creation_type,
+        hvr_edge_payload_t payload, hvr_irr_matrix_t *m, int known_no_edge);
+
+hvr_ordered_set_node_t *hvr_irr_matrix_tree(hvr_vertex_id_t i,
         hvr_irr_matrix_t *m);
 
 unsigned hvr_irr_matrix_linearize(hvr_vertex_id_t i,
         hvr_vertex_id_t *out_vals, size_t capacity, hvr_irr_matrix_t *m);
 
+// out_payloads[n] is filled with the payload of the edge in out_vals[n]
+unsigned hvr_irr_matrix_linearize_with_payloads(hvr_vertex_id_t i,
+        hvr_vertex_id_t *out_vals, hvr_edge_payload_t *out_payloads,
+        size_t capacity, hvr_irr_matrix_t *m);
+
+/*
+ * Linearizes at most capacity edges of row i whose neighbor offset is >=
+ * start, allowing a long row to be processed in bounded chunks. Unlike
+ * hvr_irr_matrix_linearize, reaching capacity is not an error.
+ */
+unsigned hvr_irr_matrix_linearize_from(hvr_vertex_id_t i,
+        hvr_vertex_id_t start, hvr_vertex_id_t *out_vals, size_t capacity,
+        hvr_irr_matrix_t *m);
+
 unsigned hvr_irr_matrix_row_len(hvr_vertex_id_t i, hvr_irr_matrix_t *m);
 
 void hvr_irr_matrix_usage(size_t *bytes_allocated, size_t *bytes_used,
@@ -35,6 +35,12 @@ int hvr_mailbox_send(const void *msg, size_t msg_len, int target_pe,
 int hvr_mailbox_recv(void *msg, size_t msg_capacity, size_t *msg_len,
         hvr_mailbox_t *mailbox);
 
+/*
+ * Returns 1 if my local mailbox currently holds no messages, without consuming
+ * any.
+ */
+int hvr_mailbox_is_empty(hvr_mailbox_t *mailbox);
+
 void hvr_mailbox_destroy(hvr_mailbox_t *mailbox);
 
 size_t hvr_mailbox_mem_used(hvr_mailbox_t *mailbox);
@@ -13,6 +13,8 @@ extern "C" {
 
 typedef struct _hvr_neighbors_t {
     hvr_edge_info_t *l;
+    // Payload of each edge in l, or NULL if no payloads were provided
+    hvr_edge_payload_t *payloads;
     unsigned l_len;
     unsigned iter;
     hvr_vertex_cache_t *cache;
@@ -29,18 +31,32 @@ static inline void hvr_neighbors_seek_to_valid(hvr_neighbors_t *n) {
     }
 }
 
-static inline void hvr_neighbors_init(hvr_vertex_id_t *l, unsigned l_len,
+/*
+ * payloads may be NULL. Otherwise, the payloads are stored in the same
+ * allocation as the neighbor list.
+ */
+static inline void hvr_neighbors_init(hvr_vertex_id_t *l,
+        hvr_edge_payload_t *payloads, unsigned l_len,
         hvr_vertex_cache_t *cache, mspace tracker, size_t pools_size,
         hvr_neighbors_t *n) {
-    n->l = (hvr_edge_info_t *)mspace_malloc(tracker, l_len * sizeof(n->l[0]));
+    const size_t nbytes = l_len * (sizeof(n->l[0]) +
+            (payloads ? sizeof(n->payloads[0]) : 0));
+    n->l = (hvr_edge_info_t *)mspace_malloc(tracker, nbytes);
     if (n->l == NULL) {
         fprintf(stderr, "ERROR failed allocating neighbor list of %lu bytes, "
                 "increase HVR_NEIGHBORS_LIST_POOL_SIZE (currently %lu)\n",
-                l_len * sizeof(n->l[0]), pools_size);
+                nbytes, pools_size);
         abort();
     }
     memcpy(n->l, l, l_len * sizeof(*l));
 
+    if (payloads) {
+        n->payloads = (hvr_edge_payload_t *)(n->l + l_len);
+        memcpy(n->payloads, payloads, l_len * sizeof(*payloads));
+    } else {
+        n->payloads = NULL;
+    }
+
     n->l_len = l_len;
     n->iter = 0;
     n->cache = cache;
@@ -56,8 +72,9 @@ static inline void hvr_neighbors_destroy(hvr_neighbors_t *n, mspace tracker) {
     mspace_free(tracker, n->l);
 }
 
-static inline int hvr_neighbors_next(hvr_neighbors_t *n,
-        hvr_vertex_t **out_neighbor, hvr_edge_type_t *out_type) {
+static inline int hvr_neighbors_next_with_payload(hvr_neighbors_t *n,
+        hvr_vertex_t **out_neighbor, hvr_edge_type_t *out_type,
+        hvr_edge_payload_t *out_payload) {
     if (n->iter >= n->l_len) {
         *out_neighbor = NULL;
         return 0;
@@ -67,9 +84,17 @@ static inline int hvr_neighbors_next(hvr_neighbors_t *n,
     assert(cached_neighbor->populated);
     *out_neighbor = &cached_neighbor->vert;
     *out_type = EDGE_INFO_EDGE(n->l[n->iter]);
+    if (out_payload) {
+        *out_payload = (n->payloads ? n->payloads[n->iter] : 0);
+    }
     n->iter += 1;
     hvr_neighbors_seek_to_valid(n);
     return 1;
 }
 
+static inline int hvr_neighbors_next(hvr_neighbors_t *n,
+        hvr_vertex_t **out_neighbor, hvr_edge_type_t *out_type) {
+    return hvr_neighbors_next_with_payload(n, out_neighbor, out_type, NULL);
+}
+
 #endif // _HVR_NEIGHBORS_H
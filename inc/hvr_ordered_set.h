@@ -0,0 +1,140 @@
+#ifndef _HVR_ORDERED_SET_H
+#define _HVR_ORDERED_SET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * An ordered set of uint32_t keys, each with an associated uint64_t value.
+ * This is intended as a more cache-friendly replacement for hvr_avl_tree, with
+ * the same pooled allocation semantics.
+ *
+ * Small sets are stored as a single flat, sorted array of keys followed by
+ * their values. As a set grows it is moved into progressively larger arrays
+ * until it fills a full node of HVR_ORDERED_SET_FANOUT keys, at which point it
+ * becomes a B+tree made of nodes of that size. Keys are searched linearly. A
+ * full node starts on a cache line, and its 8-byte header and 14 keys fill
+ * exactly that line, so a search within a node touches a single cache line.
+ *
+ * All operations are iterative. Deletes do not rebalance the tree: a node is
+ * only freed once it becomes empty, so the height of a tree is bounded by the
+ * number of keys ever inserted rather than its current size. In exchange,
+ * deletes never move keys between nodes. After many deletes, a leaf may hold a
+ * single key, so a set needs at most one full node (256 bytes) per key plus
+ * its inner nodes, against 32 bytes per key for an AVL tree. Sets that only
+ * grow, or that shrink and grow back, stay close to the AVL tree's footprint.
+ *
+ * An empty set is represented by a NULL root.
+ */
+
+#define HVR_ORDERED_SET_FANOUT 14
+/*
+ * Node sizes of 32, 64, 128, and 256 bytes, holding 2, 4, 8, and
+ * HVR_ORDERED_SET_FANOUT keys
+ */
+#define HVR_ORDERED_SET_N_CLASSES 4
+#define HVR_ORDERED_SET_MAX_DEPTH 16
+
+/*
+ * Node header. Keys are stored immediately after the header, followed by
+ * values (for leaves) or children (for inner nodes). The capacity of a node is
+ * determined by its size class. Only root leaves use the smaller size classes.
+ */
+typedef struct _hvr_ordered_set_node_t {
+    uint16_t nkeys;
+    uint8_t is_leaf;
+    uint8_t size_class;
+    // Total number of keys in the set, only maintained in the root
+    uint32_t set_size;
+} hvr_ordered_set_node_t;
+
+/*
+ * Nodes are carved out of a single preallocated pool as a binary buddy
+ * allocator over blocks of 32 to 256 bytes. The pool is handed out in 256-byte
+ * blocks, which are split in halves to allocate smaller nodes. A freed block
+ * is merged with its buddy whenever the buddy is also free, so memory freed
+ * in one size class can be reused for nodes of any other size class.
+ */
+struct _hvr_ordered_set_free_block_t;
+
+typedef struct _hvr_ordered_set_allocator_t {
+    char *mem;
+    size_t mem_size;
+    // Offset in mem of the first byte that has never been handed out
+    size_t bump;
+    // Doubly linked so that a block can be unlinked when its buddy is freed
+    struct _hvr_ordered_set_free_block_t *free_lists[HVR_ORDERED_SET_N_CLASSES];
+    /*
+     * One entry per 32 bytes of mem. Non-zero if a free block starts there, in
+     * which case it holds the block's size class plus one.
+     */
+    uint8_t *block_state;
+    size_t n_reserved_bytes;
+    size_t pool_size;
+    char *envvar;
+} hvr_ordered_set_allocator_t;
+
+/*
+ * In-order iterator over a set, which performs no allocation. The set must not
+ * be modified while it is being iterated over.
+ */
+typedef struct _hvr_ordered_set_iter_t {
+    hvr_ordered_set_node_t *nodes[HVR_ORDERED_SET_MAX_DEPTH];
+    unsigned pos[HVR_ORDERED_SET_MAX_DEPTH];
+    int depth;
+} hvr_ordered_set_iter_t;
+
+/*
+ * Returns 1 if key was inserted, 0 if it was already present (in which case
+ * its value is left unchanged).
+ */
+int hvr_ordered_set_insert(hvr_ordered_set_node_t **rootp, uint32_t key,
+        uint64_t value, hvr_ordered_set_allocator_t *allocator);
+
+// Returns 1 if key was found and removed, 0 otherwise.
+int hvr_ordered_set_delete(hvr_ordered_set_node_t **rootp, uint32_t key,
+        hvr_ordered_set_allocator_t *allocator);
+
+void hvr_ordered_set_delete_all(hvr_ordered_set_node_t *root,
+        hvr_ordered_set_allocator_t *allocator);
+
+/*
+ * Returns a pointer to the value stored for key, which may be updated in
+ * place, or NULL if key is not in the set.
+ */
+uint64_t *hvr_ordered_set_find(const hvr_ordered_set_node_t *root,
+        uint32_t key);
+
+// Copies all values into the values array in key order and returns the count
+unsigned hvr_ordered_set_serialize(const hvr_ordered_set_node_t *root,
+        uint64_t *values, unsigned arr_capacity);
+
+unsigned hvr_ordered_set_size(const hvr_ordered_set_node_t *root);
+
+void hvr_ordered_set_iter_init(hvr_ordered_set_iter_t *iter,
+        const hvr_ordered_set_node_t *root);
+
+// Starts iteration at the first key in the set that is >= start_key
+void hvr_ordered_set_iter_init_from(hvr_ordered_set_iter_t *iter,
+        const hvr_ordered_set_node_t *root, uint32_t start_key);
+
+/*
+ * Returns 1 and stores the next key and value in *out_key and *out_value (if
+ * they are non-NULL), or returns 0 once the set is exhausted.
+ */
+int hvr_ordered_set_iter_next(hvr_ordered_set_iter_t *iter,
+        uint32_t *out_key, uint64_t *out_value);
+
+/*
+ * pool_size is measured in the same units as for hvr_avl_node_allocator_init,
+ * i.e. the allocator reserves as much memory as pool_size AVL nodes would use,
+ * plus one byte of bookkeeping per AVL node.
+ */
+void hvr_ordered_set_allocator_init(hvr_ordered_set_allocator_t *allocator,
+        size_t pool_size, const char *envvar);
+
+void hvr_ordered_set_allocator_bytes_usage(
+        hvr_ordered_set_allocator_t *allocator, size_t *out_allocated,
+        size_t *out_used);
+
+#endif
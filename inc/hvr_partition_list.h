@@ -4,7 +4,7 @@
 #include "hoover.h"
 
 void hvr_partition_list_init(hvr_partition_t n_partitions,
-        hvr_partition_list_t *l);
+        int track_distances, hvr_partition_list_t *l);
 
 void prepend_to_partition_list(hvr_vertex_t *curr,
         hvr_partition_t part, hvr_partition_list_t *l, hvr_internal_ctx_t *ctx);
@@ -23,6 +23,41 @@ void update_partition_list_membership(hvr_vertex_t *curr,
 hvr_vertex_t *hvr_partition_list_head(hvr_partition_t part,
         hvr_partition_list_t *l);
 
+// Must be called before any vertices are added to l
+void hvr_partition_list_enable_grid(hvr_partition_list_t *l);
+
+/*
+ * Store the cells of the search grid that may contain vertices within
+ * search_radius of vert in out_cells (which must have room for
+ * 3^HVR_MAX_SEARCH_KEY_DIMS cells), and return how many there are.
+ */
+unsigned hvr_partition_list_grid_neighborhood(const hvr_vertex_t *vert,
+        uint64_t *out_cells, hvr_internal_ctx_t *ctx);
+
+hvr_vertex_cache_node_t *hvr_partition_list_grid_head(uint64_t cell,
+        hvr_partition_list_t *l);
+
+// Must be called before any vertices are added to l
+void hvr_partition_list_enable_children(unsigned n_children,
+        hvr_partition_list_t *l);
+
+int hvr_partition_list_is_split(hvr_partition_t part,
+        hvr_partition_list_t *l);
+
+hvr_vertex_cache_node_t *hvr_partition_list_child_head(hvr_partition_t part,
+        unsigned child, hvr_partition_list_t *l);
+
+// Record that n_scanned vertices of part were visited during edge discovery
+void hvr_partition_list_note_scan(hvr_partition_t part, unsigned n_scanned,
+        hvr_partition_list_t *l);
+
+/*
+ * Split hot partitions that are candidates for it and merge split partitions
+ * that have gone cold, then reset the traffic counters.
+ */
+void hvr_partition_list_refine(hvr_partition_list_t *l,
+        hvr_internal_ctx_t *ctx);
+
 void hvr_partition_list_destroy(hvr_partition_list_t *l);
 
 size_t hvr_partition_list_mem_used(hvr_partition_list_t *l);
@@ -0,0 +1,57 @@
+#ifndef _HVR_PROGRESS_QUEUE_H
+#define _HVR_PROGRESS_QUEUE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * A lock-free, single-producer single-consumer queue of variable-length
+ * messages stored in a circular buffer of local memory. Used to hand off
+ * messages drained from a symmetric mailbox by the communication progress
+ * thread to the main thread.
+ *
+ * head and tail count bytes written and read over the lifetime of the queue.
+ * Only the producer updates head and only the consumer updates tail.
+ */
+typedef struct _hvr_progress_queue_t {
+    char *buf;
+    uint64_t capacity_in_bytes;
+    uint64_t head;
+    uint64_t tail;
+} hvr_progress_queue_t;
+
+void hvr_progress_queue_init(hvr_progress_queue_t *q,
+        size_t capacity_in_bytes);
+
+/*
+ * Returns 1 if a message of msg_len bytes would currently fit in the queue.
+ * Only meaningful when called by the producer, as space is only ever freed
+ * concurrently.
+ */
+int hvr_progress_queue_has_space(size_t msg_len, hvr_progress_queue_t *q);
+
+/*
+ * Append msg to the queue. Returns 1 on success, or 0 if there is not enough
+ * space.
+ */
+int hvr_progress_queue_push(const void *msg, size_t msg_len,
+        hvr_progress_queue_t *q);
+
+/*
+ * Remove the oldest message from the queue, copying it into msg and storing its
+ * length in msg_len. Returns 0 if the queue is empty.
+ */
+int hvr_progress_queue_pop(void *msg, size_t msg_capacity, size_t *msg_len,
+        hvr_progress_queue_t *q);
+
+/*
+ * Returns 1 if the queue currently holds no messages. Only meaningful when
+ * called by the consumer, as messages are only ever added concurrently.
+ */
+int hvr_progress_queue_is_empty(hvr_progress_queue_t *q);
+
+size_t hvr_progress_queue_mem_used(hvr_progress_queue_t *q);
+
+void hvr_progress_queue_destroy(hvr_progress_queue_t *q);
+
+#endif
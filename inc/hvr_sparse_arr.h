@@ -9,7 +9,7 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
-#include "hvr_avl_tree.h"
+#include "hvr_ordered_set.h"
 
 /*
  * A HOOVER sparse array allows the insertion, deletion, and check for tuple
@@ -34,9 +34,39 @@ extern "C" {
 
 #define HVR_SPARSE_ARR_SEGMENT_SIZE 1024
 
+/*
+ * Each row in a sparse array is stored in one of three representations,
+ * depending on how many values it holds:
+ *
+ *   1. Inline: up to HVR_SPARSE_ARR_INLINE_VALS values stored directly in the
+ *      segment, with no allocation at all. Most rows (e.g. the subscribers of
+ *      a single vertex) live here.
+ *   2. Tree: an ordered set of values, for rows that outgrow the inline slots.
+ *   3. Bitmap: a dense bitmap over all possible values, allocated from
+ *      arr->allocator. Only available if the sparse array was created with a
+ *      non-zero value_capacity, and only used once a tree would take more
+ *      memory than the bitmap.
+ *
+ * Rows shrink back to the inline representation once they drop to half of
+ * the inline capacity, so that a row hovering around a threshold does not
+ * repeatedly convert.
+ */
+#define HVR_SPARSE_ARR_INLINE_VALS 4
+
+#define HVR_SPARSE_ARR_ROW_INLINE 0
+#define HVR_SPARSE_ARR_ROW_TREE 1
+#define HVR_SPARSE_ARR_ROW_BITMAP 2
+
+typedef union _hvr_sparse_arr_row_t {
+    uint32_t inline_vals[HVR_SPARSE_ARR_INLINE_VALS];
+    hvr_ordered_set_node_t *tree;
+    uint64_t *bitmap;
+} hvr_sparse_arr_row_t;
+
 typedef struct _hvr_sparse_arr_seg_t {
-    struct hvr_avl_node *seg[HVR_SPARSE_ARR_SEGMENT_SIZE];
+    hvr_sparse_arr_row_t seg[HVR_SPARSE_ARR_SEGMENT_SIZE];
     unsigned seg_size[HVR_SPARSE_ARR_SEGMENT_SIZE];
+    uint8_t seg_kind[HVR_SPARSE_ARR_SEGMENT_SIZE];
     // Only used for maintaining segs_pool
     struct _hvr_sparse_arr_seg_t *next;
 } hvr_sparse_arr_seg_t;
@@ -46,16 +76,76 @@ typedef struct _hvr_sparse_arr_t {
     unsigned capacity;
     unsigned nsegs;
 
+    /*
+     * Exclusive upper bound on values stored in this array, or 0 if unbounded
+     * (in which case rows never use the bitmap representation).
+     */
+    unsigned value_capacity;
+    unsigned bitmap_words;
+    // Row length beyond which a tree row is converted to a bitmap
+    unsigned bitmap_threshold;
+
     hvr_sparse_arr_seg_t *segs_pool;
     hvr_sparse_arr_seg_t *preallocated;
 
     void *pool;
     mspace allocator;
 
-    hvr_avl_node_allocator avl_allocator;
+    /*
+     * Tree rows are allocated from *set_allocator. This points at
+     * owned_set_allocator, except in a reverse index which shares both of its
+     * pools with the array it indexes.
+     */
+    hvr_ordered_set_allocator_t *set_allocator;
+    hvr_ordered_set_allocator_t owned_set_allocator;
+    int shares_pools;
+
+    /*
+     * Optional reverse index from values to the rows containing them, used to
+     * make hvr_sparse_arr_remove_value proportional to the number of rows
+     * containing the removed value rather than the capacity of the array.
+     * NULL unless hvr_sparse_arr_enable_reverse_index has been called.
+     */
+    struct _hvr_sparse_arr_t *reverse;
 } hvr_sparse_arr_t;
 
-extern void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity);
+/*
+ * Iterator over the values in a single row that performs no allocation. The
+ * row must not be modified while it is being iterated over. Values are
+ * returned in ascending order for tree and bitmap rows, and in insertion order
+ * for inline rows.
+ */
+typedef struct _hvr_sparse_arr_row_iter_t {
+    const hvr_sparse_arr_row_t *row;
+    uint8_t kind;
+    unsigned len;
+
+    // Inline rows: next index. Bitmap rows: current word index.
+    unsigned index;
+
+    // Bitmap rows
+    uint64_t curr_word;
+    unsigned bitmap_words;
+
+    // Tree rows
+    hvr_ordered_set_iter_t tree_iter;
+} hvr_sparse_arr_row_iter_t;
+
+/*
+ * Valid keys are in [0, capacity). If value_capacity is non-zero, all values
+ * inserted must be in [0, value_capacity) and dense rows will be stored as
+ * bitmaps.
+ */
+extern void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity,
+        unsigned value_capacity);
+
+/*
+ * Start maintaining a value->rows reverse index for arr. Must be called on an
+ * empty sparse array that was created with a non-zero value_capacity. The
+ * reverse index holds one entry per entry in arr and allocates them from
+ * arr's own pools, so HVR_SPARSE_ARR_POOL must leave room for both.
+ */
+extern void hvr_sparse_arr_enable_reverse_index(hvr_sparse_arr_t *arr);
 
 extern void hvr_sparse_arr_destroy(hvr_sparse_arr_t *arr);
 
@@ -79,6 +169,19 @@ extern unsigned hvr_sparse_arr_linearize_row(unsigned i, uint64_t **out_arr,
 extern void hvr_sparse_arr_release_row(uint64_t *out_arr,
         hvr_sparse_arr_t *arr);
 
+extern unsigned hvr_sparse_arr_row_length(unsigned i,
+        hvr_sparse_arr_t *arr);
+
+extern void hvr_sparse_arr_row_iter_init(hvr_sparse_arr_row_iter_t *iter,
+        unsigned i, hvr_sparse_arr_t *arr);
+
+/*
+ * Returns 1 and stores the next value in *out if there is one, returns 0 once
+ * the row is exhausted.
+ */
+extern int hvr_sparse_arr_row_iter_next(hvr_sparse_arr_row_iter_t *iter,
+        unsigned *out);
+
 extern size_t hvr_sparse_arr_used_bytes(hvr_sparse_arr_t *arr);
 
 #endif
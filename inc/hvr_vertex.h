@@ -36,7 +36,8 @@ extern hvr_vertex_t *hvr_vertex_create(hvr_ctx_t ctx);
  * Remove these vertices from the graph.
  */
 extern void hvr_vertex_delete(hvr_vertex_t *vert, hvr_ctx_t ctx);
-extern void hvr_vertex_delete_impl(hvr_vertex_t *vert, hvr_ctx_t ctx);
+extern void hvr_vertex_delete_impl(hvr_vertex_t *vert, int is_migration,
+        hvr_ctx_t ctx);
 
 /*
  * Initialize an empty sparse vector.
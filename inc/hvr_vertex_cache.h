@@ -41,6 +41,27 @@ typedef struct _hvr_vertex_cache_node_t {
     unsigned n_local_neighbors;
     unsigned n_explicit_edges;
     uint8_t dist_from_local_vert;
+    /*
+     * Partition whose distance histogram this node is counted in, or
+     * HVR_INVALID_PARTITION if it is not in a mirrored partition list.
+     */
+    hvr_partition_t dist_hist_part;
+
+    /*
+     * Used to chain together vertices in the same cell of a partition list's
+     * search grid, if there is one.
+     */
+    struct _hvr_vertex_cache_node_t *next_in_cell;
+    struct _hvr_vertex_cache_node_t *prev_in_cell;
+    uint64_t cell;
+
+    /*
+     * Used to chain together vertices in the same child of a split partition,
+     * if partitions are refined.
+     */
+    struct _hvr_vertex_cache_node_t *next_in_child;
+    struct _hvr_vertex_cache_node_t *prev_in_child;
+    unsigned child;
 
     int flag;
     int populated;
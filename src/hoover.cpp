@@ -8,6 +8,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <sys/time.h>
 #include <math.h>
 #include <limits.h>
@@ -52,7 +53,6 @@ typedef struct _profiling_info_t {
     unsigned long long start_iter_signaling_time;
 #endif
     unsigned long long end_update_vertices;
-    unsigned long long end_update_dist;
     unsigned long long end_update_partitions;
     unsigned long long end_partition_window;
     unsigned long long end_neighbor_updates;
@@ -95,6 +95,13 @@ typedef struct _profiling_info_t {
     uint64_t n_msgs_recvd_this_iter;
     uint64_t vertex_update_mailbox_nmsgs;
     uint64_t vertex_update_mailbox_nattempts;
+    unsigned long long progress_queue_stalls;
+
+    unsigned pipeline_n_sent;
+    unsigned pipeline_n_recvd;
+    unsigned long long pipeline_time_sending;
+    unsigned long long pipeline_time;
+    unsigned long long idle_time;
 
 #ifdef PRINT_PARTITIONS
     char *subscriber_partitions_str;
@@ -182,7 +189,10 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
         hvr_internal_ctx_t *ctx);
 
 static void handle_deleted_vertex(hvr_vertex_t *dead_vert,
-        int expect_no_edges,
+        int expect_no_edges, int is_migration,
+        hvr_internal_ctx_t *ctx);
+
+static void drop_vertex_subscription(hvr_vertex_id_t vid, int notify_owner,
         hvr_internal_ctx_t *ctx);
 
 static hvr_vertex_cache_node_t *set_up_vertex_subscription(hvr_vertex_id_t v,
@@ -192,10 +202,19 @@ static hvr_vertex_cache_node_t *set_up_vertex_subscription(hvr_vertex_id_t v,
 static unsigned process_vertex_updates(hvr_internal_ctx_t *ctx,
         process_perf_info_t *perf_info, int max_to_process);
 
+static void *progress_thread(void *user_data);
+
+static void pipeline_vertex_update(hvr_vertex_t *curr,
+        hvr_internal_ctx_t *ctx);
+
+static void flush_pipelined_updates(hvr_internal_ctx_t *ctx);
+
+static void deterministic_phase_barrier(hvr_internal_ctx_t *ctx);
+
 static uint64_t poll_for_dead_pes(hvr_internal_ctx_t *ctx);
 
 static void send_updates_to_all_subscribed_pes_helper(hvr_update_msg_t *msg,
-        uint64_t *subscribers, unsigned n_subscribers,
+        unsigned row, hvr_sparse_arr_t *subscribers,
         hvr_internal_ctx_t *ctx);
 
 static void inline hvr_vertex_update_init(hvr_vertex_update_t *msg,
@@ -207,16 +226,19 @@ static void inline hvr_vertex_update_init(hvr_vertex_update_t *msg,
 static inline void hvr_vert_update_init(hvr_update_msg_t *msg,
         const hvr_vertex_t *vert, uint8_t is_invalidation) {
     msg->is_vert_update = 1;
+    msg->is_snapshot = 0;
     hvr_vertex_update_init(&msg->payload.vert_update, vert, is_invalidation);
 }
 
 static inline void hvr_edge_update_init(hvr_update_msg_t *msg,
         hvr_vertex_t *src, hvr_vertex_id_t target, hvr_edge_type_t edge,
-        int is_forward) {
+        hvr_edge_payload_t payload, int is_forward) {
     msg->is_vert_update = 0;
+    msg->is_snapshot = 0;
     memcpy(&msg->payload.edge_update.src, src, sizeof(*src));
     msg->payload.edge_update.target = target;
     msg->payload.edge_update.edge = edge;
+    msg->payload.edge_update.payload = payload;
     msg->payload.edge_update.is_forward = is_forward;
 }
 
@@ -229,6 +251,7 @@ static void send_to_vertex_update_mailbox(hvr_update_msg_t *msg, int pe,
     int printed_warning = 0;
     unsigned ntries = 0;
     int success;
+    msg->src_pe = ctx->pe;
     do {
         success = hvr_mailbox_buffer_send(msg, sizeof(*msg),
                 pe, 100, &ctx->vertex_update_mailbox_buffer);
@@ -355,30 +378,124 @@ hvr_graph_id_t hvr_graph_create(hvr_ctx_t in_ctx) {
     return (1 << next_graph);
 }
 
-static void collect_impacted_vertices(hvr_vertex_cache_node_t *node,
-        hvr_vertex_cache_node_t **head, hvr_internal_ctx_t *ctx) {
-    if (node->tmp) {
-        // Already traversed and in the list
-        return;
+void hvr_partition_window_mark_dirty(hvr_partition_t p,
+        hvr_internal_ctx_t *ctx) {
+    if (!hvr_set_contains(p, ctx->dirty_partitions)) {
+        hvr_set_insert(p, ctx->dirty_partitions);
+        ctx->dirty_partitions_list[ctx->n_dirty_partitions++] = p;
     }
+}
 
-    node->tmp = *head;
-    *head = node;
+static inline int within_partition_window(uint8_t dist,
+        hvr_internal_ctx_t *ctx) {
+    return dist <= ctx->max_graph_traverse_depth - 1;
+}
 
-    unsigned n_neighbors = hvr_irr_matrix_linearize(
-            CACHE_NODE_OFFSET(node, &ctx->vec_cache), ctx->edge_buffer,
-            MAX_MODIFICATIONS, &ctx->edges);
+static inline unsigned dist_hist_bucket(uint8_t dist,
+        hvr_internal_ctx_t *ctx) {
+    const unsigned last = ctx->n_dist_hist_buckets - 1;
+    return (dist < last ? dist : last);
+}
 
-    for (unsigned n = 0; n < n_neighbors; n++) {
-        hvr_vertex_id_t offset = EDGE_INFO_VERTEX(ctx->edge_buffer[n]);
-        hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(offset,
-                &ctx->vec_cache);
-        if (neighbor->dist_from_local_vert == node->dist_from_local_vert + 1) {
-            collect_impacted_vertices(neighbor, head, ctx);
+/*
+ * Minimum distance from a local vertex of any mirrored vertex in p, or
+ * UINT8_MAX if none are closer than max_graph_traverse_depth.
+ */
+static inline uint8_t partition_min_mirror_dist(hvr_partition_t p,
+        hvr_internal_ctx_t *ctx) {
+    const unsigned *hist = ctx->partition_dist_hist +
+        (size_t)p * ctx->n_dist_hist_buckets;
+    for (unsigned b = 0; b < ctx->n_dist_hist_buckets - 1; b++) {
+        if (hist[b]) return b;
+    }
+    return UINT8_MAX;
+}
+
+static inline void dist_hist_update(hvr_partition_t p, unsigned bucket,
+        int delta, hvr_internal_ctx_t *ctx) {
+    const int was_within = within_partition_window(
+            partition_min_mirror_dist(p, ctx), ctx);
+
+    unsigned *count = ctx->partition_dist_hist +
+        (size_t)p * ctx->n_dist_hist_buckets + bucket;
+    if (delta > 0) {
+        *count += 1;
+    } else {
+        assert(*count > 0);
+        *count -= 1;
+    }
+
+    if (was_within != within_partition_window(
+                partition_min_mirror_dist(p, ctx), ctx)) {
+        hvr_partition_window_mark_dirty(p, ctx);
+    }
+}
+
+void hvr_partition_dist_hist_insert(const hvr_vertex_t *vert,
+        hvr_partition_t p, hvr_internal_ctx_t *ctx) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    assert(node->dist_hist_part == HVR_INVALID_PARTITION);
+    node->dist_hist_part = p;
+    dist_hist_update(p, dist_hist_bucket(node->dist_from_local_vert, ctx), 1,
+            ctx);
+}
+
+void hvr_partition_dist_hist_remove(const hvr_vertex_t *vert,
+        hvr_internal_ctx_t *ctx) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    assert(node->dist_hist_part != HVR_INVALID_PARTITION);
+    dist_hist_update(node->dist_hist_part,
+            dist_hist_bucket(node->dist_from_local_vert, ctx), -1, ctx);
+    node->dist_hist_part = HVR_INVALID_PARTITION;
+}
+
+// All changes to dist_from_local_vert must go through here
+static inline void set_dist_from_local_vert(hvr_vertex_cache_node_t *node,
+        uint8_t dist, hvr_internal_ctx_t *ctx) {
+    if (node->dist_hist_part != HVR_INVALID_PARTITION) {
+        const unsigned old_bucket = dist_hist_bucket(
+                node->dist_from_local_vert, ctx);
+        const unsigned new_bucket = dist_hist_bucket(dist, ctx);
+        if (old_bucket != new_bucket) {
+            dist_hist_update(node->dist_hist_part, old_bucket, -1, ctx);
+            dist_hist_update(node->dist_hist_part, new_bucket, 1, ctx);
         }
     }
+    node->dist_from_local_vert = dist;
+}
+
+/*
+ * Collect node and every vertex whose shortest path to a local vertex may pass
+ * through it into a list linked through tmp, resetting their distances. Walks
+ * the list breadth-first as it grows rather than recursing, so that a single
+ * edge buffer can be used for every vertex visited.
+ */
+static void collect_impacted_vertices(hvr_vertex_cache_node_t *node,
+        hvr_vertex_cache_node_t **head, hvr_internal_ctx_t *ctx) {
+    assert(*head == NULL);
+    *head = node;
+    hvr_vertex_cache_node_t *tail = node;
+
+    for (hvr_vertex_cache_node_t *curr = node; curr; curr = curr->tmp) {
+        unsigned n_neighbors = hvr_irr_matrix_linearize(
+                CACHE_NODE_OFFSET(curr, &ctx->vec_cache),
+                ctx->dist_edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
+
+        for (unsigned n = 0; n < n_neighbors; n++) {
+            hvr_vertex_id_t offset = EDGE_INFO_VERTEX(ctx->dist_edge_buffer[n]);
+            hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(offset,
+                    &ctx->vec_cache);
+            // Skip vertices already in the list
+            if (neighbor->dist_from_local_vert ==
+                    curr->dist_from_local_vert + 1 &&
+                    neighbor->tmp == NULL && neighbor != tail) {
+                tail->tmp = neighbor;
+                tail = neighbor;
+            }
+        }
 
-    node->dist_from_local_vert = UINT8_MAX;
+        set_dist_from_local_vert(curr, UINT8_MAX, ctx);
+    }
 }
 
 static int update_dist_from_neighbors(hvr_vertex_cache_node_t *node,
@@ -387,10 +504,10 @@ static int update_dist_from_neighbors(hvr_vertex_cache_node_t *node,
 
     unsigned n_neighbors = hvr_irr_matrix_linearize(
             CACHE_NODE_OFFSET(node, &ctx->vec_cache),
-            ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
+            ctx->dist_edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
 
     for (unsigned n = 0; n < n_neighbors; n++) {
-        hvr_vertex_id_t offset = EDGE_INFO_VERTEX(ctx->edge_buffer[n]);
+        hvr_vertex_id_t offset = EDGE_INFO_VERTEX(ctx->dist_edge_buffer[n]);
         hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(offset,
                 &ctx->vec_cache);
         uint8_t dist = neighbor->dist_from_local_vert;
@@ -400,7 +517,7 @@ static int update_dist_from_neighbors(hvr_vertex_cache_node_t *node,
     }
 
     int changed = (node->dist_from_local_vert != new_dist);
-    node->dist_from_local_vert = new_dist;
+    set_dist_from_local_vert(node, new_dist, ctx);
     return changed;
 }
 
@@ -427,23 +544,106 @@ static void update_distance_after_edge_update(hvr_vertex_cache_node_t *node,
     }
 }
 
+/*
+ * Called when a new edge gives node a shorter path to a local vertex through
+ * closer. Lowers node's distance, then the distances of every vertex with a
+ * shorter path through node, breadth-first. Vertices that were not connected
+ * to any local vertex before get their distances here too.
+ */
+static void update_distance_after_edge_create(hvr_vertex_cache_node_t *node,
+        const hvr_vertex_cache_node_t *closer, hvr_internal_ctx_t *ctx) {
+    set_dist_from_local_vert(node, closer->dist_from_local_vert + 1, ctx);
+
+    hvr_vertex_cache_node_t *head = node;
+    hvr_vertex_cache_node_t *tail = node;
+    for (hvr_vertex_cache_node_t *curr = node; curr; curr = curr->tmp) {
+        const unsigned dist = curr->dist_from_local_vert + 1;
+        unsigned n_neighbors = hvr_irr_matrix_linearize(
+                CACHE_NODE_OFFSET(curr, &ctx->vec_cache),
+                ctx->dist_edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
+
+        for (unsigned n = 0; n < n_neighbors; n++) {
+            hvr_vertex_id_t offset = EDGE_INFO_VERTEX(ctx->dist_edge_buffer[n]);
+            hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(offset,
+                    &ctx->vec_cache);
+            if (neighbor->dist_from_local_vert > dist) {
+                set_dist_from_local_vert(neighbor, dist, ctx);
+                // Skip vertices already in the list
+                if (neighbor->tmp == NULL && neighbor != tail) {
+                    tail->tmp = neighbor;
+                    tail = neighbor;
+                }
+            }
+        }
+    }
+
+    // Clear our list
+    while (head) {
+        hvr_vertex_cache_node_t *next = head->tmp;
+        head->tmp = NULL;
+        head = next;
+    }
+}
+
 static void send_edge_updates_to_subscribers(hvr_vertex_cache_node_t *node,
         hvr_vertex_cache_node_t *base, hvr_vertex_cache_node_t *neighbor,
-        hvr_edge_type_t new_edge, hvr_internal_ctx_t *ctx) {
+        hvr_edge_type_t new_edge, hvr_edge_payload_t payload,
+        hvr_internal_ctx_t *ctx) {
     assert(VERTEX_ID_PE(node->vert.id) == ctx->pe);
     const int pe = ctx->pe;
 
-    uint64_t *subscribers = NULL;
-    unsigned n_subscribers = hvr_sparse_arr_linearize_row(
-            VERTEX_ID_OFFSET(node->vert.id),
-            &subscribers, &ctx->remote_vert_subs);
+    const unsigned offset = VERTEX_ID_OFFSET(node->vert.id);
+    if (hvr_sparse_arr_row_length(offset, &ctx->remote_vert_subs) == 0) {
+        return;
+    }
 
     // If the local vertex has any remote subscribers, send them this new edge.
     hvr_update_msg_t msg;
-    hvr_edge_update_init(&msg, &base->vert, neighbor->vert.id, new_edge, 1);
-    send_updates_to_all_subscribed_pes_helper(&msg, subscribers, n_subscribers,
-            ctx);
-    hvr_sparse_arr_release_row(subscribers, &ctx->remote_vert_subs);
+    hvr_edge_update_init(&msg, &base->vert, neighbor->vert.id, new_edge,
+            payload, 1);
+    send_updates_to_all_subscribed_pes_helper(&msg, offset,
+            &ctx->remote_vert_subs, ctx);
+}
+
+/*
+ * Vertex attributes only need updating if this is an edge inbound in a given
+ * vertex (either directed in or bidirectional). new_edge direction is expressed
+ * relative to base (i.e. DIRECTED_IN means it is an inbound edge on base, and
+ * outbound on neighbor).
+ */
+static inline void mark_edge_endpoints_for_processing(
+        hvr_vertex_cache_node_t *base, hvr_vertex_cache_node_t *neighbor,
+        hvr_edge_type_t new_edge, int base_is_local, int neighbor_is_local,
+        hvr_internal_ctx_t *ctx) {
+    if (base_is_local && new_edge != DIRECTED_OUT) {
+        mark_for_processing(&base->vert, ctx);
+    }
+
+    if (neighbor_is_local && flip_edge_direction(new_edge) != DIRECTED_OUT) {
+        mark_for_processing(&neighbor->vert, ctx);
+    }
+}
+
+/*
+ * Send a change to an explicit edge between a local and a remote vertex to the
+ * remote subscribers of the local vertex.
+ */
+static void notify_explicit_edge_subscribers(hvr_vertex_cache_node_t *base,
+        hvr_vertex_cache_node_t *neighbor, hvr_edge_type_t new_edge,
+        hvr_edge_payload_t payload, int base_is_local, int neighbor_is_local,
+        hvr_internal_ctx_t *ctx) {
+    if (base_is_local == neighbor_is_local ||
+            !ctx->send_neighbor_updates_for_explicit_subs) {
+        return;
+    }
+
+    if (base_is_local) {
+        send_edge_updates_to_subscribers(base, base, neighbor, new_edge,
+                payload, ctx);
+    } else {
+        send_edge_updates_to_subscribers(neighbor, base, neighbor, new_edge,
+                payload, ctx);
+    }
 }
 
 // The only place where edges between vertices are created/deleted
@@ -451,6 +651,7 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
         hvr_vertex_cache_node_t *neighbor,
         hvr_edge_type_t new_edge,
         const hvr_edge_create_type_t creation_type,
+        hvr_edge_payload_t payload,
         const hvr_edge_type_t *known_existing_edge,
         const hvr_edge_create_type_t *known_existing_creation_type,
         int is_forwarded,
@@ -482,14 +683,38 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
             (new_edge != NO_EDGE && (existing_edge == NO_EDGE ||
                                      existing_edge == new_edge)));
 
-    if (existing_edge == new_edge) return;
+    if (existing_edge == new_edge) {
+        /*
+         * The edge itself is unchanged, but if payloads are in use its payload
+         * may have been updated.
+         */
+        if (new_edge != NO_EDGE && (payload != 0 || ctx->edge_payload) &&
+                hvr_irr_matrix_get_payload(base_offset, neighbor_offset,
+                    &ctx->edges) != payload) {
+            hvr_irr_matrix_set_with_payload(base_offset, neighbor_offset,
+                    new_edge, existing_creation_type, payload, &ctx->edges, 0);
+            hvr_irr_matrix_set_with_payload(neighbor_offset, base_offset,
+                    flip_edge_direction(new_edge), existing_creation_type,
+                    payload, &ctx->edges, 0);
+            mark_edge_endpoints_for_processing(base, neighbor, new_edge,
+                    base_is_local, neighbor_is_local, ctx);
+
+            // Subscribers only learn of explicit edges through us
+            if (creation_type == EXPLICIT_EDGE && !is_forwarded) {
+                notify_explicit_edge_subscribers(base, neighbor, new_edge,
+                        payload, base_is_local, neighbor_is_local, ctx);
+            }
+        }
+        return;
+    }
 
     if (existing_edge == NO_EDGE) {
         // new edge != NO_EDGE (creating a completely new edge)
-        hvr_irr_matrix_set(base_offset, neighbor_offset, new_edge,
-                creation_type, &ctx->edges, 1);
-        hvr_irr_matrix_set(neighbor_offset, base_offset,
-                flip_edge_direction(new_edge), creation_type, &ctx->edges, 1);
+        hvr_irr_matrix_set_with_payload(base_offset, neighbor_offset, new_edge,
+                creation_type, payload, &ctx->edges, 1);
+        hvr_irr_matrix_set_with_payload(neighbor_offset, base_offset,
+                flip_edge_direction(new_edge), creation_type, payload,
+                &ctx->edges, 1);
 
         base->n_local_neighbors += neighbor_is_local;
         neighbor->n_local_neighbors += base_is_local;
@@ -497,16 +722,15 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
         /*
          * Find if either vertex's distance-to-local is < the other's
          * minus one. If so, update the other's distance to be the new lower
-         * value, and cascade those updates through any neighbors whose
-         * distances are == the old value + 1.
+         * value, and cascade those updates through its neighbors.
          */
         if (base->dist_from_local_vert < neighbor->dist_from_local_vert - 1) {
             // Need to update neighbor and cascade
-            update_distance_after_edge_update(neighbor, ctx);
+            update_distance_after_edge_create(neighbor, base, ctx);
         } else if (neighbor->dist_from_local_vert <
                 base->dist_from_local_vert - 1) {
             // Need to update base and cascade
-            update_distance_after_edge_update(base, ctx);
+            update_distance_after_edge_create(base, neighbor, ctx);
         }
     } else if (new_edge == NO_EDGE) {
         // existing edge != NO_EDGE (deleting an existing edge)
@@ -519,6 +743,14 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
         base->n_local_neighbors -= neighbor_is_local;
         neighbor->n_local_neighbors -= base_is_local;
 
+        // Explicit edges are only removed along with a migrated vertex
+        if (existing_creation_type == EXPLICIT_EDGE) {
+            assert(base->n_explicit_edges > 0 &&
+                    neighbor->n_explicit_edges > 0);
+            base->n_explicit_edges--;
+            neighbor->n_explicit_edges--;
+        }
+
         /*
          * Check if either vertex's distance is equal to the other's
          * distance + 1. If so, its shortest path may be through that neighbor.
@@ -536,25 +768,19 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
         }
     } else {
         // Neither new or existing is NO_EDGE (updating existing edge)
-        hvr_irr_matrix_set(base_offset, neighbor_offset, new_edge,
-                creation_type, &ctx->edges, 0);
-        hvr_irr_matrix_set(neighbor_offset, base_offset, new_edge,
-                creation_type, &ctx->edges, 0);
+        hvr_irr_matrix_set_with_payload(base_offset, neighbor_offset, new_edge,
+                creation_type, payload, &ctx->edges, 0);
+        hvr_irr_matrix_set_with_payload(neighbor_offset, base_offset, new_edge,
+                creation_type, payload, &ctx->edges, 0);
     }
 
     if (creation_type == EXPLICIT_EDGE) {
         base->n_explicit_edges++;
         neighbor->n_explicit_edges++;
 
-        if (!is_forwarded && base_is_local != neighbor_is_local &&
-                ctx->send_neighbor_updates_for_explicit_subs) {
-            if (base_is_local) {
-                send_edge_updates_to_subscribers(base, base, neighbor, new_edge,
-                        ctx);
-            } else {
-                send_edge_updates_to_subscribers(neighbor, base, neighbor,
-                        new_edge, ctx);
-            }
+        if (!is_forwarded) {
+            notify_explicit_edge_subscribers(base, neighbor, new_edge, payload,
+                    base_is_local, neighbor_is_local, ctx);
         }
     }
 
@@ -584,24 +810,151 @@ static inline void update_edge_info(hvr_vertex_cache_node_t *base,
         }
     }
 
-    /*
-     * Vertex attributes only need updating if this is an edge inbound in a
-     * given vertex (either directed in or bidirectional). new_edge direction
-     * is expressed relative to base (i.e. DIRECTED_IN means it is an inbound
-     * edge on base, and outbound on neighbor).
-     */
-    if (base_is_local && new_edge != DIRECTED_OUT) {
-        mark_for_processing(&base->vert, ctx);
+    mark_edge_endpoints_for_processing(base, neighbor, new_edge,
+            base_is_local, neighbor_is_local, ctx);
+}
+
+static inline int is_hub(hvr_vertex_id_t offset, hvr_internal_ctx_t *ctx) {
+    return ctx->hub_degree_threshold > 0 &&
+        hvr_irr_matrix_row_len(offset, &ctx->edges) >
+        ctx->hub_degree_threshold;
+}
+
+static void defer_hub_work(hvr_vertex_cache_node_t *hub, int recheck_edges,
+        int mark_downstream, hvr_internal_ctx_t *ctx) {
+    const hvr_vertex_id_t offset = CACHE_NODE_OFFSET(hub, &ctx->vec_cache);
+
+    for (unsigned i = 0; i < ctx->n_pending_hubs; i++) {
+        hvr_hub_work_t *work = &ctx->pending_hubs[i];
+        if (work->offset == offset) {
+            // Keep walking from the current position, but wrap back around
+            work->end = work->next;
+            work->wrapped = 0;
+            work->recheck_edges |= recheck_edges;
+            work->mark_downstream |= mark_downstream;
+            return;
+        }
     }
 
-    if (neighbor_is_local && flip_edge_direction(new_edge) != DIRECTED_OUT) {
-        mark_for_processing(&neighbor->vert, ctx);
+    if (ctx->n_pending_hubs == ctx->max_pending_hubs) {
+        fprintf(stderr, "ERROR: PE %d exceeded the maximum number of pending "
+                "hub vertices (%u). Increase HVR_MAX_PENDING_HUBS.\n",
+                ctx->pe, ctx->max_pending_hubs);
+        abort();
+    }
+
+    hvr_hub_work_t *work = &ctx->pending_hubs[ctx->n_pending_hubs++];
+    work->id = hub->vert.id;
+    work->offset = offset;
+    work->next = 0;
+    work->end = 0;
+    work->wrapped = 0;
+    work->recheck_edges = recheck_edges;
+    work->mark_downstream = mark_downstream;
+}
+
+void remove_hub_work(hvr_vertex_id_t offset, hvr_internal_ctx_t *ctx) {
+    for (unsigned i = 0; i < ctx->n_pending_hubs; i++) {
+        if (ctx->pending_hubs[i].offset == offset) {
+            memmove(ctx->pending_hubs + i, ctx->pending_hubs + i + 1,
+                    (ctx->n_pending_hubs - i - 1) *
+                    sizeof(ctx->pending_hubs[0]));
+            ctx->n_pending_hubs--;
+            return;
+        }
     }
 }
 
+/*
+ * Make progress on deferred hub work, visiting at most hub_edges_per_iter
+ * edges in total. Hubs are serviced in the order they were first deferred.
+ */
+static void process_pending_hub_work(hvr_internal_ctx_t *ctx) {
+    unsigned budget = ctx->hub_edges_per_iter;
+    unsigned i = 0;
+
+    while (i < ctx->n_pending_hubs && budget > 0) {
+        hvr_hub_work_t *work = &ctx->pending_hubs[i];
+        hvr_vertex_cache_node_t *hub = CACHE_NODE_BY_OFFSET(work->offset,
+                &ctx->vec_cache);
+        assert(hub->vert.id == work->id);
+        int done = 0;
+
+        while (!done && budget > 0) {
+            const unsigned capacity = (budget < MAX_MODIFICATIONS ? budget :
+                    MAX_MODIFICATIONS);
+            unsigned n_neighbors = hvr_irr_matrix_linearize_from(work->offset,
+                    work->next, ctx->edge_buffer, capacity, &ctx->edges);
+
+            if (work->wrapped) {
+                unsigned limit = 0;
+                while (limit < n_neighbors &&
+                        EDGE_INFO_VERTEX(ctx->edge_buffer[limit]) < work->end) {
+                    limit++;
+                }
+                done = (limit < n_neighbors || n_neighbors < capacity);
+                n_neighbors = limit;
+            }
+
+            for (unsigned n = 0; n < n_neighbors; n++) {
+                hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
+                        EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
+                hvr_edge_type_t edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
+                hvr_edge_create_type_t create_type = EDGE_INFO_CREATION(
+                        ctx->edge_buffer[n]);
+
+                if (work->recheck_edges) {
+                    hvr_edge_type_t new_edge = ctx->should_have_edge(
+                            &hub->vert, &cached_neighbor->vert, ctx);
+                    hvr_edge_payload_t payload = 0;
+                    if (new_edge != NO_EDGE && ctx->edge_payload) {
+                        payload = ctx->edge_payload(&hub->vert,
+                                &cached_neighbor->vert, ctx);
+                    }
+                    update_edge_info(hub, cached_neighbor, new_edge,
+                            IMPLICIT_EDGE, payload, &edge, &create_type, 0,
+                            ctx);
+                }
+
+                if (work->mark_downstream && edge != DIRECTED_IN &&
+                        hvr_vertex_get_owning_pe(&cached_neighbor->vert) ==
+                        ctx->pe) {
+                    mark_for_processing(&cached_neighbor->vert, ctx);
+                }
+            }
+            budget -= n_neighbors;
+
+            if (!done) {
+                if (n_neighbors < capacity) {
+                    // Reached the end of the row
+                    if (work->end == 0) {
+                        done = 1;
+                    } else {
+                        work->wrapped = 1;
+                        work->next = 0;
+                    }
+                } else {
+                    work->next = EDGE_INFO_VERTEX(
+                            ctx->edge_buffer[n_neighbors - 1]) + 1;
+                }
+            }
+        }
+
+        if (done) {
+            remove_hub_work(work->offset, ctx);
+        } else {
+            i++;
+        }
+    }
+}
 
 static void mark_all_downstream_neighbors_for_processing(
         hvr_vertex_cache_node_t *modified, hvr_internal_ctx_t *ctx) {
+    if (is_hub(CACHE_NODE_OFFSET(modified, &ctx->vec_cache), ctx)) {
+        defer_hub_work(modified, 0, 1, ctx);
+        return;
+    }
+
     unsigned n_neighbors = hvr_irr_matrix_linearize(
             CACHE_NODE_OFFSET(modified, &ctx->vec_cache),
             ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
@@ -622,83 +975,385 @@ static void mark_all_downstream_neighbors_for_processing(
 }
 
 /*
-* Figure out what edges need to be added here, from should_have_edge and then
-* insert them for the new vertex. Eventually, any local vertex which had a new
-* edge inserted will need to be updated.
-*/
-static unsigned create_new_edges(hvr_vertex_cache_node_t *updated,
-        const hvr_partition_t *interacting, unsigned n_interacting,
-        hvr_partition_list_t *partition_lists,
+ * edge is the result of should_have_edge(cache_node, updated), i.e. relative
+ * to cache_node.
+ */
+static inline void apply_new_edge(hvr_vertex_cache_node_t *cache_node,
+        hvr_vertex_cache_node_t *updated, hvr_vertex_id_t updated_offset,
+        hvr_edge_type_t edge, int check_existing, hvr_internal_ctx_t *ctx) {
+    hvr_edge_payload_t payload = 0;
+    if (edge != NO_EDGE && ctx->edge_payload) {
+        payload = ctx->edge_payload(&cache_node->vert, &updated->vert, ctx);
+    }
+    hvr_edge_type_t existing_edge = NO_EDGE;
+    hvr_edge_create_type_t existing_create_type = IMPLICIT_EDGE;
+    if (check_existing) {
+        hvr_irr_matrix_get(CACHE_NODE_OFFSET(cache_node, &ctx->vec_cache),
+                updated_offset, &ctx->edges, &existing_edge,
+                &existing_create_type);
+    }
+    update_edge_info(cache_node, updated, edge, IMPLICIT_EDGE, payload,
+            &existing_edge, &existing_create_type, 0, ctx);
+}
+
+/*
+ * Evaluate should_have_edge_batch for updated against every vertex in
+ * ctx->batch_nodes, leaving the results (relative to updated) in
+ * ctx->batch_edges.
+ */
+static void evaluate_edge_batch(hvr_vertex_cache_node_t *updated,
         hvr_internal_ctx_t *ctx) {
-    assert(updated->vert.curr_part != HVR_INVALID_PARTITION);
+    const double *candidate_values[HVR_MAX_VECTOR_SIZE];
+    for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+        candidate_values[f] = ctx->batch_values[f];
+    }
+    ctx->should_have_edge_batch(&updated->vert, candidate_values,
+            ctx->n_batched, ctx->batch_edges, ctx);
+}
 
-    unsigned local_count_new_should_have_edges = 0;
-    const hvr_edge_type_t no_edge = NO_EDGE;
-    const hvr_edge_create_type_t no_create_type = IMPLICIT_EDGE;
+static inline void add_to_edge_batch(hvr_vertex_cache_node_t *cache_node,
+        hvr_internal_ctx_t *ctx) {
+    const unsigned i = ctx->n_batched++;
+    assert(i < HVR_EDGE_BATCH_SIZE);
+    ctx->batch_nodes[i] = cache_node;
+    for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+        ctx->batch_values[f][i] = cache_node->vert.values[f];
+    }
+}
 
-    for (unsigned i = 0; i < n_interacting; i++) {
-        hvr_partition_t other_part = interacting[i];
+static void flush_new_edge_batch(hvr_vertex_cache_node_t *updated,
+        hvr_vertex_id_t updated_offset, int check_existing,
+        hvr_internal_ctx_t *ctx) {
+    if (ctx->n_batched == 0) return;
+
+    evaluate_edge_batch(updated, ctx);
+    for (unsigned i = 0; i < ctx->n_batched; i++) {
+        apply_new_edge(ctx->batch_nodes[i], updated, updated_offset,
+                flip_edge_direction(ctx->batch_edges[i]), check_existing, ctx);
+    }
+    ctx->n_batched = 0;
+}
+
+static inline void create_new_edge_with(hvr_vertex_cache_node_t *cache_node,
+        hvr_vertex_cache_node_t *updated, hvr_vertex_id_t updated_offset,
+        int check_existing, hvr_internal_ctx_t *ctx) {
+    if (ctx->should_have_edge_batch) {
+        add_to_edge_batch(cache_node, ctx);
+        if (ctx->n_batched == HVR_EDGE_BATCH_SIZE) {
+            flush_new_edge_batch(updated, updated_offset, check_existing, ctx);
+        }
+        return;
+    }
 
+    assert(ctx->should_have_edge);
+    hvr_edge_type_t edge = ctx->should_have_edge(&cache_node->vert,
+            &updated->vert, ctx);
+    apply_new_edge(cache_node, updated, updated_offset, edge, check_existing,
+            ctx);
+}
+
+/*
+ * Consider an edge between updated and cache_node. If found is NULL the edge
+ * is created (or batched) immediately, otherwise the result of should_have_edge
+ * is saved in found to be applied later.
+ */
+static inline void visit_new_edge_candidate(hvr_vertex_cache_node_t *cache_node,
+        hvr_vertex_cache_node_t *updated, hvr_vertex_id_t updated_offset,
+        int check_existing, struct _hvr_thread_state_t *found,
+        hvr_internal_ctx_t *ctx) {
+#ifdef MULTITHREADED
+    if (found) {
+        hvr_edge_type_t edge = ctx->should_have_edge(&cache_node->vert,
+                &updated->vert, ctx);
+        if (edge == NO_EDGE && !check_existing) {
+            return;
+        }
+        if (found->n_found_edges == ctx->max_thread_edges) {
+            fprintf(stderr, "ERROR: PE %d thread %d found too many edges "
+                    "for a single vertex (%u). Increase "
+                    "HVR_MAX_THREAD_EDGES.\n", ctx->pe, omp_get_thread_num(),
+                    ctx->max_thread_edges);
+            abort();
+        }
+        hvr_found_edge_t *entry = found->found_edges + found->n_found_edges++;
+        entry->node = cache_node;
+        entry->edge = edge;
+        return;
+    }
+#else
+    (void)found;
+#endif
+    create_new_edge_with(cache_node, updated, updated_offset, check_existing,
+            ctx);
+}
+
+/*
+ * Visit every vertex in other_part that might have a new edge with updated,
+ * returning how many were visited. *updated_child is the child partition
+ * updated falls in, computed on first use if it is UINT_MAX.
+ */
+static unsigned scan_partition_for_new_edges(hvr_vertex_cache_node_t *updated,
+        hvr_vertex_id_t updated_offset, hvr_partition_t updated_part,
+        unsigned *updated_child, hvr_partition_t other_part,
+        hvr_partition_list_t *partition_lists, int check_existing,
+        struct _hvr_thread_state_t *found, hvr_internal_ctx_t *ctx) {
+    unsigned n_scanned = 0;
+
+    if (hvr_partition_list_is_split(other_part, partition_lists)) {
+        /*
+         * Only scan the children of a split partition that might interact
+         * with the child updated would be in.
+         */
+        if (*updated_child == UINT_MAX) {
+            *updated_child = ctx->child_partition(&updated->vert,
+                    updated_part, ctx);
+        }
+        for (unsigned c = 0; c < partition_lists->n_children; c++) {
+            if (!ctx->children_might_interact(updated_part, *updated_child,
+                        other_part, c, ctx)) {
+                continue;
+            }
+            hvr_vertex_cache_node_t *cache_node =
+                hvr_partition_list_child_head(other_part, c,
+                        partition_lists);
+            while (cache_node) {
+                if (!cache_node->flag) {
+                    visit_new_edge_candidate(cache_node, updated,
+                            updated_offset, check_existing, found, ctx);
+                    n_scanned++;
+                }
+                cache_node = cache_node->next_in_child;
+            }
+        }
+    } else {
         hvr_vertex_t *cache_iter = hvr_partition_list_head(other_part,
             partition_lists);
         while (cache_iter) {
             hvr_vertex_cache_node_t *cache_node =
                 (hvr_vertex_cache_node_t *)cache_iter;
             if (!cache_node->flag) {
-                assert(ctx->should_have_edge);
-                hvr_edge_type_t edge = ctx->should_have_edge(cache_iter,
-                        &updated->vert, ctx);
-                update_edge_info(cache_node, updated, edge, IMPLICIT_EDGE,
-                        &no_edge, &no_create_type, 0, ctx);
-                local_count_new_should_have_edges++;
+                visit_new_edge_candidate(cache_node, updated, updated_offset,
+                        check_existing, found, ctx);
+                n_scanned++;
             }
 
             cache_iter = cache_iter->next_in_partition;
         }
     }
 
-    return local_count_new_should_have_edges;
+    return n_scanned;
 }
 
-static unsigned update_existing_edges(hvr_vertex_cache_node_t *updated,
-        const hvr_partition_t *interacting,
-        unsigned n_interacting, hvr_internal_ctx_t *ctx) {
-    assert(updated->vert.curr_part != HVR_INVALID_PARTITION);
-
-    unsigned local_count_new_should_have_edges = 0;
-
-    /*
-     * Look for existing edges and verify they should still exist with
-     * this update to the local mirror.
-     */
-    unsigned n_neighbors = hvr_irr_matrix_linearize(
-            CACHE_NODE_OFFSET(updated, &ctx->vec_cache),
-            ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
+#ifdef MULTITHREADED
+/*
+ * Parallel version of the partition scan in create_new_edges. Each
+ * interacting partition is a task, handed out dynamically so that threads that
+ * finish early pick up the remaining partitions. Edges found are applied to
+ * ctx->edges serially, once all partitions have been scanned.
+ */
+static unsigned create_new_edges_parallel(hvr_vertex_cache_node_t *updated,
+        const hvr_partition_t *interacting, unsigned n_interacting,
+        hvr_partition_list_t *partition_lists, int check_existing,
+        hvr_internal_ctx_t *ctx) {
+    const hvr_vertex_id_t updated_offset = CACHE_NODE_OFFSET(updated,
+            &ctx->vec_cache);
+    const hvr_partition_t updated_part = updated->vert.curr_part;
+    // Computed up front so that the threads never call child_partition
+    const unsigned updated_child = (partition_lists->has_children ?
+            ctx->child_partition(&updated->vert, updated_part, ctx) : UINT_MAX);
 
-    for (unsigned n = 0; n < n_neighbors; n++) {
-        hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
-                EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
-        hvr_edge_type_t edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
-        hvr_edge_create_type_t create_type = EDGE_INFO_CREATION(
-                ctx->edge_buffer[n]);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(ctx->nthreads)
+    for (unsigned i = 0; i < n_interacting; i++) {
+        hvr_thread_state_t *thread = ctx->threads + omp_get_thread_num();
+        unsigned child = updated_child;
+        ctx->partition_n_scanned[i] = scan_partition_for_new_edges(updated,
+                updated_offset, updated_part, &child, interacting[i],
+                partition_lists, check_existing, thread, ctx);
+    }
 
-        // Check this edge should still exist
-        assert(ctx->should_have_edge);
-        hvr_edge_type_t new_edge = ctx->should_have_edge(
-                &updated->vert, &(cached_neighbor->vert), ctx);
-        update_edge_info(updated, cached_neighbor, new_edge, IMPLICIT_EDGE,
-                &edge, &create_type, 0, ctx);
+    for (int t = 0; t < ctx->nthreads; t++) {
+        hvr_thread_state_t *thread = ctx->threads + t;
+        for (unsigned e = 0; e < thread->n_found_edges; e++) {
+            apply_new_edge(thread->found_edges[e].node, updated,
+                    updated_offset, thread->found_edges[e].edge,
+                    check_existing, ctx);
+        }
+        thread->n_found_edges = 0;
+    }
 
-        // Mark that we've already handled it
-        cached_neighbor->flag = 1;
+    unsigned local_count_new_should_have_edges = 0;
+    for (unsigned i = 0; i < n_interacting; i++) {
+        if (partition_lists->has_children) {
+            hvr_partition_list_note_scan(interacting[i],
+                    ctx->partition_n_scanned[i], partition_lists);
+        }
+        local_count_new_should_have_edges += ctx->partition_n_scanned[i];
     }
+    return local_count_new_should_have_edges;
+}
+#endif
 
-    const unsigned long long done_updating_edges = hvr_current_time_us();
+/*
+* Figure out what edges need to be added here, from should_have_edge and then
+* insert them for the new vertex. Eventually, any local vertex which had a new
+* edge inserted will need to be updated.
+*
+* Unless check_existing is set, any vertex that already has an edge with
+* updated must have been flagged by the caller.
+*/
+static unsigned create_new_edges(hvr_vertex_cache_node_t *updated,
+        const hvr_partition_t *interacting, unsigned n_interacting,
+        hvr_partition_list_t *partition_lists, int check_existing,
+        hvr_internal_ctx_t *ctx) {
+    assert(updated->vert.curr_part != HVR_INVALID_PARTITION);
+
+    unsigned local_count_new_should_have_edges = 0;
+    const hvr_vertex_id_t updated_offset = CACHE_NODE_OFFSET(updated,
+            &ctx->vec_cache);
+
+    if (partition_lists->has_grid) {
+        /*
+         * Only vertices in grid cells adjacent to updated's can have an edge
+         * with it. Of those, consider the ones in interacting partitions.
+         */
+        for (unsigned i = 0; i < n_interacting; i++) {
+            hvr_set_insert(interacting[i], ctx->search_partitions);
+        }
+
+        uint64_t cells[27];
+        const unsigned n_cells = hvr_partition_list_grid_neighborhood(
+                &updated->vert, cells, ctx);
+        for (unsigned c = 0; c < n_cells; c++) {
+            hvr_vertex_cache_node_t *cache_node =
+                hvr_partition_list_grid_head(cells[c], partition_lists);
+            while (cache_node) {
+                if (!cache_node->flag && hvr_set_contains(
+                            cache_node->vert.curr_part,
+                            ctx->search_partitions)) {
+                    create_new_edge_with(cache_node, updated, updated_offset,
+                            check_existing, ctx);
+                    local_count_new_should_have_edges++;
+                }
+                cache_node = cache_node->next_in_cell;
+            }
+        }
+
+        flush_new_edge_batch(updated, updated_offset, check_existing, ctx);
+
+        for (unsigned i = 0; i < n_interacting; i++) {
+            hvr_set_clear(interacting[i], ctx->search_partitions);
+        }
+        return local_count_new_should_have_edges;
+    }
+
+    const hvr_partition_t updated_part = updated->vert.curr_part;
+    unsigned updated_child = UINT_MAX;
+
+#ifdef MULTITHREADED
+    if (ctx->parallel_edge_min_partitions > 0 && ctx->nthreads > 1 &&
+            n_interacting >= ctx->parallel_edge_min_partitions &&
+            !ctx->should_have_edge_batch) {
+        return create_new_edges_parallel(updated, interacting, n_interacting,
+                partition_lists, check_existing, ctx);
+    }
+#endif
+
+    for (unsigned i = 0; i < n_interacting; i++) {
+        hvr_partition_t other_part = interacting[i];
+        const unsigned n_scanned = scan_partition_for_new_edges(updated,
+                updated_offset, updated_part, &updated_child, other_part,
+                partition_lists, check_existing, NULL, ctx);
+
+        if (partition_lists->has_children) {
+            hvr_partition_list_note_scan(other_part, n_scanned,
+                    partition_lists);
+        }
+        local_count_new_should_have_edges += n_scanned;
+    }
+    flush_new_edge_batch(updated, updated_offset, check_existing, ctx);
+
+    return local_count_new_should_have_edges;
+}
+
+static unsigned update_existing_edges(hvr_vertex_cache_node_t *updated,
+        const hvr_partition_t *interacting,
+        unsigned n_interacting, hvr_internal_ctx_t *ctx) {
+    assert(updated->vert.curr_part != HVR_INVALID_PARTITION);
+
+    unsigned local_count_new_should_have_edges = 0;
+
+    if (is_hub(CACHE_NODE_OFFSET(updated, &ctx->vec_cache), ctx)) {
+        /*
+         * Existing edges on a hub are re-checked incrementally by
+         * process_pending_hub_work. Edges with vertices in interacting
+         * partitions are still created (or updated) immediately.
+         */
+        defer_hub_work(updated, 1, 0, ctx);
+        local_count_new_should_have_edges += create_new_edges(updated,
+                interacting, n_interacting, &ctx->mirror_partition_lists, 1,
+                ctx);
+        local_count_new_should_have_edges += create_new_edges(updated,
+                interacting, n_interacting, &ctx->local_partition_lists, 1,
+                ctx);
+        return local_count_new_should_have_edges;
+    }
+
+    /*
+     * Look for existing edges and verify they should still exist with
+     * this update to the local mirror.
+     */
+    unsigned n_neighbors = hvr_irr_matrix_linearize(
+            CACHE_NODE_OFFSET(updated, &ctx->vec_cache),
+            ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
+
+    for (unsigned base = 0; base < n_neighbors; base += HVR_EDGE_BATCH_SIZE) {
+        const unsigned n_batch = (n_neighbors - base < HVR_EDGE_BATCH_SIZE ?
+                n_neighbors - base : HVR_EDGE_BATCH_SIZE);
+        if (ctx->should_have_edge_batch) {
+            for (unsigned n = base; n < base + n_batch; n++) {
+                add_to_edge_batch(CACHE_NODE_BY_OFFSET(
+                            EDGE_INFO_VERTEX(ctx->edge_buffer[n]),
+                            &ctx->vec_cache), ctx);
+            }
+            evaluate_edge_batch(updated, ctx);
+            ctx->n_batched = 0;
+        }
+
+        for (unsigned n = base; n < base + n_batch; n++) {
+            hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
+                    EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
+            hvr_edge_type_t edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
+            hvr_edge_create_type_t create_type = EDGE_INFO_CREATION(
+                    ctx->edge_buffer[n]);
+
+            // Check this edge should still exist
+            hvr_edge_type_t new_edge;
+            if (ctx->should_have_edge_batch) {
+                new_edge = ctx->batch_edges[n - base];
+            } else {
+                assert(ctx->should_have_edge);
+                new_edge = ctx->should_have_edge(&updated->vert,
+                        &(cached_neighbor->vert), ctx);
+            }
+            hvr_edge_payload_t payload = 0;
+            if (new_edge != NO_EDGE && ctx->edge_payload) {
+                payload = ctx->edge_payload(&updated->vert,
+                        &(cached_neighbor->vert), ctx);
+            }
+            update_edge_info(updated, cached_neighbor, new_edge,
+                    IMPLICIT_EDGE, payload, &edge, &create_type, 0, ctx);
+
+            // Mark that we've already handled it
+            cached_neighbor->flag = 1;
+        }
+    }
+
+    const unsigned long long done_updating_edges = hvr_current_time_us();
 
     local_count_new_should_have_edges += create_new_edges(updated, interacting,
-            n_interacting, &ctx->mirror_partition_lists, ctx);
+            n_interacting, &ctx->mirror_partition_lists, 0, ctx);
     local_count_new_should_have_edges += create_new_edges(updated, interacting,
-            n_interacting, &ctx->local_partition_lists, ctx);
+            n_interacting, &ctx->local_partition_lists, 0, ctx);
 
     // Clear the flag
     for (unsigned n = 0; n < n_neighbors; n++) {
@@ -719,6 +1374,44 @@ static inline hvr_partition_t wrap_actor_to_partition(hvr_vertex_t *curr,
     }
 }
 
+/*
+ * Returns the partitions that might interact with p. The returned array is
+ * only valid until the next call.
+ */
+static const hvr_partition_t *get_interacting_partitions(hvr_partition_t p,
+        unsigned *out_n_interacting, hvr_internal_ctx_t *ctx) {
+    assert(ctx->might_interact);
+
+    if (ctx->might_interact_is_pure) {
+        const uint32_t start = ctx->interacting_cache_start[p];
+        if (start != UINT32_MAX) {
+            *out_n_interacting = ctx->interacting_cache_len[p];
+            return ctx->interacting_cache + start;
+        }
+    }
+
+    unsigned n_interacting = 0;
+    ctx->might_interact(p, ctx->interacting, &n_interacting,
+            MAX_INTERACTING_PARTITIONS, ctx);
+    *out_n_interacting = n_interacting;
+
+    /*
+     * Append this partition's list to the cache if there is room. Once the
+     * cache fills up, uncached partitions fall back to calling might_interact.
+     */
+    if (ctx->might_interact_is_pure && ctx->interacting_cache_used +
+            n_interacting <= ctx->interacting_cache_capacity) {
+        const uint32_t start = (uint32_t)ctx->interacting_cache_used;
+        memcpy(ctx->interacting_cache + start, ctx->interacting,
+                n_interacting * sizeof(ctx->interacting[0]));
+        ctx->interacting_cache_start[p] = start;
+        ctx->interacting_cache_len[p] = n_interacting;
+        ctx->interacting_cache_used += n_interacting;
+    }
+
+    return ctx->interacting;
+}
+
 static void insert_recently_created_in_partitions(hvr_internal_ctx_t *ctx) {
     hvr_partition_list_t *local_partition_lists = &ctx->local_partition_lists;
 
@@ -735,12 +1428,11 @@ static void insert_recently_created_in_partitions(hvr_internal_ctx_t *ctx) {
             prepend_to_partition_list(curr, part, local_partition_lists, ctx);
 
             unsigned n_interacting = 0;
-            assert(ctx->might_interact);
-            ctx->might_interact(part, ctx->interacting, &n_interacting,
-                    MAX_INTERACTING_PARTITIONS, ctx);
+            const hvr_partition_t *interacting = get_interacting_partitions(
+                    part, &n_interacting, ctx);
 
             update_existing_edges((hvr_vertex_cache_node_t *)curr,
-                    ctx->interacting, n_interacting, ctx);
+                    interacting, n_interacting, ctx);
         } else {
             curr->next_in_partition = NULL;
             curr->prev_in_partition = NULL;
@@ -801,27 +1493,100 @@ static void pull_vertices_from_dead_pe(int dead_pe, hvr_partition_t partition,
     }
 }
 
-static void handle_new_subscription(hvr_partition_t p,
+/*
+ * Try to send the producer changes waiting in producer_change_outbox, in
+ * order, stopping at the first one whose target's mailbox is still full.
+ * Changes for terminated PEs are dropped, as registry rows owned by a
+ * terminated PE are polled by their subscribers instead.
+ */
+static void flush_producer_changes(hvr_internal_ctx_t *ctx) {
+    while (ctx->n_producer_change_outbox > 0) {
+        hvr_producer_change_outbox_entry_t *entry =
+            ctx->producer_change_outbox + ctx->producer_change_outbox_head;
+        if (!hvr_set_contains(entry->target_pe, ctx->all_terminated_pes) &&
+                !hvr_mailbox_send(&entry->msg, sizeof(entry->msg),
+                    entry->target_pe, 1, &ctx->producer_change_mailbox)) {
+            return;
+        }
+        ctx->producer_change_outbox_head =
+            (ctx->producer_change_outbox_head + 1) %
+            ctx->producer_change_outbox_capacity;
+        ctx->n_producer_change_outbox--;
+    }
+}
+
+/*
+ * Never blocks on target_pe, which may itself be waiting on us: if the change
+ * cannot be sent right away it is queued to be retried on later iterations.
+ */
+static void send_producer_change(hvr_producer_change_type_t type,
+        int pe, hvr_partition_t p, int target_pe, hvr_internal_ctx_t *ctx) {
+    if (hvr_set_contains(target_pe, ctx->all_terminated_pes)) {
+        return;
+    }
+
+    hvr_producer_change_msg_t msg;
+    msg.pe = pe;
+    msg.partition = p;
+    msg.type = type;
+    if (ctx->n_producer_change_outbox == 0 &&
+            hvr_mailbox_send(&msg, sizeof(msg), target_pe, 1,
+                &ctx->producer_change_mailbox)) {
+        return;
+    }
+
+    if (ctx->n_producer_change_outbox ==
+            ctx->producer_change_outbox_capacity) {
+        fprintf(stderr, "ERROR: PE %d exceeded %u unsent producer changes. "
+                "Increase HVR_PRODUCER_CHANGE_OUTBOX.\n", ctx->pe,
+                ctx->producer_change_outbox_capacity);
+        abort();
+    }
+    hvr_producer_change_outbox_entry_t *entry = ctx->producer_change_outbox +
+        ((ctx->producer_change_outbox_head + ctx->n_producer_change_outbox) %
+         ctx->producer_change_outbox_capacity);
+    memcpy(&entry->msg, &msg, sizeof(msg));
+    entry->target_pe = target_pe;
+    ctx->n_producer_change_outbox++;
+}
+
+/*
+ * New subscriptions made in the same call to update_partition_window are
+ * handled in two steps, so that the registry rows for all of them can be
+ * fetched together by fetch_new_subscriptions.
+ */
+static void start_new_subscription(hvr_partition_t p,
         hvr_internal_ctx_t *ctx) {
     hvr_dist_bitvec_local_subcopy_t *p_dead_info =
-        (hvr_dist_bitvec_local_subcopy_t *)malloc_helper(sizeof(*p_dead_info));
-    assert(p_dead_info);
-    hvr_dist_bitvec_local_subcopy_init(&ctx->terminated_pes,
-            p_dead_info);
+        hvr_dist_bitvec_subcopy_pool_acquire(&ctx->dead_info_pool);
     hvr_map_add(p, p_dead_info, 0, &ctx->dead_info);
 
     hvr_dist_bitvec_local_subcopy_t *p_producer_info =
-        (hvr_dist_bitvec_local_subcopy_t *)malloc_helper(
-                sizeof(*p_producer_info));
-    assert(p_producer_info);
-    hvr_dist_bitvec_local_subcopy_init(&ctx->partition_producers,
-            p_producer_info);
+        hvr_dist_bitvec_subcopy_pool_acquire(&ctx->producer_info_pool);
     hvr_map_add(p, p_producer_info, 0, &ctx->producer_info);
 
+    const unsigned i = ctx->n_new_subs++;
+    assert(i < ctx->max_active_partitions);
+    ctx->new_sub_partitions[i] = p;
+    ctx->new_sub_producer_info[i] = p_producer_info;
+    ctx->new_sub_dead_info[i] = p_dead_info;
+}
 
-    // Download the list of producers for partition p.
-    hvr_dist_bitvec_copy_locally(p, &ctx->partition_producers, p_producer_info);
+// Download the lists of producers (and dead PEs) for each new subscription
+static void fetch_new_subscriptions(hvr_internal_ctx_t *ctx) {
+    hvr_dist_bitvec_copy_rows_locally(ctx->new_sub_partitions,
+            ctx->n_new_subs, &ctx->partition_producers,
+            ctx->new_sub_producer_info);
+    if (dead_pe_processing) {
+        hvr_dist_bitvec_copy_rows_locally(ctx->new_sub_partitions,
+                ctx->n_new_subs, &ctx->terminated_pes, ctx->new_sub_dead_info);
+    }
+}
 
+static void handle_new_subscription(hvr_partition_t p,
+        hvr_dist_bitvec_local_subcopy_t *p_producer_info,
+        hvr_dist_bitvec_local_subcopy_t *p_dead_info,
+        hvr_internal_ctx_t *ctx) {
     /*
      * notify all producers of this partition of our subscription
      * (they will then send us a full update).
@@ -837,10 +1602,16 @@ static void handle_new_subscription(hvr_partition_t p,
         }
     }
 
+    /*
+     * Register with the owner of p's registry row, which will notify us of
+     * any producers we missed in the copy above and of all later changes.
+     */
+    if (ctx->push_producer_changes) {
+        send_producer_change(PRODUCER_CHANGE_SUBSCRIBE, ctx->pe, p,
+                hvr_dist_bitvec_owning_pe(p, &ctx->partition_producers), ctx);
+    }
+
     if (dead_pe_processing) {
-        const unsigned long long start = hvr_current_time_us();
-        hvr_dist_bitvec_copy_locally(p, &ctx->terminated_pes,
-                p_dead_info);
         for (int pe = 0; pe < ctx->npes; pe++) {
             if (hvr_dist_bitvec_local_subcopy_contains(pe,
                         p_dead_info)) {
@@ -948,56 +1719,106 @@ static void handle_new_unsubscription(hvr_partition_t p,
         }
     }
 
+    if (ctx->push_producer_changes) {
+        send_producer_change(PRODUCER_CHANGE_UNSUBSCRIBE, ctx->pe, p,
+                hvr_dist_bitvec_owning_pe(p, &ctx->partition_producers), ctx);
+    }
+
     /*
      * Invalidate all vertices cached in this partition because we won't be
-     * getting new updates.
+     * getting new updates, except those we are subscribed to individually.
      */
     hvr_vertex_t *iter = hvr_partition_list_head(p,
             &ctx->mirror_partition_lists);
     while (iter) {
         hvr_vertex_t *next = iter->next_in_partition;
-        if (hvr_vertex_get_owning_pe(iter) != ctx->pe) {
-            handle_deleted_vertex(iter, 1, ctx);
+        if (hvr_vertex_get_owning_pe(iter) != ctx->pe &&
+                !hvr_sparse_arr_contains(VERTEX_ID_PE(iter->id),
+                    VERTEX_ID_OFFSET(iter->id), &ctx->my_vert_subs)) {
+            handle_deleted_vertex(iter, 1, 0, ctx);
         }
         iter = next;
     }
 
     hvr_map_remove(p, p_producer_info, &ctx->producer_info);
-    hvr_dist_bitvec_local_subcopy_destroy(&ctx->partition_producers,
-            p_producer_info);
+    hvr_dist_bitvec_subcopy_pool_release(p_producer_info,
+            &ctx->producer_info_pool);
 
     hvr_dist_bitvec_local_subcopy_t *p_dead_info =
         (hvr_dist_bitvec_local_subcopy_t *)hvr_map_get(p, &ctx->dead_info);
     assert(p_dead_info);
     hvr_map_remove(p, p_dead_info, &ctx->dead_info);
-    hvr_dist_bitvec_local_subcopy_destroy(&ctx->terminated_pes, p_dead_info);
+    hvr_dist_bitvec_subcopy_pool_release(p_dead_info, &ctx->dead_info_pool);
+}
+
+
+/*
+ * A partition is a source if we subscribe to all partitions it might interact
+ * with: it either contains a local vertex, or a mirrored vertex close enough to
+ * a local vertex.
+ */
+static inline int is_source_partition(hvr_partition_t p,
+        hvr_internal_ctx_t *ctx) {
+    return hvr_partition_list_head(p, &ctx->local_partition_lists) ||
+        (hvr_partition_list_head(p, &ctx->mirror_partition_lists) &&
+         within_partition_window(partition_min_mirror_dist(p, ctx), ctx));
+}
 
-    free(p_producer_info);
-    free(p_dead_info);
+static inline void touch_partition(hvr_partition_t p, size_t *n_touched,
+        hvr_internal_ctx_t *ctx) {
+    if (!hvr_set_contains(p, ctx->touched_partitions)) {
+        assert(*n_touched < ctx->max_active_partitions);
+        hvr_set_insert(p, ctx->touched_partitions);
+        ctx->touched_partitions_list[*n_touched] = p;
+        *n_touched += 1;
+    }
 }
 
-static inline void add_interacting_partitions(hvr_vertex_id_t p, hvr_set_t *s,
-        hvr_internal_ctx_t *ctx, size_t *n_subscriber_partitions) {
+static void add_source_partition(hvr_partition_t p, size_t *n_touched,
+        hvr_internal_ctx_t *ctx) {
     unsigned n_interacting = 0;
-    hvr_partition_t *interacting = ctx->interacting;
-    assert(ctx->might_interact);
-    ctx->might_interact(p, interacting, &n_interacting,
-            MAX_INTERACTING_PARTITIONS, ctx);
+    const hvr_partition_t *interacting = get_interacting_partitions(p,
+            &n_interacting, ctx);
 
     /*
-     * Mark any partitions which this locally active partition might
-     * interact with.
+     * Save the interacting partitions so that the same references are dropped
+     * when p stops being a source.
      */
     for (unsigned i = 0; i < n_interacting; i++) {
-        if (!hvr_set_contains(interacting[i], s)) {
-            assert(*n_subscriber_partitions < ctx->max_active_partitions);
-            ctx->new_subscriber_partitions_list[*n_subscriber_partitions] =
-                interacting[i];
-            *n_subscriber_partitions += 1;
+        hvr_partition_t other = interacting[i];
+        if (!hvr_sparse_arr_contains(p, other, &ctx->source_interacting)) {
+            hvr_sparse_arr_insert(p, other, &ctx->source_interacting);
+            if (ctx->partition_sub_refcount[other]++ == 0) {
+                touch_partition(other, n_touched, ctx);
+            }
+        }
+    }
+}
 
-            hvr_set_insert(interacting[i], s);
+static void remove_source_partition(hvr_partition_t p, size_t *n_touched,
+        hvr_internal_ctx_t *ctx) {
+    hvr_sparse_arr_row_iter_t iter;
+    hvr_sparse_arr_row_iter_init(&iter, p, &ctx->source_interacting);
+    unsigned other;
+    while (hvr_sparse_arr_row_iter_next(&iter, &other)) {
+        assert(ctx->partition_sub_refcount[other] > 0);
+        if (--ctx->partition_sub_refcount[other] == 0) {
+            touch_partition(other, n_touched, ctx);
         }
     }
+    hvr_sparse_arr_remove_row(p, &ctx->source_interacting);
+}
+
+static inline void record_producer_change(hvr_partition_t p,
+        hvr_producer_change_type_t type, hvr_internal_ctx_t *ctx) {
+    if (!ctx->push_producer_changes) return;
+
+    assert(ctx->n_producer_changes < ctx->n_partitions);
+    hvr_producer_change_msg_t *change =
+        &ctx->producer_changes[ctx->n_producer_changes++];
+    change->pe = ctx->pe;
+    change->partition = p;
+    change->type = type;
 }
 
 static void update_partition_window(hvr_internal_ctx_t *ctx,
@@ -1009,51 +1830,23 @@ static void update_partition_window(hvr_internal_ctx_t *ctx,
         unsigned long long *out_time_5) {
     const unsigned long long start = hvr_current_time_us();
 
-    hvr_set_t *new_subscribed_partitions = ctx->new_subscribed_partitions;
-    hvr_set_t *new_produced_partitions = ctx->new_produced_partitions;
-    hvr_set_wipe(new_subscribed_partitions);
-    hvr_set_wipe(new_produced_partitions);
-
-    size_t n_producer_partitions = 0;
-    size_t n_subscriber_partitions = 0;
-
-    for (int b = 0; b < HVR_MAP_BUCKETS; b++) {
-        hvr_map_seg_t *iter = ctx->local_partition_lists.map.buckets[b];
-        while (iter) {
-            for (int i = 0; i < iter->nkeys; i++) {
-                hvr_vertex_id_t p = iter->data_key[i];
-
-                // Producer
-                if (!hvr_set_contains(p, new_produced_partitions)) {
-                    assert(n_producer_partitions < ctx->max_active_partitions);
-                    ctx->new_producer_partitions_list[n_producer_partitions++] =
-                        p;
-
-                    hvr_set_insert(p, new_produced_partitions);
-                }
-
-                // Subscriber to any interacting partitions with p
-                add_interacting_partitions(p, new_subscribed_partitions, ctx,
-                        &n_subscriber_partitions);
-            }
-            iter = iter->next;
-        }
-    }
-
-    for (int b = 0; b < HVR_MAP_BUCKETS; b++) {
-        hvr_map_seg_t *iter = ctx->mirror_partition_lists.map.buckets[b];
-        while (iter) {
-            for (int i = 0; i < iter->nkeys; i++) {
-                hvr_vertex_id_t p = iter->data_key[i];
-                if (ctx->partition_min_dist_from_local_vert[p] <=
-                        ctx->max_graph_traverse_depth - 1) {
-                    // Subscriber to any interacting partitions with p
-                    add_interacting_partitions(p,
-                            new_subscribed_partitions, ctx,
-                            &n_subscriber_partitions);
-                }
-            }
-            iter = iter->next;
+    /*
+     * Only partitions marked dirty since the last window update can have
+     * changed whether we produce them or subscribe to their interacting
+     * partitions. Reference count subscriptions so that each partition is
+     * (un)subscribed when its first (last) interacting source appears
+     * (disappears).
+     */
+    size_t n_touched = 0;
+    for (size_t i = 0; i < ctx->n_dirty_partitions; i++) {
+        hvr_partition_t p = ctx->dirty_partitions_list[i];
+        const int is_source = is_source_partition(p, ctx);
+        if (is_source && !hvr_set_contains(p, ctx->source_partitions)) {
+            hvr_set_insert(p, ctx->source_partitions);
+            add_source_partition(p, &n_touched, ctx);
+        } else if (!is_source && hvr_set_contains(p, ctx->source_partitions)) {
+            hvr_set_clear(p, ctx->source_partitions);
+            remove_source_partition(p, &n_touched, ctx);
         }
     }
 
@@ -1071,30 +1864,86 @@ static void update_partition_window(hvr_internal_ctx_t *ctx,
      */
 
     // ***** #1 (stopped producing) *****
-    for (size_t i = 0; i < ctx->n_prev_producer_partitions; i++) {
-        hvr_partition_t p = ctx->prev_producer_partitions_list[i];
-        if (!hvr_set_contains(p, new_produced_partitions)) {
-            hvr_dist_bitvec_clear(p, ctx->pe, &ctx->partition_producers);
+    for (size_t i = 0; i < ctx->n_dirty_partitions; i++) {
+        hvr_partition_t p = ctx->dirty_partitions_list[i];
+        if (hvr_set_contains(p, ctx->produced_partitions) &&
+                !hvr_partition_list_head(p, &ctx->local_partition_lists)) {
+            hvr_dist_bitvec_batch_clear(p, ctx->pe,
+                    &ctx->partition_producers_batch);
+            hvr_set_clear(p, ctx->produced_partitions);
+            record_producer_change(p, PRODUCER_CHANGE_STOPPED, ctx);
         }
     }
 
     const unsigned long long after_1 = hvr_current_time_us();
 
     // ***** #2 (new producer) *****
-    for (size_t i = 0; i < n_producer_partitions; i++) {
-        hvr_partition_t p = ctx->new_producer_partitions_list[i];
-        if (!hvr_set_contains(p, ctx->produced_partitions)) {
-            hvr_dist_bitvec_set(p, ctx->pe, &ctx->partition_producers);
+    for (size_t i = 0; i < ctx->n_dirty_partitions; i++) {
+        hvr_partition_t p = ctx->dirty_partitions_list[i];
+        if (!hvr_set_contains(p, ctx->produced_partitions) &&
+                hvr_partition_list_head(p, &ctx->local_partition_lists)) {
+            hvr_dist_bitvec_batch_set(p, ctx->pe,
+                    &ctx->partition_producers_batch);
+            hvr_set_insert(p, ctx->produced_partitions);
+            record_producer_change(p, PRODUCER_CHANGE_STARTED, ctx);
         }
+        hvr_set_clear(p, ctx->dirty_partitions);
+    }
+    ctx->n_dirty_partitions = 0;
+    hvr_dist_bitvec_batch_flush(&ctx->partition_producers_batch);
+
+    // Read other PEs' producer changes only once they have all been made
+    deterministic_phase_barrier(ctx);
+
+    /*
+     * The flush fences the registry updates ahead of these messages, so an
+     * owner handling one will find the registry row already updated.
+     */
+    for (unsigned i = 0; i < ctx->n_producer_changes; i++) {
+        hvr_producer_change_msg_t *change = &ctx->producer_changes[i];
+        send_producer_change((hvr_producer_change_type_t)change->type,
+                ctx->pe, change->partition, hvr_dist_bitvec_owning_pe(
+                    change->partition, &ctx->partition_producers), ctx);
     }
+    ctx->n_producer_changes = 0;
 
     const unsigned long long after_2 = hvr_current_time_us();
 
-    // ***** #3 (new sub) and #4 (existing sub) *****
-    for (size_t i = 0; i < n_subscriber_partitions; i++) {
-        hvr_partition_t p = ctx->new_subscriber_partitions_list[i];
-        const int old_sub = hvr_set_contains(p, ctx->subscribed_partitions);
-        if (!old_sub) {
+    /*
+     * ***** #4 (existing sub) *****
+     *
+     * When producer changes are pushed to us there is nothing to poll for,
+     * unless the owner of the registry row has terminated or we need to look
+     * for the partitions a newly terminated PE produced.
+     */
+    const int poll_for_dead = ctx->poll_subscriptions_for_dead_pes;
+    const int poll_all = !ctx->push_producer_changes || poll_for_dead;
+    ctx->poll_subscriptions_for_dead_pes = 0;
+    for (size_t i = 0; i < ctx->n_subscriber_partitions; i++) {
+        hvr_partition_t p = ctx->subscriber_partitions_list[i];
+        if (!poll_all && !hvr_set_contains(hvr_dist_bitvec_owning_pe(p,
+                        &ctx->partition_producers), ctx->all_terminated_pes)) {
+            continue;
+        }
+        if (poll_for_dead) {
+            // Skip any backoff from polling an orphaned row
+            ctx->next_producer_info_check[p] = ctx->iter;
+        }
+        if (ctx->partition_sub_refcount[p] > 0) {
+            /*
+             * If this is an existing subscription, copy down the current
+             * list of producers and check for changes. If a change is
+             * found, notify the new producer that we're subscribed.
+             */
+            handle_existing_subscription(p, ctx);
+        }
+    }
+
+    // ***** #3 (new sub) *****
+    for (size_t i = 0; i < n_touched; i++) {
+        hvr_partition_t p = ctx->touched_partitions_list[i];
+        if (ctx->partition_sub_refcount[p] > 0 &&
+                !hvr_set_contains(p, ctx->subscribed_partitions)) {
             /*
              * New subscription on this iteration. Copy down the set of
              * producers for this partition and send each a notification
@@ -1102,55 +1951,51 @@ static void update_partition_window(hvr_internal_ctx_t *ctx,
              * the set of dead PEs that were producers of this partition,
              * and pull vertices from those PEs.
              */
-            handle_new_subscription(p, ctx);
+            start_new_subscription(p, ctx);
             ctx->next_producer_info_check[p] = ctx->iter + 1;
             ctx->curr_producer_info_interval[p] = 1;
-        } else {
-            /*
-             * If this is an existing subscription, copy down the current
-             * list of producers and check for changes. If a change is
-             * found, notify the new producer that we're subscribed.
-             */
-            handle_existing_subscription(p, ctx);
+
+            assert(ctx->n_subscriber_partitions < ctx->max_active_partitions);
+            ctx->subscriber_partitions_index[p] = ctx->n_subscriber_partitions;
+            ctx->subscriber_partitions_list[ctx->n_subscriber_partitions++] = p;
+            hvr_set_insert(p, ctx->subscribed_partitions);
         }
     }
 
+    fetch_new_subscriptions(ctx);
+    for (unsigned i = 0; i < ctx->n_new_subs; i++) {
+        handle_new_subscription(ctx->new_sub_partitions[i],
+                ctx->new_sub_producer_info[i], ctx->new_sub_dead_info[i], ctx);
+    }
+    ctx->n_new_subs = 0;
+
     const unsigned long long after_3_4 = hvr_current_time_us();
 
     // ***** #5 (unsubscription) *****
-    for (size_t i = 0; i < ctx->n_prev_subscriber_partitions; i++) {
-        hvr_partition_t p = ctx->prev_subscriber_partitions_list[i];
-        if (!hvr_set_contains(p, new_subscribed_partitions)) {
+    for (size_t i = 0; i < n_touched; i++) {
+        hvr_partition_t p = ctx->touched_partitions_list[i];
+        hvr_set_clear(p, ctx->touched_partitions);
+        if (ctx->partition_sub_refcount[p] == 0 &&
+                hvr_set_contains(p, ctx->subscribed_partitions)) {
             /*
              * If this is a new unsubscription notify all producers that we
              * are no longer subscribed. They will remove us from the list
              * of people they send msgs to.
              */
             handle_new_unsubscription(p, ctx);
+
+            const size_t index = ctx->subscriber_partitions_index[p];
+            hvr_partition_t last = ctx->subscriber_partitions_list[
+                ctx->n_subscriber_partitions - 1];
+            ctx->subscriber_partitions_list[index] = last;
+            ctx->subscriber_partitions_index[last] = index;
+            ctx->n_subscriber_partitions--;
+            hvr_set_clear(p, ctx->subscribed_partitions);
         }
     }
 
     const unsigned long long after_5 = hvr_current_time_us();
 
-    /*
-     * Copy the newly computed partition windows for this PE over for next time
-     * when we need to check for changes.
-     */
-    hvr_set_copy(ctx->subscribed_partitions, new_subscribed_partitions);
-
-    hvr_set_copy(ctx->produced_partitions, new_produced_partitions);
-
-    hvr_partition_t *tmp_p = ctx->prev_producer_partitions_list;
-    hvr_partition_t *tmp_s = ctx->prev_subscriber_partitions_list;
-
-    ctx->prev_producer_partitions_list = ctx->new_producer_partitions_list;
-    ctx->prev_subscriber_partitions_list = ctx->new_subscriber_partitions_list;
-    ctx->n_prev_producer_partitions = n_producer_partitions;
-    ctx->n_prev_subscriber_partitions = n_subscriber_partitions;
-
-    ctx->new_producer_partitions_list = tmp_p;
-    ctx->new_subscriber_partitions_list = tmp_s;
-
     const unsigned long long end = hvr_current_time_us();
 
     *out_time_updating_partitions = after_part_updates - start;
@@ -1202,8 +2047,9 @@ void hvr_init(const hvr_partition_t n_partitions,
 
     new_ctx->subscribed_partitions = hvr_create_empty_set(n_partitions);
     new_ctx->produced_partitions = hvr_create_empty_set(n_partitions);
-    new_ctx->new_subscribed_partitions = hvr_create_empty_set(n_partitions);
-    new_ctx->new_produced_partitions = hvr_create_empty_set(n_partitions);
+    new_ctx->dirty_partitions = hvr_create_empty_set(n_partitions);
+    new_ctx->source_partitions = hvr_create_empty_set(n_partitions);
+    new_ctx->touched_partitions = hvr_create_empty_set(n_partitions);
 
     new_ctx->update_metadata = update_metadata;
     new_ctx->might_interact = might_interact;
@@ -1226,6 +2072,15 @@ void hvr_init(const hvr_partition_t n_partitions,
         assert(new_ctx->strict_counter_src && new_ctx->strict_counter_dest);
     }
 
+    if (getenv("HVR_ASYNC_ITERATIONS")) {
+        if (new_ctx->strict_mode) {
+            fprintf(stderr, "ERROR: HVR_ASYNC_ITERATIONS and HVR_STRICT cannot "
+                    "be used together\n");
+            abort();
+        }
+        new_ctx->async_iterations = 1;
+    }
+
     if (getenv("HVR_TRACE_DUMP")) {
         new_ctx->dump_mode = 1;
 
@@ -1258,6 +2113,21 @@ void hvr_init(const hvr_partition_t n_partitions,
         assert(max_producer_info_interval > 0);
     }
 
+    if (getenv("HVR_PARTITION_SNAPSHOT_SIZE")) {
+        new_ctx->snapshot_capacity = atoll(getenv(
+                    "HVR_PARTITION_SNAPSHOT_SIZE"));
+    }
+
+    if (getenv("HVR_PUSH_PRODUCER_CHANGES")) {
+        new_ctx->push_producer_changes = atoi(getenv(
+                    "HVR_PUSH_PRODUCER_CHANGES"));
+    }
+
+    if (getenv("HVR_MIGRATION_INTERVAL")) {
+        new_ctx->migration_interval = atoi(getenv("HVR_MIGRATION_INTERVAL"));
+        assert(new_ctx->migration_interval > 0);
+    }
+
     if (getenv("HVR_DISABLE_PROFILING_PRINTS")) {
         print_profiling = 0;
     } else {
@@ -1310,17 +2180,12 @@ void hvr_init(const hvr_partition_t n_partitions,
             new_ctx->npes * sizeof(new_ctx->updates_on_this_iter[0]));
     assert(new_ctx->updates_on_this_iter);
 
-    hvr_partition_list_init(new_ctx->n_partitions,
+    hvr_partition_list_init(new_ctx->n_partitions, 0,
             &new_ctx->local_partition_lists);
 
-    hvr_partition_list_init(new_ctx->n_partitions,
+    hvr_partition_list_init(new_ctx->n_partitions, 1,
             &new_ctx->mirror_partition_lists);
 
-    new_ctx->partition_min_dist_from_local_vert = (uint8_t *)malloc_helper(
-            sizeof(new_ctx->partition_min_dist_from_local_vert[0]) *
-            new_ctx->n_partitions);
-    assert(new_ctx->partition_min_dist_from_local_vert);
-
     hvr_mailbox_init(&new_ctx->vertex_update_mailbox,       256 * 1024 * 1024);
     hvr_mailbox_init(&new_ctx->forward_mailbox,              32 * 1024 * 1024);
     hvr_mailbox_init(&new_ctx->vert_sub_mailbox,             32 * 1024 * 1024);
@@ -1330,6 +2195,59 @@ void hvr_init(const hvr_partition_t n_partitions,
     hvr_mailbox_init(&new_ctx->coupling_val_mailbox,          8 * 1024 * 1024);
     hvr_mailbox_init(&new_ctx->to_couple_with_mailbox,        8 * 1024 * 1024);
     hvr_mailbox_init(&new_ctx->root_info_mailbox,             8 * 1024 * 1024);
+    if (new_ctx->push_producer_changes) {
+        hvr_mailbox_init(&new_ctx->producer_change_mailbox,  32 * 1024 * 1024);
+    }
+    if (new_ctx->snapshot_capacity > 0) {
+        new_ctx->snapshot_ring = (hvr_vertex_t *)shmem_malloc_wrapper(
+                new_ctx->snapshot_capacity * sizeof(hvr_vertex_t));
+        new_ctx->snapshot_head = (uint64_t *)shmem_malloc_wrapper(
+                sizeof(*(new_ctx->snapshot_head)));
+        new_ctx->snapshot_recv_buf = (hvr_vertex_t *)malloc_helper(
+                new_ctx->snapshot_capacity * sizeof(hvr_vertex_t));
+        assert(new_ctx->snapshot_ring && new_ctx->snapshot_head &&
+                new_ctx->snapshot_recv_buf);
+        *(new_ctx->snapshot_head) = 0;
+        new_ctx->snapshot_recv_in_progress = 0;
+    }
+    if (new_ctx->migration_interval > 0) {
+        hvr_mailbox_init(&new_ctx->migration_mailbox,         8 * 1024 * 1024);
+
+        const size_t pool_size = new_ctx->vec_cache.pool_size;
+        new_ctx->forwarding = (hvr_vertex_id_t *)shmem_malloc_wrapper(
+                pool_size * sizeof(new_ctx->forwarding[0]));
+        new_ctx->load = (hvr_pe_load_t *)shmem_malloc_wrapper(
+                sizeof(*(new_ctx->load)));
+        new_ctx->all_loads = (hvr_pe_load_t *)malloc_helper(
+                new_ctx->npes * sizeof(new_ctx->all_loads[0]));
+        assert(new_ctx->forwarding && new_ctx->load && new_ctx->all_loads);
+        for (size_t i = 0; i < pool_size; i++) {
+            new_ctx->forwarding[i] = HVR_INVALID_VERTEX_ID;
+        }
+        memset(new_ctx->load, 0x00, sizeof(*(new_ctx->load)));
+
+        new_ctx->max_pending_migrations = 1024;
+        if (getenv("HVR_MAX_PENDING_MIGRATIONS")) {
+            new_ctx->max_pending_migrations = atoi(getenv(
+                        "HVR_MAX_PENDING_MIGRATIONS"));
+        }
+        new_ctx->pending_migrations = (hvr_pending_migration_t *)malloc_helper(
+                new_ctx->max_pending_migrations *
+                sizeof(new_ctx->pending_migrations[0]));
+        new_ctx->max_forward_retries = 1024;
+        if (getenv("HVR_MAX_FORWARD_RETRIES")) {
+            new_ctx->max_forward_retries = atoi(getenv(
+                        "HVR_MAX_FORWARD_RETRIES"));
+        }
+        new_ctx->forward_retries = (inter_vert_msg_t *)malloc_helper(
+                new_ctx->max_forward_retries *
+                sizeof(new_ctx->forward_retries[0]));
+        new_ctx->edge_forward_retries = (hvr_edge_create_msg_t *)malloc_helper(
+                new_ctx->max_forward_retries *
+                sizeof(new_ctx->edge_forward_retries[0]));
+        assert(new_ctx->pending_migrations && new_ctx->forward_retries &&
+                new_ctx->edge_forward_retries);
+    }
 
     const unsigned n_to_buffer = 1024;
     hvr_mailbox_buffer_init(&new_ctx->vert_sub_mailbox_buffer,
@@ -1343,18 +2261,61 @@ void hvr_init(const hvr_partition_t n_partitions,
             &new_ctx->partition_producers);
     hvr_dist_bitvec_init(new_ctx->n_partitions, new_ctx->npes,
             &new_ctx->terminated_pes);
+    hvr_dist_bitvec_batch_init(&new_ctx->partition_producers, 4096,
+            &new_ctx->partition_producers_batch);
 
     hvr_dist_bitvec_local_subcopy_init(&new_ctx->partition_producers,
             &new_ctx->local_partition_producers);
     hvr_dist_bitvec_local_subcopy_init(&new_ctx->terminated_pes,
             &new_ctx->local_terminated_pes);
 
-    hvr_sparse_arr_init(&new_ctx->remote_partition_subs, new_ctx->n_partitions);
+    /*
+     * The subscriber sets store PEs as values, so dense rows can be stored as
+     * bitmaps over PEs. my_vert_subs stores vertex offsets, which are too
+     * sparse for that to pay off.
+     */
+    hvr_sparse_arr_init(&new_ctx->remote_partition_subs, new_ctx->n_partitions,
+            new_ctx->npes);
     hvr_sparse_arr_init(&new_ctx->remote_vert_subs,
-            new_ctx->vec_cache.pool_size);
-    hvr_sparse_arr_init(&new_ctx->my_vert_subs, new_ctx->npes);
+            new_ctx->vec_cache.pool_size, new_ctx->npes);
+    hvr_sparse_arr_init(&new_ctx->my_vert_subs, new_ctx->npes, 0);
+    hvr_sparse_arr_enable_reverse_index(&new_ctx->remote_partition_subs);
+    hvr_sparse_arr_enable_reverse_index(&new_ctx->remote_vert_subs);
+    hvr_sparse_arr_init(&new_ctx->source_interacting, new_ctx->n_partitions,
+            new_ctx->n_partitions);
+    if (new_ctx->push_producer_changes) {
+        hvr_sparse_arr_init(&new_ctx->registry_subs, new_ctx->n_partitions,
+                new_ctx->npes);
+        new_ctx->producer_changes = (hvr_producer_change_msg_t *)malloc_helper(
+                new_ctx->n_partitions * sizeof(new_ctx->producer_changes[0]));
+        assert(new_ctx->producer_changes);
+
+        new_ctx->producer_change_outbox_capacity = 64 * 1024;
+        if (getenv("HVR_PRODUCER_CHANGE_OUTBOX")) {
+            new_ctx->producer_change_outbox_capacity = atoi(getenv(
+                        "HVR_PRODUCER_CHANGE_OUTBOX"));
+        }
+        assert(new_ctx->producer_change_outbox_capacity > 0);
+        new_ctx->producer_change_outbox =
+            (hvr_producer_change_outbox_entry_t *)malloc_helper(
+                    new_ctx->producer_change_outbox_capacity *
+                    sizeof(new_ctx->producer_change_outbox[0]));
+        assert(new_ctx->producer_change_outbox);
+        new_ctx->producer_change_outbox_head = 0;
+        new_ctx->n_producer_change_outbox = 0;
+    }
+    new_ctx->poll_subscriptions_for_dead_pes = 0;
 
     new_ctx->max_graph_traverse_depth = max_graph_traverse_depth;
+
+    new_ctx->n_dist_hist_buckets = max_graph_traverse_depth + 1;
+    const size_t dist_hist_len = (size_t)new_ctx->n_partitions *
+        new_ctx->n_dist_hist_buckets;
+    new_ctx->partition_dist_hist = (unsigned *)malloc_helper(
+            dist_hist_len * sizeof(new_ctx->partition_dist_hist[0]));
+    assert(new_ctx->partition_dist_hist);
+    memset(new_ctx->partition_dist_hist, 0x00,
+            dist_hist_len * sizeof(new_ctx->partition_dist_hist[0]));
     new_ctx->send_neighbor_updates_for_explicit_subs =
         send_neighbor_updates_for_explicit_subs;
 
@@ -1418,8 +2379,33 @@ void hvr_init(const hvr_partition_t n_partitions,
     if (getenv("HVR_BUFFERED_MSGS_POOL_SIZE")) {
         buffered_msgs_pool_size = atoi(getenv("HVR_BUFFERED_MSGS_POOL_SIZE"));
     }
+    new_ctx->deterministic = (getenv("HVR_DETERMINISTIC") != NULL);
     hvr_buffered_msgs_init(new_ctx->vec_cache.pool_size,
-            buffered_msgs_pool_size, &new_ctx->buffered_msgs);
+            buffered_msgs_pool_size, new_ctx->deterministic,
+            &new_ctx->buffered_msgs);
+
+    if (new_ctx->deterministic) {
+        new_ctx->max_staged_updates = 16 * n_to_buffer;
+        if (getenv("HVR_DETERMINISTIC_MAX_UPDATES")) {
+            new_ctx->max_staged_updates = atoi(
+                    getenv("HVR_DETERMINISTIC_MAX_UPDATES"));
+        }
+        if (new_ctx->max_staged_updates <
+                new_ctx->vertex_update_mailbox_buffer.buffer_size_per_pe) {
+            fprintf(stderr, "ERROR: HVR_DETERMINISTIC_MAX_UPDATES must be at "
+                    "least %lu\n",
+                    new_ctx->vertex_update_mailbox_buffer.buffer_size_per_pe);
+            abort();
+        }
+        new_ctx->staged_updates = (hvr_update_msg_t *)malloc_helper(
+                new_ctx->max_staged_updates *
+                sizeof(new_ctx->staged_updates[0]));
+        new_ctx->staged_order = (hvr_staged_update_t *)malloc_helper(
+                new_ctx->max_staged_updates *
+                sizeof(new_ctx->staged_order[0]));
+        assert(new_ctx->staged_updates && new_ctx->staged_order);
+        new_ctx->n_staged_updates = 0;
+    }
 
     // Initialize edges
     size_t edges_pool_size = 1024ULL * 1024ULL * 1024ULL;
@@ -1433,26 +2419,49 @@ void hvr_init(const hvr_partition_t n_partitions,
     if (getenv("HVR_MAX_ACTIVE_PARTITIONS")) {
         max_active_partitions = atoi(getenv("HVR_MAX_ACTIVE_PARTITIONS"));
     }
-    new_ctx->new_producer_partitions_list = (hvr_partition_t *)malloc_helper(
-            max_active_partitions *
-            sizeof(new_ctx->new_producer_partitions_list[0]));
-    new_ctx->new_subscriber_partitions_list = (hvr_partition_t *)malloc_helper(
-            max_active_partitions *
-            sizeof(new_ctx->new_subscriber_partitions_list[0]));
-    new_ctx->prev_producer_partitions_list = (hvr_partition_t *)malloc_helper(
+    new_ctx->touched_partitions_list = (hvr_partition_t *)malloc_helper(
             max_active_partitions *
-            sizeof(new_ctx->prev_producer_partitions_list[0]));
-    new_ctx->prev_subscriber_partitions_list = (hvr_partition_t *)malloc_helper(
+            sizeof(new_ctx->touched_partitions_list[0]));
+    new_ctx->subscriber_partitions_list = (hvr_partition_t *)malloc_helper(
             max_active_partitions *
-            sizeof(new_ctx->prev_subscriber_partitions_list[0]));
-    assert(new_ctx->new_producer_partitions_list &&
-            new_ctx->new_subscriber_partitions_list &&
-            new_ctx->prev_producer_partitions_list &&
-            new_ctx->prev_subscriber_partitions_list);
+            sizeof(new_ctx->subscriber_partitions_list[0]));
+    // Every partition may be dirtied at once, e.g. on the first iteration
+    new_ctx->dirty_partitions_list = (hvr_partition_t *)malloc_helper(
+            new_ctx->n_partitions *
+            sizeof(new_ctx->dirty_partitions_list[0]));
+    new_ctx->subscriber_partitions_index = (size_t *)malloc_helper(
+            new_ctx->n_partitions *
+            sizeof(new_ctx->subscriber_partitions_index[0]));
+    new_ctx->partition_sub_refcount = (unsigned *)malloc_helper(
+            new_ctx->n_partitions *
+            sizeof(new_ctx->partition_sub_refcount[0]));
+    assert(new_ctx->touched_partitions_list &&
+            new_ctx->subscriber_partitions_list &&
+            new_ctx->dirty_partitions_list &&
+            new_ctx->subscriber_partitions_index &&
+            new_ctx->partition_sub_refcount);
+    memset(new_ctx->partition_sub_refcount, 0x00, new_ctx->n_partitions *
+            sizeof(new_ctx->partition_sub_refcount[0]));
     new_ctx->max_active_partitions = max_active_partitions;
 
-    new_ctx->n_prev_producer_partitions = 0;
-    new_ctx->n_prev_subscriber_partitions = 0;
+    new_ctx->new_sub_partitions = (hvr_dist_bitvec_size_t *)malloc_helper(
+            max_active_partitions * sizeof(new_ctx->new_sub_partitions[0]));
+    new_ctx->new_sub_producer_info =
+        (hvr_dist_bitvec_local_subcopy_t **)malloc_helper(
+                max_active_partitions *
+                sizeof(new_ctx->new_sub_producer_info[0]));
+    new_ctx->new_sub_dead_info =
+        (hvr_dist_bitvec_local_subcopy_t **)malloc_helper(
+                max_active_partitions * sizeof(new_ctx->new_sub_dead_info[0]));
+    assert(new_ctx->new_sub_partitions && new_ctx->new_sub_producer_info &&
+            new_ctx->new_sub_dead_info);
+    hvr_dist_bitvec_subcopy_pool_init(&new_ctx->partition_producers, 1024,
+            &new_ctx->producer_info_pool);
+    hvr_dist_bitvec_subcopy_pool_init(&new_ctx->terminated_pes, 1024,
+            &new_ctx->dead_info_pool);
+
+    new_ctx->n_dirty_partitions = 0;
+    new_ctx->n_subscriber_partitions = 0;
     new_ctx->any_needs_processing = 1;
 
     new_ctx->edge_list_pool_size = 128 * 1024;
@@ -1483,25 +2492,177 @@ void hvr_init(const hvr_partition_t n_partitions,
             new_ctx->neighbors_list_pool, new_ctx->neighbors_list_pool_size, 0);
     assert(new_ctx->neighbors_list_tracker);
 
-    // Print the number of bytes allocated
-#ifdef DETAILED_PRINTS
-    shmem_malloc_wrapper(0);
-    malloc_helper(0);
-    print_memory_metrics(new_ctx);
-#endif
-
-    shmem_barrier_all();
-}
+    new_ctx->hub_degree_threshold = 0;
+    if (getenv("HVR_HUB_DEGREE_THRESHOLD")) {
+        new_ctx->hub_degree_threshold = atoi(getenv("HVR_HUB_DEGREE_THRESHOLD"));
+    }
+    new_ctx->hub_edges_per_iter = MAX_MODIFICATIONS;
+    if (getenv("HVR_HUB_EDGES_PER_ITER")) {
+        new_ctx->hub_edges_per_iter = atoi(getenv("HVR_HUB_EDGES_PER_ITER"));
+        assert(new_ctx->hub_edges_per_iter > 0);
+    }
+    new_ctx->max_pending_hubs = 1024;
+    if (getenv("HVR_MAX_PENDING_HUBS")) {
+        new_ctx->max_pending_hubs = atoi(getenv("HVR_MAX_PENDING_HUBS"));
+    }
+    new_ctx->pending_hubs = (hvr_hub_work_t *)malloc_helper(
+            new_ctx->max_pending_hubs * sizeof(new_ctx->pending_hubs[0]));
+    assert(new_ctx->pending_hubs);
+    new_ctx->n_pending_hubs = 0;
+
+    new_ctx->pipeline_chunk = 0;
+    if (getenv("HVR_PIPELINE_CHUNK")) {
+        new_ctx->pipeline_chunk = atoi(getenv("HVR_PIPELINE_CHUNK"));
+    }
 
-static void *aborting_thread(void *user_data) {
-    int nseconds = atoi(getenv("HVR_HANG_ABORT"));
-    assert(nseconds > 0);
+    new_ctx->idle_iterations = 0;
+    new_ctx->n_empty_iterations = 0;
+    new_ctx->idle_timeout_us = 10000;
+    new_ctx->idle_max_backoff_us = 1000;
+    new_ctx->idle_time = 0;
 
-    fprintf(stderr, "INFO: HOOVER will forcibly abort PE %d after %d "
-            "seconds.\n", shmem_my_pe(), nseconds);
+    new_ctx->n_priority_buckets = 64;
+    if (getenv("HVR_PRIORITY_BUCKETS")) {
+        new_ctx->n_priority_buckets = atoi(getenv("HVR_PRIORITY_BUCKETS"));
+        assert(new_ctx->n_priority_buckets > 0);
+    }
 
-    const unsigned long long start = hvr_current_time_us();
-    while (hvr_current_time_us() - start < nseconds * 1000000) {
+    new_ctx->max_mirror_awaits = 1024;
+    if (getenv("HVR_MAX_MIRROR_AWAITS")) {
+        new_ctx->max_mirror_awaits = atoi(getenv("HVR_MAX_MIRROR_AWAITS"));
+    }
+    new_ctx->mirror_awaits = (hvr_mirror_await_t *)malloc_helper(
+            new_ctx->max_mirror_awaits * sizeof(new_ctx->mirror_awaits[0]));
+    assert(new_ctx->mirror_awaits);
+    new_ctx->n_mirror_awaits = 0;
+    new_ctx->resume_state = NULL;
+    if (getenv("HVR_IDLE_ITERATIONS")) {
+        if (new_ctx->strict_mode) {
+            fprintf(stderr, "ERROR: HVR_IDLE_ITERATIONS and HVR_STRICT cannot "
+                    "be used together\n");
+            abort();
+        }
+        new_ctx->idle_iterations = atoi(getenv("HVR_IDLE_ITERATIONS"));
+    }
+    if (getenv("HVR_IDLE_TIMEOUT_US")) {
+        new_ctx->idle_timeout_us = atoll(getenv("HVR_IDLE_TIMEOUT_US"));
+    }
+    if (getenv("HVR_IDLE_MAX_BACKOFF_US")) {
+        new_ctx->idle_max_backoff_us = atoll(getenv("HVR_IDLE_MAX_BACKOFF_US"));
+    }
+
+    new_ctx->progress_thread_enabled = 0;
+    if (getenv("HVR_PROGRESS_THREAD")) {
+        new_ctx->progress_thread_enabled = atoi(getenv("HVR_PROGRESS_THREAD"));
+    }
+    if (new_ctx->progress_thread_enabled) {
+        int provided;
+        shmem_query_thread(&provided);
+        if (provided != SHMEM_THREAD_MULTIPLE) {
+            fprintf(stderr, "ERROR: HVR_PROGRESS_THREAD requires OpenSHMEM to "
+                    "be initialized with SHMEM_THREAD_MULTIPLE\n");
+            abort();
+        }
+
+        size_t progress_queue_size = 16 * 1024 * 1024;
+        if (getenv("HVR_PROGRESS_QUEUE_SIZE")) {
+            progress_queue_size = atol(getenv("HVR_PROGRESS_QUEUE_SIZE"));
+        }
+        new_ctx->progress_recv_buf_size = max_msg_len;
+        if (progress_queue_size < 2 * max_msg_len) {
+            fprintf(stderr, "ERROR: HVR_PROGRESS_QUEUE_SIZE must be at least "
+                    "%lu bytes\n", 2 * max_msg_len);
+            abort();
+        }
+        hvr_progress_queue_init(&new_ctx->progress_queue, progress_queue_size);
+        new_ctx->progress_recv_buf = malloc_helper(max_msg_len);
+        assert(new_ctx->progress_recv_buf);
+        new_ctx->progress_thread_stop = 0;
+        new_ctx->progress_queue_stalls = 0;
+    }
+
+#ifdef MULTITHREADED
+    new_ctx->nthreads = omp_get_max_threads();
+    new_ctx->in_parallel_update = 0;
+    new_ctx->max_thread_msgs = 4096;
+    if (getenv("HVR_MAX_THREAD_MSGS")) {
+        new_ctx->max_thread_msgs = atoi(getenv("HVR_MAX_THREAD_MSGS"));
+    }
+    new_ctx->threads = (hvr_thread_state_t *)malloc_helper(
+            new_ctx->nthreads * sizeof(new_ctx->threads[0]));
+    assert(new_ctx->threads);
+    for (int t = 0; t < new_ctx->nthreads; t++) {
+        hvr_thread_state_t *thread = new_ctx->threads + t;
+        hvr_buffered_changes_init(n_allocated_changes,
+                &thread->buffered_changes);
+        thread->to_couple_with = hvr_create_empty_set(new_ctx->npes);
+        thread->msgs = (inter_vert_msg_t *)malloc_helper(
+                new_ctx->max_thread_msgs * sizeof(thread->msgs[0]));
+        assert(thread->msgs);
+        thread->n_msgs = 0;
+        thread->neighbors_list_pool = malloc_helper(
+                new_ctx->neighbors_list_pool_size);
+        assert(thread->neighbors_list_pool);
+        thread->neighbors_list_tracker = create_mspace_with_base(
+                thread->neighbors_list_pool, new_ctx->neighbors_list_pool_size,
+                0);
+        assert(thread->neighbors_list_tracker);
+    }
+    new_ctx->frontier = (hvr_frontier_entry_t *)malloc_helper(
+            new_ctx->vec_cache.pool_size * sizeof(new_ctx->frontier[0]));
+    assert(new_ctx->frontier);
+    int err = pthread_rwlock_init(&new_ctx->cache_lock, NULL);
+    assert(err == 0);
+
+    new_ctx->parallel_edge_min_partitions = 0;
+    if (getenv("HVR_PARALLEL_EDGE_MIN_PARTITIONS")) {
+        new_ctx->parallel_edge_min_partitions = atoi(
+                getenv("HVR_PARALLEL_EDGE_MIN_PARTITIONS"));
+    }
+    new_ctx->max_thread_edges = 65536;
+    if (getenv("HVR_MAX_THREAD_EDGES")) {
+        new_ctx->max_thread_edges = atoi(getenv("HVR_MAX_THREAD_EDGES"));
+    }
+    if (new_ctx->parallel_edge_min_partitions > 0) {
+        for (int t = 0; t < new_ctx->nthreads; t++) {
+            hvr_thread_state_t *thread = new_ctx->threads + t;
+            thread->found_edges = (hvr_found_edge_t *)malloc_helper(
+                    new_ctx->max_thread_edges * sizeof(thread->found_edges[0]));
+            assert(thread->found_edges);
+            thread->n_found_edges = 0;
+        }
+        new_ctx->partition_n_scanned = (unsigned *)malloc_helper(
+                MAX_INTERACTING_PARTITIONS *
+                sizeof(new_ctx->partition_n_scanned[0]));
+        assert(new_ctx->partition_n_scanned);
+    }
+#endif
+
+    // Print the number of bytes allocated
+#ifdef DETAILED_PRINTS
+    shmem_malloc_wrapper(0);
+    malloc_helper(0);
+    print_memory_metrics(new_ctx);
+#endif
+
+    if (new_ctx->progress_thread_enabled) {
+        const int pthread_err = pthread_create(&new_ctx->progress_pthread,
+                NULL, progress_thread, new_ctx);
+        assert(pthread_err == 0);
+    }
+
+    shmem_barrier_all();
+}
+
+static void *aborting_thread(void *user_data) {
+    int nseconds = atoi(getenv("HVR_HANG_ABORT"));
+    assert(nseconds > 0);
+
+    fprintf(stderr, "INFO: HOOVER will forcibly abort PE %d after %d "
+            "seconds.\n", shmem_my_pe(), nseconds);
+
+    const unsigned long long start = hvr_current_time_us();
+    while (hvr_current_time_us() - start < nseconds * 1000000) {
         sleep(10);
     }
 
@@ -1532,6 +2693,66 @@ static void send_all_vertices_in_partition(int pe, hvr_partition_t part,
     }
 }
 
+/*
+ * Copy all local vertices in part to the snapshot ring and tell pe where to
+ * find them. Returns 0 if they do not fit in the ring, in which case the
+ * caller should fall back to send_all_vertices_in_partition.
+ *
+ * The notice is sent through vertex_update_mailbox, so pe applies the
+ * snapshot after any update we sent it before now and before any update we
+ * send it later.
+ */
+static int publish_partition_snapshot(int pe, hvr_partition_t part,
+        hvr_internal_ctx_t *ctx) {
+    if (pe == ctx->pe) {
+        return 1;
+    }
+
+    uint64_t count = 0;
+    hvr_vertex_t *iter = hvr_partition_list_head(part,
+            &ctx->local_partition_lists);
+    while (iter) {
+        count++;
+        iter = iter->next_in_partition;
+    }
+    if (count > ctx->snapshot_capacity) {
+        return 0;
+    }
+
+    // Snapshots never wrap around the end of the ring
+    uint64_t start = *(ctx->snapshot_head);
+    const uint64_t offset = start % ctx->snapshot_capacity;
+    if (offset + count > ctx->snapshot_capacity) {
+        start += ctx->snapshot_capacity - offset;
+    }
+    /*
+     * The head must be visible to readers before we start overwriting the
+     * reserved positions, and the copies must be complete before pe can be
+     * told to read them.
+     */
+    shmem_uint64_atomic_set(ctx->snapshot_head, start + count, ctx->pe);
+    shmem_quiet();
+
+    hvr_vertex_t *dst = ctx->snapshot_ring +
+        (start % ctx->snapshot_capacity);
+    iter = hvr_partition_list_head(part, &ctx->local_partition_lists);
+    while (iter) {
+        memcpy(dst++, iter, sizeof(*iter));
+        iter = iter->next_in_partition;
+    }
+    shmem_quiet();
+
+    hvr_update_msg_t msg;
+    msg.is_vert_update = 0;
+    msg.is_snapshot = 1;
+    msg.payload.snapshot.pe = ctx->pe;
+    msg.payload.snapshot.partition = part;
+    msg.payload.snapshot.start = start;
+    msg.payload.snapshot.count = count;
+    send_to_vertex_update_mailbox(&msg, pe, ctx);
+    return 1;
+}
+
 static void process_vertex_subscriptions(hvr_internal_ctx_t *ctx,
         int max_iters) {
     size_t msg_len;
@@ -1555,6 +2776,23 @@ static void process_vertex_subscriptions(hvr_internal_ctx_t *ctx,
             hvr_vertex_cache_node_t *local = ctx->vec_cache.pool_mem + offset;
 
             if (change->entered) {
+                if (!hvr_vertex_cache_lookup(change->vert, &ctx->vec_cache)) {
+                    /*
+                     * Deleted or migrated before the subscription arrived,
+                     * tell the subscriber to drop its copy.
+                     */
+                    const int migrated = ctx->forwarding &&
+                        shmem_uint64_atomic_fetch(ctx->forwarding + offset,
+                                ctx->pe) != HVR_INVALID_VERTEX_ID;
+                    hvr_vertex_t gone;
+                    hvr_vertex_init(&gone, change->vert, ctx->iter);
+                    hvr_update_msg_t msg;
+                    hvr_vert_update_init(&msg, &gone,
+                            migrated ? HVR_MIGRATION_INVALIDATION :
+                            HVR_DELETE_INVALIDATION);
+                    send_to_vertex_update_mailbox(&msg, change->pe, ctx);
+                    continue;
+                }
                 if (!hvr_sparse_arr_contains(offset, change->pe,
                             &ctx->remote_vert_subs)) {
                     /*
@@ -1574,10 +2812,11 @@ static void process_vertex_subscriptions(hvr_internal_ctx_t *ctx,
 
                     if (ctx->send_neighbor_updates_for_explicit_subs) {
                         // Send all edges for this vertex to the subscribing PE
-                        unsigned n_neighbors = hvr_irr_matrix_linearize(
+                        unsigned n_neighbors =
+                            hvr_irr_matrix_linearize_with_payloads(
                                 CACHE_NODE_OFFSET(local, &ctx->vec_cache),
-                                ctx->edge_buffer, MAX_MODIFICATIONS,
-                                &ctx->edges);
+                                ctx->edge_buffer, ctx->edge_payload_buffer,
+                                MAX_MODIFICATIONS, &ctx->edges);
 
 
                         for (unsigned n = 0; n < n_neighbors; n++) {
@@ -1590,7 +2829,8 @@ static void process_vertex_subscriptions(hvr_internal_ctx_t *ctx,
                             if (neighbor->populated) {
                                 hvr_update_msg_t msg;
                                 hvr_edge_update_init(&msg, &local->vert,
-                                        neighbor->vert.id, edge, 1);
+                                        neighbor->vert.id, edge,
+                                        ctx->edge_payload_buffer[n], 1);
                                 send_to_vertex_update_mailbox(&msg, change->pe,
                                         ctx);
                             }
@@ -1633,9 +2873,16 @@ static void process_partition_subscriptions(hvr_internal_ctx_t *ctx) {
             (hvr_partition_member_change_t *)msg_buf_node->ptr;
         assert(change->pe >= 0 && change->pe < ctx->npes);
         assert(change->partition < ctx->n_partitions);
-        assert(change->entered == 0 || change->entered == 1);
+        assert(change->entered == 0 || change->entered == 1 ||
+                change->entered == PARTITION_SUB_RESEND);
 
-        if (change->entered) {
+        if (change->entered == PARTITION_SUB_RESEND) {
+            if (hvr_sparse_arr_contains(change->partition, change->pe,
+                        &ctx->remote_partition_subs)) {
+                send_all_vertices_in_partition(change->pe, change->partition,
+                        ctx);
+            }
+        } else if (change->entered) {
             // Entered partition
 
             if (!hvr_sparse_arr_contains(change->partition, change->pe,
@@ -1643,10 +2890,16 @@ static void process_partition_subscriptions(hvr_internal_ctx_t *ctx) {
                 /*
                  * This is a new subscription from a remote PE for this
                  * partition. If we find new subscriptions, we need to transmit
-                 * all vertex information we have for that partition to the PE.
+                 * all vertex information we have for that partition to the PE,
+                 * either by publishing a snapshot for it to pull or by sending
+                 * each vertex.
                  */
-                send_all_vertices_in_partition(change->pe, change->partition,
-                        ctx);
+                if (ctx->snapshot_capacity == 0 ||
+                        !publish_partition_snapshot(change->pe,
+                            change->partition, ctx)) {
+                    send_all_vertices_in_partition(change->pe,
+                            change->partition, ctx);
+                }
                 hvr_sparse_arr_insert(change->partition, change->pe,
                         &ctx->remote_partition_subs);
             }
@@ -1677,8 +2930,110 @@ static void process_partition_subscriptions(hvr_internal_ctx_t *ctx) {
 
 }
 
+/*
+ * Retry any unsent producer changes, then handle messages on
+ * producer_change_mailbox, both as the owner of registry rows and as a
+ * subscriber.
+ */
+static void process_producer_changes(hvr_internal_ctx_t *ctx) {
+    flush_producer_changes(ctx);
+
+    size_t msg_len;
+    hvr_producer_change_msg_t change;
+    int success = hvr_mailbox_recv(&change, sizeof(change), &msg_len,
+            &ctx->producer_change_mailbox);
+    while (success) {
+        assert(msg_len == sizeof(change));
+        assert(change.pe >= 0 && change.pe < ctx->npes);
+        assert(change.partition < ctx->n_partitions);
+        const hvr_partition_t p = change.partition;
+
+        switch (change.type) {
+            case (PRODUCER_CHANGE_SUBSCRIBE): {
+                /*
+                 * The new subscriber copied the registry row before
+                 * registering, and may have missed producers that registered
+                 * concurrently. Any producer whose registration message we
+                 * have already handled is set in our copy of the row, so
+                 * re-sending the current producers closes that gap.
+                 */
+                hvr_sparse_arr_insert(p, change.pe, &ctx->registry_subs);
+                hvr_dist_bitvec_copy_locally(p, &ctx->partition_producers,
+                        &ctx->local_partition_producers);
+                for (int pe = 0; pe < ctx->npes; pe++) {
+                    if (hvr_dist_bitvec_local_subcopy_contains(pe,
+                                &ctx->local_partition_producers)) {
+                        send_producer_change(PRODUCER_CHANGE_NOTIFY_STARTED,
+                                pe, p, change.pe, ctx);
+                    }
+                }
+                break;
+            }
+            case (PRODUCER_CHANGE_UNSUBSCRIBE):
+                if (hvr_sparse_arr_contains(p, change.pe,
+                            &ctx->registry_subs)) {
+                    hvr_sparse_arr_remove(p, change.pe, &ctx->registry_subs);
+                }
+                break;
+            case (PRODUCER_CHANGE_STARTED):
+            case (PRODUCER_CHANGE_STOPPED): {
+                hvr_producer_change_type_t notify =
+                    (change.type == PRODUCER_CHANGE_STARTED ?
+                     PRODUCER_CHANGE_NOTIFY_STARTED :
+                     PRODUCER_CHANGE_NOTIFY_STOPPED);
+                hvr_sparse_arr_row_iter_t iter;
+                hvr_sparse_arr_row_iter_init(&iter, p, &ctx->registry_subs);
+                unsigned subscriber;
+                while (hvr_sparse_arr_row_iter_next(&iter, &subscriber)) {
+                    send_producer_change(notify, change.pe, p, subscriber,
+                            ctx);
+                }
+                break;
+            }
+            case (PRODUCER_CHANGE_NOTIFY_STARTED):
+            case (PRODUCER_CHANGE_NOTIFY_STOPPED): {
+                hvr_dist_bitvec_local_subcopy_t *p_producer_info =
+                    (hvr_dist_bitvec_local_subcopy_t *)hvr_map_get(p,
+                            &ctx->producer_info);
+                if (!p_producer_info) {
+                    // We have since unsubscribed from p
+                    break;
+                }
+
+                if (change.type == PRODUCER_CHANGE_NOTIFY_STOPPED) {
+                    hvr_dist_bitvec_local_subcopy_clear(change.pe,
+                            p_producer_info);
+                } else {
+                    /*
+                     * Always (re-)subscribe with the producer, which ignores
+                     * duplicate subscriptions.
+                     */
+                    hvr_dist_bitvec_local_subcopy_set(change.pe,
+                            p_producer_info);
+                    hvr_partition_member_change_t sub;
+                    sub.pe = ctx->pe;
+                    sub.partition = p;
+                    sub.entered = 1;
+                    hvr_mailbox_send(&sub, sizeof(sub), change.pe, -1,
+                            &ctx->forward_mailbox);
+                }
+                break;
+            }
+            default:
+                abort();
+        }
+
+        success = hvr_mailbox_recv(&change, sizeof(change), &msg_len,
+                &ctx->producer_change_mailbox);
+    }
+}
+
 static void process_neighbor_updates(hvr_internal_ctx_t *ctx,
         unsigned long long *measure_midpoint) {
+    if (ctx->push_producer_changes) {
+        process_producer_changes(ctx);
+    }
+
     // Poll for new partition subscriptions/unsubscriptions
     process_partition_subscriptions(ctx);
 
@@ -1688,12 +3043,27 @@ static void process_neighbor_updates(hvr_internal_ctx_t *ctx,
     process_vertex_subscriptions(ctx, 1000);
 }
 
+// Delete all edges of cached, the first n_neighbors of which are in edge_buffer
+static void delete_all_edges(hvr_vertex_cache_node_t *cached,
+        unsigned n_neighbors, hvr_internal_ctx_t *ctx) {
+    for (size_t n = 0; n < n_neighbors; n++) {
+        hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
+                EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
+        hvr_edge_type_t edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
+        hvr_edge_create_type_t create_type = EDGE_INFO_CREATION(
+                ctx->edge_buffer[n]);
+        update_edge_info(cached, cached_neighbor, NO_EDGE, IMPLICIT_EDGE,
+                0, &edge, &create_type, 0, ctx);
+    }
+}
+
 /*
  * When a vertex is deleted, we simply need to remove all of its
- * edges with local vertices and remove it from the cache.
+ * edges with local vertices and remove it from the cache. Only a vertex that
+ * has migrated away may still have explicit edges.
  */
 static void handle_deleted_vertex(hvr_vertex_t *dead_vert,
-        int expect_no_edges,
+        int expect_no_edges, int is_migration,
         hvr_internal_ctx_t *ctx) {
     hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(dead_vert->id,
             &ctx->vec_cache);
@@ -1706,32 +3076,37 @@ static void handle_deleted_vertex(hvr_vertex_t *dead_vert,
 
         if (expect_no_edges) {
             for (size_t n = 0; n < n_neighbors; n++) {
-                hvr_vertex_id_t id = EDGE_INFO_VERTEX(ctx->edge_buffer[n]);
-                assert(VERTEX_ID_PE(id) != ctx->pe);
+                hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(
+                        EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
+                assert(VERTEX_ID_PE(neighbor->vert.id) != ctx->pe);
             }
         }
-        assert(cached->n_explicit_edges == 0);
+        assert(is_migration || cached->n_explicit_edges == 0);
 
-        // Delete all edges
-        for (size_t n = 0; n < n_neighbors; n++) {
-            hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
-                    EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
-            hvr_edge_type_t edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
-            hvr_edge_create_type_t create_type = EDGE_INFO_CREATION(
-                    ctx->edge_buffer[n]);
-            update_edge_info(cached, cached_neighbor, NO_EDGE, IMPLICIT_EDGE,
-                    &edge, &create_type, 0, ctx);
-        }
+        delete_all_edges(cached, n_neighbors, ctx);
+        assert(cached->n_explicit_edges == 0);
 
         hvr_vertex_t *cached_vert = &cached->vert;
         hvr_partition_t partition = cached_vert->curr_part;
         remove_from_partition_list_helper(cached_vert, partition,
                 &ctx->mirror_partition_lists, ctx);
 
+        remove_hub_work(CACHE_NODE_OFFSET(cached, &ctx->vec_cache), ctx);
         hvr_vertex_cache_delete(cached, &ctx->vec_cache);
     }
 }
 
+// Returns whether a local vertex is waiting on the remote vertex id
+static int is_mirror_awaited(hvr_vertex_id_t id, hvr_internal_ctx_t *ctx) {
+    for (unsigned i = 0; i < ctx->n_mirror_awaits; i++) {
+        if (ctx->mirror_awaits[i].awaited == id &&
+                !ctx->mirror_awaits[i].missing) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void handle_new_vertex(hvr_vertex_t *new_vert,
         process_perf_info_t *perf_info,
         hvr_internal_ctx_t *ctx) {
@@ -1741,10 +3116,10 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
     hvr_vertex_id_t updated_vert_id = new_vert->id;
 
     unsigned n_interacting = 0;
+    const hvr_partition_t *interacting = NULL;
     if (new_partition != HVR_INVALID_PARTITION) {
-        assert(ctx->might_interact);
-        ctx->might_interact(new_partition, ctx->interacting, &n_interacting,
-                MAX_INTERACTING_PARTITIONS, ctx);
+        interacting = get_interacting_partitions(new_partition, &n_interacting,
+                ctx);
     }
 
     hvr_vertex_cache_node_t *updated = hvr_vertex_cache_lookup(
@@ -1752,11 +3127,13 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
 
     /*
      * Am I subscribed to the partition the vertex is now in, or have explicit
-     * edges on this vertex (meaning I am subscribed specifically to it).
+     * edges on this vertex or a local vertex waiting for it (meaning I am
+     * subscribed specifically to it).
      */
     int am_subscribed = (updated && updated->n_explicit_edges > 0) ||
         (new_partition != HVR_INVALID_PARTITION &&
-         hvr_set_contains(new_partition, ctx->subscribed_partitions));
+         hvr_set_contains(new_partition, ctx->subscribed_partitions)) ||
+        is_mirror_awaited(updated_vert_id, ctx);
 
     /*
      * If this is a vertex we already know about then we have
@@ -1780,7 +3157,7 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
                 update_partition_list_membership(&updated->vert, old_partition,
                         new_partition, &ctx->mirror_partition_lists, ctx);
                 local_count_new_should_have_edges += update_existing_edges(
-                        updated, ctx->interacting, n_interacting, ctx);
+                        updated, interacting, n_interacting, ctx);
             }
 
             /*
@@ -1799,8 +3176,12 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
                 perf_info->time_creating_edges += (done - done_updating_edges);
             }
         } else {
-            // Not subscribed to the partition this vertex has moved to
-            handle_deleted_vertex(new_vert, 0, ctx);
+            /*
+             * Not subscribed to the partition this vertex has moved to, and no
+             * longer have explicit edges on it
+             */
+            drop_vertex_subscription(new_vert->id, 1, ctx);
+            handle_deleted_vertex(new_vert, 0, 0, ctx);
         }
     } else {
         /*
@@ -1817,11 +3198,11 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
             prepend_to_partition_list(&updated->vert, new_partition,
                     &ctx->mirror_partition_lists, ctx);
             local_count_new_should_have_edges += create_new_edges(updated,
-                    ctx->interacting, n_interacting,
-                    &ctx->mirror_partition_lists, ctx);
+                    interacting, n_interacting,
+                    &ctx->mirror_partition_lists, 0, ctx);
             local_count_new_should_have_edges += create_new_edges(updated,
-                    ctx->interacting, n_interacting,
-                    &ctx->local_partition_lists, ctx);
+                    interacting, n_interacting,
+                    &ctx->local_partition_lists, 0, ctx);
 
             /*
              * Don't need to mark downstream because creation of new edges for
@@ -1840,9 +3221,106 @@ static void handle_new_vertex(hvr_vertex_t *new_vert,
     }
 }
 
+/*
+ * If dst_id is a local vertex that has been migrated to another PE, redirect
+ * payload to its new ID (or hold it until its migration completes) and return
+ * 1. Otherwise, return 0.
+ */
+static int forward_if_migrated(hvr_vertex_id_t dst_id, hvr_vertex_t *payload,
+        hvr_internal_ctx_t *ctx) {
+    if (!ctx->forwarding) {
+        return 0;
+    }
+
+    const hvr_vertex_id_t forward_to = shmem_uint64_atomic_fetch(
+            ctx->forwarding + VERTEX_ID_OFFSET(dst_id), ctx->pe);
+    if (forward_to == HVR_INVALID_VERTEX_ID) {
+        return 0;
+    }
+
+    if (forward_to == HVR_FORWARDING_PENDING) {
+        if (ctx->n_forward_retries == ctx->max_forward_retries) {
+            fprintf(stderr, "ERROR: PE %d exceeded the maximum number of "
+                    "messages held for migrating vertices (%u). Increase "
+                    "HVR_MAX_FORWARD_RETRIES.\n", ctx->pe,
+                    ctx->max_forward_retries);
+            abort();
+        }
+        inter_vert_msg_t *held = ctx->forward_retries +
+            ctx->n_forward_retries++;
+        held->dst = dst_id;
+        memcpy(&held->payload, payload, sizeof(*payload));
+    } else {
+        hvr_send_msg(forward_to, payload, ctx);
+    }
+    return 1;
+}
+
+/*
+ * If msg creates an edge with a local vertex that has been migrated to another
+ * PE, redirect it to the vertex's new owner (or hold it until its migration
+ * completes) and return 1. Otherwise, return 0. The creator drops its copy of
+ * the vertex under its old ID, and the edge with it, when its subscription to
+ * that ID is refused.
+ */
+static int forward_edge_if_migrated(hvr_edge_create_msg_t *msg,
+        hvr_internal_ctx_t *ctx) {
+    if (!ctx->forwarding || msg->is_forward == 1 ||
+            VERTEX_ID_PE(msg->target) != ctx->pe) {
+        return 0;
+    }
+
+    const hvr_vertex_id_t forward_to = shmem_uint64_atomic_fetch(
+            ctx->forwarding + VERTEX_ID_OFFSET(msg->target), ctx->pe);
+    if (forward_to == HVR_INVALID_VERTEX_ID) {
+        return 0;
+    }
+
+    if (forward_to == HVR_FORWARDING_PENDING) {
+        if (ctx->n_edge_forward_retries == ctx->max_forward_retries) {
+            fprintf(stderr, "ERROR: PE %d exceeded the maximum number of edge "
+                    "creates held for migrating vertices (%u). Increase "
+                    "HVR_MAX_FORWARD_RETRIES.\n", ctx->pe,
+                    ctx->max_forward_retries);
+            abort();
+        }
+        memcpy(ctx->edge_forward_retries + ctx->n_edge_forward_retries++, msg,
+                sizeof(*msg));
+        return 1;
+    }
+
+    hvr_update_msg_t out;
+    hvr_edge_update_init(&out, &msg->src, forward_to, msg->edge, msg->payload,
+            HVR_EDGE_REDIRECTED);
+    send_to_vertex_update_mailbox(&out, VERTEX_ID_PE(forward_to), ctx);
+    return 1;
+}
+
 void hvr_send_msg(hvr_vertex_id_t dst_id, hvr_vertex_t *payload,
         hvr_internal_ctx_t *ctx) {
+#ifdef MULTITHREADED
+    if (ctx->in_parallel_update) {
+        // Staged until all threads finish, then sent from update_vertices
+        hvr_thread_state_t *thread = ctx->threads + omp_get_thread_num();
+        if (thread->n_msgs == ctx->max_thread_msgs) {
+            fprintf(stderr, "ERROR: PE %d thread %d exceeded the maximum "
+                    "number of messages sent in one update (%u). Increase "
+                    "HVR_MAX_THREAD_MSGS.\n", ctx->pe, omp_get_thread_num(),
+                    ctx->max_thread_msgs);
+            abort();
+        }
+        inter_vert_msg_t *msg = thread->msgs + thread->n_msgs++;
+        msg->dst = dst_id;
+        memcpy(&msg->payload, payload, sizeof(*payload));
+        return;
+    }
+#endif
+
     if (VERTEX_ID_PE(dst_id) == ctx->pe) {
+        if (forward_if_migrated(dst_id, payload, ctx)) {
+            return;
+        }
+
         size_t offset = VERTEX_ID_OFFSET(dst_id);
         hvr_buffered_msgs_insert(offset, payload, &ctx->buffered_msgs);
 
@@ -1863,11 +3341,28 @@ void hvr_send_msg(hvr_vertex_id_t dst_id, hvr_vertex_t *payload,
 int hvr_poll_msg(hvr_vertex_t *vert, hvr_vertex_t *out,
         hvr_internal_ctx_t *ctx) {
     assert(VERTEX_ID_PE(vert->id) == ctx->pe);
-    return hvr_buffered_msgs_poll(VERTEX_ID_OFFSET(vert->id), out,
+    int success;
+#ifdef MULTITHREADED
+#pragma omp critical(hvr_buffered_msgs)
+#endif
+    success = hvr_buffered_msgs_poll(VERTEX_ID_OFFSET(vert->id), out,
             &ctx->buffered_msgs);
+    return success;
 }
 
 static void process_incoming_messages(hvr_internal_ctx_t *ctx) {
+    /*
+     * Retry messages held for vertices that were migrating. Any that are still
+     * in flight are held again, never past their current position.
+     */
+    const unsigned n_retries = ctx->n_forward_retries;
+    ctx->n_forward_retries = 0;
+    for (unsigned i = 0; i < n_retries; i++) {
+        inter_vert_msg_t held;
+        memcpy(&held, ctx->forward_retries + i, sizeof(held));
+        hvr_send_msg(held.dst, &held.payload, ctx);
+    }
+
     size_t msg_len;
     hvr_msg_buf_node_t *msg_buf_node = hvr_msg_buf_pool_acquire(
             &ctx->msg_buf_pool);
@@ -1878,12 +3373,16 @@ static void process_incoming_messages(hvr_internal_ctx_t *ctx) {
         inter_vert_msg_t *msg = (inter_vert_msg_t *)msg_buf_node->ptr;
         assert(VERTEX_ID_PE(msg->dst) == ctx->pe);
 
-        size_t offset = VERTEX_ID_OFFSET(msg->dst);
-        hvr_buffered_msgs_insert(offset, &msg->payload, &ctx->buffered_msgs);
+        if (!forward_if_migrated(msg->dst, &msg->payload, ctx)) {
+            size_t offset = VERTEX_ID_OFFSET(msg->dst);
+            hvr_buffered_msgs_insert(offset, &msg->payload,
+                    &ctx->buffered_msgs);
 
-        hvr_vertex_cache_node_t *local = ctx->vec_cache.pool_mem + offset;
-        assert(local->vert.id != HVR_INVALID_VERTEX_ID); // Verify is allocated
-        mark_for_processing(&local->vert, ctx);
+            hvr_vertex_cache_node_t *local = ctx->vec_cache.pool_mem + offset;
+            // Verify is allocated
+            assert(local->vert.id != HVR_INVALID_VERTEX_ID);
+            mark_for_processing(&local->vert, ctx);
+        }
 
         success = hvr_mailbox_recv(msg_buf_node->ptr, msg_buf_node->buf_size,
                 &msg_len, &ctx->vertex_msg_mailbox);
@@ -1892,226 +3391,399 @@ static void process_incoming_messages(hvr_internal_ctx_t *ctx) {
     hvr_msg_buf_pool_release(msg_buf_node, &ctx->msg_buf_pool);
 }
 
-static unsigned process_vertex_updates(hvr_internal_ctx_t *ctx,
-        process_perf_info_t *perf_info, int max_to_process) {
-    unsigned count_update_msgs = 0;
-    unsigned count_msgs = 0;
-    size_t msg_len;
+/*
+ * Body of the communication progress thread. Continuously drains
+ * vertex_update_mailbox into progress_queue. If progress_queue is full, leaves
+ * messages in the mailbox until the main thread catches up, so that remote
+ * senders see the same back pressure as without a progress thread.
+ */
+static void *progress_thread(void *user_data) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)user_data;
+    unsigned n_empty_polls = 0;
+    int stalled = 0;
+
+    while (!ctx->progress_thread_stop) {
+        if (!hvr_progress_queue_has_space(ctx->progress_recv_buf_size,
+                    &ctx->progress_queue)) {
+            // Count each time the queue fills up, not each poll while full
+            if (!stalled) {
+                ctx->progress_queue_stalls++;
+                stalled = 1;
+            }
+            sched_yield();
+            continue;
+        }
+        stalled = 0;
 
-    const unsigned long long start = hvr_current_time_us();
-    // Handle deletes, then updates
-    hvr_msg_buf_node_t *msg_buf_node = hvr_msg_buf_pool_acquire(
-            &ctx->msg_buf_pool);
+        size_t msg_len;
+        if (hvr_mailbox_recv(ctx->progress_recv_buf,
+                    ctx->progress_recv_buf_size, &msg_len,
+                    &ctx->vertex_update_mailbox)) {
+            const int success = hvr_progress_queue_push(ctx->progress_recv_buf,
+                    msg_len, &ctx->progress_queue);
+            assert(success);
+            n_empty_polls = 0;
+        } else if (++n_empty_polls > 1000) {
+            // Back off while idle rather than spin on remote atomics
+            usleep(10);
+        }
+    }
+    return NULL;
+}
 
-    const unsigned long long midpoint = hvr_current_time_us();
-    int success = hvr_mailbox_recv(msg_buf_node->ptr, msg_buf_node->buf_size,
-            &msg_len, &ctx->vertex_update_mailbox);
-    while (success) {
-        assert(msg_len % sizeof(hvr_update_msg_t) == 0);
-        hvr_update_msg_t *msgs = (hvr_update_msg_t *)msg_buf_node->ptr;
+/*
+ * Fetch the next batch of vertex updates sent to this PE, either from the
+ * progress thread or directly from the mailbox.
+ */
+static int recv_vertex_updates(hvr_msg_buf_node_t *msg_buf_node,
+        size_t *msg_len, hvr_internal_ctx_t *ctx) {
+    if (ctx->progress_thread_enabled) {
+        return hvr_progress_queue_pop(msg_buf_node->ptr,
+                msg_buf_node->buf_size, msg_len, &ctx->progress_queue);
+    } else {
+        return hvr_mailbox_recv(msg_buf_node->ptr, msg_buf_node->buf_size,
+                msg_len, &ctx->vertex_update_mailbox);
+    }
+}
+
+static void request_partition_resend(int pe, hvr_partition_t partition,
+        hvr_internal_ctx_t *ctx) {
+    hvr_partition_member_change_t change;
+    change.pe = ctx->pe;
+    change.partition = partition;
+    change.entered = PARTITION_SUB_RESEND;
+    hvr_mailbox_send(&change, sizeof(change), pe, -1, &ctx->forward_mailbox);
+}
+
+/*
+ * Pull a snapshot published for us by a producer of a partition we have
+ * subscribed to. Everything the producer sent us before the snapshot is older
+ * than it, so its vertices replace any cached copies.
+ */
+static void apply_partition_snapshot(hvr_partition_snapshot_msg_t *msg,
+        process_perf_info_t *perf_info, hvr_internal_ctx_t *ctx) {
+    assert(msg->count <= ctx->snapshot_capacity);
 
-        for (unsigned i = 0; i < msg_len / sizeof(*msgs); i++) {
-            hvr_update_msg_t *wrapper_msg = msgs + i;
+    if (!hvr_set_contains(msg->partition, ctx->subscribed_partitions)) {
+        return;
+    }
 
-            if (wrapper_msg->is_vert_update) {
-                hvr_vertex_update_t *msg = &wrapper_msg->payload.vert_update;
-                assert(VERTEX_ID_PE(msg->vert.id) != ctx->pe);
+    if (ctx->snapshot_recv_in_progress) {
+        /*
+         * We got here from a send blocked while applying another snapshot,
+         * which still needs snapshot_recv_buf.
+         */
+        request_partition_resend(msg->pe, msg->partition, ctx);
+        return;
+    }
 
-                if (msg->is_invalidation) {
-                    handle_deleted_vertex(&(msg->vert), 0, ctx);
-                } else {
-                    handle_new_vertex(&(msg->vert), perf_info, ctx);
-                }
-            } else {
-                hvr_edge_create_msg_t *msg = &wrapper_msg->payload.edge_update;
+    // Blocking get, so the ring is read before the head is re-checked
+    shmem_getmem(ctx->snapshot_recv_buf, ctx->snapshot_ring +
+            (msg->start % ctx->snapshot_capacity),
+            msg->count * sizeof(hvr_vertex_t), msg->pe);
+    const uint64_t head = shmem_uint64_atomic_fetch(ctx->snapshot_head,
+            msg->pe);
 
-                /*
-                 * There are two ways in which an edge create notification is
-                 * sent to a PE:
-                 *   1. Another PE has explicitly created an edge with a
-                 *      locally-owned vertex, in which case target is the ID of
-                 *      the locally-owned vertex and src is the content of the
-                 *      remote vertex that just created an edge with us.
-                 *   2. This PE is subscribed to a remote vertex (because an
-                 *      edge was created with it) and a new explicit edge is
-                 *      created on that vertex. This new explicit edge may be
-                 *      between the subscribed-to vertex and any other vertex
-                 *      in the simulation. There are no rules on which of these
-                 *      is src/target, and both may be remote (though at least
-                 *      one must be cached locally as we are subscribed to it).
-                 *
-                 * In each of these cases at least one of the vertices is
-                 * guaranteed to be stored in the local vertex pool (in one
-                 * case because it is locally-owned, in the other case because
-                 * it is locally subscribed). In both cases, there are no
-                 * guarantees that the other vertex is locally known or not. It
-                 * may even be locally-owned.
-                 */
-                hvr_vertex_cache_node_t *cached_target =
-                    hvr_vertex_cache_lookup(msg->target, &ctx->vec_cache);
-                hvr_vertex_cache_node_t *cached_src = hvr_vertex_cache_lookup(
-                        msg->src.id, &ctx->vec_cache);
-                assert(cached_target || cached_src);
+    if (head > msg->start + ctx->snapshot_capacity) {
+        /*
+         * The producer reused part of the ring before we got to it, ask for
+         * the vertices to be pushed to us instead.
+         */
+        request_partition_resend(msg->pe, msg->partition, ctx);
+        return;
+    }
 
-                /*
-                 * If this is case #1 described above, we need to force this
-                 * edge being created and force a subscription to both vertices
-                 * if it doesn't already exist. If this is someone just
-                 * notifying us of a new edge create on a vertex we are
-                 * subscribed to (case #2) then we don't want to perform any new
-                 * subscriptions as a result and only want to proceed if we
-                 * already have both vertices locally present.
-                 */
-                if (!msg->is_forward) {
-                    // Force subscriptions
-                    if (VERTEX_ID_PE(msg->target) != ctx->pe) {
-                        hvr_vertex_t *body =
-                            (cached_target && cached_target->populated) ?
-                            &cached_target->vert : NULL;
-                        cached_target = set_up_vertex_subscription(msg->target,
-                                body, ctx);
-                    }
+    ctx->snapshot_recv_in_progress = 1;
+    for (uint64_t i = 0; i < msg->count; i++) {
+        handle_new_vertex(ctx->snapshot_recv_buf + i, perf_info, ctx);
+    }
+    ctx->snapshot_recv_in_progress = 0;
+}
 
-                    if (VERTEX_ID_PE(msg->src.id) != ctx->pe) {
-                        cached_src = set_up_vertex_subscription(msg->src.id,
-                                &msg->src, ctx);
-                    }
-                }
+static void apply_vertex_update(hvr_update_msg_t *wrapper_msg,
+        process_perf_info_t *perf_info, hvr_internal_ctx_t *ctx) {
+    if (wrapper_msg->is_snapshot) {
+        apply_partition_snapshot(&wrapper_msg->payload.snapshot, perf_info,
+                ctx);
+    } else if (wrapper_msg->is_vert_update) {
+        hvr_vertex_update_t *msg = &wrapper_msg->payload.vert_update;
+        assert(VERTEX_ID_PE(msg->vert.id) != ctx->pe);
 
-                if (cached_target && cached_src) {
-                    /*
-                     * Insert the explicitly created edge in our local edge info,
-                     * only if we're in case #1 and we forced these two vertices
-                     * into our cache or we just happened to already have them.
-                     */
-                    update_edge_info(cached_src, cached_target, msg->edge,
-                            EXPLICIT_EDGE, NULL, NULL, 1, ctx);
-                }
+        if (msg->is_invalidation == HVR_PARTITION_INVALIDATION) {
+            /*
+             * The vertex left a partition we subscribe to. If we are also
+             * subscribed to the vertex itself, keep our copy and let the
+             * update that follows decide whether we still need it.
+             */
+            if (!hvr_sparse_arr_contains(VERTEX_ID_PE(msg->vert.id),
+                        VERTEX_ID_OFFSET(msg->vert.id), &ctx->my_vert_subs)) {
+                handle_deleted_vertex(&(msg->vert), 0, 0, ctx);
             }
-            count_msgs++;
+        } else if (msg->is_invalidation) {
+            // Our subscription, if any, went with the vertex
+            drop_vertex_subscription(msg->vert.id, 0, ctx);
+            handle_deleted_vertex(&(msg->vert), 0,
+                    msg->is_invalidation == HVR_MIGRATION_INVALIDATION, ctx);
+        } else {
+            handle_new_vertex(&(msg->vert), perf_info, ctx);
         }
+    } else {
+        hvr_edge_create_msg_t *msg = &wrapper_msg->payload.edge_update;
 
-        count_update_msgs++;
-        if (count_update_msgs >= max_to_process) break;
+        /*
+         * There are two ways in which an edge create notification is
+         * sent to a PE:
+         *   1. Another PE has explicitly created an edge with a
+         *      locally-owned vertex, in which case target is the ID of
+         *      the locally-owned vertex and src is the content of the
+         *      remote vertex that just created an edge with us.
+         *   2. This PE is subscribed to a remote vertex (because an
+         *      edge was created with it) and a new explicit edge is
+         *      created on that vertex. This new explicit edge may be
+         *      between the subscribed-to vertex and any other vertex
+         *      in the simulation. There are no rules on which of these
+         *      is src/target, and both may be remote (though at least
+         *      one must be cached locally as we are subscribed to it).
+         *
+         * In each of these cases at least one of the vertices is
+         * guaranteed to be stored in the local vertex pool (in one
+         * case because it is locally-owned, in the other case because
+         * it is locally subscribed). In both cases, there are no
+         * guarantees that the other vertex is locally known or not. It
+         * may even be locally-owned. The exception is case #2 after the
+         * local vertex whose explicit edge we subscribed for has migrated
+         * away, taking that edge and possibly our cached copy with it.
+         */
+        hvr_vertex_cache_node_t *cached_target =
+            hvr_vertex_cache_lookup(msg->target, &ctx->vec_cache);
+        hvr_vertex_cache_node_t *cached_src = hvr_vertex_cache_lookup(
+                msg->src.id, &ctx->vec_cache);
+        if (!cached_target && forward_edge_if_migrated(msg, ctx)) {
+            return;
+        }
+        assert(cached_target || cached_src || msg->is_forward == 1);
 
-        success = hvr_mailbox_recv(msg_buf_node->ptr, msg_buf_node->buf_size,
-                &msg_len, &ctx->vertex_update_mailbox);
-    }
+        /*
+         * If this is case #1 described above, we need to force this
+         * edge being created and force a subscription to both vertices
+         * if it doesn't already exist. If this is someone just
+         * notifying us of a new edge create on a vertex we are
+         * subscribed to (case #2) then we don't want to perform any new
+         * subscriptions as a result and only want to proceed if we
+         * already have both vertices locally present.
+         */
+        if (!msg->is_forward || msg->is_forward == HVR_EDGE_REDIRECTED) {
+            // Force subscriptions
+            if (VERTEX_ID_PE(msg->target) != ctx->pe) {
+                hvr_vertex_t *body =
+                    (cached_target && cached_target->populated) ?
+                    &cached_target->vert : NULL;
+                cached_target = set_up_vertex_subscription(msg->target,
+                        body, ctx);
+            }
 
-    hvr_msg_buf_pool_release(msg_buf_node, &ctx->msg_buf_pool);
+            if (VERTEX_ID_PE(msg->src.id) != ctx->pe) {
+                cached_src = set_up_vertex_subscription(msg->src.id,
+                        &msg->src, ctx);
+            }
+        }
 
-    const unsigned long long done = hvr_current_time_us();
+        if (cached_target && cached_src) {
+            /*
+             * Insert the explicitly created edge in our local edge info,
+             * only if we're in case #1 and we forced these two vertices
+             * into our cache or we just happened to already have them.
+             */
+            update_edge_info(cached_src, cached_target, msg->edge,
+                    EXPLICIT_EDGE, msg->payload, NULL, NULL, 1, ctx);
 
-    if (perf_info) {
-        perf_info->time_handling_deletes += midpoint - start;
-        perf_info->time_handling_news += done - midpoint;
+            /*
+             * The creator of a redirected edge only has it with target's old
+             * ID, which it is told to drop by target's previous owner.
+             */
+            if (msg->is_forward == HVR_EDGE_REDIRECTED &&
+                    VERTEX_ID_PE(msg->src.id) != ctx->pe) {
+                hvr_update_msg_t back;
+                hvr_edge_update_init(&back, &cached_target->vert,
+                        msg->src.id, flip_edge_direction(msg->edge),
+                        msg->payload, 0);
+                send_to_vertex_update_mailbox(&back, VERTEX_ID_PE(msg->src.id),
+                        ctx);
+            }
+        }
     }
-    ctx->n_msgs_recvd_this_iter += count_msgs;
-    ctx->n_msgs_recvd_total += count_msgs;
+}
 
-    return count_update_msgs;
+/*
+ * Retry edge creates held by forward_edge_if_migrated. Any held again are
+ * appended after the ones being retried.
+ */
+static void retry_held_edge_creates(hvr_internal_ctx_t *ctx) {
+    const unsigned n_retries = ctx->n_edge_forward_retries;
+    for (unsigned i = 0; i < n_retries; i++) {
+        hvr_update_msg_t msg;
+        msg.is_vert_update = 0;
+        msg.is_snapshot = 0;
+        memcpy(&msg.payload.edge_update, ctx->edge_forward_retries + i,
+                sizeof(msg.payload.edge_update));
+        apply_vertex_update(&msg, NULL, ctx);
+    }
+
+    ctx->n_edge_forward_retries -= n_retries;
+    memmove(ctx->edge_forward_retries, ctx->edge_forward_retries + n_retries,
+            ctx->n_edge_forward_retries * sizeof(ctx->edge_forward_retries[0]));
+}
+
+static int compare_staged_updates(const void *_a, const void *_b) {
+    const hvr_staged_update_t *a = (const hvr_staged_update_t *)_a;
+    const hvr_staged_update_t *b = (const hvr_staged_update_t *)_b;
+    if (a->src_pe != b->src_pe) {
+        return (a->src_pe < b->src_pe) ? -1 : 1;
+    }
+    return (a->index < b->index) ? -1 : (a->index > b->index);
 }
 
-static inline void update_partition_distance(hvr_vertex_cache_node_t *node,
-        uint8_t dist, uint8_t *partition_min_dist_from_local_vert) {
-    const hvr_partition_t curr_part = node->vert.curr_part;
-    if (curr_part != HVR_INVALID_PARTITION &&
-            partition_min_dist_from_local_vert[curr_part] > dist) {
-        partition_min_dist_from_local_vert[curr_part] = dist;
+/*
+ * Apply the updates staged from base onwards in deterministic mode. Each
+ * sender's batches arrive in the order they were sent, so sorting by sending
+ * PE and then by staging position applies them in (PE, sequence) order.
+ */
+static void apply_staged_updates(unsigned base, process_perf_info_t *perf_info,
+        hvr_internal_ctx_t *ctx) {
+    const unsigned n_staged = ctx->n_staged_updates - base;
+    hvr_staged_update_t *order = ctx->staged_order + base;
+    for (unsigned i = 0; i < n_staged; i++) {
+        order[i].src_pe = ctx->staged_updates[base + i].src_pe;
+        order[i].index = base + i;
+    }
+    qsort(order, n_staged, sizeof(order[0]), compare_staged_updates);
+
+    for (unsigned i = 0; i < n_staged; i++) {
+        apply_vertex_update(ctx->staged_updates + order[i].index, perf_info,
+                ctx);
     }
+    ctx->n_staged_updates = base;
 }
 
-static void update_distances(hvr_internal_ctx_t *ctx) {
+static unsigned process_vertex_updates(hvr_internal_ctx_t *ctx,
+        process_perf_info_t *perf_info, int max_to_process) {
+    unsigned count_update_msgs = 0;
+    unsigned count_msgs = 0;
+    size_t msg_len;
+
+    const unsigned long long start = hvr_current_time_us();
+    // Handle deletes, then updates
+    hvr_msg_buf_node_t *msg_buf_node = hvr_msg_buf_pool_acquire(
+            &ctx->msg_buf_pool);
+
     /*
-     * Clear all distances of mirrored vertices to an invalid value before
-     * recomputing
+     * In deterministic mode, stage updates to sort them before applying them,
+     * as long as there is room for at least one more batch. A nested call
+     * that finds no room left applies its updates as they arrive.
      */
-    const unsigned max_graph_traverse_depth = ctx->max_graph_traverse_depth;
-    hvr_vertex_cache_node_t *q = ctx->vec_cache.local_neighbors_head;
+    const unsigned staged_base = ctx->n_staged_updates;
+    const unsigned max_batch =
+        ctx->vertex_update_mailbox_buffer.buffer_size_per_pe;
+    const int staging = ctx->deterministic &&
+        ctx->max_staged_updates - staged_base >= max_batch;
 
-    uint8_t *partition_min_dist_from_local_vert =
-        ctx->partition_min_dist_from_local_vert;
-    memset(partition_min_dist_from_local_vert, 0xff,
-            sizeof(*partition_min_dist_from_local_vert) * ctx->n_partitions);
+    const unsigned long long midpoint = hvr_current_time_us();
+    int success = recv_vertex_updates(msg_buf_node, &msg_len, ctx);
+    while (success) {
+        assert(msg_len % sizeof(hvr_update_msg_t) == 0);
+        hvr_update_msg_t *msgs = (hvr_update_msg_t *)msg_buf_node->ptr;
+        const unsigned nmsgs = msg_len / sizeof(*msgs);
 
-    for (hvr_partition_t p = 0; p < ctx->n_partitions; p++) {
-        hvr_vertex_t *iter = hvr_partition_list_head(p,
-                &ctx->local_partition_lists);
-        if (iter) {
-            partition_min_dist_from_local_vert[p] = 0;
+        if (staging) {
+            memcpy(ctx->staged_updates + ctx->n_staged_updates, msgs, msg_len);
+            ctx->n_staged_updates += nmsgs;
         } else {
-            uint8_t min_dist = UINT8_MAX;
-            iter = hvr_partition_list_head(p, &ctx->mirror_partition_lists);
-            while (iter) {
-                const uint8_t distance =
-                    ((hvr_vertex_cache_node_t *)iter)->dist_from_local_vert;
-                if (distance < min_dist) {
-                    min_dist = distance;
-                }
-                iter = iter->next_in_partition;
+            for (unsigned i = 0; i < nmsgs; i++) {
+                apply_vertex_update(msgs + i, perf_info, ctx);
             }
-            partition_min_dist_from_local_vert[p] = min_dist;
         }
+        count_msgs += nmsgs;
+
+        count_update_msgs++;
+        if (count_update_msgs >= max_to_process) break;
+        if (staging && ctx->max_staged_updates - ctx->n_staged_updates <
+                max_batch) break;
+
+        success = recv_vertex_updates(msg_buf_node, &msg_len, ctx);
     }
-}
 
-static uint64_t hvr_neighbors_min_helper_0(struct hvr_avl_node *curr,
-        uint64_t init_val, const hvr_internal_ctx_t *ctx) {
-    if (curr == nnil) {
-        return init_val;
+    hvr_msg_buf_pool_release(msg_buf_node, &ctx->msg_buf_pool);
+
+    if (staging) {
+        apply_staged_updates(staged_base, perf_info, ctx);
     }
 
-    uint64_t lval = hvr_neighbors_min_helper_0(curr->kid[0], init_val, ctx);
-    uint64_t rval = hvr_neighbors_min_helper_0(curr->kid[1], init_val, ctx);
-    uint64_t min_child_val = (lval < rval ? lval : rval);
+    const unsigned long long done = hvr_current_time_us();
 
-    hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
-            EDGE_INFO_VERTEX(curr->value), &ctx->vec_cache);
-    uint64_t my_val = (cached_neighbor->populated ?
-            hvr_vertex_get_uint64(0, &cached_neighbor->vert, (hvr_ctx_t)ctx) :
-            init_val);
-    return (min_child_val < my_val ? min_child_val : my_val);
+    if (perf_info) {
+        perf_info->time_handling_deletes += midpoint - start;
+        perf_info->time_handling_news += done - midpoint;
+    }
+    ctx->n_msgs_recvd_this_iter += count_msgs;
+    ctx->n_msgs_recvd_total += count_msgs;
+
+    return count_update_msgs;
 }
 
-static uint64_t hvr_neighbors_min_helper(struct hvr_avl_node *curr,
+static uint64_t hvr_neighbors_min_helper(hvr_ordered_set_node_t *root,
         unsigned feat, uint64_t init_val, const hvr_internal_ctx_t *ctx) {
-    if (curr == nnil) {
-        return init_val;
-    }
+    uint64_t min_val = init_val;
 
-    uint64_t lval = hvr_neighbors_min_helper(curr->kid[0], feat, init_val, ctx);
-    uint64_t rval = hvr_neighbors_min_helper(curr->kid[1], feat, init_val, ctx);
-    uint64_t min_child_val = (lval < rval ? lval : rval);
-
-    hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
-            EDGE_INFO_VERTEX(curr->value), &ctx->vec_cache);
-    uint64_t my_val = (cached_neighbor->populated ?
-            hvr_vertex_get_uint64(feat, &cached_neighbor->vert,
-                (hvr_ctx_t)ctx) :
-            init_val);
-    return (min_child_val < my_val ? min_child_val : my_val);
+    hvr_ordered_set_iter_t iter;
+    hvr_ordered_set_iter_init(&iter, root);
+    // Rows are keyed by neighbor offset, their values hold the edge payload
+    uint32_t neighbor;
+    while (hvr_ordered_set_iter_next(&iter, &neighbor, NULL)) {
+        hvr_vertex_cache_node_t *cached_neighbor = CACHE_NODE_BY_OFFSET(
+                neighbor, &ctx->vec_cache);
+        if (cached_neighbor->populated) {
+            uint64_t val = hvr_vertex_get_uint64(feat, &cached_neighbor->vert,
+                    (hvr_ctx_t)ctx);
+            if (val < min_val) {
+                min_val = val;
+            }
+        }
+    }
+    return min_val;
 }
 
 uint64_t hvr_neighbors_min(hvr_vertex_t *vert, unsigned feature,
         uint64_t init_val, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    hvr_lock_vertex_cache(0, ctx);
+    uint64_t min_val = init_val;
     hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(vert->id,
             &ctx->vec_cache);
-    if (!cached) {
-        return init_val;
-    }
-    struct hvr_avl_node *root = hvr_irr_matrix_tree(
-            CACHE_NODE_OFFSET(cached, &ctx->vec_cache), &ctx->edges);
-    if (feature == 0) {
-        return hvr_neighbors_min_helper_0(root, init_val, ctx);
-    } else {
-        return hvr_neighbors_min_helper(root, feature, init_val, ctx);
+    if (cached) {
+        hvr_ordered_set_node_t *root = hvr_irr_matrix_tree(
+                CACHE_NODE_OFFSET(cached, &ctx->vec_cache), &ctx->edges);
+        min_val = hvr_neighbors_min_helper(root, feature, init_val, ctx);
     }
+    hvr_unlock_vertex_cache(ctx);
+    return min_val;
 }
 
 void hvr_get_neighbors(hvr_vertex_t *vert, hvr_neighbors_t *neighbors,
         hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    hvr_vertex_id_t *edge_buffer = ctx->edge_buffer;
+    hvr_edge_payload_t *edge_payload_buffer = ctx->edge_payload_buffer;
+    mspace tracker = ctx->neighbors_list_tracker;
+#ifdef MULTITHREADED
+    if (ctx->in_parallel_update) {
+        hvr_thread_state_t *thread = ctx->threads + omp_get_thread_num();
+        edge_buffer = thread->edge_buffer;
+        edge_payload_buffer = thread->edge_payload_buffer;
+        tracker = thread->neighbors_list_tracker;
+    }
+#endif
+
+    hvr_lock_vertex_cache(0, ctx);
     hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(vert->id,
             &ctx->vec_cache);
     if (!cached) {
@@ -2119,19 +3791,21 @@ void hvr_get_neighbors(hvr_vertex_t *vert, hvr_neighbors_t *neighbors,
          * cached may be NULL due to throttling of producer checking, we may
          * have a local vertex that we don't know we are a producer for yet.
          */
-        hvr_neighbors_init(NULL, 0, &ctx->vec_cache,
-                ctx->neighbors_list_tracker, ctx->neighbors_list_pool_size,
-                neighbors);
+        hvr_neighbors_init(NULL, NULL, 0, &ctx->vec_cache, tracker,
+                ctx->neighbors_list_pool_size, neighbors);
+        hvr_unlock_vertex_cache(ctx);
         return;
     }
 
     // Lookup edge information in ctx->edges
-    unsigned n_neighbors = hvr_irr_matrix_linearize(
+    unsigned n_neighbors = hvr_irr_matrix_linearize_with_payloads(
             CACHE_NODE_OFFSET(cached, &ctx->vec_cache),
-            ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges);
-    hvr_neighbors_init(ctx->edge_buffer, n_neighbors,
-            &ctx->vec_cache, ctx->neighbors_list_tracker,
-            ctx->neighbors_list_pool_size, neighbors);
+            edge_buffer, edge_payload_buffer, MAX_MODIFICATIONS,
+            &ctx->edges);
+    hvr_neighbors_init(edge_buffer, edge_payload_buffer, n_neighbors,
+            &ctx->vec_cache, tracker, ctx->neighbors_list_pool_size,
+            neighbors);
+    hvr_unlock_vertex_cache(ctx);
 }
 
 void hvr_reset_neighbors(hvr_neighbors_t *n, hvr_ctx_t in_ctx) {
@@ -2140,9 +3814,33 @@ void hvr_reset_neighbors(hvr_neighbors_t *n, hvr_ctx_t in_ctx) {
 
 void hvr_release_neighbors(hvr_neighbors_t *n, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+#ifdef MULTITHREADED
+    if (ctx->in_parallel_update) {
+        hvr_neighbors_destroy(n,
+                ctx->threads[omp_get_thread_num()].neighbors_list_tracker);
+        return;
+    }
+#endif
     hvr_neighbors_destroy(n, ctx->neighbors_list_tracker);
 }
 
+static void send_vertex_subscription_change(hvr_vertex_id_t vid, int entered,
+        hvr_internal_ctx_t *ctx) {
+    hvr_vertex_subscription_t msg;
+    msg.pe = ctx->pe;
+    msg.vert = vid;
+    msg.entered = entered;
+
+    int success;
+    do {
+        success = hvr_mailbox_buffer_send(&msg, sizeof(msg), VERTEX_ID_PE(vid),
+                100, &ctx->vert_sub_mailbox_buffer);
+        if (!success) {
+            process_vertex_subscriptions(ctx, 100);
+        }
+    } while (!success);
+}
+
 static hvr_vertex_cache_node_t *set_up_vertex_subscription(hvr_vertex_id_t vid,
         hvr_vertex_t *optional_body, hvr_internal_ctx_t *ctx) {
     /*
@@ -2185,19 +3883,7 @@ static hvr_vertex_cache_node_t *set_up_vertex_subscription(hvr_vertex_id_t vid,
             }
         } else {
             // Notify owning PE that we are subscribed to this vertex
-            hvr_vertex_subscription_t msg;
-            msg.pe = ctx->pe;
-            msg.vert = vid;
-            msg.entered = 1;
-
-            int success;
-            do {
-                success = hvr_mailbox_buffer_send(&msg, sizeof(msg), owning_pe,
-                        100, &ctx->vert_sub_mailbox_buffer);
-                if (!success) {
-                    process_vertex_subscriptions(ctx, 100);
-                }
-            } while (!success);
+            send_vertex_subscription_change(vid, 1, ctx);
         }
     }
 
@@ -2206,6 +3892,26 @@ static hvr_vertex_cache_node_t *set_up_vertex_subscription(hvr_vertex_id_t vid,
     return cached;
 }
 
+/*
+ * Forget our subscription to the remote vertex vid once we stop caching it,
+ * telling its owner if the vertex still exists there.
+ */
+static void drop_vertex_subscription(hvr_vertex_id_t vid, int notify_owner,
+        hvr_internal_ctx_t *ctx) {
+    const int owning_pe = VERTEX_ID_PE(vid);
+    if (!hvr_sparse_arr_contains(owning_pe, VERTEX_ID_OFFSET(vid),
+                &ctx->my_vert_subs)) {
+        return;
+    }
+    hvr_sparse_arr_remove(owning_pe, VERTEX_ID_OFFSET(vid),
+            &ctx->my_vert_subs);
+
+    if (notify_owner && !hvr_set_contains(owning_pe,
+                ctx->all_terminated_pes)) {
+        send_vertex_subscription_change(vid, 0, ctx);
+    }
+}
+
 static uint64_t handle_dead_msg(hvr_dead_pe_msg_t *msg,
         hvr_internal_ctx_t *ctx) {
     uint64_t pulled_vertices = 0;
@@ -2217,49 +3923,41 @@ static uint64_t handle_dead_msg(hvr_dead_pe_msg_t *msg,
      * if so go grab their final state if we're doing dead PE processing.
      */
     if (dead_pe_processing) {
-        uint64_t *subscriptions = NULL;
-        unsigned n_subscriptions = hvr_sparse_arr_linearize_row(msg->pe,
-                &subscriptions, &ctx->my_vert_subs);
-        for (unsigned i = 0; i < n_subscriptions; i++) {
-            hvr_vertex_id_t id = construct_vertex_id(msg->pe,
-                    subscriptions[i]);
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, msg->pe, &ctx->my_vert_subs);
+        unsigned subscription;
+        while (hvr_sparse_arr_row_iter_next(&iter, &subscription)) {
+            hvr_vertex_id_t id = construct_vertex_id(msg->pe, subscription);
             hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
                     id, &ctx->vec_cache);
             assert(cached);
 
             shmem_getmem(&cached->vert,
-                    ctx->vec_cache.pool_mem + subscriptions[i],
+                    ctx->vec_cache.pool_mem + subscription,
                     sizeof(cached->vert), msg->pe);
             cached->populated = 1;
             pulled_vertices++;
         }
-
-        hvr_sparse_arr_release_row(subscriptions, &ctx->my_vert_subs);
     }
 
 
     /*
      * Clear this PE from any partition or vertex subscriptions
      * locally so that we don't flood their mailboxes with messages
-     * they'll never process.
+     * they'll never process. Both sparse arrays maintain a reverse index, so
+     * this only touches the rows msg->pe was actually subscribed to.
      */
-    for (hvr_partition_t p = 0; p < ctx->n_partitions; p++) {
-        if (hvr_sparse_arr_contains(p, msg->pe,
-                    &ctx->remote_partition_subs)) {
-            hvr_sparse_arr_remove(p, msg->pe,
-                    &ctx->remote_partition_subs);
-        }
-    }
+    hvr_sparse_arr_remove_value(msg->pe, &ctx->remote_partition_subs);
+    hvr_sparse_arr_remove_value(msg->pe, &ctx->remote_vert_subs);
 
-#if 0
     /*
-     * For now, this is commented out because we don't send updates to
-     * terminated PEs anyway. Technically, msg->pe should be deleted from all
-     * vertex subscriptions but it shouldn't impact semantics. Doing this
-     * operation adds a lot of overhead.
+     * Producers terminating are not pushed to us as producer changes, so look
+     * for the partitions msg->pe produced on the next update_partition_window.
      */
-    hvr_sparse_arr_remove_value(msg->pe, &ctx->remote_vert_subs);
-#endif
+    if (ctx->push_producer_changes && dead_pe_processing) {
+        ctx->poll_subscriptions_for_dead_pes = 1;
+    }
+
     return pulled_vertices;
 }
 
@@ -2287,11 +3985,12 @@ static uint64_t poll_for_dead_pes(hvr_internal_ctx_t *ctx) {
 
 // edge is relative to remote
 static void signal_edge_creation(hvr_vertex_id_t remote, hvr_vertex_t *base,
-        hvr_edge_type_t edge, hvr_internal_ctx_t *ctx) {
+        hvr_edge_type_t edge, hvr_edge_payload_t payload,
+        hvr_internal_ctx_t *ctx) {
     assert(VERTEX_ID_PE(remote) != ctx->pe);
 
     hvr_update_msg_t msg;
-    hvr_edge_update_init(&msg, base, remote, edge, 0);
+    hvr_edge_update_init(&msg, base, remote, edge, payload, 0);
     send_to_vertex_update_mailbox(&msg, VERTEX_ID_PE(remote), ctx);
 }
 
@@ -2303,7 +4002,7 @@ static void signal_edge_creation(hvr_vertex_id_t remote, hvr_vertex_t *base,
  */
 static void hvr_create_edge_helper(hvr_vertex_t *local,
         hvr_vertex_id_t neighbor, hvr_vertex_t *optional_neighbor_body,
-        hvr_edge_type_t edge, hvr_ctx_t in_ctx
+        hvr_edge_type_t edge, hvr_edge_payload_t payload, hvr_ctx_t in_ctx
 #ifdef DETAILED_PRINTS
         , unsigned long long *time_vertex_sub,
         unsigned long long *time_updating_edge_info,
@@ -2336,14 +4035,15 @@ static void hvr_create_edge_helper(hvr_vertex_t *local,
     const unsigned long long time_b = hvr_current_time_us();
 #endif
     // Create explicit edge
-    update_edge_info(cached_local, cached_neighbor, edge, EXPLICIT_EDGE, NULL,
-            NULL, 0, ctx);
+    update_edge_info(cached_local, cached_neighbor, edge, EXPLICIT_EDGE,
+            payload, NULL, NULL, 0, ctx);
 
 #ifdef DETAILED_PRINTS
     const unsigned long long time_c = hvr_current_time_us();
 #endif
     if (VERTEX_ID_PE(neighbor) != ctx->pe) {
-        signal_edge_creation(neighbor, local, flip_edge_direction(edge), ctx);
+        signal_edge_creation(neighbor, local, flip_edge_direction(edge),
+                payload, ctx);
     }
 #ifdef DETAILED_PRINTS
     const unsigned long long time_d = hvr_current_time_us();
@@ -2358,22 +4058,113 @@ void hvr_create_edge_with_vertex_id(hvr_vertex_t *local,
         hvr_vertex_id_t neighbor, hvr_edge_type_t edge, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
     assert(ctx->user_mutation_allowed);
-    hvr_buffered_changes_edge_create(local->id, neighbor, edge,
-            &ctx->buffered_changes);
+    hvr_buffered_changes_edge_create(local->id, neighbor, edge, 0,
+            hvr_current_buffered_changes(ctx));
 }
 
 void hvr_create_edge_with_vertex(hvr_vertex_t *local,
         hvr_vertex_t *neighbor, hvr_edge_type_t edge, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
     assert(ctx->user_mutation_allowed);
-    hvr_buffered_changes_edge_create(local->id, neighbor->id, edge,
-            &ctx->buffered_changes);
+    hvr_buffered_changes_edge_create(local->id, neighbor->id, edge, 0,
+            hvr_current_buffered_changes(ctx));
+}
+
+void hvr_create_edge_with_payload(hvr_vertex_t *local,
+        hvr_vertex_id_t neighbor, hvr_edge_type_t edge,
+        hvr_edge_payload_t payload, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(ctx->user_mutation_allowed);
+    hvr_buffered_changes_edge_create(local->id, neighbor, edge, payload,
+            hvr_current_buffered_changes(ctx));
+}
+
+void hvr_set_edge_payload_func(hvr_edge_payload_func edge_payload,
+        hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    ctx->edge_payload = edge_payload;
+}
+
+void hvr_set_should_have_edge_batch(
+        hvr_should_have_edge_batch should_have_edge_batch, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    ctx->should_have_edge_batch = should_have_edge_batch;
+}
+
+void hvr_set_edge_search_key(hvr_edge_search_key_func search_key,
+        unsigned ndims, double radius, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(ndims > 0 && ndims <= HVR_MAX_SEARCH_KEY_DIMS);
+    assert(radius > 0.0);
+    assert(ctx->search_key == NULL);
+
+    ctx->search_key = search_key;
+    ctx->search_key_dims = ndims;
+    ctx->search_radius = radius;
+    ctx->search_partitions = hvr_create_empty_set(ctx->n_partitions);
+
+    hvr_partition_list_enable_grid(&ctx->local_partition_lists);
+    hvr_partition_list_enable_grid(&ctx->mirror_partition_lists);
+}
+
+void hvr_set_partition_refinement(unsigned n_children,
+        hvr_child_partition_func child_partition,
+        hvr_children_might_interact_func children_might_interact,
+        hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(ctx->child_partition == NULL);
+    if (ctx->search_key) {
+        // The search grid already bounds the vertices scanned
+        return;
+    }
+
+    ctx->child_partition = child_partition;
+    ctx->children_might_interact = children_might_interact;
+    ctx->partition_refine_interval = 16;
+    if (getenv("HVR_PARTITION_REFINE_INTERVAL")) {
+        ctx->partition_refine_interval = atoi(getenv(
+                    "HVR_PARTITION_REFINE_INTERVAL"));
+        assert(ctx->partition_refine_interval > 0);
+    }
+
+    hvr_partition_list_enable_children(n_children,
+            &ctx->local_partition_lists);
+    hvr_partition_list_enable_children(n_children,
+            &ctx->mirror_partition_lists);
+}
+
+void hvr_declare_might_interact_pure(hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    if (ctx->might_interact_is_pure) return;
+
+    size_t capacity = 8 * 1024 * 1024;
+    if (getenv("HVR_INTERACTING_CACHE_SIZE")) {
+        capacity = atoi(getenv("HVR_INTERACTING_CACHE_SIZE"));
+    }
+    assert(capacity < UINT32_MAX);
+
+    ctx->interacting_cache_start = (uint32_t *)malloc_helper(
+            ctx->n_partitions * sizeof(ctx->interacting_cache_start[0]));
+    ctx->interacting_cache_len = (uint32_t *)malloc_helper(
+            ctx->n_partitions * sizeof(ctx->interacting_cache_len[0]));
+    ctx->interacting_cache = (hvr_partition_t *)malloc_helper(
+            capacity * sizeof(ctx->interacting_cache[0]));
+    assert(ctx->interacting_cache_start && ctx->interacting_cache_len &&
+            ctx->interacting_cache);
+    memset(ctx->interacting_cache_start, 0xff,
+            ctx->n_partitions * sizeof(ctx->interacting_cache_start[0]));
+    ctx->interacting_cache_used = 0;
+    ctx->interacting_cache_capacity = capacity;
+
+    ctx->might_interact_is_pure = 1;
 }
 
 hvr_vertex_t *hvr_get_vertex(hvr_vertex_id_t id, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    hvr_lock_vertex_cache(0, ctx);
     hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(id,
             &ctx->vec_cache);
+    hvr_unlock_vertex_cache(ctx);
     if (cached) {
         return &cached->vert;
     } else {
@@ -2400,102 +4191,740 @@ static void process_buffered_changes(hvr_internal_ctx_t *ctx
             hvr_vertex_cache_node_t *cached_neighbor = hvr_vertex_cache_lookup(
                     chng.change.edge.neighbor_id, &ctx->vec_cache);
 
-            hvr_create_edge_helper(&cached_base->vert,
-                    chng.change.edge.neighbor_id,
-                    cached_neighbor ? &cached_neighbor->vert : NULL,
-                    chng.change.edge.edge, ctx
-#ifdef DETAILED_PRINTS
-                    , time_vertex_sub, time_updating_edge_info, time_signaling
-#endif
-                    );
+            hvr_create_edge_helper(&cached_base->vert,
+                    chng.change.edge.neighbor_id,
+                    cached_neighbor ? &cached_neighbor->vert : NULL,
+                    chng.change.edge.edge, chng.change.edge.payload, ctx
+#ifdef DETAILED_PRINTS
+                    , time_vertex_sub, time_updating_edge_info, time_signaling
+#endif
+                    );
+        } else {
+            // Vertex delete
+            hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
+                    chng.change.del.to_delete, &ctx->vec_cache);
+            hvr_vertex_delete_impl(&cached->vert, 0, ctx);
+        }
+    }
+}
+
+/*
+ * Bring partition membership and edges up to date after update_metadata has
+ * been called on curr, a local vertex that was in old_part beforehand.
+ */
+static void finish_vertex_update(hvr_vertex_t *curr, hvr_partition_t old_part,
+        hvr_internal_ctx_t *ctx) {
+    hvr_partition_t new_partition = wrap_actor_to_partition(curr, ctx);
+    curr->curr_part = new_partition;
+    curr->prev_part = old_part;
+
+    if (new_partition == HVR_INVALID_PARTITION) {
+        assert(old_part == HVR_INVALID_PARTITION);
+    } else {
+        update_partition_list_membership(curr, old_part, new_partition,
+                &ctx->local_partition_lists, ctx);
+        if (curr->needs_send) {
+            // Something changed
+            unsigned n_interacting = 0;
+            const hvr_partition_t *interacting =
+                get_interacting_partitions(new_partition,
+                        &n_interacting, ctx);
+            update_existing_edges((hvr_vertex_cache_node_t *)curr,
+                    interacting, n_interacting, ctx);
+        }
+    }
+
+    if (curr->needs_send) {
+        /*
+         * Mark all downstream neighbors because attributes of this
+         * local vertex changed.
+         */
+        mark_all_downstream_neighbors_for_processing(
+                (hvr_vertex_cache_node_t *)curr, ctx);
+    }
+}
+
+/*
+ * Fill ctx->frontier with the local vertices that need processing this
+ * iteration, clearing their needs_processing flags, and return how many there
+ * are. If a vertex priority is registered, vertices are bucketed by priority
+ * and placed in decreasing order of priority (in iteration order within a
+ * bucket), and only the first max_updates_per_iter are taken.
+ */
+static unsigned gather_frontier(hvr_internal_ctx_t *ctx) {
+    hvr_frontier_entry_t *gathered = (ctx->vertex_priority ?
+            ctx->priority_scratch : ctx->frontier);
+    if (ctx->vertex_priority) {
+        memset(ctx->priority_bucket_counts, 0x00,
+                ctx->n_priority_buckets *
+                sizeof(ctx->priority_bucket_counts[0]));
+    }
+
+    unsigned count = 0;
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    for (hvr_vertex_t *curr = hvr_vertex_iter_next(&iter); curr;
+            curr = hvr_vertex_iter_next(&iter)) {
+        if (curr->needs_processing) {
+            hvr_frontier_entry_t *entry = gathered + count++;
+            entry->vert = curr;
+            entry->id = curr->id;
+            if (ctx->vertex_priority) {
+                unsigned priority = ctx->vertex_priority(curr, ctx);
+                if (priority >= ctx->n_priority_buckets) {
+                    priority = ctx->n_priority_buckets - 1;
+                }
+                entry->priority = priority;
+                ctx->priority_bucket_counts[priority]++;
+            }
+        }
+    }
+
+    if (ctx->vertex_priority) {
+        // Turn the counts into the offset in frontier of each bucket
+        unsigned offset = 0;
+        for (int b = ctx->n_priority_buckets - 1; b >= 0; b--) {
+            const unsigned bucket_count = ctx->priority_bucket_counts[b];
+            ctx->priority_bucket_counts[b] = offset;
+            offset += bucket_count;
+        }
+
+        for (unsigned i = 0; i < count; i++) {
+            hvr_frontier_entry_t *entry = ctx->priority_scratch + i;
+            memcpy(ctx->frontier +
+                    ctx->priority_bucket_counts[entry->priority]++, entry,
+                    sizeof(*entry));
+        }
+
+        if (ctx->max_updates_per_iter > 0 &&
+                count > ctx->max_updates_per_iter) {
+            // The rest remain marked for processing
+            count = ctx->max_updates_per_iter;
+            ctx->any_needs_processing = 1;
+        }
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        hvr_frontier_entry_t *entry = ctx->frontier + i;
+        entry->vert->needs_processing = 0;
+        entry->old_part = wrap_actor_to_partition(entry->vert, ctx);
+    }
+    return count;
+}
+
+#ifdef MULTITHREADED
+/*
+ * Calls update_metadata on every local vertex that needs processing from
+ * ctx->nthreads OpenMP threads. Edge creates, deletes, messages, and coupling
+ * requests made by each thread are buffered per-thread and applied in thread
+ * order once all threads finish, after which the remaining per-vertex work is
+ * done serially. Unlike the serial path, changes made by update_metadata on
+ * one vertex are not visible in the graph while the others are being updated.
+ */
+static int update_vertices_parallel(hvr_set_t *to_couple_with,
+        hvr_internal_ctx_t *ctx) {
+    unsigned long long update_vertex_vertex_sub_time = 0;
+    unsigned long long update_vertex_updating_edge_info_time = 0;
+    unsigned long long update_vertex_signaling_time = 0;
+
+    const int count = gather_frontier(ctx);
+
+    ctx->in_parallel_update = 1;
+    if (ctx->vertex_priority) {
+        /*
+         * Hand out vertices in priority order to whichever thread is free,
+         * so that the highest priority vertices are updated first.
+         */
+#pragma omp parallel for schedule(dynamic, 16) num_threads(ctx->nthreads)
+        for (int i = 0; i < count; i++) {
+            hvr_thread_state_t *thread = ctx->threads + omp_get_thread_num();
+            ctx->update_metadata(ctx->frontier[i].vert,
+                    thread->to_couple_with, ctx);
+        }
+    } else {
+#pragma omp parallel for schedule(static) num_threads(ctx->nthreads)
+        for (int i = 0; i < count; i++) {
+            hvr_thread_state_t *thread = ctx->threads + omp_get_thread_num();
+            ctx->update_metadata(ctx->frontier[i].vert,
+                    thread->to_couple_with, ctx);
+        }
+    }
+    ctx->in_parallel_update = 0;
+
+    /*
+     * Changes are polled in LIFO order, so walk the threads backwards to have
+     * those of thread 0 applied first.
+     */
+    for (int t = ctx->nthreads - 1; t >= 0; t--) {
+        hvr_thread_state_t *thread = ctx->threads + t;
+        hvr_buffered_change_t chng;
+        while (hvr_buffered_changes_poll(&thread->buffered_changes, &chng)) {
+            if (chng.is_edge_create) {
+                hvr_buffered_changes_edge_create(chng.change.edge.base_id,
+                        chng.change.edge.neighbor_id, chng.change.edge.edge,
+                        chng.change.edge.payload, &ctx->buffered_changes);
+            } else {
+                hvr_buffered_changes_delete_vertex(chng.change.del.to_delete,
+                        &ctx->buffered_changes);
+            }
+        }
+    }
+
+    for (int t = 0; t < ctx->nthreads; t++) {
+        hvr_thread_state_t *thread = ctx->threads + t;
+        hvr_set_merge(to_couple_with, thread->to_couple_with);
+        hvr_set_wipe(thread->to_couple_with);
+
+        for (unsigned m = 0; m < thread->n_msgs; m++) {
+            hvr_send_msg(thread->msgs[m].dst, &thread->msgs[m].payload, ctx);
+        }
+        thread->n_msgs = 0;
+    }
+
+    process_buffered_changes(ctx
+#ifdef DETAILED_PRINTS
+            , &update_vertex_vertex_sub_time,
+            &update_vertex_updating_edge_info_time,
+            &update_vertex_signaling_time
+#endif
+            );
+
+    for (int i = 0; i < count; i++) {
+        hvr_frontier_entry_t *entry = ctx->frontier + i;
+        // Skip vertices deleted by update_metadata
+        hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(entry->id,
+                &ctx->vec_cache);
+        if (cached && &cached->vert == entry->vert) {
+            finish_vertex_update(entry->vert, entry->old_part, ctx);
+            if (ctx->pipeline_chunk) {
+                pipeline_vertex_update(entry->vert, ctx);
+            }
+            // Resume vertices that called hvr_vertex_yield next iteration
+            if (entry->vert->needs_processing) {
+                ctx->any_needs_processing = 1;
+            }
+        }
+    }
+
+    return count;
+}
+#endif
+
+static void update_vertex(hvr_vertex_t *curr, hvr_set_t *to_couple_with,
+        hvr_internal_ctx_t *ctx) {
+    unsigned long long update_vertex_vertex_sub_time = 0;
+    unsigned long long update_vertex_updating_edge_info_time = 0;
+    unsigned long long update_vertex_signaling_time = 0;
+    const hvr_partition_t old_part = wrap_actor_to_partition(curr, ctx);
+
+    ctx->update_metadata(curr, to_couple_with, ctx);
+
+    process_buffered_changes(ctx
+#ifdef DETAILED_PRINTS
+            , &update_vertex_vertex_sub_time,
+            &update_vertex_updating_edge_info_time,
+            &update_vertex_signaling_time
+#endif
+            );
+
+    finish_vertex_update(curr, old_part, ctx);
+    if (ctx->pipeline_chunk) {
+        pipeline_vertex_update(curr, ctx);
+    }
+}
+
+/*
+ * Subscribe to the remote vertices that local vertices started waiting on in
+ * hvr_vertex_await_mirror, and mark waiting vertices for processing once the
+ * vertex they wait on is cached or known to no longer exist. A vertex that
+ * migrated is followed to its new ID.
+ */
+static void process_mirror_awaits(hvr_internal_ctx_t *ctx) {
+    unsigned i = 0;
+    while (i < ctx->n_mirror_awaits) {
+        hvr_mirror_await_t *await = ctx->mirror_awaits + i;
+        hvr_vertex_cache_node_t *waiter = hvr_vertex_cache_lookup(
+                await->waiter, &ctx->vec_cache);
+        if (!waiter) {
+            // The waiting vertex was deleted or migrated away
+            memcpy(await, ctx->mirror_awaits + --ctx->n_mirror_awaits,
+                    sizeof(*await));
+            continue;
+        }
+        i++;
+
+        if (await->woken) {
+            continue;
+        }
+
+        const int owning_pe = VERTEX_ID_PE(await->awaited);
+        if (!await->subscribed) {
+            set_up_vertex_subscription(await->awaited, NULL, ctx);
+            await->subscribed = 1;
+        }
+
+        hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
+                await->awaited, &ctx->vec_cache);
+        if (cached && cached->populated) {
+            await->woken = 1;
+            mark_for_processing(&waiter->vert, ctx);
+        } else if (!cached || !hvr_sparse_arr_contains(owning_pe,
+                    VERTEX_ID_OFFSET(await->awaited), &ctx->my_vert_subs)) {
+            // Its owner told us that it no longer has it
+            const hvr_vertex_id_t resolved = hvr_resolve_vertex_id(
+                    await->awaited, ctx);
+            if (resolved != await->awaited &&
+                    resolved != HVR_INVALID_VERTEX_ID) {
+                await->awaited = resolved;
+                await->subscribed = 0;
+            } else if (ctx->forwarding && shmem_uint64_atomic_fetch(
+                        ctx->forwarding + VERTEX_ID_OFFSET(await->awaited),
+                        owning_pe) == HVR_FORWARDING_PENDING) {
+                // Still in flight, try again once it has landed
+                await->subscribed = 0;
+            } else {
+                await->missing = 1;
+                await->woken = 1;
+                mark_for_processing(&waiter->vert, ctx);
+            }
+        }
+    }
+}
+
+static int update_vertices(hvr_set_t *to_couple_with,
+        hvr_internal_ctx_t *ctx) {
+    if (ctx->n_mirror_awaits > 0) {
+        process_mirror_awaits(ctx);
+    }
+
+    if (ctx->update_metadata == NULL || !ctx->any_needs_processing) {
+        return 0;
+    }
+
+    ctx->any_needs_processing = 0;
+    ctx->user_mutation_allowed = 1;
+
+#ifdef MULTITHREADED
+    if (ctx->nthreads > 1) {
+        const int count = update_vertices_parallel(to_couple_with, ctx);
+        ctx->user_mutation_allowed = 0;
+        flush_pipelined_updates(ctx);
+        return count;
+    }
+#endif
+
+    int count = 0;
+    if (ctx->vertex_priority) {
+        const unsigned n_frontier = gather_frontier(ctx);
+        for (unsigned i = 0; i < n_frontier; i++) {
+            hvr_frontier_entry_t *entry = ctx->frontier + i;
+            // Skip vertices deleted by update_metadata on an earlier vertex
+            hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
+                    entry->id, &ctx->vec_cache);
+            if (cached && &cached->vert == entry->vert) {
+                entry->vert->needs_processing = 0;
+                update_vertex(entry->vert, to_couple_with, ctx);
+                count++;
+            }
+        }
+    } else {
+        hvr_vertex_iter_t iter;
+        hvr_vertex_iter_init(&iter, ctx);
+        for (hvr_vertex_t *curr = hvr_vertex_iter_next(&iter); curr;
+                curr = hvr_vertex_iter_next(&iter)) {
+            if (curr->needs_processing) {
+                curr->needs_processing = 0;
+                update_vertex(curr, to_couple_with, ctx);
+                count++;
+            }
+        }
+    }
+    ctx->user_mutation_allowed = 0;
+    flush_pipelined_updates(ctx);
+
+    return count;
+}
+
+void hvr_set_migration_policy(hvr_migration_policy_func policy,
+        hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    ctx->migration_policy = policy;
+}
+
+void hvr_set_vertex_priority(hvr_vertex_priority_func priority,
+        unsigned max_updates_per_iter, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(priority);
+    assert(ctx->vertex_priority == NULL);
+    ctx->vertex_priority = priority;
+    ctx->max_updates_per_iter = max_updates_per_iter;
+
+    const size_t pool_size = ctx->vec_cache.pool_size;
+    if (ctx->frontier == NULL) {
+        ctx->frontier = (hvr_frontier_entry_t *)malloc_helper(
+                pool_size * sizeof(ctx->frontier[0]));
+        assert(ctx->frontier);
+    }
+    ctx->priority_scratch = (hvr_frontier_entry_t *)malloc_helper(
+            pool_size * sizeof(ctx->priority_scratch[0]));
+    assert(ctx->priority_scratch);
+    ctx->priority_bucket_counts = (unsigned *)malloc_helper(
+            ctx->n_priority_buckets * sizeof(ctx->priority_bucket_counts[0]));
+    assert(ctx->priority_bucket_counts);
+}
+
+// Returns the number of explicit edges of local copied into out_edges
+static unsigned collect_explicit_edges(hvr_vertex_cache_node_t *local,
+        hvr_migrated_edge_t *out_edges, hvr_internal_ctx_t *ctx) {
+    unsigned n_neighbors = hvr_irr_matrix_linearize_with_payloads(
+            CACHE_NODE_OFFSET(local, &ctx->vec_cache), ctx->edge_buffer,
+            ctx->edge_payload_buffer, MAX_MODIFICATIONS, &ctx->edges);
+
+    unsigned n_explicit = 0;
+    for (unsigned n = 0; n < n_neighbors; n++) {
+        if (EDGE_INFO_CREATION(ctx->edge_buffer[n]) != EXPLICIT_EDGE) {
+            continue;
+        }
+        if (out_edges && n_explicit < HVR_MAX_MIGRATED_EDGES) {
+            hvr_vertex_cache_node_t *neighbor = CACHE_NODE_BY_OFFSET(
+                    EDGE_INFO_VERTEX(ctx->edge_buffer[n]), &ctx->vec_cache);
+            out_edges[n_explicit].neighbor = neighbor->vert.id;
+            out_edges[n_explicit].edge = EDGE_INFO_EDGE(ctx->edge_buffer[n]);
+            out_edges[n_explicit].payload = ctx->edge_payload_buffer[n];
+        }
+        n_explicit++;
+    }
+    return n_explicit;
+}
+
+static int queue_migration(hvr_vertex_t *vert, int target_pe,
+        hvr_internal_ctx_t *ctx) {
+    assert(ctx->forwarding); // HVR_MIGRATION_INTERVAL must be set
+    assert(VERTEX_ID_PE(vert->id) == ctx->pe);
+    assert(target_pe >= 0 && target_pe < ctx->npes);
+
+    if (target_pe == ctx->pe) {
+        return 1;
+    }
+
+    if (collect_explicit_edges((hvr_vertex_cache_node_t *)vert, NULL, ctx) >
+            HVR_MAX_MIGRATED_EDGES) {
+        return 0;
+    }
+
+    if (ctx->n_pending_migrations == ctx->max_pending_migrations) {
+        fprintf(stderr, "ERROR: PE %d exceeded the maximum number of pending "
+                "vertex migrations (%u). Increase HVR_MAX_PENDING_MIGRATIONS.\n",
+                ctx->pe, ctx->max_pending_migrations);
+        abort();
+    }
+    hvr_pending_migration_t *pending = ctx->pending_migrations +
+        ctx->n_pending_migrations++;
+    pending->id = vert->id;
+    pending->target_pe = target_pe;
+    return 1;
+}
+
+int hvr_vertex_migrate(hvr_vertex_t *vert, int target_pe, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(ctx->user_mutation_allowed);
+    int success;
+#ifdef MULTITHREADED
+#pragma omp critical(hvr_migrations)
+#endif
+    success = queue_migration(vert, target_pe, ctx);
+    return success;
+}
+
+void hvr_vertex_yield(hvr_vertex_t *vert, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(VERTEX_ID_PE(vert->id) == ctx->pe);
+#ifdef MULTITHREADED
+    if (ctx->in_parallel_update) {
+        // any_needs_processing is set once all threads have finished
+        vert->needs_processing = 1;
+        return;
+    }
+#endif
+    mark_for_processing(vert, ctx);
+}
+
+uint64_t *hvr_vertex_resume_state(hvr_vertex_t *vert, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(VERTEX_ID_PE(vert->id) == ctx->pe);
+    if (ctx->resume_state == NULL) {
+#ifdef MULTITHREADED
+#pragma omp critical(hvr_resume_state)
+#endif
+        if (ctx->resume_state == NULL) {
+            const size_t nbytes = ctx->vec_cache.pool_size *
+                sizeof(ctx->resume_state[0]);
+            uint64_t *resume_state = (uint64_t *)malloc_helper(nbytes);
+            assert(resume_state);
+            memset(resume_state, 0x00, nbytes);
+            ctx->resume_state = resume_state;
+        }
+    }
+    return ctx->resume_state + VERTEX_ID_OFFSET(vert->id);
+}
+
+hvr_mirror_status_t hvr_vertex_await_mirror(hvr_vertex_t *vert,
+        hvr_vertex_id_t id, hvr_vertex_t **out, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    assert(VERTEX_ID_PE(vert->id) == ctx->pe);
+    *out = NULL;
+
+    hvr_mirror_status_t status = HVR_MIRROR_PENDING;
+#ifdef MULTITHREADED
+#pragma omp critical(hvr_mirror_awaits)
+#endif
+    {
+        unsigned i = 0;
+        while (i < ctx->n_mirror_awaits &&
+                (ctx->mirror_awaits[i].waiter != vert->id ||
+                 ctx->mirror_awaits[i].requested != id)) {
+            i++;
+        }
+
+        hvr_lock_vertex_cache(0, ctx);
+        hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
+                i < ctx->n_mirror_awaits ? ctx->mirror_awaits[i].awaited : id,
+                &ctx->vec_cache);
+        hvr_unlock_vertex_cache(ctx);
+
+        if (cached && cached->populated) {
+            *out = &cached->vert;
+            status = HVR_MIRROR_READY;
+        } else if (VERTEX_ID_PE(id) == ctx->pe ||
+                (i < ctx->n_mirror_awaits && ctx->mirror_awaits[i].missing)) {
+            status = HVR_MIRROR_MISSING;
+        }
+
+        if (status != HVR_MIRROR_PENDING) {
+            if (i < ctx->n_mirror_awaits) {
+                memcpy(ctx->mirror_awaits + i,
+                        ctx->mirror_awaits + --ctx->n_mirror_awaits,
+                        sizeof(ctx->mirror_awaits[i]));
+            }
+        } else if (i == ctx->n_mirror_awaits) {
+            if (ctx->n_mirror_awaits == ctx->max_mirror_awaits) {
+                fprintf(stderr, "ERROR: PE %d exceeded the maximum number of "
+                        "vertices waiting on remote vertices (%u). Increase "
+                        "HVR_MAX_MIRROR_AWAITS.\n", ctx->pe,
+                        ctx->max_mirror_awaits);
+                abort();
+            }
+            hvr_mirror_await_t *await = ctx->mirror_awaits +
+                ctx->n_mirror_awaits++;
+            await->waiter = vert->id;
+            await->requested = id;
+            await->awaited = id;
+            await->subscribed = 0;
+            await->woken = 0;
+            await->missing = 0;
+        }
+    }
+    return status;
+}
+
+hvr_vertex_id_t hvr_resolve_vertex_id(hvr_vertex_id_t id, hvr_ctx_t in_ctx) {
+    hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
+    if (!ctx->forwarding) {
+        return id;
+    }
+
+    /*
+     * A vertex may have migrated several times. Give up following forwarding
+     * entries after a reasonable number of hops, in case of cycles left by
+     * reused slots.
+     */
+    for (unsigned hop = 0; hop < 16 && id != HVR_INVALID_VERTEX_ID; hop++) {
+        const int pe = VERTEX_ID_PE(id);
+        const size_t offset = VERTEX_ID_OFFSET(id);
+
+        const hvr_vertex_id_t forward_to = shmem_uint64_atomic_fetch(
+                ctx->forwarding + offset, pe);
+        if (forward_to == HVR_FORWARDING_PENDING) {
+            return id;
+        } else if (forward_to != HVR_INVALID_VERTEX_ID) {
+            id = forward_to;
+            continue;
+        }
+
+        hvr_vertex_id_t slot_id;
+        if (pe == ctx->pe) {
+            slot_id = ctx->vec_cache.pool_mem[offset].vert.id;
         } else {
-            // Vertex delete
-            hvr_vertex_cache_node_t *cached = hvr_vertex_cache_lookup(
-                    chng.change.del.to_delete, &ctx->vec_cache);
-            hvr_vertex_delete_impl(&cached->vert, ctx);
+            shmem_getmem(&slot_id, &(ctx->vec_cache.pool_mem[offset].vert.id),
+                    sizeof(slot_id), pe);
         }
+        return (slot_id == id ? id : HVR_INVALID_VERTEX_ID);
     }
+    return id;
 }
 
-static int update_vertices(hvr_set_t *to_couple_with,
+/*
+ * Publish this PE's load and, every migration_interval iterations, gather the
+ * loads of all PEs and give them to the migration policy.
+ */
+static void run_migration_policy(unsigned long long last_iter_time_us,
         hvr_internal_ctx_t *ctx) {
-    if (ctx->update_metadata == NULL || !ctx->any_needs_processing) {
-        return 0;
+    ctx->load->n_local_vertices = ctx->vec_cache.n_local_vertices;
+    ctx->load->iter_time_us = last_iter_time_us;
+    ctx->load->iter = ctx->iter;
+
+    if (!ctx->migration_policy || ctx->iter % ctx->migration_interval != 0) {
+        return;
     }
 
-    ctx->any_needs_processing = 0;
-    ctx->user_mutation_allowed = 1;
+    for (int pe = 0; pe < ctx->npes; pe++) {
+        shmem_getmem_nbi(ctx->all_loads + pe, ctx->load, sizeof(hvr_pe_load_t),
+                pe);
+    }
+    shmem_quiet();
 
-    unsigned long long update_vertex_vertex_sub_time = 0;
-    unsigned long long update_vertex_updating_edge_info_time = 0;
-    unsigned long long update_vertex_signaling_time = 0;
-    int count = 0;
     hvr_vertex_iter_t iter;
     hvr_vertex_iter_init(&iter, ctx);
-    for (hvr_vertex_t *curr = hvr_vertex_iter_next(&iter); curr;
-            curr = hvr_vertex_iter_next(&iter)) {
 
-        if (curr->needs_processing) {
-            curr->needs_processing = 0;
-            const hvr_partition_t old_part = wrap_actor_to_partition(curr, ctx);
+    ctx->user_mutation_allowed = 1;
+    ctx->migration_policy(ctx->all_loads, &iter, ctx);
+    ctx->user_mutation_allowed = 0;
+}
 
-            ctx->update_metadata(curr, to_couple_with, ctx);
+/*
+ * Ship each vertex queued by hvr_vertex_migrate to its new PE and delete the
+ * local copy. Its slot's forwarding entry stays pending until the new owner
+ * reports the vertex's new ID.
+ */
+static void send_pending_migrations(hvr_internal_ctx_t *ctx) {
+    hvr_migration_msg_t msg;
+    for (unsigned i = 0; i < ctx->n_pending_migrations; i++) {
+        hvr_pending_migration_t *pending = ctx->pending_migrations + i;
+        hvr_vertex_cache_node_t *local = hvr_vertex_cache_lookup(pending->id,
+                &ctx->vec_cache);
+        if (!local) {
+            // Deleted or already migrated since it was queued
+            continue;
+        }
 
-            process_buffered_changes(ctx
-#ifdef DETAILED_PRINTS
-                    , &update_vertex_vertex_sub_time,
-                    &update_vertex_updating_edge_info_time,
-                    &update_vertex_signaling_time
-#endif
-                    );
+        msg.n_edges = collect_explicit_edges(local, msg.edges, ctx);
+        if (msg.n_edges > HVR_MAX_MIGRATED_EDGES) {
+            // Gained too many edges since it was queued
+            continue;
+        }
+        memcpy(&msg.vert, &local->vert, sizeof(msg.vert));
 
-            hvr_partition_t new_partition = wrap_actor_to_partition(curr, ctx);
-            curr->curr_part = new_partition;
-            curr->prev_part = old_part;
+        shmem_uint64_atomic_set(
+                ctx->forwarding + VERTEX_ID_OFFSET(pending->id),
+                HVR_FORWARDING_PENDING, ctx->pe);
+        hvr_mailbox_send(&msg, sizeof(msg), pending->target_pe, -1,
+                &ctx->migration_mailbox);
 
-            if (new_partition == HVR_INVALID_PARTITION) {
-                assert(old_part == HVR_INVALID_PARTITION);
-            } else {
-                update_partition_list_membership(curr, old_part, new_partition,
-                        &ctx->local_partition_lists, ctx);
-                if (curr->needs_send) {
-                    // Something changed
-                    unsigned n_interacting = 0;
-                    assert(ctx->might_interact);
-                    ctx->might_interact(new_partition, ctx->interacting,
-                            &n_interacting, MAX_INTERACTING_PARTITIONS, ctx);
-                    update_existing_edges((hvr_vertex_cache_node_t *)curr,
-                            ctx->interacting, n_interacting, ctx);
-                }
-            }
+        /*
+         * Subscribers drop their copies and any explicit edges with them, and
+         * the new owner recreates those edges for the vertex's new ID.
+         */
+        delete_all_edges(local, hvr_irr_matrix_linearize(
+                    CACHE_NODE_OFFSET(local, &ctx->vec_cache),
+                    ctx->edge_buffer, MAX_MODIFICATIONS, &ctx->edges), ctx);
+        hvr_vertex_delete_impl(&local->vert, 1, ctx);
+    }
+    ctx->n_pending_migrations = 0;
+}
 
-            if (curr->needs_send) {
-                /*
-                 * Mark all downstream neighbors because attributes of this
-                 * local vertex changed.
-                 */
-                mark_all_downstream_neighbors_for_processing(
-                        (hvr_vertex_cache_node_t *)curr, ctx);
-            }
+/*
+ * Recreate vertices migrated to this PE as new local vertices, along with
+ * their explicit edges, and tell their previous owners their new IDs.
+ */
+static void receive_migrations(hvr_internal_ctx_t *ctx) {
+    hvr_migration_msg_t msg;
+    size_t msg_len;
+    int any_received = 0;
 
-            count++;
+    ctx->user_mutation_allowed = 1;
+    while (hvr_mailbox_recv(&msg, sizeof(msg), &msg_len,
+                &ctx->migration_mailbox)) {
+        assert(msg_len == sizeof(msg));
+
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        memcpy(vert->values, msg.vert.values, sizeof(vert->values));
+        vert->creation_iter = msg.vert.creation_iter;
+
+        for (unsigned e = 0; e < msg.n_edges; e++) {
+            hvr_vertex_id_t neighbor = hvr_resolve_vertex_id(
+                    msg.edges[e].neighbor, ctx);
+            if (neighbor != HVR_INVALID_VERTEX_ID) {
+                hvr_create_edge_with_payload(vert, neighbor,
+                        msg.edges[e].edge, msg.edges[e].payload, ctx);
+            }
         }
+
+        /*
+         * Only publish the new ID if the old slot has not been reused by a new
+         * local vertex in the meantime.
+         */
+        shmem_uint64_atomic_compare_swap(
+                ctx->forwarding + VERTEX_ID_OFFSET(msg.vert.id),
+                HVR_FORWARDING_PENDING, vert->id, VERTEX_ID_PE(msg.vert.id));
+        any_received = 1;
     }
     ctx->user_mutation_allowed = 0;
 
-    return count;
+    if (any_received) {
+#ifdef DETAILED_PRINTS
+        unsigned long long time_vertex_sub = 0;
+        unsigned long long time_updating_edge_info = 0;
+        unsigned long long time_signaling = 0;
+#endif
+        process_buffered_changes(ctx
+#ifdef DETAILED_PRINTS
+                , &time_vertex_sub, &time_updating_edge_info, &time_signaling
+#endif
+                );
+    }
+}
+
+static void migrate_vertices(unsigned long long last_iter_time_us,
+        hvr_internal_ctx_t *ctx) {
+    run_migration_policy(last_iter_time_us, ctx);
+    send_pending_migrations(ctx);
+    receive_migrations(ctx);
 }
 
 static void send_updates_to_all_subscribed_pes_helper(hvr_update_msg_t *msg,
-        uint64_t *subscribers, unsigned n_subscribers,
+        unsigned row, hvr_sparse_arr_t *subscribers,
         hvr_internal_ctx_t *ctx) {
+    /*
+     * A blocked send drains incoming messages, which can add or remove
+     * subscribers in this same row, so send to a copy of it. Rows small
+     * enough to be stored inline are copied without allocating.
+     */
+    uint64_t inline_subs[HVR_SPARSE_ARR_INLINE_VALS];
+    uint64_t *subs = inline_subs;
+    unsigned n_subs = hvr_sparse_arr_row_length(row, subscribers);
+    if (n_subs <= HVR_SPARSE_ARR_INLINE_VALS) {
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, row, subscribers);
+        unsigned sub_pe;
+        n_subs = 0;
+        while (hvr_sparse_arr_row_iter_next(&iter, &sub_pe)) {
+            inline_subs[n_subs++] = sub_pe;
+        }
+    } else {
+        n_subs = hvr_sparse_arr_linearize_row(row, &subs, subscribers);
+    }
+
     const int pe = ctx->pe;
-    for (unsigned s = 0; s < n_subscribers; s++) {
-        int sub_pe = subscribers[s];
+    for (unsigned s = 0; s < n_subs; s++) {
+        const int sub_pe = (int)subs[s];
         if (sub_pe != pe) {
             send_to_vertex_update_mailbox(msg, sub_pe, ctx);
         }
     }
+
+    if (subs != inline_subs) {
+        hvr_sparse_arr_release_row(subs, subscribers);
+    }
 }
 
 void send_updates_to_all_subscribed_pes(
@@ -2506,28 +4935,23 @@ void send_updates_to_all_subscribed_pes(
         process_perf_info_t *perf_info,
         unsigned long long *time_sending,
         hvr_internal_ctx_t *ctx) {
-    uint64_t *subs = NULL;
-    unsigned n_subs;
     assert(VERTEX_ID_PE(vert->id) == ctx->pe);
 
     hvr_update_msg_t msg;
-    hvr_vert_update_init(&msg, vert, is_delete || is_invalidation);
+    hvr_vert_update_init(&msg, vert, is_invalidation ? is_invalidation :
+            (is_delete ? HVR_DELETE_INVALIDATION : 0));
 
     unsigned long long start = hvr_current_time_us();
 
     // Find subscribers to part and send message to them
     if (part != HVR_INVALID_PARTITION) {
-        n_subs = hvr_sparse_arr_linearize_row(part, &subs,
-                &ctx->remote_partition_subs);
-        send_updates_to_all_subscribed_pes_helper(&msg, subs, n_subs, ctx);
-        hvr_sparse_arr_release_row(subs, &ctx->remote_partition_subs);
+        send_updates_to_all_subscribed_pes_helper(&msg, part,
+                &ctx->remote_partition_subs, ctx);
     }
 
     // Find subscribers to this particular vertex and send update to them
-    n_subs = hvr_sparse_arr_linearize_row(VERTEX_ID_OFFSET(vert->id),
-            &subs, &ctx->remote_vert_subs);
-    send_updates_to_all_subscribed_pes_helper(&msg, subs, n_subs, ctx);
-    hvr_sparse_arr_release_row(subs, &ctx->remote_vert_subs);
+    send_updates_to_all_subscribed_pes_helper(&msg, VERTEX_ID_OFFSET(vert->id),
+            &ctx->remote_vert_subs, ctx);
 
     *time_sending += (hvr_current_time_us() - start);
 }
@@ -2545,6 +4969,32 @@ static int process_vertex_updates_cb(void *data, int pe_sending_to) {
     return hvr_set_contains(pe_sending_to, hvr_ctx->all_terminated_pes);
 }
 
+static void send_vertex_update(hvr_vertex_t *curr,
+        unsigned long long *time_sending, process_perf_info_t *perf_info,
+        hvr_internal_ctx_t *ctx) {
+    /*
+     * If this vertex changed partitions, need to invalidate any cached
+     * copies in the old partition.
+     */
+    hvr_partition_t new_partition = curr->curr_part;
+    hvr_partition_t old_partition = curr->prev_part;
+
+    if (new_partition == HVR_INVALID_PARTITION) {
+        assert(old_partition == HVR_INVALID_PARTITION);
+    }
+
+    if (old_partition != HVR_INVALID_PARTITION &&
+            old_partition != new_partition) {
+        send_updates_to_all_subscribed_pes(curr, old_partition,
+                HVR_PARTITION_INVALIDATION, 0, perf_info, time_sending, ctx);
+    }
+
+    send_updates_to_all_subscribed_pes(curr, new_partition, 0, 0,
+            perf_info, time_sending, ctx);
+
+    curr->needs_send = 0;
+}
+
 static unsigned send_vertex_updates(hvr_internal_ctx_t *ctx,
         unsigned long long *time_sending,
         process_perf_info_t *perf_info) {
@@ -2556,37 +5006,89 @@ static unsigned send_vertex_updates(hvr_internal_ctx_t *ctx,
             curr = hvr_vertex_iter_next(&iter)) {
         // If this vertex was mutated on this iteration
         if (curr->needs_send) {
-            /*
-             * If this vertex changed partitions, need to invalidate any cached
-             * copies in the old partition.
-             */
-            hvr_partition_t new_partition = curr->curr_part;
-            hvr_partition_t old_partition = curr->prev_part;
+            send_vertex_update(curr, time_sending, perf_info, ctx);
+            n_updates_sent++;
+        }
+    }
 
-            if (new_partition == HVR_INVALID_PARTITION) {
-                assert(old_partition == HVR_INVALID_PARTITION);
-            }
+    process_vertex_updates_ctx cb_ctx;
+    cb_ctx.ctx = ctx;
+    hvr_mailbox_buffer_flush(&ctx->vertex_update_mailbox_buffer,
+            process_vertex_updates_cb, &cb_ctx);
 
-            if (old_partition != HVR_INVALID_PARTITION &&
-                    old_partition != new_partition) {
-                send_updates_to_all_subscribed_pes(curr, old_partition, 1,
-                        0, perf_info, time_sending, ctx);
-            }
+    return n_updates_sent;
+}
 
-            send_updates_to_all_subscribed_pes(curr, new_partition, 0, 0,
-                    perf_info, time_sending, ctx);
-            n_updates_sent++;
+/*
+ * Called by update_vertices on each local vertex once it has been updated, when
+ * pipelining is enabled. Sends out the new state of curr if it changed, and
+ * every pipeline_chunk sends pushes the buffered updates to the network and
+ * handles some of the updates that other PEs have sent us in the meantime.
+ */
+static void pipeline_vertex_update(hvr_vertex_t *curr,
+        hvr_internal_ctx_t *ctx) {
+    if (!curr->needs_send) {
+        return;
+    }
 
-            curr->needs_send = 0;
-        }
+    const unsigned long long start = hvr_current_time_us();
+    send_vertex_update(curr, &ctx->pipeline_time_sending, NULL, ctx);
+    ctx->pipeline_n_sent++;
+
+    if (++ctx->pipeline_n_unflushed == ctx->pipeline_chunk) {
+        flush_pipelined_updates(ctx);
+        ctx->pipeline_n_recvd += process_vertex_updates(ctx, NULL,
+                MAX_MSGS_DRAINED);
+    }
+    ctx->pipeline_time += hvr_current_time_us() - start;
+}
+
+static void flush_pipelined_updates(hvr_internal_ctx_t *ctx) {
+    if (ctx->pipeline_n_unflushed == 0) {
+        return;
     }
 
     process_vertex_updates_ctx cb_ctx;
     cb_ctx.ctx = ctx;
     hvr_mailbox_buffer_flush(&ctx->vertex_update_mailbox_buffer,
             process_vertex_updates_cb, &cb_ctx);
+    ctx->pipeline_n_unflushed = 0;
+}
 
-    return n_updates_sent;
+/*
+ * With both HVR_DETERMINISTIC and HVR_STRICT, called by every PE between
+ * sending and receiving so that each PE receives everything that was sent to
+ * it before, however its messages raced each other.
+ */
+static void deterministic_phase_barrier(hvr_internal_ctx_t *ctx) {
+    if (!ctx->deterministic || !ctx->strict_mode) {
+        return;
+    }
+
+    process_vertex_updates_ctx cb_ctx;
+    cb_ctx.ctx = ctx;
+    hvr_mailbox_buffer_flush(&ctx->vertex_update_mailbox_buffer,
+            process_vertex_updates_cb, &cb_ctx);
+    hvr_mailbox_buffer_flush(&ctx->vert_sub_mailbox_buffer, NULL, NULL);
+    shmem_barrier_all();
+}
+
+/*
+ * Handle the vertex updates waiting for us. With both HVR_DETERMINISTIC and
+ * HVR_STRICT, handle all of them so that none are left to a later iteration.
+ */
+static unsigned receive_vertex_updates(process_perf_info_t *perf_info,
+        hvr_internal_ctx_t *ctx) {
+    unsigned count = process_vertex_updates(ctx, perf_info,
+            MAX_MSGS_PROCESSED);
+    if (ctx->deterministic && ctx->strict_mode) {
+        unsigned n;
+        while ((n = process_vertex_updates(ctx, perf_info,
+                        MAX_MSGS_PROCESSED)) > 0) {
+            count += n;
+        }
+    }
+    return count;
 }
 
 static void receive_coupled_val(hvr_coupling_msg_t *msg,
@@ -2816,6 +5318,64 @@ static int wait_for_coupling_ack(hvr_msg_buf_node_t *msg_buf_node,
     }
 }
 
+/*
+ * Returns 1 if this PE can skip the coupling protocol on this iteration: it is
+ * running with HVR_ASYNC_ITERATIONS, is not coupled with (and has not asked to
+ * couple with) any other PE, and no other PE has asked to couple with it.
+ */
+static int is_uncoupled(hvr_internal_ctx_t *ctx) {
+    return ctx->async_iterations && ctx->coupled_pes_root == ctx->pe &&
+        hvr_set_count(ctx->coupled_pes) == 1 &&
+        hvr_set_count(ctx->prev_coupled_pes) <= 1 &&
+        hvr_mailbox_is_empty(&ctx->coupling_mailbox);
+}
+
+/*
+ * The part of update_coupled_values that is left for a PE which is not
+ * coupled with any other PE. No messages are exchanged, other than checking
+ * for PEs that have left the simulation.
+ */
+static unsigned update_uncoupled_values(hvr_internal_ctx_t *ctx,
+        hvr_vertex_t *coupled_metric, int count_updated,
+        uint64_t *n_pulled_from_dead_pes, int terminating) {
+    memcpy(coupled_metric, ctx->coupled_pes_values + ctx->pe,
+            sizeof(*coupled_metric));
+
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_all_init(&iter, ctx);
+    ctx->update_coupled_val(&iter, ctx, coupled_metric,
+            ctx->n_msgs_recvd_this_iter,
+            ctx->vertex_update_mailbox_nmsgs,
+            ctx->n_msgs_recvd_total,
+            ctx->vertex_update_mailbox_nmsgs_total);
+
+    memcpy(ctx->coupled_pes_values + ctx->pe, coupled_metric,
+            sizeof(*coupled_metric));
+    memset(ctx->updates_on_this_iter, 0x00,
+            ctx->npes * sizeof(ctx->updates_on_this_iter[0]));
+    ctx->updates_on_this_iter[ctx->pe] = count_updated;
+    hvr_set_copy(ctx->prev_coupled_pes, ctx->coupled_pes);
+
+    *n_pulled_from_dead_pes = poll_for_dead_pes(ctx);
+
+    if (terminating) {
+        return 1;
+    } else if (ctx->should_terminate) {
+        hvr_vertex_iter_all_init(&iter, ctx);
+        return ctx->should_terminate(&iter, ctx,
+                ctx->coupled_pes_values + ctx->pe,
+                ctx->coupled_pes_values,
+                ctx->coupled_pes, 1, ctx->updates_on_this_iter,
+                ctx->all_terminated_cluster_pes,
+                ctx->n_msgs_recvd_this_iter,
+                ctx->vertex_update_mailbox_nmsgs,
+                ctx->n_msgs_recvd_total,
+                ctx->vertex_update_mailbox_nmsgs_total);
+    } else {
+        return 0;
+    }
+}
+
 static unsigned update_coupled_values(hvr_internal_ctx_t *ctx,
         hvr_vertex_t *coupled_metric, int count_updated,
         unsigned long long *time_coupling,
@@ -2835,6 +5395,15 @@ static unsigned update_coupled_values(hvr_internal_ctx_t *ctx,
         *time_sharing_info = *time_waiting_for_info = *time_negotiating = 0;
     unsigned long long start_coupling = hvr_current_time_us();
 
+    if (is_uncoupled(ctx)) {
+        const int should_abort = update_uncoupled_values(ctx, coupled_metric,
+                count_updated, n_pulled_from_dead_pes, terminating);
+        *time_coupling = *time_waiting = *time_after = 0;
+        *time_should_terminate = hvr_current_time_us() - start_coupling;
+        *out_naborts = 0;
+        return should_abort;
+    }
+
     hvr_msg_buf_node_t *msg_buf_node = hvr_msg_buf_pool_acquire(
             &ctx->msg_buf_pool);
 
@@ -3202,7 +5771,6 @@ static void save_profiling_info(
         unsigned long long start_iter_signaling_time,
 #endif
         unsigned long long end_update_vertices,
-        unsigned long long end_update_dist,
         unsigned long long end_update_partitions,
         unsigned long long end_partition_window,
         unsigned long long end_neighbor_updates,
@@ -3254,7 +5822,6 @@ static void save_profiling_info(
     saved_profiling_info[n_profiled_iters].start_iter_signaling_time = start_iter_signaling_time;
 #endif
     saved_profiling_info[n_profiled_iters].end_update_vertices = end_update_vertices;
-    saved_profiling_info[n_profiled_iters].end_update_dist = end_update_dist;
     saved_profiling_info[n_profiled_iters].end_update_partitions = end_update_partitions;
     saved_profiling_info[n_profiled_iters].end_partition_window = end_partition_window;
     saved_profiling_info[n_profiled_iters].end_neighbor_updates = end_neighbor_updates;
@@ -3320,6 +5887,17 @@ static void save_profiling_info(
         ctx->vertex_update_mailbox_nmsgs;
     saved_profiling_info[n_profiled_iters].vertex_update_mailbox_nattempts =
         ctx->vertex_update_mailbox_nattempts;
+    saved_profiling_info[n_profiled_iters].progress_queue_stalls =
+        ctx->progress_queue_stalls;
+    saved_profiling_info[n_profiled_iters].pipeline_n_sent =
+        ctx->pipeline_n_sent;
+    saved_profiling_info[n_profiled_iters].pipeline_n_recvd =
+        ctx->pipeline_n_recvd;
+    saved_profiling_info[n_profiled_iters].pipeline_time_sending =
+        ctx->pipeline_time_sending;
+    saved_profiling_info[n_profiled_iters].pipeline_time =
+        ctx->pipeline_time;
+    saved_profiling_info[n_profiled_iters].idle_time = ctx->idle_time;
 
 #ifdef PRINT_PARTITIONS
 #define PARTITIONS_STR_BUFSIZE (1024 * 1024)
@@ -3394,7 +5972,9 @@ static void save_profiling_info(
         hvr_mailbox_mem_used(&ctx->coupling_ack_and_dead_mailbox) +
         hvr_mailbox_mem_used(&ctx->coupling_val_mailbox) +
         hvr_mailbox_mem_used(&ctx->to_couple_with_mailbox) +
-        hvr_mailbox_mem_used(&ctx->root_info_mailbox);
+        hvr_mailbox_mem_used(&ctx->root_info_mailbox) +
+        (ctx->progress_thread_enabled ?
+         hvr_progress_queue_mem_used(&ctx->progress_queue) : 0);
 
     saved_profiling_info[n_profiled_iters].msg_buf_pool_bytes_used =
         hvr_msg_buf_pool_mem_used(&ctx->msg_buf_pool);
@@ -3445,10 +6025,8 @@ static void print_profiling_info(profiling_info_t *info) {
     fprintf(profiling_fp, "  update vertices %f - %d updates\n",
             (double)(info->end_update_vertices - info->end_start_time_step) / MS_PER_S,
             info->count_updated);
-    fprintf(profiling_fp, "  update distances %f\n",
-            (double)(info->end_update_dist - info->end_update_vertices) / MS_PER_S);
     fprintf(profiling_fp, "  update actor partitions %f\n",
-            (double)(info->end_update_partitions - info->end_update_dist) / MS_PER_S);
+            (double)(info->end_update_partitions - info->end_update_vertices) / MS_PER_S);
     fprintf(profiling_fp, "  update partition window %f - update time = "
             "(parts=%f subscribers=%f - %f %f %f %f)\n",
             (double)(info->end_partition_window - info->end_update_partitions) / MS_PER_S,
@@ -3519,6 +6097,16 @@ static void print_profiling_info(profiling_info_t *info) {
             "msg send attempts = %llu\n", info->n_msgs_recvd_this_iter,
             info->vertex_update_mailbox_nmsgs,
             info->vertex_update_mailbox_nattempts);
+    fprintf(profiling_fp, "  progress queue stalls = %llu\n",
+            info->progress_queue_stalls);
+    fprintf(profiling_fp, "  pipelined in update vertices: %u updates sent "
+            "(%f ms sending), %u update msgs received, %f ms total\n",
+            info->pipeline_n_sent,
+            (double)info->pipeline_time_sending / MS_PER_S,
+            info->pipeline_n_recvd,
+            (double)info->pipeline_time / MS_PER_S);
+    fprintf(profiling_fp, "  idle waiting for messages: %f ms\n",
+            (double)info->idle_time / MS_PER_S);
     fprintf(profiling_fp, "  aborting? %d\n", info->should_abort);
 
 #ifdef PRINT_PARTITIONS
@@ -3644,6 +6232,92 @@ static void save_local_state_to_dump_file(hvr_internal_ctx_t *ctx) {
     fflush(ctx->edges_dump_file);
 }
 
+/*
+ * Returns 1 if a message is waiting in any of the mailboxes other PEs use to
+ * notify this PE of new work.
+ */
+static int any_incoming_msgs(hvr_internal_ctx_t *ctx) {
+    if (ctx->progress_thread_enabled) {
+        if (!hvr_progress_queue_is_empty(&ctx->progress_queue)) {
+            return 1;
+        }
+    } else if (!hvr_mailbox_is_empty(&ctx->vertex_update_mailbox)) {
+        return 1;
+    }
+
+    if (!hvr_mailbox_is_empty(&ctx->forward_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->vert_sub_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->vertex_msg_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->coupling_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->coupling_ack_and_dead_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->coupling_val_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->to_couple_with_mailbox) ||
+            !hvr_mailbox_is_empty(&ctx->root_info_mailbox)) {
+        return 1;
+    }
+    if (ctx->push_producer_changes &&
+            (ctx->n_producer_change_outbox > 0 ||
+             !hvr_mailbox_is_empty(&ctx->producer_change_mailbox))) {
+        return 1;
+    }
+    if (ctx->migration_interval > 0 &&
+            !hvr_mailbox_is_empty(&ctx->migration_mailbox)) {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Track whether the iteration that just completed did any work, and once
+ * idle_iterations consecutive iterations have not, wait for a message to
+ * arrive rather than running another empty iteration. Only a PE that is not
+ * coupled with any other PE goes idle, as coupled PEs must take part in every
+ * iteration of their cluster.
+ */
+static void wait_if_idle(int count_updated, unsigned n_updates_sent,
+        unsigned long long n_received_updates, unsigned long long deadline,
+        hvr_internal_ctx_t *ctx) {
+    if (ctx->idle_iterations == 0) {
+        return;
+    }
+
+    if (count_updated > 0 || n_updates_sent > 0 || n_received_updates > 0 ||
+            ctx->n_msgs_recvd_this_iter > 0 || ctx->any_needs_processing ||
+            ctx->n_pending_hubs > 0 || hvr_set_count(ctx->coupled_pes) > 1) {
+        ctx->n_empty_iterations = 0;
+        return;
+    }
+
+    ctx->n_empty_iterations++;
+    if (ctx->n_empty_iterations < ctx->idle_iterations) {
+        return;
+    }
+
+    const unsigned long long start_idle = hvr_current_time_us();
+    unsigned long long wake = start_idle + ctx->idle_timeout_us;
+    if (wake > deadline) {
+        wake = deadline;
+    }
+
+    unsigned long long backoff_us = 1;
+    unsigned long long now = start_idle;
+    while (now < wake && !any_incoming_msgs(ctx)) {
+        unsigned long long sleep_us = backoff_us;
+        if (sleep_us > wake - now) {
+            sleep_us = wake - now;
+        }
+        usleep(sleep_us);
+
+        backoff_us *= 2;
+        if (backoff_us > ctx->idle_max_backoff_us) {
+            backoff_us = ctx->idle_max_backoff_us;
+        }
+        now = hvr_current_time_us();
+    }
+
+    ctx->idle_time = hvr_current_time_us() - start_idle;
+}
+
 hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
     unsigned long long start_hvr_body_us = hvr_current_time_us();
 
@@ -3671,7 +6345,9 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
         abort();
     }
 
-    shmem_barrier_all();
+    if (!ctx->async_iterations) {
+        shmem_barrier_all();
+    }
 
     ctx->user_mutation_allowed = 0;
     ctx->n_msgs_recvd_this_iter = 0;
@@ -3688,11 +6364,6 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
      */
     insert_recently_created_in_partitions(ctx);
 
-    // Update distance of each mirrored vertex from a local vertex
-    update_distances(ctx);
-
-    const unsigned long long end_update_dist = hvr_current_time_us();
-
     const unsigned long long end_update_partitions = hvr_current_time_us();
 
     /*
@@ -3708,9 +6379,13 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
 
     /*
      * Ensure everyone's partition windows are initialized before initializing
-     * neighbors.
+     * neighbors. Without this, PEs that register as producers late are picked
+     * up on a later iteration, the same way as vertices that move into new
+     * partitions.
      */
-    shmem_barrier_all();
+    if (!ctx->async_iterations) {
+        shmem_barrier_all();
+    }
 
     /*
      * Process updates sent to us by neighbors via our main mailbox. Use these
@@ -3732,12 +6407,16 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
      * partition to the PEs that are subscribed to updates in that partition
      * inside of ctx->remote_partition_subs.
      */
+    deterministic_phase_barrier(ctx);
     process_neighbor_updates(ctx, &end_partition_sub_updates);
+    deterministic_phase_barrier(ctx);
     const unsigned long long end_neighbor_updates = hvr_current_time_us();
 
-    perf_info.n_received_updates += process_vertex_updates(ctx, &perf_info,
-            MAX_MSGS_PROCESSED);
+    perf_info.n_received_updates += receive_vertex_updates(&perf_info, ctx);
+    retry_held_edge_creates(ctx);
     process_incoming_messages(ctx);
+    // Nothing sent on the first iteration may arrive before this one ends
+    deterministic_phase_barrier(ctx);
     const unsigned long long end_vertex_updates = hvr_current_time_us();
 
     hvr_vertex_t coupled_metric;
@@ -3768,7 +6447,6 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
                 0,0,0,
 #endif
                 start_body,
-                end_update_dist,
                 end_update_partitions,
                 end_partition_window,
                 end_neighbor_updates,
@@ -3799,6 +6477,7 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
     }
 
     unsigned long long start_hvr_body_iterations_us = hvr_current_time_us();
+    unsigned long long prev_start_iter = start_hvr_body_iterations_us;
 
     ctx->iter += 1;
     while (!should_abort && hvr_current_time_us() - start_body <
@@ -3815,6 +6494,11 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
         ctx->n_msgs_recvd_this_iter = 0;
         ctx->vertex_update_mailbox_nmsgs = 0;
         ctx->vertex_update_mailbox_nattempts = 0;
+        ctx->pipeline_n_sent = 0;
+        ctx->pipeline_n_recvd = 0;
+        ctx->pipeline_time_sending = 0;
+        ctx->pipeline_time = 0;
+        ctx->idle_time = 0;
         hvr_set_wipe(to_couple_with);
 
         unsigned long long start_buffered_changes = 0;
@@ -3847,17 +6531,26 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
         // Must come before everything else
         const int count_updated = update_vertices(to_couple_with, ctx);
 
+        if (ctx->forwarding) {
+            migrate_vertices(start_iter - prev_start_iter, ctx);
+        }
+        prev_start_iter = start_iter;
+
         insert_recently_created_in_partitions(ctx);
 
+        process_pending_hub_work(ctx);
+
+        if (ctx->child_partition &&
+                ctx->iter % ctx->partition_refine_interval == 0) {
+            hvr_partition_list_refine(&ctx->local_partition_lists, ctx);
+            hvr_partition_list_refine(&ctx->mirror_partition_lists, ctx);
+        }
+
         // Update my local information on PEs I am coupled with.
         hvr_set_merge(ctx->coupled_pes, to_couple_with);
 
         const unsigned long long end_update_vertices = hvr_current_time_us();
 
-        update_distances(ctx);
-
-        const unsigned long long end_update_dist = hvr_current_time_us();
-
         const unsigned long long end_update_partitions = hvr_current_time_us();
 
         update_partition_window(ctx, &time_updating_partitions,
@@ -3867,18 +6560,23 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
 
         time_sending = 0;
         memset(&perf_info, 0x00, sizeof(perf_info));
-        n_updates_sent = send_vertex_updates(ctx, &time_sending, &perf_info);
+        n_updates_sent = ctx->pipeline_n_sent +
+            send_vertex_updates(ctx, &time_sending, &perf_info);
 
         const unsigned long long end_send_updates = hvr_current_time_us();
 
+        deterministic_phase_barrier(ctx);
+
         process_neighbor_updates(ctx, &end_partition_sub_updates);
 
         hvr_mailbox_buffer_flush(&ctx->vert_sub_mailbox_buffer, NULL, NULL);
+        deterministic_phase_barrier(ctx);
 
         const unsigned long long end_neighbor_updates = hvr_current_time_us();
 
-        perf_info.n_received_updates += process_vertex_updates(ctx, &perf_info,
-                MAX_MSGS_PROCESSED);
+        perf_info.n_received_updates += ctx->pipeline_n_recvd +
+            receive_vertex_updates(&perf_info, ctx);
+        retry_held_edge_creates(ctx);
         process_incoming_messages(ctx);
 
         const unsigned long long end_vertex_updates = hvr_current_time_us();
@@ -3894,6 +6592,12 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
 
         const unsigned long long end_update_coupled = hvr_current_time_us();
 
+        if (!should_abort) {
+            wait_if_idle(count_updated, n_updates_sent,
+                    perf_info.n_received_updates,
+                    start_body + ctx->max_elapsed_seconds * 1000000ULL, ctx);
+        }
+
         if (print_profiling) {
             save_profiling_info(
                     start_iter,
@@ -3905,7 +6609,6 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
                     start_iter_signaling_time,
 #endif
                     end_update_vertices,
-                    end_update_dist,
                     end_update_partitions,
                     end_partition_window,
                     end_neighbor_updates,
@@ -3952,6 +6655,10 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
 
     if (ctx->strict_mode) {
         while (1) {
+            // Match the barriers of the PEs still iterating
+            deterministic_phase_barrier(ctx);
+            deterministic_phase_barrier(ctx);
+            deterministic_phase_barrier(ctx);
             *(ctx->strict_counter_src) = 1;
             shmem_int_sum_to_all(ctx->strict_counter_dest,
                     ctx->strict_counter_src, 1, 0, 0, ctx->npes, ctx->p_wrk_int,
@@ -3972,16 +6679,6 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
             &coupling_sharing_info, &coupling_waiting_for_info,
             &coupling_negotiating, 1);
 
-    // Notify all PEs that I have terminated
-    hvr_dead_pe_msg_t dead_msg;
-    dead_msg.pe = ctx->pe;
-    for (int p = 0; p < ctx->npes; p++) {
-        hvr_mailbox_send(&dead_msg, sizeof(dead_msg), p, -1,
-                &ctx->coupling_ack_and_dead_mailbox);
-    }
-
-    this_pe_has_exited = 1;
-
     /*
      * For each local vertex, persist its partition so that other PEs can come
      * look it up after I have terminated.
@@ -4004,11 +6701,29 @@ hvr_exec_info hvr_body(hvr_ctx_t in_ctx) {
      * For each partition that I am a producer for, mark myself as a terminated
      * producer of that partition.
      */
+    hvr_dist_bitvec_batch_t terminated_batch;
+    hvr_dist_bitvec_batch_init(&ctx->terminated_pes, 4096, &terminated_batch);
     for (hvr_partition_t p = 0; p < ctx->n_partitions; p++) {
         if (hvr_partition_list_head(p, &ctx->local_partition_lists)) {
-            hvr_dist_bitvec_set(p, ctx->pe, &ctx->terminated_pes);
+            hvr_dist_bitvec_batch_set(p, ctx->pe, &terminated_batch);
         }
     }
+    hvr_dist_bitvec_batch_flush(&terminated_batch);
+    hvr_dist_bitvec_batch_destroy(&terminated_batch);
+
+    /*
+     * Notify all PEs that I have terminated, once the state above is visible
+     * so that they can go look at it as soon as they hear of it.
+     */
+    shmem_quiet();
+    hvr_dead_pe_msg_t dead_msg;
+    dead_msg.pe = ctx->pe;
+    for (int p = 0; p < ctx->npes; p++) {
+        hvr_mailbox_send(&dead_msg, sizeof(dead_msg), p, -1,
+                &ctx->coupling_ack_and_dead_mailbox);
+    }
+
+    this_pe_has_exited = 1;
 
     if (ctx->dump_mode && ctx->only_last_iter_dump) {
         save_local_state_to_dump_file(ctx);
@@ -4048,6 +6763,14 @@ void hvr_finalize(hvr_ctx_t in_ctx) {
 
     shmem_barrier_all();
 
+    if (ctx->progress_thread_enabled) {
+        ctx->progress_thread_stop = 1;
+        const int pthread_err = pthread_join(ctx->progress_pthread, NULL);
+        assert(pthread_err == 0);
+        hvr_progress_queue_destroy(&ctx->progress_queue);
+        free(ctx->progress_recv_buf);
+    }
+
     if (dead_pe_processing) {
         shmem_free(ctx->vertex_partitions);
     }
@@ -4056,7 +6779,16 @@ void hvr_finalize(hvr_ctx_t in_ctx) {
     free(ctx->updates_on_this_iter);
     hvr_partition_list_destroy(&ctx->local_partition_lists);
     hvr_partition_list_destroy(&ctx->mirror_partition_lists);
-    free(ctx->partition_min_dist_from_local_vert);
+    free(ctx->partition_dist_hist);
+    free(ctx->dirty_partitions_list);
+    free(ctx->touched_partitions_list);
+    free(ctx->subscriber_partitions_list);
+    free(ctx->subscriber_partitions_index);
+    free(ctx->new_sub_partitions);
+    free(ctx->new_sub_producer_info);
+    free(ctx->new_sub_dead_info);
+    hvr_dist_bitvec_batch_destroy(&ctx->partition_producers_batch);
+    free(ctx->partition_sub_refcount);
 
     hvr_vertex_cache_destroy(&ctx->vec_cache);
 
@@ -4067,19 +6799,79 @@ void hvr_finalize(hvr_ctx_t in_ctx) {
     hvr_mailbox_destroy(&ctx->coupling_ack_and_dead_mailbox);
     hvr_mailbox_destroy(&ctx->coupling_val_mailbox);
     hvr_mailbox_destroy(&ctx->root_info_mailbox);
+    if (ctx->snapshot_capacity > 0) {
+        shmem_free(ctx->snapshot_ring);
+        shmem_free(ctx->snapshot_head);
+        free(ctx->snapshot_recv_buf);
+    }
+    if (ctx->migration_interval > 0) {
+        hvr_mailbox_destroy(&ctx->migration_mailbox);
+        shmem_free(ctx->forwarding);
+        shmem_free(ctx->load);
+        free(ctx->all_loads);
+        free(ctx->pending_migrations);
+        free(ctx->forward_retries);
+        free(ctx->edge_forward_retries);
+    }
+    if (ctx->push_producer_changes) {
+        hvr_mailbox_destroy(&ctx->producer_change_mailbox);
+        hvr_sparse_arr_destroy(&ctx->registry_subs);
+        free(ctx->producer_changes);
+        free(ctx->producer_change_outbox);
+    }
 
     hvr_sparse_arr_destroy(&ctx->remote_partition_subs);
     hvr_sparse_arr_destroy(&ctx->remote_vert_subs);
     hvr_sparse_arr_destroy(&ctx->my_vert_subs);
+    hvr_sparse_arr_destroy(&ctx->source_interacting);
 
     hvr_map_destroy(&ctx->producer_info);
     hvr_map_destroy(&ctx->dead_info);
+    hvr_dist_bitvec_subcopy_pool_destroy(&ctx->producer_info_pool);
+    hvr_dist_bitvec_subcopy_pool_destroy(&ctx->dead_info_pool);
 
     free(ctx->vert_partition_buf);
 
     hvr_msg_buf_pool_destroy(&ctx->msg_buf_pool);
 
     free(ctx->interacting);
+    if (ctx->search_key) {
+        hvr_set_destroy(ctx->search_partitions);
+    }
+    if (ctx->might_interact_is_pure) {
+        free(ctx->interacting_cache_start);
+        free(ctx->interacting_cache_len);
+        free(ctx->interacting_cache);
+    }
+#ifdef MULTITHREADED
+    for (int t = 0; t < ctx->nthreads; t++) {
+        hvr_thread_state_t *thread = ctx->threads + t;
+        hvr_buffered_changes_destroy(&thread->buffered_changes);
+        hvr_set_destroy(thread->to_couple_with);
+        free(thread->msgs);
+        destroy_mspace(thread->neighbors_list_tracker);
+        free(thread->neighbors_list_pool);
+        if (ctx->parallel_edge_min_partitions > 0) {
+            free(thread->found_edges);
+        }
+    }
+    if (ctx->parallel_edge_min_partitions > 0) {
+        free(ctx->partition_n_scanned);
+    }
+    free(ctx->threads);
+    pthread_rwlock_destroy(&ctx->cache_lock);
+#endif
+    free(ctx->frontier);
+    if (ctx->vertex_priority) {
+        free(ctx->priority_scratch);
+        free(ctx->priority_bucket_counts);
+    }
+    free(ctx->resume_state);
+    free(ctx->mirror_awaits);
+    if (ctx->deterministic) {
+        free(ctx->staged_updates);
+        free(ctx->staged_order);
+    }
 
     free(ctx);
 }
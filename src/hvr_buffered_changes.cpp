@@ -23,7 +23,7 @@ void hvr_buffered_changes_init(size_t nallocated,
 
 void hvr_buffered_changes_edge_create(hvr_vertex_id_t base_id,
         hvr_vertex_id_t neighbor_id, hvr_edge_type_t edge,
-        hvr_buffered_changes_t *changes) {
+        hvr_edge_payload_t payload, hvr_buffered_changes_t *changes) {
     hvr_buffered_change_t *change = changes->pool;
     if (!change) {
         fprintf(stderr, "ERROR Failed allocating a change object, increase "
@@ -40,6 +40,7 @@ void hvr_buffered_changes_edge_create(hvr_vertex_id_t base_id,
     change->change.edge.base_id = base_id;
     change->change.edge.neighbor_id = neighbor_id;
     change->change.edge.edge = edge;
+    change->change.edge.payload = payload;
 }
 
 void hvr_buffered_changes_delete_vertex(hvr_vertex_id_t to_delete,
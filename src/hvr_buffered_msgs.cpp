@@ -1,12 +1,20 @@
 #include "hvr_buffered_msgs.h"
 
-void hvr_buffered_msgs_init(size_t nvertices, size_t pool_size,
+void hvr_buffered_msgs_init(size_t nvertices, size_t pool_size, int ordered,
         hvr_buffered_msgs_t *b) {
     b->buffered = (hvr_buffered_msgs_node_t **)malloc_helper(
             nvertices * sizeof(b->buffered[0]));
     assert(b->buffered);
     memset(b->buffered, 0x00, nvertices * sizeof(b->buffered[0]));
     b->nvertices = nvertices;
+    b->ordered = ordered;
+    b->unsorted = NULL;
+    if (ordered) {
+        b->unsorted = (unsigned char *)malloc_helper(
+                nvertices * sizeof(b->unsorted[0]));
+        assert(b->unsorted);
+        memset(b->unsorted, 0x00, nvertices * sizeof(b->unsorted[0]));
+    }
 
     b->pool = malloc_helper(pool_size);
     assert(b->pool);
@@ -16,6 +24,51 @@ void hvr_buffered_msgs_init(size_t nvertices, size_t pool_size,
     assert(b->allocator);
 }
 
+static int compare_msgs(const hvr_vertex_t *a, const hvr_vertex_t *b) {
+    if (a->id != b->id) {
+        return (a->id < b->id) ? -1 : 1;
+    }
+    if (a->creation_iter != b->creation_iter) {
+        return (a->creation_iter < b->creation_iter) ? -1 : 1;
+    }
+    return memcmp(a->values, b->values, sizeof(a->values));
+}
+
+// Merge sort the list starting at head with compare_msgs
+static hvr_buffered_msgs_node_t *sort_msgs(hvr_buffered_msgs_node_t *head) {
+    if (head == NULL || head->next == NULL) {
+        return head;
+    }
+
+    // Split the list in half
+    hvr_buffered_msgs_node_t *slow = head;
+    hvr_buffered_msgs_node_t *fast = head->next;
+    while (fast && fast->next) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    hvr_buffered_msgs_node_t *second = slow->next;
+    slow->next = NULL;
+
+    hvr_buffered_msgs_node_t *a = sort_msgs(head);
+    hvr_buffered_msgs_node_t *b = sort_msgs(second);
+
+    hvr_buffered_msgs_node_t *merged = NULL;
+    hvr_buffered_msgs_node_t **tail = &merged;
+    while (a && b) {
+        if (compare_msgs(&a->vert, &b->vert) <= 0) {
+            *tail = a;
+            a = a->next;
+        } else {
+            *tail = b;
+            b = b->next;
+        }
+        tail = &(*tail)->next;
+    }
+    *tail = (a ? a : b);
+    return merged;
+}
+
 void hvr_buffered_msgs_insert(size_t i, hvr_vertex_t *payload,
         hvr_buffered_msgs_t *b) {
     assert(i < b->nvertices);
@@ -28,12 +81,20 @@ void hvr_buffered_msgs_insert(size_t i, hvr_vertex_t *payload,
 
     node->next = b->buffered[i];
     b->buffered[i] = node;
+    if (b->ordered) {
+        b->unsorted[i] = 1;
+    }
 }
 
 int hvr_buffered_msgs_poll(size_t i, hvr_vertex_t *out,
         hvr_buffered_msgs_t *b) {
     assert(i < b->nvertices);
 
+    if (b->ordered && b->unsorted[i]) {
+        b->buffered[i] = sort_msgs(b->buffered[i]);
+        b->unsorted[i] = 0;
+    }
+
     hvr_buffered_msgs_node_t *head = b->buffered[i];
     if (head) {
         memcpy(out, &(head->vert), sizeof(*out));
@@ -47,5 +108,6 @@ int hvr_buffered_msgs_poll(size_t i, hvr_vertex_t *out,
 }
 
 size_t hvr_buffered_msgs_mem_used(hvr_buffered_msgs_t *b) {
-    return b->nvertices * sizeof(b->buffered[0]) + b->pool_size;
+    return b->nvertices * sizeof(b->buffered[0]) + b->pool_size +
+        (b->ordered ? b->nvertices * sizeof(b->unsorted[0]) : 0);
 }
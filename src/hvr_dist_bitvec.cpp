@@ -58,7 +58,7 @@ void hvr_dist_bitvec_set(hvr_dist_bitvec_size_t coord0,
     assert(coord0_offset < vec->dim0_per_pe);
 
     const unsigned coord1_word = coord1 / BITS_PER_ELE;
-    const unsigned coord1_bit = coord1 % BITS_PER_WORD;
+    const unsigned coord1_bit = coord1 % BITS_PER_ELE;
     hvr_dist_bitvec_ele_t coord1_mask = (((hvr_dist_bitvec_ele_t)1) <<
             ((hvr_dist_bitvec_ele_t)coord1_bit));
 
@@ -80,7 +80,7 @@ void hvr_dist_bitvec_clear(hvr_dist_bitvec_size_t coord0,
     const unsigned coord0_offset = coord0 % vec->dim0_per_pe;
 
     const unsigned coord1_word = coord1 / BITS_PER_ELE;
-    const unsigned coord1_bit = coord1 % BITS_PER_WORD;
+    const unsigned coord1_bit = coord1 % BITS_PER_ELE;
     hvr_dist_bitvec_ele_t coord1_mask = (((hvr_dist_bitvec_ele_t)1) <<
             ((hvr_dist_bitvec_ele_t)coord1_bit));
     coord1_mask = ~coord1_mask;
@@ -94,6 +94,132 @@ void hvr_dist_bitvec_clear(hvr_dist_bitvec_size_t coord0,
     shmem_uint64_atomic_inc(vec->seq_nos + coord0_offset, coord0_pe);
 }
 
+void hvr_dist_bitvec_batch_init(hvr_dist_bitvec_t *vec, unsigned capacity,
+        hvr_dist_bitvec_batch_t *batch) {
+    if (getenv("HVR_DIST_BITVEC_BATCH_SIZE")) {
+        capacity = atoi(getenv("HVR_DIST_BITVEC_BATCH_SIZE"));
+    }
+    assert(capacity > 0);
+
+    batch->vec = vec;
+    batch->ops = (hvr_dist_bitvec_batch_op_t *)malloc_helper(
+            capacity * sizeof(batch->ops[0]));
+    assert(batch->ops);
+    batch->n_ops = 0;
+    batch->capacity = capacity;
+}
+
+static void batch_append(hvr_dist_bitvec_size_t coord0,
+        hvr_dist_bitvec_size_t coord1, int is_set,
+        hvr_dist_bitvec_batch_t *batch) {
+    assert(coord0 < batch->vec->dim0);
+    assert(coord1 < batch->vec->dim1);
+
+    if (batch->n_ops == batch->capacity) {
+        hvr_dist_bitvec_batch_flush(batch);
+    }
+
+    hvr_dist_bitvec_batch_op_t *op = &batch->ops[batch->n_ops];
+    op->coord0 = coord0;
+    op->coord1 = coord1;
+    op->index = batch->n_ops;
+    op->is_set = is_set;
+    batch->n_ops++;
+}
+
+void hvr_dist_bitvec_batch_set(hvr_dist_bitvec_size_t coord0,
+        hvr_dist_bitvec_size_t coord1, hvr_dist_bitvec_batch_t *batch) {
+    batch_append(coord0, coord1, 1, batch);
+}
+
+void hvr_dist_bitvec_batch_clear(hvr_dist_bitvec_size_t coord0,
+        hvr_dist_bitvec_size_t coord1, hvr_dist_bitvec_batch_t *batch) {
+    batch_append(coord0, coord1, 0, batch);
+}
+
+// Orders by row, then word within the row, then position in the batch
+static int compare_batch_ops(const void *_a, const void *_b) {
+    const hvr_dist_bitvec_batch_op_t *a = (const hvr_dist_bitvec_batch_op_t *)_a;
+    const hvr_dist_bitvec_batch_op_t *b = (const hvr_dist_bitvec_batch_op_t *)_b;
+    if (a->coord0 != b->coord0) {
+        return (a->coord0 < b->coord0) ? -1 : 1;
+    }
+    const hvr_dist_bitvec_size_t a_word = a->coord1 / BITS_PER_ELE;
+    const hvr_dist_bitvec_size_t b_word = b->coord1 / BITS_PER_ELE;
+    if (a_word != b_word) {
+        return (a_word < b_word) ? -1 : 1;
+    }
+    return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+void hvr_dist_bitvec_batch_flush(hvr_dist_bitvec_batch_t *batch) {
+    if (batch->n_ops == 0) return;
+
+    hvr_dist_bitvec_t *vec = batch->vec;
+    hvr_dist_bitvec_batch_op_t *ops = batch->ops;
+    const unsigned n_ops = batch->n_ops;
+    qsort(ops, n_ops, sizeof(ops[0]), compare_batch_ops);
+
+    /*
+     * Rows are owned by contiguous ranges of PEs, so after sorting all
+     * operations bound for a given PE are adjacent. Fold the operations on
+     * each word into the bits to set and the bits to clear, and issue at most
+     * one atomic of each kind per word.
+     */
+    unsigned i = 0;
+    while (i < n_ops) {
+        const hvr_dist_bitvec_size_t coord0 = ops[i].coord0;
+        const hvr_dist_bitvec_size_t word = ops[i].coord1 / BITS_PER_ELE;
+        hvr_dist_bitvec_ele_t set_bits = 0;
+        hvr_dist_bitvec_ele_t clear_bits = 0;
+
+        while (i < n_ops && ops[i].coord0 == coord0 &&
+                ops[i].coord1 / BITS_PER_ELE == word) {
+            hvr_dist_bitvec_ele_t mask = (((hvr_dist_bitvec_ele_t)1) <<
+                    ((hvr_dist_bitvec_ele_t)(ops[i].coord1 % BITS_PER_ELE)));
+            if (ops[i].is_set) {
+                set_bits |= mask;
+                clear_bits &= ~mask;
+            } else {
+                clear_bits |= mask;
+                set_bits &= ~mask;
+            }
+            i++;
+        }
+
+        const int coord0_pe = coord0 / vec->dim0_per_pe;
+        hvr_dist_bitvec_ele_t *dst = vec->symm_vec +
+            ((coord0 % vec->dim0_per_pe) * vec->dim1_length_in_words) + word;
+        if (set_bits) {
+            shmem_uint64_atomic_or(dst, set_bits, coord0_pe);
+        }
+        if (clear_bits) {
+            shmem_uint64_atomic_and(dst, ~clear_bits, coord0_pe);
+        }
+    }
+
+    /*
+     * Make sure the bitvector updates land before any of the sequence number
+     * updates, so that a reader observing a new sequence number also observes
+     * the updated row.
+     */
+    shmem_fence();
+
+    for (i = 0; i < n_ops; i++) {
+        if (i > 0 && ops[i].coord0 == ops[i - 1].coord0) continue;
+        const hvr_dist_bitvec_size_t coord0 = ops[i].coord0;
+        shmem_uint64_atomic_inc(vec->seq_nos + (coord0 % vec->dim0_per_pe),
+                coord0 / vec->dim0_per_pe);
+    }
+
+    batch->n_ops = 0;
+}
+
+void hvr_dist_bitvec_batch_destroy(hvr_dist_bitvec_batch_t *batch) {
+    assert(batch->n_ops == 0);
+    free(batch->ops);
+}
+
 uint64_t hvr_dist_bitvec_get_seq_no(hvr_dist_bitvec_size_t coord0,
         hvr_dist_bitvec_t *vec) {
     assert(coord0 < vec->dim0);
@@ -125,6 +251,81 @@ void hvr_dist_bitvec_local_subcopy_init(hvr_dist_bitvec_t *vec,
     memset(out->subvec, 0x00,
             vec->dim1_length_in_words * sizeof(out->subvec[0]));
     out->seq_no = 0;
+    out->next_free = NULL;
+}
+
+void hvr_dist_bitvec_subcopy_pool_init(hvr_dist_bitvec_t *vec,
+        size_t slab_size, hvr_dist_bitvec_subcopy_pool_t *pool) {
+    if (getenv("HVR_DIST_BITVEC_SLAB_SIZE")) {
+        slab_size = atoi(getenv("HVR_DIST_BITVEC_SLAB_SIZE"));
+    }
+    assert(slab_size > 0);
+
+    pool->dim1 = vec->dim1;
+    pool->dim1_length_in_words = vec->dim1_length_in_words;
+    pool->free_list = NULL;
+    pool->slab_size = slab_size;
+    pool->n_allocated = 0;
+    pool->slabs = NULL;
+}
+
+hvr_dist_bitvec_local_subcopy_t *hvr_dist_bitvec_subcopy_pool_acquire(
+        hvr_dist_bitvec_subcopy_pool_t *pool) {
+    if (pool->free_list == NULL) {
+        /*
+         * Carve a new slab into subcopies, each followed by its backing data.
+         * Slabs are only returned to the system when the pool is destroyed.
+         */
+        const size_t words_bytes = pool->dim1_length_in_words *
+            sizeof(hvr_dist_bitvec_ele_t);
+        const size_t entry_bytes = sizeof(hvr_dist_bitvec_local_subcopy_t) +
+            words_bytes;
+        char *slab = (char *)malloc_helper(sizeof(void *) +
+                pool->slab_size * entry_bytes);
+        assert(slab);
+        *((void **)slab) = pool->slabs;
+        pool->slabs = slab;
+
+        char *entries = slab + sizeof(void *);
+        for (size_t i = 0; i < pool->slab_size; i++) {
+            hvr_dist_bitvec_local_subcopy_t *c =
+                (hvr_dist_bitvec_local_subcopy_t *)(entries + i * entry_bytes);
+            c->dim1 = pool->dim1;
+            c->dim1_length_in_words = pool->dim1_length_in_words;
+            c->subvec = (hvr_dist_bitvec_ele_t *)(c + 1);
+            c->next_free = pool->free_list;
+            pool->free_list = c;
+        }
+        pool->n_allocated += pool->slab_size;
+    }
+
+    hvr_dist_bitvec_local_subcopy_t *c = pool->free_list;
+    pool->free_list = c->next_free;
+    c->next_free = NULL;
+    c->coord0 = UINT64_MAX;
+    c->seq_no = 0;
+    memset(c->subvec, 0x00, c->dim1_length_in_words * sizeof(c->subvec[0]));
+    return c;
+}
+
+void hvr_dist_bitvec_subcopy_pool_release(hvr_dist_bitvec_local_subcopy_t *c,
+        hvr_dist_bitvec_subcopy_pool_t *pool) {
+    assert(c->dim1_length_in_words == pool->dim1_length_in_words);
+    c->next_free = pool->free_list;
+    pool->free_list = c;
+}
+
+void hvr_dist_bitvec_subcopy_pool_destroy(
+        hvr_dist_bitvec_subcopy_pool_t *pool) {
+    void *slab = pool->slabs;
+    while (slab) {
+        void *prev = *((void **)slab);
+        free(slab);
+        slab = prev;
+    }
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->n_allocated = 0;
 }
 
 void hvr_dist_bitvec_copy_locally(hvr_dist_bitvec_size_t coord0,
@@ -146,11 +347,132 @@ void hvr_dist_bitvec_copy_locally(hvr_dist_bitvec_size_t coord0,
             vec->dim1_length_in_words * sizeof(out->subvec[0]), coord0_pe);
 }
 
+typedef struct _row_request_t {
+    hvr_dist_bitvec_size_t coord0;
+    unsigned out_index;
+} row_request_t;
+
+static int compare_row_requests(const void *_a, const void *_b) {
+    const row_request_t *a = (const row_request_t *)_a;
+    const row_request_t *b = (const row_request_t *)_b;
+    if (a->coord0 != b->coord0) {
+        return (a->coord0 < b->coord0) ? -1 : 1;
+    }
+    return (a->out_index < b->out_index) ? -1 : (a->out_index > b->out_index);
+}
+
+// The rows read from one owning PE, from the lowest to the highest requested
+typedef struct _row_span_t {
+    int pe;
+    hvr_dist_bitvec_size_t first_offset;
+    hvr_dist_bitvec_size_t n_rows;
+    // Index of first_offset's row in the staging buffers
+    size_t staged;
+} row_span_t;
+
+static void get_seq_nos(const row_span_t *spans, unsigned n_spans,
+        uint64_t *out, hvr_dist_bitvec_t *vec) {
+    for (unsigned s = 0; s < n_spans; s++) {
+        shmem_getmem_nbi(out + spans[s].staged,
+                vec->seq_nos + spans[s].first_offset,
+                spans[s].n_rows * sizeof(out[0]), spans[s].pe);
+    }
+    shmem_quiet();
+}
+
+void hvr_dist_bitvec_copy_rows_locally(const hvr_dist_bitvec_size_t *coord0s,
+        unsigned n, hvr_dist_bitvec_t *vec,
+        hvr_dist_bitvec_local_subcopy_t **outs) {
+    if (n == 0) return;
+
+    /*
+     * Rows are owned by contiguous ranges of PEs, so sorting the requests by
+     * row groups them by owner.
+     */
+    row_request_t *reqs = (row_request_t *)malloc_helper(n * sizeof(reqs[0]));
+    row_span_t *spans = (row_span_t *)malloc_helper(n * sizeof(spans[0]));
+    assert(reqs && spans);
+    for (unsigned i = 0; i < n; i++) {
+        assert(coord0s[i] < vec->dim0);
+        assert(outs[i]->subvec);
+        reqs[i].coord0 = coord0s[i];
+        reqs[i].out_index = i;
+    }
+    qsort(reqs, n, sizeof(reqs[0]), compare_row_requests);
+
+    unsigned n_spans = 0;
+    size_t n_staged = 0;
+    for (unsigned i = 0; i < n; i++) {
+        const int pe = reqs[i].coord0 / vec->dim0_per_pe;
+        const hvr_dist_bitvec_size_t offset = reqs[i].coord0 %
+            vec->dim0_per_pe;
+        if (n_spans == 0 || spans[n_spans - 1].pe != pe) {
+            spans[n_spans].pe = pe;
+            spans[n_spans].first_offset = offset;
+            spans[n_spans].staged = n_staged;
+            n_spans++;
+        }
+        row_span_t *span = &spans[n_spans - 1];
+        span->n_rows = offset - span->first_offset + 1;
+        n_staged = span->staged + span->n_rows;
+    }
+
+    const size_t row_bytes = vec->dim1_length_in_words *
+        sizeof(hvr_dist_bitvec_ele_t);
+    hvr_dist_bitvec_ele_t *rows = (hvr_dist_bitvec_ele_t *)malloc_helper(
+            n_staged * row_bytes);
+    uint64_t *seq_nos = (uint64_t *)malloc_helper(
+            2 * n_staged * sizeof(seq_nos[0]));
+    assert(rows && seq_nos);
+    uint64_t *seq_nos_after = seq_nos + n_staged;
+
+    /*
+     * As in hvr_dist_bitvec_copy_locally, sequence numbers are read before
+     * their rows so that a copy is never considered newer than it is. Each
+     * step is a single get per owner, completed by one quiet. Owners update
+     * sequence numbers atomically, which these gets are not, so they are read
+     * again once the rows are in. A row whose sequence number moved in between
+     * is re-read on its own with an atomic fetch.
+     */
+    get_seq_nos(spans, n_spans, seq_nos, vec);
+    for (unsigned s = 0; s < n_spans; s++) {
+        shmem_getmem_nbi(rows + spans[s].staged * vec->dim1_length_in_words,
+                vec->symm_vec + spans[s].first_offset *
+                vec->dim1_length_in_words, spans[s].n_rows * row_bytes,
+                spans[s].pe);
+    }
+    shmem_quiet();
+    get_seq_nos(spans, n_spans, seq_nos_after, vec);
+
+    unsigned s = 0;
+    for (unsigned i = 0; i < n; i++) {
+        const int pe = reqs[i].coord0 / vec->dim0_per_pe;
+        while (spans[s].pe != pe) s++;
+        const size_t staged = spans[s].staged +
+            (reqs[i].coord0 % vec->dim0_per_pe) - spans[s].first_offset;
+
+        hvr_dist_bitvec_local_subcopy_t *out = outs[reqs[i].out_index];
+        if (seq_nos[staged] == seq_nos_after[staged]) {
+            out->coord0 = reqs[i].coord0;
+            out->seq_no = seq_nos[staged];
+            memcpy(out->subvec, rows + staged * vec->dim1_length_in_words,
+                    row_bytes);
+        } else {
+            hvr_dist_bitvec_copy_locally(reqs[i].coord0, vec, out);
+        }
+    }
+
+    free(rows);
+    free(seq_nos);
+    free(spans);
+    free(reqs);
+}
+
 int hvr_dist_bitvec_local_subcopy_contains(hvr_dist_bitvec_size_t coord1,
         hvr_dist_bitvec_local_subcopy_t *vec) {
     assert(coord1 < vec->dim1);
     const hvr_dist_bitvec_size_t coord1_word = coord1 / BITS_PER_ELE;
-    const hvr_dist_bitvec_size_t coord1_bit = coord1 % BITS_PER_WORD;
+    const hvr_dist_bitvec_size_t coord1_bit = coord1 % BITS_PER_ELE;
     hvr_dist_bitvec_size_t coord1_mask = ((uint64_t)1 << coord1_bit);
     if (vec->subvec[coord1_word] & coord1_mask) {
         return 1;
@@ -159,6 +481,20 @@ int hvr_dist_bitvec_local_subcopy_contains(hvr_dist_bitvec_size_t coord1,
     }
 }
 
+void hvr_dist_bitvec_local_subcopy_set(hvr_dist_bitvec_size_t coord1,
+        hvr_dist_bitvec_local_subcopy_t *vec) {
+    assert(coord1 < vec->dim1);
+    vec->subvec[coord1 / BITS_PER_ELE] |= ((uint64_t)1 <<
+            (coord1 % BITS_PER_ELE));
+}
+
+void hvr_dist_bitvec_local_subcopy_clear(hvr_dist_bitvec_size_t coord1,
+        hvr_dist_bitvec_local_subcopy_t *vec) {
+    assert(coord1 < vec->dim1);
+    vec->subvec[coord1 / BITS_PER_ELE] &= ~((uint64_t)1 <<
+            (coord1 % BITS_PER_ELE));
+}
+
 int hvr_dist_bitvec_owning_pe(hvr_dist_bitvec_size_t coord0,
         hvr_dist_bitvec_t *vec) {
     assert(coord0 < vec->dim0);
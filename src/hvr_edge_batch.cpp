@@ -0,0 +1,95 @@
+/* For license: see LICENSE.txt file at top-level */
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HVR_EDGE_BATCH_AVX2
+#endif
+
+#include "hvr_edge_batch.h"
+
+// Candidates [start, n_candidates) one at a time
+static void euclidean_edges_scalar(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned start,
+        unsigned n_candidates, unsigned ndims, double threshold2,
+        hvr_edge_type_t *out_edges) {
+    for (unsigned i = start; i < n_candidates; i++) {
+        double dist2 = 0.0;
+        for (unsigned f = 0; f < ndims; f++) {
+            const double delta = candidate_values[f][i] - target->values[f];
+            dist2 += delta * delta;
+        }
+        out_edges[i] = (dist2 <= threshold2) ? BIDIRECTIONAL : NO_EDGE;
+    }
+}
+
+#ifdef HVR_EDGE_BATCH_AVX2
+/*
+ * Four candidates at a time, returning how many candidates were handled. This
+ * is compiled for AVX2 regardless of the flags the library is built with, and
+ * must only be called once __builtin_cpu_supports("avx2") has been checked.
+ * Multiplies and adds are kept separate (rather than fused) so that results
+ * match the scalar loop exactly.
+ */
+__attribute__((target("avx2")))
+static unsigned euclidean_edges_avx2(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold2, hvr_edge_type_t *out_edges) {
+    const __m256d vthreshold2 = _mm256_set1_pd(threshold2);
+    unsigned i = 0;
+    for (; i + 4 <= n_candidates; i += 4) {
+        __m256d dist2 = _mm256_setzero_pd();
+        for (unsigned f = 0; f < ndims; f++) {
+            const __m256d delta = _mm256_sub_pd(
+                    _mm256_loadu_pd(candidate_values[f] + i),
+                    _mm256_set1_pd(target->values[f]));
+            dist2 = _mm256_add_pd(dist2, _mm256_mul_pd(delta, delta));
+        }
+        const int within = _mm256_movemask_pd(_mm256_cmp_pd(dist2,
+                    vthreshold2, _CMP_LE_OQ));
+        for (unsigned j = 0; j < 4; j++) {
+            out_edges[i + j] = ((within >> j) & 1) ? BIDIRECTIONAL : NO_EDGE;
+        }
+    }
+    return i;
+}
+
+static int cpu_has_avx2() {
+    static const int has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+void hvr_euclidean_edges_batch_scalar(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges) {
+    assert(ndims <= HVR_MAX_VECTOR_SIZE);
+    euclidean_edges_scalar(target, candidate_values, 0, n_candidates, ndims,
+            threshold * threshold, out_edges);
+}
+
+int hvr_euclidean_edges_batch_avx2(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges) {
+    assert(ndims <= HVR_MAX_VECTOR_SIZE);
+#ifdef HVR_EDGE_BATCH_AVX2
+    if (cpu_has_avx2()) {
+        const double threshold2 = threshold * threshold;
+        const unsigned n_vectorized = euclidean_edges_avx2(target,
+                candidate_values, n_candidates, ndims, threshold2, out_edges);
+        euclidean_edges_scalar(target, candidate_values, n_vectorized,
+                n_candidates, ndims, threshold2, out_edges);
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+void hvr_euclidean_edges_batch(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        unsigned ndims, double threshold, hvr_edge_type_t *out_edges) {
+    if (!hvr_euclidean_edges_batch_avx2(target, candidate_values,
+                n_candidates, ndims, threshold, out_edges)) {
+        hvr_euclidean_edges_batch_scalar(target, candidate_values,
+                n_candidates, ndims, threshold, out_edges);
+    }
+}
@@ -4,19 +4,27 @@
 
 #include "hvr_irregular_matrix.h"
 
+// Row entries use the vertex field of an edge info to store the payload
+static inline uint64_t construct_row_entry(hvr_edge_type_t e,
+        hvr_edge_create_type_t create_type, hvr_edge_payload_t payload) {
+    return construct_edge_info(payload, e, create_type);
+}
+
+#define ROW_ENTRY_PAYLOAD(entry) ((hvr_edge_payload_t)(entry))
+
 void hvr_irr_matrix_init(size_t nvertices, size_t pool_size,
         hvr_irr_matrix_t *m) {
-    m->edges = (struct hvr_avl_node **)malloc_helper(
+    m->edges = (hvr_ordered_set_node_t **)malloc_helper(
             nvertices * sizeof(m->edges[0]));
     assert(m->edges);
     for (size_t i = 0; i < nvertices; i++) {
-        m->edges[i] = nnil;
+        m->edges[i] = NULL;
     }
 
     m->nvertices = nvertices;
     m->nedges = 0;
 
-    hvr_avl_node_allocator_init(&m->allocator, pool_size,
+    hvr_ordered_set_allocator_init(&m->allocator, pool_size,
             "HVR_EDGES_POOL_SIZE");
 }
 
@@ -24,56 +32,108 @@ void hvr_irr_matrix_get(const hvr_vertex_id_t i,
         const hvr_vertex_id_t j, const hvr_irr_matrix_t *m,
         hvr_edge_type_t *out_edge_type,
         hvr_edge_create_type_t *out_creation_type) {
-    struct hvr_avl_node *root = m->edges[i];
-    struct hvr_avl_node *found = hvr_avl_find(root, j);
-    if (found != nnil) {
-        *out_edge_type = EDGE_INFO_EDGE(found->value);
-        *out_creation_type = EDGE_INFO_CREATION(found->value);
+    uint64_t *found = hvr_ordered_set_find(m->edges[i], j);
+    if (found) {
+        *out_edge_type = EDGE_INFO_EDGE(*found);
+        *out_creation_type = EDGE_INFO_CREATION(*found);
     } else {
         *out_edge_type = NO_EDGE;
     }
 }
 
+hvr_edge_payload_t hvr_irr_matrix_get_payload(hvr_vertex_id_t i,
+        hvr_vertex_id_t j, const hvr_irr_matrix_t *m) {
+    uint64_t *found = hvr_ordered_set_find(m->edges[i], j);
+    return (found ? ROW_ENTRY_PAYLOAD(*found) : 0);
+}
+
 void hvr_irr_matrix_set(hvr_vertex_id_t i, hvr_vertex_id_t j, hvr_edge_type_t e,
         hvr_edge_create_type_t create_type, hvr_irr_matrix_t *m,
         int known_no_edge) {
-    struct hvr_avl_node *root = m->edges[i];
-    struct hvr_avl_node *found = hvr_avl_find(root, j);
-    if (found == nnil) {
+    uint64_t *found = hvr_ordered_set_find(m->edges[i], j);
+    hvr_edge_payload_t payload = (found ? ROW_ENTRY_PAYLOAD(*found) : 0);
+    hvr_irr_matrix_set_with_payload(i, j, e, create_type, payload, m,
+            known_no_edge);
+}
+
+void hvr_irr_matrix_set_with_payload(hvr_vertex_id_t i, hvr_vertex_id_t j,
+        hvr_edge_type_t e, hvr_edge_create_type_t create_type,
+        hvr_edge_payload_t payload, hvr_irr_matrix_t *m, int known_no_edge) {
+    uint64_t *found = hvr_ordered_set_find(m->edges[i], j);
+    if (found == NULL) {
         if (e == NO_EDGE) return;
 
-        hvr_avl_insert(&(m->edges[i]), j,
-                construct_edge_info(j, e, create_type), &m->allocator);
+        hvr_ordered_set_insert(&(m->edges[i]), j,
+                construct_row_entry(e, create_type, payload), &m->allocator);
         m->nedges += 1;
     } else {
         if (e == NO_EDGE) {
-            hvr_avl_delete(&(m->edges[i]), j, &m->allocator);
+            hvr_ordered_set_delete(&(m->edges[i]), j, &m->allocator);
             m->nedges -= 1;
         } else {
-            found->value = construct_edge_info(j, e, create_type);
+            *found = construct_row_entry(e, create_type, payload);
         }
     }
 }
 
 unsigned hvr_irr_matrix_row_len(hvr_vertex_id_t i, hvr_irr_matrix_t *m) {
-    return hvr_avl_size(m->edges[i]);
+    return hvr_ordered_set_size(m->edges[i]);
 }
 
-struct hvr_avl_node *hvr_irr_matrix_tree(hvr_vertex_id_t i,
+hvr_ordered_set_node_t *hvr_irr_matrix_tree(hvr_vertex_id_t i,
         hvr_irr_matrix_t *m) {
     return m->edges[i];
 }
 
 unsigned hvr_irr_matrix_linearize(hvr_vertex_id_t i,
         hvr_vertex_id_t *out_vals, size_t capacity, hvr_irr_matrix_t *m) {
-    return hvr_avl_serialize(m->edges[i], out_vals, capacity);
+    return hvr_irr_matrix_linearize_with_payloads(i, out_vals, NULL, capacity,
+            m);
+}
+
+unsigned hvr_irr_matrix_linearize_with_payloads(hvr_vertex_id_t i,
+        hvr_vertex_id_t *out_vals, hvr_edge_payload_t *out_payloads,
+        size_t capacity, hvr_irr_matrix_t *m) {
+    hvr_ordered_set_iter_t iter;
+    hvr_ordered_set_iter_init(&iter, m->edges[i]);
+
+    unsigned count = 0;
+    uint32_t neighbor;
+    uint64_t entry;
+    while (hvr_ordered_set_iter_next(&iter, &neighbor, &entry)) {
+        assert(count < capacity);
+        out_vals[count] = construct_edge_info(neighbor, EDGE_INFO_EDGE(entry),
+                EDGE_INFO_CREATION(entry));
+        if (out_payloads) {
+            out_payloads[count] = ROW_ENTRY_PAYLOAD(entry);
+        }
+        count++;
+    }
+    return count;
+}
+
+unsigned hvr_irr_matrix_linearize_from(hvr_vertex_id_t i,
+        hvr_vertex_id_t start, hvr_vertex_id_t *out_vals, size_t capacity,
+        hvr_irr_matrix_t *m) {
+    hvr_ordered_set_iter_t iter;
+    hvr_ordered_set_iter_init_from(&iter, m->edges[i], start);
+
+    unsigned count = 0;
+    uint32_t neighbor;
+    uint64_t entry;
+    while (count < capacity &&
+            hvr_ordered_set_iter_next(&iter, &neighbor, &entry)) {
+        out_vals[count++] = construct_edge_info(neighbor,
+                EDGE_INFO_EDGE(entry), EDGE_INFO_CREATION(entry));
+    }
+    return count;
 }
 
 void hvr_irr_matrix_usage(size_t *out_bytes_allocated, size_t *out_bytes_used,
         size_t *out_max_edges, size_t *out_max_edges_index,
         hvr_irr_matrix_t *m) {
     size_t allocator_used, allocator_allocated;
-    hvr_avl_node_allocator_bytes_usage(&m->allocator, &allocator_allocated,
+    hvr_ordered_set_allocator_bytes_usage(&m->allocator, &allocator_allocated,
             &allocator_used);
 
     *out_bytes_allocated = m->nvertices * sizeof(m->edges[0]) +
@@ -322,6 +322,19 @@ int hvr_mailbox_recv(void *msg, size_t msg_capacity, size_t *msg_len,
     return 1;
 }
 
+int hvr_mailbox_is_empty(hvr_mailbox_t *mailbox) {
+    uint32_t read_index, write_index;
+    unpack_indices(mailbox->indices_curr_val, &read_index, &write_index);
+    if (used_bytes(read_index, write_index, mailbox) > 0) {
+        return 0;
+    }
+
+    const uint64_t indices = shmem_uint64_atomic_fetch(mailbox->indices,
+            mailbox->pe);
+    unpack_indices(indices, &read_index, &write_index);
+    return used_bytes(read_index, write_index, mailbox) == 0;
+}
+
 void hvr_mailbox_destroy(hvr_mailbox_t *mailbox) {
     shmem_free(mailbox->indices);
     shmem_free(mailbox->buf);
@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hvr_ordered_set.h"
+#include "hvr_common.h"
+
+typedef hvr_ordered_set_node_t node_t;
+
+static const size_t class_bytes[HVR_ORDERED_SET_N_CLASSES] = {32, 64, 128,
+    256};
+#define FULL_CLASS (HVR_ORDERED_SET_N_CLASSES - 1)
+#define FANOUT HVR_ORDERED_SET_FANOUT
+
+static_assert(sizeof(node_t) + FANOUT * sizeof(uint32_t) <= 64,
+        "A full node's header and keys must fit in one cache line");
+
+// Memory reserved per pool_size unit, matching sizeof(struct hvr_avl_node)
+#define BYTES_PER_POOL_ENTRY 32
+
+static inline unsigned class_capacity(unsigned size_class) {
+    return (size_class == FULL_CLASS ? FANOUT : 2U << size_class);
+}
+
+static inline unsigned node_capacity(const node_t *n) {
+    return class_capacity(n->size_class);
+}
+
+static inline uint32_t *node_keys(const node_t *n) {
+    return (uint32_t *)(n + 1);
+}
+
+// Only valid for leaves
+static inline uint64_t *node_vals(const node_t *n) {
+    return (uint64_t *)(node_keys(n) + node_capacity(n));
+}
+
+// Only valid for inner nodes, which are always full-sized
+static inline node_t **node_kids(const node_t *n) {
+    return (node_t **)(node_keys(n) + FANOUT);
+}
+
+/*
+ * Keys within a node are searched with a branch-free linear scan, which is
+ * cheaper than a binary search at these node sizes.
+ */
+static inline unsigned inner_child_index(const node_t *n, uint32_t key) {
+    const uint32_t *keys = node_keys(n);
+    const unsigned nkeys = n->nkeys;
+    unsigned count = 0;
+    for (unsigned i = 0; i < nkeys; i++) {
+        count += (keys[i] <= key);
+    }
+    return count;
+}
+
+static inline unsigned leaf_lower_bound(const node_t *n, uint32_t key) {
+    const uint32_t *keys = node_keys(n);
+    const unsigned nkeys = n->nkeys;
+    unsigned count = 0;
+    for (unsigned i = 0; i < nkeys; i++) {
+        count += (keys[i] < key);
+    }
+    return count;
+}
+
+typedef struct _hvr_ordered_set_free_block_t {
+    struct _hvr_ordered_set_free_block_t *next;
+    struct _hvr_ordered_set_free_block_t *prev;
+} free_block_t;
+
+#define MIN_BLOCK_BYTES (class_bytes[0])
+#define MAX_BLOCK_BYTES (class_bytes[FULL_CLASS])
+
+static void push_free_block(size_t offset, unsigned size_class,
+        hvr_ordered_set_allocator_t *allocator) {
+    free_block_t *b = (free_block_t *)(allocator->mem + offset);
+    b->prev = NULL;
+    b->next = allocator->free_lists[size_class];
+    if (b->next) {
+        b->next->prev = b;
+    }
+    allocator->free_lists[size_class] = b;
+    allocator->block_state[offset / MIN_BLOCK_BYTES] = size_class + 1;
+}
+
+static void unlink_free_block(size_t offset, unsigned size_class,
+        hvr_ordered_set_allocator_t *allocator) {
+    free_block_t *b = (free_block_t *)(allocator->mem + offset);
+    if (b->prev) {
+        b->prev->next = b->next;
+    } else {
+        allocator->free_lists[size_class] = b->next;
+    }
+    if (b->next) {
+        b->next->prev = b->prev;
+    }
+    allocator->block_state[offset / MIN_BLOCK_BYTES] = 0;
+}
+
+static node_t *alloc_node(unsigned size_class, int is_leaf,
+        hvr_ordered_set_allocator_t *allocator) {
+    // Take the smallest free block that is large enough
+    unsigned c = size_class;
+    while (c < HVR_ORDERED_SET_N_CLASSES && allocator->free_lists[c] == NULL) {
+        c++;
+    }
+
+    size_t offset;
+    if (c < HVR_ORDERED_SET_N_CLASSES) {
+        offset = (char *)allocator->free_lists[c] - allocator->mem;
+        unlink_free_block(offset, c, allocator);
+    } else {
+        if (allocator->bump + MAX_BLOCK_BYTES > allocator->mem_size) {
+            fprintf(stderr, "ERROR failed allocating ordered set node. "
+                    "Increase %s (%lu).\n", allocator->envvar,
+                    allocator->pool_size);
+            abort();
+        }
+        offset = allocator->bump;
+        allocator->bump += MAX_BLOCK_BYTES;
+        c = FULL_CLASS;
+    }
+
+    // Split the block down to size, freeing the upper half each time
+    while (c > size_class) {
+        c--;
+        push_free_block(offset + class_bytes[c], c, allocator);
+    }
+    allocator->n_reserved_bytes += class_bytes[size_class];
+
+    node_t *n = (node_t *)(allocator->mem + offset);
+    n->nkeys = 0;
+    n->is_leaf = is_leaf;
+    n->size_class = size_class;
+    n->set_size = 0;
+    return n;
+}
+
+static void free_node(node_t *n, hvr_ordered_set_allocator_t *allocator) {
+    unsigned c = n->size_class;
+    size_t offset = (char *)n - allocator->mem;
+    allocator->n_reserved_bytes -= class_bytes[c];
+
+    // Merge with the buddy block for as long as it is free and the same size
+    while (c < FULL_CLASS) {
+        const size_t buddy = offset ^ class_bytes[c];
+        if (allocator->block_state[buddy / MIN_BLOCK_BYTES] != c + 1) {
+            break;
+        }
+        unlink_free_block(buddy, c, allocator);
+        offset &= ~class_bytes[c];
+        c++;
+    }
+    push_free_block(offset, c, allocator);
+}
+
+static inline void leaf_insert_at(node_t *n, unsigned pos, uint32_t key,
+        uint64_t value) {
+    uint32_t *keys = node_keys(n);
+    uint64_t *vals = node_vals(n);
+    assert(n->nkeys < node_capacity(n));
+    memmove(keys + pos + 1, keys + pos, (n->nkeys - pos) * sizeof(*keys));
+    memmove(vals + pos + 1, vals + pos, (n->nkeys - pos) * sizeof(*vals));
+    keys[pos] = key;
+    vals[pos] = value;
+    n->nkeys += 1;
+}
+
+static inline void leaf_remove_at(node_t *n, unsigned pos) {
+    uint32_t *keys = node_keys(n);
+    uint64_t *vals = node_vals(n);
+    memmove(keys + pos, keys + pos + 1, (n->nkeys - pos - 1) * sizeof(*keys));
+    memmove(vals + pos, vals + pos + 1, (n->nkeys - pos - 1) * sizeof(*vals));
+    n->nkeys -= 1;
+}
+
+// Move a leaf into a new node of a different size class
+static node_t *resize_leaf(node_t *n, unsigned size_class,
+        hvr_ordered_set_allocator_t *allocator) {
+    assert(n->nkeys <= class_capacity(size_class));
+    node_t *resized = alloc_node(size_class, 1, allocator);
+    memcpy(node_keys(resized), node_keys(n), n->nkeys * sizeof(uint32_t));
+    memcpy(node_vals(resized), node_vals(n), n->nkeys * sizeof(uint64_t));
+    resized->nkeys = n->nkeys;
+    free_node(n, allocator);
+    return resized;
+}
+
+/*
+ * Insert separator key sep and its right child at child index i of an inner
+ * node that has room for them.
+ */
+static inline void inner_insert_at(node_t *n, unsigned i, uint32_t sep,
+        node_t *right) {
+    uint32_t *keys = node_keys(n);
+    node_t **kids = node_kids(n);
+    assert(n->nkeys < FANOUT);
+    memmove(keys + i + 1, keys + i, (n->nkeys - i) * sizeof(*keys));
+    memmove(kids + i + 2, kids + i + 1, (n->nkeys - i) * sizeof(*kids));
+    keys[i] = sep;
+    kids[i + 1] = right;
+    n->nkeys += 1;
+}
+
+// Remove child i, along with one of the separators adjacent to it
+static inline void inner_remove_kid(node_t *n, unsigned i) {
+    uint32_t *keys = node_keys(n);
+    node_t **kids = node_kids(n);
+    assert(n->nkeys > 0);
+    const unsigned key_index = (i > 0 ? i - 1 : 0);
+    memmove(keys + key_index, keys + key_index + 1,
+            (n->nkeys - key_index - 1) * sizeof(*keys));
+    memmove(kids + i, kids + i + 1, (n->nkeys - i) * sizeof(*kids));
+    n->nkeys -= 1;
+}
+
+int hvr_ordered_set_insert(node_t **rootp, uint32_t key, uint64_t value,
+        hvr_ordered_set_allocator_t *allocator) {
+    node_t *root = *rootp;
+    if (root == NULL) {
+        root = alloc_node(0, 1, allocator);
+        node_keys(root)[0] = key;
+        node_vals(root)[0] = value;
+        root->nkeys = 1;
+        root->set_size = 1;
+        *rootp = root;
+        return 1;
+    }
+
+    node_t *path[HVR_ORDERED_SET_MAX_DEPTH];
+    unsigned path_index[HVR_ORDERED_SET_MAX_DEPTH];
+    int depth = 0;
+
+    node_t *leaf = root;
+    while (!leaf->is_leaf) {
+        assert(depth < HVR_ORDERED_SET_MAX_DEPTH);
+        const unsigned i = inner_child_index(leaf, key);
+        path[depth] = leaf;
+        path_index[depth] = i;
+        depth++;
+        leaf = node_kids(leaf)[i];
+    }
+
+    const unsigned pos = leaf_lower_bound(leaf, key);
+    if (pos < leaf->nkeys && node_keys(leaf)[pos] == key) {
+        // Duplicate key
+        return 0;
+    }
+
+    const uint32_t set_size = root->set_size + 1;
+
+    if (leaf->nkeys < node_capacity(leaf)) {
+        leaf_insert_at(leaf, pos, key, value);
+    } else if (leaf->size_class != FULL_CLASS) {
+        // Only a root leaf can be smaller than a full node
+        assert(leaf == root);
+        root = resize_leaf(leaf, leaf->size_class + 1, allocator);
+        leaf_insert_at(root, pos, key, value);
+    } else {
+        // Split a full leaf in half, then propagate the split upwards
+        const unsigned half = FANOUT / 2;
+        node_t *right = alloc_node(FULL_CLASS, 1, allocator);
+        memcpy(node_keys(right), node_keys(leaf) + half,
+                (FANOUT - half) * sizeof(uint32_t));
+        memcpy(node_vals(right), node_vals(leaf) + half,
+                (FANOUT - half) * sizeof(uint64_t));
+        right->nkeys = FANOUT - half;
+        leaf->nkeys = half;
+        if (pos <= half) {
+            leaf_insert_at(leaf, pos, key, value);
+        } else {
+            leaf_insert_at(right, pos - half, key, value);
+        }
+
+        uint32_t sep = node_keys(right)[0];
+        node_t *new_kid = right;
+        while (new_kid) {
+            if (depth == 0) {
+                node_t *new_root = alloc_node(FULL_CLASS, 0, allocator);
+                node_keys(new_root)[0] = sep;
+                node_kids(new_root)[0] = root;
+                node_kids(new_root)[1] = new_kid;
+                new_root->nkeys = 1;
+                root = new_root;
+                break;
+            }
+
+            depth--;
+            node_t *parent = path[depth];
+            const unsigned i = path_index[depth];
+            if (parent->nkeys < FANOUT) {
+                inner_insert_at(parent, i, sep, new_kid);
+                new_kid = NULL;
+            } else {
+                uint32_t keys[FANOUT + 1];
+                node_t *kids[FANOUT + 2];
+                memcpy(keys, node_keys(parent), i * sizeof(*keys));
+                keys[i] = sep;
+                memcpy(keys + i + 1, node_keys(parent) + i,
+                        (FANOUT - i) * sizeof(*keys));
+                memcpy(kids, node_kids(parent), (i + 1) * sizeof(*kids));
+                kids[i + 1] = new_kid;
+                memcpy(kids + i + 2, node_kids(parent) + i + 1,
+                        (FANOUT - i) * sizeof(*kids));
+
+                // Keep keys[mid] as the separator between the two halves
+                const unsigned mid = (FANOUT + 1) / 2;
+                node_t *right_inner = alloc_node(FULL_CLASS, 0, allocator);
+                memcpy(node_keys(parent), keys, mid * sizeof(*keys));
+                memcpy(node_kids(parent), kids, (mid + 1) * sizeof(*kids));
+                parent->nkeys = mid;
+                memcpy(node_keys(right_inner), keys + mid + 1,
+                        (FANOUT - mid) * sizeof(*keys));
+                memcpy(node_kids(right_inner), kids + mid + 1,
+                        (FANOUT - mid + 1) * sizeof(*kids));
+                right_inner->nkeys = FANOUT - mid;
+
+                sep = keys[mid];
+                new_kid = right_inner;
+            }
+        }
+    }
+
+    root->set_size = set_size;
+    *rootp = root;
+    return 1;
+}
+
+int hvr_ordered_set_delete(node_t **rootp, uint32_t key,
+        hvr_ordered_set_allocator_t *allocator) {
+    node_t *root = *rootp;
+    if (root == NULL) return 0;
+
+    node_t *path[HVR_ORDERED_SET_MAX_DEPTH];
+    unsigned path_index[HVR_ORDERED_SET_MAX_DEPTH];
+    int depth = 0;
+
+    node_t *leaf = root;
+    while (!leaf->is_leaf) {
+        assert(depth < HVR_ORDERED_SET_MAX_DEPTH);
+        const unsigned i = inner_child_index(leaf, key);
+        path[depth] = leaf;
+        path_index[depth] = i;
+        depth++;
+        leaf = node_kids(leaf)[i];
+    }
+
+    const unsigned pos = leaf_lower_bound(leaf, key);
+    if (pos >= leaf->nkeys || node_keys(leaf)[pos] != key) {
+        // Not found
+        return 0;
+    }
+
+    const uint32_t set_size = root->set_size - 1;
+    leaf_remove_at(leaf, pos);
+
+    if (set_size == 0) {
+        hvr_ordered_set_delete_all(root, allocator);
+        *rootp = NULL;
+        return 1;
+    }
+
+    // Free empty nodes from the bottom up
+    node_t *empty = (leaf->nkeys == 0 ? leaf : NULL);
+    while (empty) {
+        assert(depth > 0);
+        free_node(empty, allocator);
+        depth--;
+        node_t *parent = path[depth];
+        if (parent->nkeys == 0) {
+            // parent's only child was empty
+            empty = parent;
+        } else {
+            inner_remove_kid(parent, path_index[depth]);
+            empty = NULL;
+        }
+    }
+
+    // Collapse roots with a single child
+    while (!root->is_leaf && root->nkeys == 0) {
+        node_t *kid = node_kids(root)[0];
+        free_node(root, allocator);
+        root = kid;
+    }
+
+    // Shrink small root leaves back into smaller size classes
+    if (root->is_leaf && root->size_class > 0 &&
+            root->nkeys <= node_capacity(root) / 4) {
+        root = resize_leaf(root, root->size_class - 1, allocator);
+    }
+
+    root->set_size = set_size;
+    *rootp = root;
+    return 1;
+}
+
+void hvr_ordered_set_delete_all(node_t *root,
+        hvr_ordered_set_allocator_t *allocator) {
+    if (root == NULL) return;
+
+    node_t *stack[HVR_ORDERED_SET_MAX_DEPTH * (FANOUT + 1)];
+    int stack_size = 0;
+    stack[stack_size++] = root;
+    while (stack_size > 0) {
+        node_t *n = stack[--stack_size];
+        if (!n->is_leaf) {
+            for (unsigned i = 0; i <= n->nkeys; i++) {
+                assert(stack_size < HVR_ORDERED_SET_MAX_DEPTH * (FANOUT + 1));
+                stack[stack_size++] = node_kids(n)[i];
+            }
+        }
+        free_node(n, allocator);
+    }
+}
+
+uint64_t *hvr_ordered_set_find(const node_t *root, uint32_t key) {
+    if (root == NULL) return NULL;
+
+    while (!root->is_leaf) {
+        root = node_kids(root)[inner_child_index(root, key)];
+    }
+
+    const unsigned pos = leaf_lower_bound(root, key);
+    if (pos < root->nkeys && node_keys(root)[pos] == key) {
+        return node_vals(root) + pos;
+    }
+    return NULL;
+}
+
+unsigned hvr_ordered_set_serialize(const node_t *root, uint64_t *values,
+        unsigned arr_capacity) {
+    hvr_ordered_set_iter_t iter;
+    hvr_ordered_set_iter_init(&iter, root);
+
+    unsigned index = 0;
+    uint64_t value;
+    while (hvr_ordered_set_iter_next(&iter, NULL, &value)) {
+        assert(index < arr_capacity);
+        values[index++] = value;
+    }
+    return index;
+}
+
+unsigned hvr_ordered_set_size(const node_t *root) {
+    return (root ? root->set_size : 0);
+}
+
+void hvr_ordered_set_iter_init(hvr_ordered_set_iter_t *iter,
+        const node_t *root) {
+    iter->depth = 0;
+    if (root) {
+        iter->nodes[0] = (node_t *)root;
+        iter->pos[0] = 0;
+        iter->depth = 1;
+    }
+}
+
+void hvr_ordered_set_iter_init_from(hvr_ordered_set_iter_t *iter,
+        const node_t *root, uint32_t start_key) {
+    iter->depth = 0;
+    if (root == NULL) return;
+
+    node_t *n = (node_t *)root;
+    while (!n->is_leaf) {
+        assert(iter->depth < HVR_ORDERED_SET_MAX_DEPTH);
+        const unsigned child = inner_child_index(n, start_key);
+        iter->nodes[iter->depth] = n;
+        iter->pos[iter->depth] = child + 1;
+        iter->depth++;
+        n = node_kids(n)[child];
+    }
+    assert(iter->depth < HVR_ORDERED_SET_MAX_DEPTH);
+    iter->nodes[iter->depth] = n;
+    iter->pos[iter->depth] = leaf_lower_bound(n, start_key);
+    iter->depth++;
+}
+
+int hvr_ordered_set_iter_next(hvr_ordered_set_iter_t *iter,
+        uint32_t *out_key, uint64_t *out_value) {
+    while (iter->depth > 0) {
+        const int top = iter->depth - 1;
+        node_t *n = iter->nodes[top];
+        const unsigned p = iter->pos[top];
+
+        if (n->is_leaf) {
+            if (p < n->nkeys) {
+                if (out_key) *out_key = node_keys(n)[p];
+                if (out_value) *out_value = node_vals(n)[p];
+                iter->pos[top] = p + 1;
+                return 1;
+            }
+            iter->depth--;
+        } else if (p <= n->nkeys) {
+            // For inner nodes, pos is the index of the next child to visit
+            assert(iter->depth < HVR_ORDERED_SET_MAX_DEPTH);
+            iter->pos[top] = p + 1;
+            iter->nodes[iter->depth] = node_kids(n)[p];
+            iter->pos[iter->depth] = 0;
+            iter->depth++;
+        } else {
+            iter->depth--;
+        }
+    }
+    return 0;
+}
+
+void hvr_ordered_set_allocator_init(hvr_ordered_set_allocator_t *allocator,
+        size_t pool_size, const char *envvar) {
+    const size_t mem_size = pool_size * BYTES_PER_POOL_ENTRY;
+    char *mem = (char *)malloc_helper(mem_size + 64);
+    assert(mem);
+
+    // Align the start of the pool to a cache line
+    allocator->mem = (char *)(((uintptr_t)mem + 63) & ~((uintptr_t)63));
+    allocator->mem_size = mem_size;
+    allocator->bump = 0;
+    for (unsigned c = 0; c < HVR_ORDERED_SET_N_CLASSES; c++) {
+        allocator->free_lists[c] = NULL;
+    }
+    allocator->block_state = (uint8_t *)malloc_helper(
+            mem_size / MIN_BLOCK_BYTES);
+    assert(allocator->block_state);
+    memset(allocator->block_state, 0x00, mem_size / MIN_BLOCK_BYTES);
+    allocator->n_reserved_bytes = 0;
+    allocator->pool_size = pool_size;
+
+    allocator->envvar = (char *)malloc(strlen(envvar) + 1);
+    memcpy(allocator->envvar, envvar, strlen(envvar) + 1);
+}
+
+void hvr_ordered_set_allocator_bytes_usage(
+        hvr_ordered_set_allocator_t *allocator, size_t *out_allocated,
+        size_t *out_used) {
+    *out_allocated = allocator->mem_size;
+    *out_used = allocator->n_reserved_bytes;
+}
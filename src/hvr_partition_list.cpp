@@ -1,11 +1,23 @@
 #include "hvr_map.h"
 #include "hvr_partition_list.h"
 
+#include <math.h>
+#include <string.h>
+
 static const char *segs_var_name = "HVR_PARTITION_LIST_SEGS";
+static const char *grid_segs_var_name = "HVR_PARTITION_GRID_SEGS";
+static const char *children_segs_var_name = "HVR_PARTITION_CHILDREN_SEGS";
+
+#define PARTITION_FLAT 0
+#define PARTITION_SPLIT_CANDIDATE 1
+#define PARTITION_SPLIT 2
 
 void hvr_partition_list_init(hvr_partition_t n_partitions,
-        hvr_partition_list_t *l) {
+        int track_distances, hvr_partition_list_t *l) {
     l->n_partitions = n_partitions;
+    l->track_distances = track_distances;
+    l->has_grid = 0;
+    l->has_children = 0;
     int segs = 1024;
     if (getenv(segs_var_name)) {
         segs = atoi(getenv(segs_var_name));
@@ -13,8 +25,252 @@ void hvr_partition_list_init(hvr_partition_t n_partitions,
     hvr_map_init(&l->map, segs, segs_var_name);
 }
 
+void hvr_partition_list_enable_grid(hvr_partition_list_t *l) {
+    int segs = 1024;
+    if (getenv(grid_segs_var_name)) {
+        segs = atoi(getenv(grid_segs_var_name));
+    }
+    hvr_map_init(&l->grid, segs, grid_segs_var_name);
+    l->has_grid = 1;
+}
+
+void hvr_partition_list_enable_children(unsigned n_children,
+        hvr_partition_list_t *l) {
+    assert(n_children > 1);
+    int segs = 1024;
+    if (getenv(children_segs_var_name)) {
+        segs = atoi(getenv(children_segs_var_name));
+    }
+    hvr_map_init(&l->children, segs, children_segs_var_name);
+
+    l->split_threshold = 1024;
+    if (getenv("HVR_PARTITION_SPLIT_THRESHOLD")) {
+        l->split_threshold = atoi(getenv("HVR_PARTITION_SPLIT_THRESHOLD"));
+    }
+    l->merge_threshold = l->split_threshold / 4;
+    if (getenv("HVR_PARTITION_MERGE_THRESHOLD")) {
+        l->merge_threshold = atoi(getenv("HVR_PARTITION_MERGE_THRESHOLD"));
+    }
+    assert(l->merge_threshold < l->split_threshold);
+
+    l->counts = (unsigned *)malloc_helper(
+            l->n_partitions * sizeof(l->counts[0]));
+    l->traffic = (unsigned *)malloc_helper(
+            l->n_partitions * sizeof(l->traffic[0]));
+    l->split_state = (uint8_t *)malloc_helper(
+            l->n_partitions * sizeof(l->split_state[0]));
+    l->refine_list = (hvr_partition_t *)malloc_helper(
+            l->n_partitions * sizeof(l->refine_list[0]));
+    assert(l->counts && l->traffic && l->split_state && l->refine_list);
+    memset(l->counts, 0x00, l->n_partitions * sizeof(l->counts[0]));
+    memset(l->traffic, 0x00, l->n_partitions * sizeof(l->traffic[0]));
+    memset(l->split_state, PARTITION_FLAT,
+            l->n_partitions * sizeof(l->split_state[0]));
+    l->n_refine_list = 0;
+
+    l->n_children = n_children;
+    l->has_children = 1;
+}
+
 void hvr_partition_list_destroy(hvr_partition_list_t *l) {
     hvr_map_destroy(&l->map);
+    if (l->has_grid) {
+        hvr_map_destroy(&l->grid);
+    }
+    if (l->has_children) {
+        hvr_map_destroy(&l->children);
+        free(l->counts);
+        free(l->traffic);
+        free(l->split_state);
+        free(l->refine_list);
+    }
+}
+
+static inline uint64_t child_key(hvr_partition_t partition, unsigned child,
+        hvr_partition_list_t *l) {
+    return (uint64_t)partition * l->n_children + child;
+}
+
+static void child_insert(hvr_vertex_t *vert, hvr_partition_t partition,
+        hvr_partition_list_t *l, hvr_internal_ctx_t *ctx) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    node->child = ctx->child_partition(vert, partition, ctx);
+    assert(node->child < l->n_children);
+
+    const uint64_t key = child_key(partition, node->child, l);
+    hvr_vertex_cache_node_t *head = (hvr_vertex_cache_node_t *)hvr_map_get(
+            key, &l->children);
+    node->prev_in_child = NULL;
+    node->next_in_child = head;
+    if (head) {
+        head->prev_in_child = node;
+    }
+    hvr_map_add(key, node, 1, &l->children);
+}
+
+static void child_remove(const hvr_vertex_t *vert, hvr_partition_t partition,
+        hvr_partition_list_t *l) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    const uint64_t key = child_key(partition, node->child, l);
+    if (node->prev_in_child) {
+        node->prev_in_child->next_in_child = node->next_in_child;
+    } else if (node->next_in_child) {
+        hvr_map_add(key, node->next_in_child, 1, &l->children);
+    } else {
+        hvr_map_remove(key, node, &l->children);
+    }
+
+    if (node->next_in_child) {
+        node->next_in_child->prev_in_child = node->prev_in_child;
+    }
+    node->next_in_child = NULL;
+    node->prev_in_child = NULL;
+}
+
+int hvr_partition_list_is_split(hvr_partition_t part,
+        hvr_partition_list_t *l) {
+    return l->has_children && l->split_state[part] == PARTITION_SPLIT;
+}
+
+hvr_vertex_cache_node_t *hvr_partition_list_child_head(hvr_partition_t part,
+        unsigned child, hvr_partition_list_t *l) {
+    return (hvr_vertex_cache_node_t *)hvr_map_get(child_key(part, child, l),
+            &l->children);
+}
+
+void hvr_partition_list_note_scan(hvr_partition_t part, unsigned n_scanned,
+        hvr_partition_list_t *l) {
+    l->traffic[part] += n_scanned;
+    if (l->split_state[part] == PARTITION_FLAT &&
+            l->counts[part] >= l->split_threshold) {
+        l->split_state[part] = PARTITION_SPLIT_CANDIDATE;
+        l->refine_list[l->n_refine_list++] = part;
+    }
+}
+
+void hvr_partition_list_refine(hvr_partition_list_t *l,
+        hvr_internal_ctx_t *ctx) {
+    size_t n_kept = 0;
+    for (size_t i = 0; i < l->n_refine_list; i++) {
+        const hvr_partition_t part = l->refine_list[i];
+        int keep;
+
+        if (l->split_state[part] == PARTITION_SPLIT_CANDIDATE) {
+            keep = (l->counts[part] >= l->split_threshold &&
+                    l->traffic[part] > 0);
+            if (keep) {
+                for (hvr_vertex_t *curr = hvr_partition_list_head(part, l);
+                        curr; curr = curr->next_in_partition) {
+                    child_insert(curr, part, l, ctx);
+                }
+                l->split_state[part] = PARTITION_SPLIT;
+            }
+        } else {
+            assert(l->split_state[part] == PARTITION_SPLIT);
+            keep = (l->counts[part] >= l->merge_threshold &&
+                    l->traffic[part] > 0);
+            if (!keep) {
+                for (hvr_vertex_t *curr = hvr_partition_list_head(part, l);
+                        curr; curr = curr->next_in_partition) {
+                    child_remove(curr, part, l);
+                }
+            }
+        }
+
+        if (keep) {
+            l->refine_list[n_kept++] = part;
+        } else {
+            l->split_state[part] = PARTITION_FLAT;
+        }
+        l->traffic[part] = 0;
+    }
+    l->n_refine_list = n_kept;
+}
+
+static void grid_coords(const hvr_vertex_t *vert, int64_t *out_coords,
+        hvr_internal_ctx_t *ctx) {
+    double key[HVR_MAX_SEARCH_KEY_DIMS];
+    ctx->search_key(vert, key, ctx);
+    for (unsigned d = 0; d < ctx->search_key_dims; d++) {
+        out_coords[d] = (int64_t)floor(key[d] / ctx->search_radius);
+    }
+}
+
+/*
+ * Pack grid coordinates into a single map key. Coordinates wrap around, so
+ * distant cells may share a key. That only adds candidates that are then
+ * rejected by should_have_edge.
+ */
+static uint64_t grid_cell(const int64_t *coords, unsigned ndims) {
+    const unsigned bits = 63 / ndims;
+    const uint64_t mask = (1ULL << bits) - 1;
+    uint64_t cell = 0;
+    for (unsigned d = 0; d < ndims; d++) {
+        cell = (cell << bits) | ((uint64_t)coords[d] & mask);
+    }
+    return cell;
+}
+
+static void grid_insert(hvr_vertex_t *vert, hvr_partition_list_t *l,
+        hvr_internal_ctx_t *ctx) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    int64_t coords[HVR_MAX_SEARCH_KEY_DIMS];
+    grid_coords(vert, coords, ctx);
+    node->cell = grid_cell(coords, ctx->search_key_dims);
+
+    hvr_vertex_cache_node_t *head = (hvr_vertex_cache_node_t *)hvr_map_get(
+            node->cell, &l->grid);
+    node->prev_in_cell = NULL;
+    node->next_in_cell = head;
+    if (head) {
+        head->prev_in_cell = node;
+    }
+    hvr_map_add(node->cell, node, 1, &l->grid);
+}
+
+static void grid_remove(const hvr_vertex_t *vert, hvr_partition_list_t *l) {
+    hvr_vertex_cache_node_t *node = (hvr_vertex_cache_node_t *)vert;
+    if (node->prev_in_cell) {
+        node->prev_in_cell->next_in_cell = node->next_in_cell;
+    } else if (node->next_in_cell) {
+        hvr_map_add(node->cell, node->next_in_cell, 1, &l->grid);
+    } else {
+        hvr_map_remove(node->cell, node, &l->grid);
+    }
+
+    if (node->next_in_cell) {
+        node->next_in_cell->prev_in_cell = node->prev_in_cell;
+    }
+    node->next_in_cell = NULL;
+    node->prev_in_cell = NULL;
+}
+
+unsigned hvr_partition_list_grid_neighborhood(const hvr_vertex_t *vert,
+        uint64_t *out_cells, hvr_internal_ctx_t *ctx) {
+    const unsigned ndims = ctx->search_key_dims;
+    int64_t coords[HVR_MAX_SEARCH_KEY_DIMS];
+    grid_coords(vert, coords, ctx);
+
+    unsigned n_cells = 1;
+    for (unsigned d = 0; d < ndims; d++) {
+        n_cells *= 3;
+    }
+
+    for (unsigned i = 0; i < n_cells; i++) {
+        int64_t neighbor[HVR_MAX_SEARCH_KEY_DIMS];
+        unsigned rem = i;
+        for (unsigned d = 0; d < ndims; d++) {
+            neighbor[d] = coords[d] + (int64_t)(rem % 3) - 1;
+            rem /= 3;
+        }
+        out_cells[i] = grid_cell(neighbor, ndims);
+    }
+    return n_cells;
+}
+
+hvr_vertex_cache_node_t *hvr_partition_list_grid_head(uint64_t cell,
+        hvr_partition_list_t *l) {
+    return (hvr_vertex_cache_node_t *)hvr_map_get(cell, &l->grid);
 }
 
 static void prepend_to_partition_list_helper(hvr_vertex_t *curr,
@@ -28,8 +284,23 @@ static void prepend_to_partition_list_helper(hvr_vertex_t *curr,
 
     if (head) {
         head->prev_in_partition = curr;
+    } else {
+        hvr_partition_window_mark_dirty(partition, ctx);
     }
     hvr_map_add(partition, curr, 1, &l->map);
+
+    if (l->track_distances) {
+        hvr_partition_dist_hist_insert(curr, partition, ctx);
+    }
+    if (l->has_grid) {
+        grid_insert(curr, l, ctx);
+    }
+    if (l->has_children) {
+        l->counts[partition]++;
+        if (l->split_state[partition] == PARTITION_SPLIT) {
+            child_insert(curr, partition, l, ctx);
+        }
+    }
 }
 
 void prepend_to_partition_list(hvr_vertex_t *curr,
@@ -40,8 +311,25 @@ void prepend_to_partition_list(hvr_vertex_t *curr,
 void remove_from_partition_list_helper(const hvr_vertex_t *vert,
         hvr_partition_t partition, hvr_partition_list_t *l,
         hvr_internal_ctx_t *ctx) {
+    if (partition == HVR_INVALID_PARTITION) {
+        // Never added to a partition's list
+        return;
+    }
     assert(partition < l->n_partitions);
 
+    if (l->track_distances) {
+        hvr_partition_dist_hist_remove(vert, ctx);
+    }
+    if (l->has_grid) {
+        grid_remove(vert, l);
+    }
+    if (l->has_children) {
+        l->counts[partition]--;
+        if (l->split_state[partition] == PARTITION_SPLIT) {
+            child_remove(vert, partition, l);
+        }
+    }
+
     if (vert->next_in_partition && vert->prev_in_partition) {
         // Remove from current partition list
         vert->prev_in_partition->next_in_partition =
@@ -63,6 +351,7 @@ void remove_from_partition_list_helper(const hvr_vertex_t *vert,
         assert(head == vert);
         // Only entry in list
         hvr_map_remove(partition, head, &l->map);
+        hvr_partition_window_mark_dirty(partition, ctx);
     }
 }
 
@@ -86,6 +375,17 @@ void update_partition_list_membership(hvr_vertex_t *curr,
 
         // Prepend to new partition list
         prepend_to_partition_list_helper(curr, new_partition, l, ctx);
+    } else {
+        if (l->has_grid) {
+            // The vertex may have moved to a different cell of the partition
+            grid_remove(curr, l);
+            grid_insert(curr, l, ctx);
+        }
+        if (hvr_partition_list_is_split(new_partition, l)) {
+            // Or to a different child of the partition
+            child_remove(curr, new_partition, l);
+            child_insert(curr, new_partition, l, ctx);
+        }
     }
 }
 
@@ -0,0 +1,101 @@
+/* For license: see LICENSE.txt file at top-level */
+
+#include <assert.h>
+#include <string.h>
+
+#include "hvr_common.h"
+#include "hvr_progress_queue.h"
+
+// Messages are stored as a length followed by a payload padded to this size
+#define RECORD_ALIGN sizeof(uint64_t)
+
+static inline uint64_t record_len(size_t msg_len) {
+    return sizeof(uint64_t) + ((msg_len + RECORD_ALIGN - 1) / RECORD_ALIGN) *
+        RECORD_ALIGN;
+}
+
+static void write_with_rotation(const void *data, size_t data_len,
+        uint64_t pos, hvr_progress_queue_t *q) {
+    const uint64_t offset = pos % q->capacity_in_bytes;
+    if (offset + data_len <= q->capacity_in_bytes) {
+        memcpy(q->buf + offset, data, data_len);
+    } else {
+        const uint64_t rotate_index = q->capacity_in_bytes - offset;
+        memcpy(q->buf + offset, data, rotate_index);
+        memcpy(q->buf, (const char *)data + rotate_index,
+                data_len - rotate_index);
+    }
+}
+
+static void read_with_rotation(void *data, size_t data_len, uint64_t pos,
+        hvr_progress_queue_t *q) {
+    const uint64_t offset = pos % q->capacity_in_bytes;
+    if (offset + data_len <= q->capacity_in_bytes) {
+        memcpy(data, q->buf + offset, data_len);
+    } else {
+        const uint64_t rotate_index = q->capacity_in_bytes - offset;
+        memcpy(data, q->buf + offset, rotate_index);
+        memcpy((char *)data + rotate_index, q->buf, data_len - rotate_index);
+    }
+}
+
+void hvr_progress_queue_init(hvr_progress_queue_t *q,
+        size_t capacity_in_bytes) {
+    assert(capacity_in_bytes % RECORD_ALIGN == 0);
+    q->buf = (char *)malloc_helper(capacity_in_bytes);
+    assert(q->buf);
+    q->capacity_in_bytes = capacity_in_bytes;
+    q->head = 0;
+    q->tail = 0;
+}
+
+int hvr_progress_queue_has_space(size_t msg_len, hvr_progress_queue_t *q) {
+    const uint64_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    return q->capacity_in_bytes - (q->head - tail) >= record_len(msg_len);
+}
+
+int hvr_progress_queue_push(const void *msg, size_t msg_len,
+        hvr_progress_queue_t *q) {
+    assert(record_len(msg_len) <= q->capacity_in_bytes);
+    if (!hvr_progress_queue_has_space(msg_len, q)) {
+        return 0;
+    }
+
+    const uint64_t len = msg_len;
+    write_with_rotation(&len, sizeof(len), q->head, q);
+    write_with_rotation(msg, msg_len, q->head + sizeof(len), q);
+
+    // Publish the message only once its contents are in place
+    __atomic_store_n(&q->head, q->head + record_len(msg_len), __ATOMIC_RELEASE);
+    return 1;
+}
+
+int hvr_progress_queue_pop(void *msg, size_t msg_capacity, size_t *msg_len,
+        hvr_progress_queue_t *q) {
+    const uint64_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (head == q->tail) {
+        return 0;
+    }
+
+    uint64_t len;
+    read_with_rotation(&len, sizeof(len), q->tail, q);
+    assert(msg_capacity >= len);
+    read_with_rotation(msg, len, q->tail + sizeof(len), q);
+    *msg_len = len;
+
+    // Hand the space back to the producer only once we are done reading it
+    __atomic_store_n(&q->tail, q->tail + record_len(len), __ATOMIC_RELEASE);
+    return 1;
+}
+
+int hvr_progress_queue_is_empty(hvr_progress_queue_t *q) {
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == q->tail;
+}
+
+size_t hvr_progress_queue_mem_used(hvr_progress_queue_t *q) {
+    return q->capacity_in_bytes + sizeof(*q);
+}
+
+void hvr_progress_queue_destroy(hvr_progress_queue_t *q) {
+    free(q->buf);
+}
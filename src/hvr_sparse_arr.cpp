@@ -8,13 +8,126 @@
 
 static inline void hvr_sparse_arr_seg_init(hvr_sparse_arr_seg_t *seg) {
     for (int i = 0; i < HVR_SPARSE_ARR_SEGMENT_SIZE; i++) {
-        seg->seg[i] = nnil;
         seg->seg_size[i] = 0;
+        seg->seg_kind[i] = HVR_SPARSE_ARR_ROW_INLINE;
     }
     seg->next = NULL;
 }
 
-void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity) {
+static inline int bitmap_contains(const uint64_t *bitmap, unsigned j) {
+    return (bitmap[j / 64] & (1ULL << (j % 64))) != 0;
+}
+
+static uint64_t *bitmap_alloc(hvr_sparse_arr_t *arr) {
+    uint64_t *bitmap = (uint64_t *)mspace_malloc(arr->allocator,
+            arr->bitmap_words * sizeof(*bitmap));
+    if (!bitmap) {
+        fprintf(stderr, "ERROR failed allocating sparse array bitmap. "
+                "Increase HVR_SPARSE_ARR_BUF_POOL.\n");
+        abort();
+    }
+    memset(bitmap, 0x00, arr->bitmap_words * sizeof(*bitmap));
+    return bitmap;
+}
+
+static void row_iter_init(hvr_sparse_arr_row_iter_t *iter,
+        hvr_sparse_arr_seg_t *segment, unsigned seg_index,
+        hvr_sparse_arr_t *arr) {
+    iter->index = 0;
+    iter->curr_word = 0;
+    iter->bitmap_words = arr->bitmap_words;
+
+    if (segment == NULL) {
+        iter->row = NULL;
+        iter->kind = HVR_SPARSE_ARR_ROW_INLINE;
+        iter->len = 0;
+        return;
+    }
+
+    const hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    iter->row = row;
+    iter->kind = segment->seg_kind[seg_index];
+    iter->len = segment->seg_size[seg_index];
+
+    switch (iter->kind) {
+        case (HVR_SPARSE_ARR_ROW_TREE):
+            hvr_ordered_set_iter_init(&iter->tree_iter, row->tree);
+            break;
+        case (HVR_SPARSE_ARR_ROW_BITMAP):
+            iter->curr_word = row->bitmap[0];
+            break;
+    }
+}
+
+/*
+ * Convert a tree or bitmap row back into an inline row. The row must
+ * currently contain no more than HVR_SPARSE_ARR_INLINE_VALS values.
+ */
+static void convert_to_inline(hvr_sparse_arr_seg_t *segment,
+        unsigned seg_index, hvr_sparse_arr_t *arr) {
+    assert(segment->seg_size[seg_index] <= HVR_SPARSE_ARR_INLINE_VALS);
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    const uint8_t kind = segment->seg_kind[seg_index];
+    if (kind == HVR_SPARSE_ARR_ROW_INLINE) return;
+
+    uint32_t vals[HVR_SPARSE_ARR_INLINE_VALS];
+    unsigned nvals = 0;
+
+    hvr_sparse_arr_row_iter_t iter;
+    row_iter_init(&iter, segment, seg_index, arr);
+    unsigned val;
+    while (hvr_sparse_arr_row_iter_next(&iter, &val)) {
+        vals[nvals++] = val;
+    }
+
+    if (kind == HVR_SPARSE_ARR_ROW_TREE) {
+        hvr_ordered_set_delete_all(row->tree, arr->set_allocator);
+    } else {
+        mspace_free(arr->allocator, row->bitmap);
+    }
+
+    memcpy(row->inline_vals, vals, nvals * sizeof(vals[0]));
+    segment->seg_kind[seg_index] = HVR_SPARSE_ARR_ROW_INLINE;
+}
+
+/*
+ * Convert a full inline row into a tree row. If the row keeps growing, it will
+ * later be converted from a tree into a bitmap (if enabled).
+ */
+static void convert_to_tree(hvr_sparse_arr_seg_t *segment,
+        unsigned seg_index, hvr_sparse_arr_t *arr) {
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    const unsigned len = segment->seg_size[seg_index];
+    uint32_t vals[HVR_SPARSE_ARR_INLINE_VALS];
+    memcpy(vals, row->inline_vals, len * sizeof(vals[0]));
+
+    row->tree = NULL;
+    for (unsigned v = 0; v < len; v++) {
+        hvr_ordered_set_insert(&row->tree, vals[v], vals[v],
+                arr->set_allocator);
+    }
+    segment->seg_kind[seg_index] = HVR_SPARSE_ARR_ROW_TREE;
+}
+
+static void convert_tree_to_bitmap(hvr_sparse_arr_seg_t *segment,
+        unsigned seg_index, hvr_sparse_arr_t *arr) {
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    uint64_t *bitmap = bitmap_alloc(arr);
+
+    hvr_sparse_arr_row_iter_t iter;
+    row_iter_init(&iter, segment, seg_index, arr);
+    unsigned val;
+    while (hvr_sparse_arr_row_iter_next(&iter, &val)) {
+        bitmap[val / 64] |= (1ULL << (val % 64));
+    }
+
+    hvr_ordered_set_delete_all(row->tree, arr->set_allocator);
+    row->bitmap = bitmap;
+    segment->seg_kind[seg_index] = HVR_SPARSE_ARR_ROW_BITMAP;
+}
+
+static void init_helper(hvr_sparse_arr_t *arr, unsigned capacity,
+        unsigned value_capacity, hvr_sparse_arr_t *share_pools_with) {
     unsigned nsegs = (capacity + HVR_SPARSE_ARR_SEGMENT_SIZE - 1) /
         HVR_SPARSE_ARR_SEGMENT_SIZE;
 
@@ -26,10 +139,29 @@ void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity) {
     arr->capacity = capacity;
     arr->nsegs = nsegs;
 
+    /*
+     * A bitmap row only pays off once a tree holding the same values would
+     * be at least as large as the bitmap. Tree nodes are assumed to be about
+     * half full on average.
+     */
+    const size_t tree_bytes_per_value = 2 * (sizeof(uint32_t) +
+            sizeof(uint64_t));
+    arr->value_capacity = value_capacity;
+    arr->bitmap_words = (value_capacity + 63) / 64;
+    arr->bitmap_threshold = (arr->bitmap_words * sizeof(uint64_t) +
+            tree_bytes_per_value - 1) / tree_bytes_per_value;
+    if (arr->bitmap_threshold <= HVR_SPARSE_ARR_INLINE_VALS) {
+        arr->bitmap_threshold = HVR_SPARSE_ARR_INLINE_VALS + 1;
+    }
+
     int prealloc = 1024;
     if (getenv("HVR_SPARSE_ARR_SEGS")) {
         prealloc = atoi(getenv("HVR_SPARSE_ARR_SEGS"));
     }
+    // Segments are never released, so we never need more than nsegs of them
+    if (prealloc > (int)nsegs) {
+        prealloc = nsegs;
+    }
     arr->preallocated = (hvr_sparse_arr_seg_t *)malloc_helper(
             prealloc * sizeof(arr->preallocated[0]));
     assert(arr->preallocated);
@@ -39,11 +171,22 @@ void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity) {
     arr->preallocated[prealloc - 1].next = NULL;
     arr->segs_pool = arr->preallocated;
 
+    arr->reverse = NULL;
+
+    if (share_pools_with) {
+        arr->set_allocator = share_pools_with->set_allocator;
+        arr->pool = share_pools_with->pool;
+        arr->allocator = share_pools_with->allocator;
+        arr->shares_pools = 1;
+        return;
+    }
+
     int pool_size = 1024 * 1024;
     if (getenv("HVR_SPARSE_ARR_POOL")) {
         pool_size = atoi(getenv("HVR_SPARSE_ARR_POOL"));
     }
-    hvr_avl_node_allocator_init(&arr->avl_allocator, pool_size,
+    arr->set_allocator = &arr->owned_set_allocator;
+    hvr_ordered_set_allocator_init(arr->set_allocator, pool_size,
             "HVR_SPARSE_ARR_POOL");
 
     pool_size = 1024 * 1024;
@@ -54,17 +197,39 @@ void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity) {
     assert(arr->pool);
     arr->allocator = create_mspace_with_base(arr->pool, pool_size, 0);
     assert(arr->allocator);
+    arr->shares_pools = 0;
+}
+
+void hvr_sparse_arr_init(hvr_sparse_arr_t *arr, unsigned capacity,
+        unsigned value_capacity) {
+    init_helper(arr, capacity, value_capacity, NULL);
+}
+
+void hvr_sparse_arr_enable_reverse_index(hvr_sparse_arr_t *arr) {
+    assert(arr->value_capacity > 0);
+    assert(arr->reverse == NULL);
+
+    arr->reverse = (hvr_sparse_arr_t *)malloc_helper(sizeof(*arr->reverse));
+    assert(arr->reverse);
+    init_helper(arr->reverse, arr->value_capacity, 0, arr);
 }
 
 void hvr_sparse_arr_destroy(hvr_sparse_arr_t *arr) {
+    if (arr->reverse) {
+        hvr_sparse_arr_destroy(arr->reverse);
+        free(arr->reverse);
+    }
     free(arr->segs);
     free(arr->preallocated);
-    destroy_mspace(arr->allocator);
-    free(arr->pool);
+    if (!arr->shares_pools) {
+        destroy_mspace(arr->allocator);
+        free(arr->pool);
+    }
 }
 
-void hvr_sparse_arr_insert(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
+static int insert_helper(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
     assert(i < arr->capacity);
+    assert(arr->value_capacity == 0 || j < arr->value_capacity);
 
     const unsigned seg = i / HVR_SPARSE_ARR_SEGMENT_SIZE;
     const unsigned seg_index = i % HVR_SPARSE_ARR_SEGMENT_SIZE;
@@ -79,15 +244,52 @@ void hvr_sparse_arr_insert(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
     }
 
     hvr_sparse_arr_seg_t *segment = arr->segs[seg];
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
 
-    /*
-     * hvr_avl_insert will ensure no duplicate entries, and return 1 if an
-     * actual insert occurred.
-     */
-    int is_new_entry = hvr_avl_insert(&(segment->seg[seg_index]), j, j,
-            &arr->avl_allocator);
-    if (is_new_entry) {
-        segment->seg_size[seg_index] += 1;
+    if (segment->seg_kind[seg_index] == HVR_SPARSE_ARR_ROW_INLINE) {
+        const unsigned len = segment->seg_size[seg_index];
+        for (unsigned v = 0; v < len; v++) {
+            if (row->inline_vals[v] == j) return 0;
+        }
+
+        if (len < HVR_SPARSE_ARR_INLINE_VALS) {
+            row->inline_vals[len] = j;
+            segment->seg_size[seg_index] += 1;
+            return 1;
+        }
+
+        convert_to_tree(segment, seg_index, arr);
+    }
+
+    if (segment->seg_kind[seg_index] == HVR_SPARSE_ARR_ROW_TREE) {
+        /*
+         * hvr_ordered_set_insert will ensure no duplicate entries, and return
+         * 1 if an actual insert occurred.
+         */
+        int is_new_entry = hvr_ordered_set_insert(&row->tree, j, j,
+                arr->set_allocator);
+        if (is_new_entry) {
+            segment->seg_size[seg_index] += 1;
+            if (arr->bitmap_words > 0 &&
+                    segment->seg_size[seg_index] >= arr->bitmap_threshold) {
+                convert_tree_to_bitmap(segment, seg_index, arr);
+            }
+        }
+        return is_new_entry;
+    } else {
+        if (!bitmap_contains(row->bitmap, j)) {
+            row->bitmap[j / 64] |= (1ULL << (j % 64));
+            segment->seg_size[seg_index] += 1;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+void hvr_sparse_arr_insert(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
+    int is_new_entry = insert_helper(i, j, arr);
+    if (is_new_entry && arr->reverse) {
+        hvr_sparse_arr_insert(j, i, arr->reverse);
     }
 }
 
@@ -102,11 +304,25 @@ int hvr_sparse_arr_contains(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
         return 0;
     }
 
-    struct hvr_avl_node *exists = hvr_avl_find(segment->seg[seg_index], j);
-    return (exists != nnil);
+    const hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    switch (segment->seg_kind[seg_index]) {
+        case (HVR_SPARSE_ARR_ROW_INLINE): {
+            const unsigned len = segment->seg_size[seg_index];
+            for (unsigned v = 0; v < len; v++) {
+                if (row->inline_vals[v] == j) return 1;
+            }
+            return 0;
+        }
+        case (HVR_SPARSE_ARR_ROW_TREE):
+            return hvr_ordered_set_find(row->tree, j) != NULL;
+        case (HVR_SPARSE_ARR_ROW_BITMAP):
+            return j < arr->value_capacity && bitmap_contains(row->bitmap, j);
+        default:
+            abort();
+    }
 }
 
-void hvr_sparse_arr_remove(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
+static int remove_helper(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
     assert(i < arr->capacity);
 
     const unsigned seg = i / HVR_SPARSE_ARR_SEGMENT_SIZE;
@@ -114,27 +330,80 @@ void hvr_sparse_arr_remove(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
 
     hvr_sparse_arr_seg_t *segment = arr->segs[seg];
     if (segment == NULL) {
-        return;
+        return 0;
+    }
+
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    int success = 0;
+    switch (segment->seg_kind[seg_index]) {
+        case (HVR_SPARSE_ARR_ROW_INLINE): {
+            const unsigned len = segment->seg_size[seg_index];
+            for (unsigned v = 0; v < len; v++) {
+                if (row->inline_vals[v] == j) {
+                    // Order of inline values is not preserved
+                    row->inline_vals[v] = row->inline_vals[len - 1];
+                    success = 1;
+                    break;
+                }
+            }
+            break;
+        }
+        case (HVR_SPARSE_ARR_ROW_TREE):
+            success = hvr_ordered_set_delete(&row->tree, j,
+                    arr->set_allocator);
+            break;
+        case (HVR_SPARSE_ARR_ROW_BITMAP):
+            if (j < arr->value_capacity && bitmap_contains(row->bitmap, j)) {
+                row->bitmap[j / 64] &= ~(1ULL << (j % 64));
+                success = 1;
+            }
+            break;
+        default:
+            abort();
     }
 
-    int success = hvr_avl_delete(&(segment->seg[seg_index]), j,
-            &arr->avl_allocator);
     if (success) {
         segment->seg_size[seg_index] -= 1;
+        if (segment->seg_size[seg_index] <= HVR_SPARSE_ARR_INLINE_VALS / 2) {
+            convert_to_inline(segment, seg_index, arr);
+        }
+    }
+    return success;
+}
+
+void hvr_sparse_arr_remove(unsigned i, unsigned j, hvr_sparse_arr_t *arr) {
+    int success = remove_helper(i, j, arr);
+    if (success && arr->reverse) {
+        hvr_sparse_arr_remove(j, i, arr->reverse);
     }
 }
 
 void hvr_sparse_arr_remove_value(unsigned j, hvr_sparse_arr_t *arr) {
+    if (arr->reverse) {
+        if (j >= arr->value_capacity) return;
+
+        // Only visit the rows that actually contain j
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, j, arr->reverse);
+        unsigned i;
+        while (hvr_sparse_arr_row_iter_next(&iter, &i)) {
+            int success = remove_helper(i, j, arr);
+            assert(success);
+        }
+        hvr_sparse_arr_remove_row(j, arr->reverse);
+        return;
+    }
+
     const unsigned nsegs = arr->nsegs;
     for (unsigned seg = 0; seg < nsegs; seg++) {
         hvr_sparse_arr_seg_t *segment = arr->segs[seg];
         if (segment) {
+            const unsigned base = seg * HVR_SPARSE_ARR_SEGMENT_SIZE;
             for (unsigned seg_index = 0;
-                    seg_index < HVR_SPARSE_ARR_SEGMENT_SIZE; seg_index++) {
-                int success = hvr_avl_delete(&(segment->seg[seg_index]), j,
-                        &arr->avl_allocator);
-                if (success) {
-                    segment->seg_size[seg_index] -= 1;
+                    seg_index < HVR_SPARSE_ARR_SEGMENT_SIZE &&
+                    base + seg_index < arr->capacity; seg_index++) {
+                if (segment->seg_size[seg_index] > 0) {
+                    hvr_sparse_arr_remove(base + seg_index, j, arr);
                 }
             }
         }
@@ -150,25 +419,82 @@ void hvr_sparse_arr_remove_row(unsigned i, hvr_sparse_arr_t *arr) {
         return;
     }
 
-    hvr_avl_delete_all(segment->seg[seg_index], &arr->avl_allocator);
-    segment->seg[seg_index] = nnil;
+    if (arr->reverse) {
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, i, arr);
+        unsigned j;
+        while (hvr_sparse_arr_row_iter_next(&iter, &j)) {
+            hvr_sparse_arr_remove(j, i, arr->reverse);
+        }
+    }
+
+    hvr_sparse_arr_row_t *row = &segment->seg[seg_index];
+    switch (segment->seg_kind[seg_index]) {
+        case (HVR_SPARSE_ARR_ROW_TREE):
+            hvr_ordered_set_delete_all(row->tree, arr->set_allocator);
+            break;
+        case (HVR_SPARSE_ARR_ROW_BITMAP):
+            mspace_free(arr->allocator, row->bitmap);
+            break;
+    }
+    segment->seg_kind[seg_index] = HVR_SPARSE_ARR_ROW_INLINE;
     segment->seg_size[seg_index] = 0;
 }
 
-unsigned hvr_sparse_arr_linearize_row(unsigned i, uint64_t **out_arr,
-        hvr_sparse_arr_t *arr) {
+unsigned hvr_sparse_arr_row_length(unsigned i, hvr_sparse_arr_t *arr) {
     assert(i < arr->capacity);
 
-    const unsigned seg = i / HVR_SPARSE_ARR_SEGMENT_SIZE;
-    const unsigned seg_index = i % HVR_SPARSE_ARR_SEGMENT_SIZE;
-
-    hvr_sparse_arr_seg_t *segment = arr->segs[seg];
+    hvr_sparse_arr_seg_t *segment = arr->segs[i / HVR_SPARSE_ARR_SEGMENT_SIZE];
     if (segment == NULL) {
-        *out_arr = NULL;
         return 0;
     }
+    return segment->seg_size[i % HVR_SPARSE_ARR_SEGMENT_SIZE];
+}
+
+void hvr_sparse_arr_row_iter_init(hvr_sparse_arr_row_iter_t *iter,
+        unsigned i, hvr_sparse_arr_t *arr) {
+    assert(i < arr->capacity);
+    row_iter_init(iter, arr->segs[i / HVR_SPARSE_ARR_SEGMENT_SIZE],
+            i % HVR_SPARSE_ARR_SEGMENT_SIZE, arr);
+}
+
+int hvr_sparse_arr_row_iter_next(hvr_sparse_arr_row_iter_t *iter,
+        unsigned *out) {
+    switch (iter->kind) {
+        case (HVR_SPARSE_ARR_ROW_INLINE):
+            if (iter->index >= iter->len) return 0;
+            *out = iter->row->inline_vals[iter->index++];
+            return 1;
+
+        case (HVR_SPARSE_ARR_ROW_TREE): {
+            uint32_t key;
+            if (!hvr_ordered_set_iter_next(&iter->tree_iter, &key, NULL)) {
+                return 0;
+            }
+            *out = key;
+            return 1;
+        }
+
+        case (HVR_SPARSE_ARR_ROW_BITMAP):
+            // Skip over empty words
+            while (iter->curr_word == 0) {
+                iter->index++;
+                if (iter->index >= iter->bitmap_words) return 0;
+                iter->curr_word = iter->row->bitmap[iter->index];
+            }
+            *out = iter->index * 64 + __builtin_ctzll(iter->curr_word);
+            // Clear lowest set bit
+            iter->curr_word &= (iter->curr_word - 1);
+            return 1;
+
+        default:
+            abort();
+    }
+}
 
-    int n_stored_values = segment->seg_size[seg_index];
+unsigned hvr_sparse_arr_linearize_row(unsigned i, uint64_t **out_arr,
+        hvr_sparse_arr_t *arr) {
+    unsigned n_stored_values = hvr_sparse_arr_row_length(i, arr);
     if (n_stored_values == 0) {
         *out_arr = NULL;
     } else {
@@ -176,8 +502,14 @@ unsigned hvr_sparse_arr_linearize_row(unsigned i, uint64_t **out_arr,
                 n_stored_values * sizeof(*keys_cache));
         assert(keys_cache);
 
-        hvr_avl_serialize(segment->seg[seg_index], keys_cache,
-                n_stored_values);
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, i, arr);
+        unsigned val;
+        unsigned count = 0;
+        while (hvr_sparse_arr_row_iter_next(&iter, &val)) {
+            keys_cache[count++] = val;
+        }
+        assert(count == n_stored_values);
 
         *out_arr = keys_cache;
     }
@@ -195,10 +527,23 @@ size_t hvr_sparse_arr_used_bytes(hvr_sparse_arr_t *arr) {
     for (unsigned s = 0; s < arr->nsegs; s++) {
         hvr_sparse_arr_seg_t *seg = arr->segs[s];
         if (seg) {
+            nbytes += sizeof(*seg);
             for (unsigned i = 0; i < HVR_SPARSE_ARR_SEGMENT_SIZE; i++) {
-                nbytes += seg->seg_size[i] * sizeof(seg->seg[0][0]);
+                if (seg->seg_kind[i] == HVR_SPARSE_ARR_ROW_BITMAP) {
+                    nbytes += arr->bitmap_words * sizeof(uint64_t);
+                }
             }
         }
     }
+    if (!arr->shares_pools) {
+        size_t set_allocated, set_used;
+        hvr_ordered_set_allocator_bytes_usage(arr->set_allocator,
+                &set_allocated, &set_used);
+        nbytes += set_used;
+    }
+
+    if (arr->reverse) {
+        nbytes += hvr_sparse_arr_used_bytes(arr->reverse);
+    }
     return nbytes;
 }
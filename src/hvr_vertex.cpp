@@ -8,16 +8,29 @@ hvr_vertex_t *hvr_vertex_create(hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
     assert(ctx->user_mutation_allowed);
 
+    hvr_lock_vertex_cache(1, ctx);
     hvr_vertex_cache_node_t *reserved = hvr_vertex_cache_reserve(
             &ctx->vec_cache, ctx->pe, ctx->iter);
     hvr_vertex_t *allocated = &reserved->vert;
 
     hvr_vertex_cache_add_to_locals_list(reserved, &ctx->vec_cache);
 
+    if (ctx->resume_state) {
+        ctx->resume_state[VERTEX_ID_OFFSET(allocated->id)] = 0;
+    }
+
+    if (ctx->forwarding) {
+        // This slot no longer forwards to a vertex migrated away from it
+        shmem_uint64_atomic_set(ctx->forwarding +
+                VERTEX_ID_OFFSET(allocated->id), HVR_INVALID_VERTEX_ID,
+                ctx->pe);
+    }
+
     allocated->next_in_partition = ctx->recently_created;
     ctx->recently_created = allocated;
 
     ctx->any_needs_processing = 1;
+    hvr_unlock_vertex_cache(ctx);
 
     return allocated;
 }
@@ -25,16 +38,20 @@ hvr_vertex_t *hvr_vertex_create(hvr_ctx_t in_ctx) {
 void hvr_vertex_delete(hvr_vertex_t *vert, hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
     assert(ctx->user_mutation_allowed);
-    hvr_buffered_changes_delete_vertex(vert->id, &ctx->buffered_changes);
+    hvr_buffered_changes_delete_vertex(vert->id,
+            hvr_current_buffered_changes(ctx));
 }
 
-void hvr_vertex_delete_impl(hvr_vertex_t *vert, hvr_ctx_t in_ctx) {
+void hvr_vertex_delete_impl(hvr_vertex_t *vert, int is_migration,
+        hvr_ctx_t in_ctx) {
     hvr_internal_ctx_t *ctx = (hvr_internal_ctx_t *)in_ctx;
 
     // Notify others of the deletion
     unsigned long long unused;
     hvr_partition_t part = wrap_actor_to_partition(vert, ctx);
-    send_updates_to_all_subscribed_pes(vert, part, 0, 1, NULL, &unused, ctx);
+    send_updates_to_all_subscribed_pes(vert, part,
+            is_migration ? HVR_MIGRATION_INVALIDATION : 0, 1, NULL, &unused,
+            ctx);
 
     remove_from_partition_list(vert, &ctx->local_partition_lists, ctx);
 
@@ -44,6 +61,9 @@ void hvr_vertex_delete_impl(hvr_vertex_t *vert, hvr_ctx_t in_ctx) {
     hvr_vertex_cache_remove_from_locals_list((hvr_vertex_cache_node_t *)vert,
             &ctx->vec_cache);
 
+    remove_hub_work(CACHE_NODE_OFFSET((hvr_vertex_cache_node_t *)vert,
+                &ctx->vec_cache), ctx);
+
     hvr_vertex_cache_delete((hvr_vertex_cache_node_t *)vert, &ctx->vec_cache);
 }
 
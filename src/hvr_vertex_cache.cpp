@@ -108,6 +108,7 @@ static inline hvr_vertex_cache_node_t *allocate_node_from_pool(
 
     new_node->populated = 1;
     new_node->dist_from_local_vert = UINT8_MAX;
+    new_node->dist_hist_part = HVR_INVALID_PARTITION;
 
     return new_node;
 }
@@ -0,0 +1,213 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * With HVR_DETERMINISTIC and HVR_STRICT, checks that runs of the same
+ * simulation do the same work with the same results. Vertices move along a
+ * line with edges between vertices no more than 1 apart, and each one sends
+ * messages to vertices on several other PEs every iteration. Each vertex folds
+ * the messages it receives into a digest in the order in which they are
+ * polled, so that any difference in the order in which messages or updates are
+ * delivered shows up in the digests. The first run records each PE's digest in
+ * <digest-file>.<pe>, and every later run with the same number of PEs must
+ * produce the same digests.
+ */
+
+#define N_PER_PE 16
+#define N_PARTITIONS 4
+#define PARTITION_WIDTH 4
+#define N_TARGETS 3
+#define N_ITERS 40
+
+// Positions are multiples of 1/POS_SCALE in [0, LINE_LENGTH)
+#define POS_SCALE 8
+#define LINE_LENGTH (N_PARTITIONS * PARTITION_WIDTH)
+
+#define POS 0
+#define INDEX 1
+// Messages carry a single value
+#define MSG_VALUE 0
+
+static int pe, npes;
+static size_t offsets[N_PER_PE];
+
+// Per local vertex index, what this run observed
+static uint64_t digests[N_PER_PE];
+static uint64_t n_updates[N_PER_PE];
+static uint64_t n_msgs[N_PER_PE];
+static uint64_t n_neighbors[N_PER_PE];
+static uint64_t n_sent;
+
+static int64_t position(int owner, int64_t index, hvr_time_t iter) {
+    const int64_t length = LINE_LENGTH * POS_SCALE;
+    const int64_t start = (owner * 37 + index * 11) % length;
+    const int64_t velocity = (owner + index) % 7 - 3;
+    return ((start + velocity * iter) % length + length) % length;
+}
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    const int64_t index = hvr_vertex_get_uint64(INDEX, vertex, ctx);
+    n_updates[index]++;
+
+    hvr_vertex_t msg;
+    while (hvr_poll_msg(vertex, &msg, ctx)) {
+        digests[index] = digests[index] * 1000003ULL +
+            hvr_vertex_get_uint64(MSG_VALUE, &msg, ctx);
+        n_msgs[index]++;
+    }
+
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vertex, &neighbors, ctx);
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+        n_neighbors[index]++;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    if (ctx->iter < N_ITERS) {
+        hvr_vertex_set(POS, (double)position(pe, index, ctx->iter) /
+                POS_SCALE, vertex, ctx);
+        hvr_vertex_init(&msg, vertex->id, ctx->iter);
+        for (int k = 1; k <= N_TARGETS; k++) {
+            hvr_vertex_set_uint64(MSG_VALUE, ((uint64_t)pe << 32) |
+                    (index << 16) | ctx->iter, &msg, ctx);
+            hvr_send_msg(construct_vertex_id((pe + k) % npes,
+                        offsets[(index + k) % N_PER_PE]), &msg, ctx);
+            n_sent++;
+        }
+        mark_for_processing(vertex, ctx);
+    }
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    unsigned n = 0;
+    if (partition > 0) {
+        interacting_partitions[n++] = partition - 1;
+    }
+    interacting_partitions[n++] = partition;
+    if (partition < N_PARTITIONS - 1) {
+        interacting_partitions[n++] = partition + 1;
+    }
+    *n_interacting_partitions = n;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return (hvr_partition_t)(hvr_vertex_get(POS, actor, ctx) /
+            PARTITION_WIDTH);
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    const double delta = hvr_vertex_get(POS, a, ctx) -
+        hvr_vertex_get(POS, b, ctx);
+    return (delta <= 1.0 && delta >= -1.0) ? BIDIRECTIONAL : NO_EDGE;
+}
+
+static int should_terminate(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *local_coupled_val, hvr_vertex_t *all_coupled_vals,
+        hvr_set_t *coupled_pes, int n_coupled_pes, int *updates_on_this_iter,
+        hvr_set_t *terminated_coupled_pes, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    return ctx->iter >= N_ITERS + 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <digest-file>\n", argv[0]);
+        return 1;
+    }
+
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    setenv("HVR_DETERMINISTIC", "1", 0);
+    setenv("HVR_STRICT", "1", 0);
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    for (unsigned i = 0; i < N_PER_PE; i++) {
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        hvr_vertex_set_uint64(INDEX, i, vert, ctx);
+        hvr_vertex_set(POS, (double)position(pe, i, 0) / POS_SCALE, vert, ctx);
+        // Every PE allocates its vertices from the same offsets
+        offsets[i] = VERTEX_ID_OFFSET(vert->id);
+    }
+
+    hvr_init(N_PARTITIONS, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            should_terminate,
+            60, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+
+    hvr_body(ctx);
+
+    uint64_t digest = 0;
+    uint64_t total_msgs = 0;
+    for (unsigned i = 0; i < N_PER_PE; i++) {
+        digest = digest * 1000003ULL + digests[i];
+        digest = digest * 1000003ULL + n_updates[i];
+        digest = digest * 1000003ULL + n_neighbors[i];
+        total_msgs += n_msgs[i];
+    }
+    /*
+     * Every PE sends as many messages as it receives, and every message sent
+     * was received.
+     */
+    assert(n_sent > 0 && total_msgs == n_sent);
+
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s.%d", argv[1], pe);
+    FILE *fp = fopen(filename, "r");
+    if (fp) {
+        unsigned long long recorded;
+        int nread = fscanf(fp, "%llu", &recorded);
+        assert(nread == 1);
+        fclose(fp);
+        if (recorded != digest) {
+            fprintf(stderr, "PE %d: digest %llu differs from %llu recorded in "
+                    "%s\n", pe, (unsigned long long)digest, recorded,
+                    filename);
+            abort();
+        }
+    } else {
+        fp = fopen(filename, "w");
+        assert(fp);
+        fprintf(fp, "%llu\n", (unsigned long long)digest);
+        fclose(fp);
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
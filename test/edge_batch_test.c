@@ -0,0 +1,86 @@
+#include "hvr_edge_batch.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_CANDIDATES 1027
+#define N_TRIALS 100
+
+/*
+ * Checks hvr_euclidean_edges_batch against a scalar reference, including
+ * candidate counts that are not a multiple of the vector width and candidates
+ * exactly on the threshold. The AVX2 kernel, when the CPU supports it, must
+ * produce exactly the same edges as the library's scalar loop.
+ */
+
+static double rand_double() {
+    // Multiples of 1/8, so that distances on the threshold are exact
+    return (double)(rand() % 80) / 8.0;
+}
+
+int main(int argc, char **argv) {
+    static double values[HVR_MAX_VECTOR_SIZE][N_CANDIDATES];
+    const double *candidate_values[HVR_MAX_VECTOR_SIZE];
+    for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+        candidate_values[f] = values[f];
+    }
+    static hvr_edge_type_t edges[N_CANDIDATES];
+    static hvr_edge_type_t scalar_edges[N_CANDIDATES];
+    static hvr_edge_type_t avx2_edges[N_CANDIDATES];
+    const double threshold = 2.0;
+    int tested_avx2 = 0;
+
+    for (int t = 0; t < N_TRIALS; t++) {
+        hvr_vertex_t target;
+        for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+            target.values[f] = rand_double();
+        }
+        for (unsigned i = 0; i < N_CANDIDATES; i++) {
+            for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+                values[f][i] = rand_double();
+            }
+        }
+        // One candidate exactly threshold away along the first feature
+        values[0][t] = target.values[0] + threshold;
+        for (unsigned f = 1; f < HVR_MAX_VECTOR_SIZE; f++) {
+            values[f][t] = target.values[f];
+        }
+
+        /*
+         * Cover every remainder modulo the vector width, and counts smaller
+         * than a single vector.
+         */
+        const unsigned n = (t < 8 ? t : N_CANDIDATES - (t % 4));
+        hvr_euclidean_edges_batch(&target, candidate_values, n,
+                HVR_MAX_VECTOR_SIZE, threshold, edges);
+        hvr_euclidean_edges_batch_scalar(&target, candidate_values, n,
+                HVR_MAX_VECTOR_SIZE, threshold, scalar_edges);
+        const int has_avx2 = hvr_euclidean_edges_batch_avx2(&target,
+                candidate_values, n, HVR_MAX_VECTOR_SIZE, threshold,
+                avx2_edges);
+        tested_avx2 = tested_avx2 || has_avx2;
+
+        for (unsigned i = 0; i < n; i++) {
+            double dist2 = 0.0;
+            for (unsigned f = 0; f < HVR_MAX_VECTOR_SIZE; f++) {
+                const double delta = values[f][i] - target.values[f];
+                dist2 += delta * delta;
+            }
+            const hvr_edge_type_t expected = (dist2 <= threshold * threshold ?
+                        BIDIRECTIONAL : NO_EDGE);
+            assert(scalar_edges[i] == expected);
+            assert(edges[i] == expected);
+            if (has_avx2) {
+                assert(avx2_edges[i] == scalar_edges[i]);
+            }
+        }
+        if ((unsigned)t < n) {
+            assert(edges[t] == BIDIRECTIONAL);
+        }
+    }
+
+    printf("Passed! (AVX2 kernel %s)\n", tested_avx2 ? "tested" :
+            "not supported on this CPU");
+    return 0;
+}
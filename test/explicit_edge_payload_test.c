@@ -0,0 +1,169 @@
+#include <shmem.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <hoover.h>
+
+/*
+ * Each PE's vertex creates an explicit edge to the vertex on the next PE, and
+ * later changes only the payload of that edge. With three PEs, each PE learns
+ * of the edge between the next two PEs' vertices only through the next PE's
+ * subscriber notifications, so it must end up seeing the final payload.
+ * hvr_neighbors_min must still find the neighbors behind edges that carry a
+ * payload.
+ */
+
+#define CREATE_ITER 5
+#define CHANGE_ITER 15
+
+#define INITIAL_PAYLOAD 1
+#define CHANGED_PAYLOAD 2
+
+static int pe, npes;
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    const hvr_vertex_id_t next = construct_vertex_id((pe + 1) % npes,
+            VERTEX_ID_OFFSET(vertex->id));
+
+    if (ctx->iter == CREATE_ITER) {
+        hvr_create_edge_with_payload(vertex, next, BIDIRECTIONAL,
+                INITIAL_PAYLOAD, ctx);
+    } else if (ctx->iter == CHANGE_ITER) {
+        hvr_create_edge_with_payload(vertex, next, BIDIRECTIONAL,
+                CHANGED_PAYLOAD, ctx);
+    }
+
+    // Keep being processed so that the iterations above are not missed
+    mark_for_processing(vertex, ctx);
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = 0;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+// Vertices with explicit edges must not be in a partition
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return HVR_INVALID_PARTITION;
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return NO_EDGE;
+}
+
+// Checks every edge of vert, returning how many there are
+static unsigned check_edges(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    hvr_edge_payload_t payload;
+    unsigned n_neighbors = 0;
+    while (hvr_neighbors_next_with_payload(&neighbors, &neighbor, &dir,
+                &payload)) {
+        assert(dir == BIDIRECTIONAL);
+        if (payload != CHANGED_PAYLOAD) {
+            fprintf(stderr, "PE %d: edge %lu <-> %lu has payload %lu, "
+                    "expected %d\n", pe, (unsigned long)vert->id,
+                    (unsigned long)neighbor->id,
+                    (unsigned long)payload, CHANGED_PAYLOAD);
+            abort();
+        }
+        n_neighbors++;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+    return n_neighbors;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 3) {
+        if (pe == 0) {
+            fprintf(stderr, "explicit_edge_payload_test requires at least 3 "
+                    "PEs\n");
+        }
+        shmem_finalize();
+        return 1;
+    }
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    hvr_vertex_t *vert = hvr_vertex_create(ctx);
+    hvr_vertex_set_uint64(0, pe, vert, ctx);
+
+    hvr_init(1, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            10, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            1, // send_neighbor_updates_for_explicit_subs
+            ctx);
+
+    hvr_body(ctx);
+
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    vert = hvr_vertex_iter_next(&iter);
+    assert(vert && hvr_vertex_iter_next(&iter) == NULL);
+
+    /*
+     * The local vertex has edges to the previous and next PEs' vertices. With
+     * three PEs, the mirror of the next PE's vertex also has an edge to the
+     * vertex after it, which this PE only hears about from the next PE. With
+     * more PEs, that vertex is not cached here and the edge is not applied.
+     */
+    assert(check_edges(vert, ctx) == 2);
+
+    // Neighbors are found by their offsets, not the payloads stored with them
+    const uint64_t prev = (pe + npes - 1) % npes;
+    const uint64_t next = (pe + 1) % npes;
+    assert(hvr_neighbors_min(vert, 0, UINT64_MAX, ctx) ==
+            (prev < next ? prev : next));
+
+    hvr_vertex_t *mirrors[2];
+    unsigned n_mirrors = 0;
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+        mirrors[n_mirrors++] = neighbor;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    for (unsigned i = 0; i < n_mirrors; i++) {
+        assert(check_edges(mirrors[i], ctx) == (npes == 3 ? 2 : 1));
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
@@ -77,6 +77,66 @@ int main(int argc, char **argv) {
 
     shmem_barrier_all();
 
+    /*
+     * The same pattern through a batch small enough to be flushed
+     * automatically, with redundant operations that must collapse to the last
+     * one on each bit.
+     */
+    hvr_dist_bitvec_batch_t batch;
+    hvr_dist_bitvec_batch_init(&vec, 7, &batch);
+    for (unsigned i = 0; i < N; i += 2) {
+        hvr_dist_bitvec_batch_clear(i, shmem_my_pe(), &batch);
+        hvr_dist_bitvec_batch_set(i, shmem_my_pe(), &batch);
+        if (shmem_my_pe() % 2 == 0) {
+            hvr_dist_bitvec_batch_clear(i, shmem_my_pe(), &batch);
+        }
+    }
+    hvr_dist_bitvec_batch_flush(&batch);
+
+    shmem_barrier_all();
+
+    for (unsigned i = 0; i < N; i += 2) {
+        hvr_dist_bitvec_copy_locally(i, &vec, &copy);
+        for (int j = 0; j < shmem_n_pes(); j++) {
+            assert(hvr_dist_bitvec_local_subcopy_contains(j, &copy) ==
+                    (j % 2 == 1));
+        }
+    }
+
+    shmem_barrier_all();
+
+    hvr_dist_bitvec_batch_destroy(&batch);
+
+    /*
+     * Rows copied in bulk, requested out of order, from every PE and with
+     * duplicates, must match rows copied one at a time.
+     */
+    const unsigned n_rows = 64;
+    hvr_dist_bitvec_size_t coord0s[64];
+    hvr_dist_bitvec_local_subcopy_t bulk[64];
+    hvr_dist_bitvec_local_subcopy_t *bulk_ptrs[64];
+    for (unsigned r = 0; r < n_rows; r++) {
+        coord0s[r] = ((r * 7919) + (r % 3 == 0 ? 0 : 1)) % N;
+        hvr_dist_bitvec_local_subcopy_init(&vec, &bulk[r]);
+        bulk_ptrs[r] = &bulk[r];
+    }
+    coord0s[n_rows - 1] = coord0s[0];
+    hvr_dist_bitvec_copy_rows_locally(coord0s, n_rows, &vec, bulk_ptrs);
+    for (unsigned r = 0; r < n_rows; r++) {
+        hvr_dist_bitvec_copy_locally(coord0s[r], &vec, &copy);
+        assert(bulk[r].coord0 == coord0s[r]);
+        assert(bulk[r].seq_no == copy.seq_no);
+        for (int j = 0; j < shmem_n_pes(); j++) {
+            assert(hvr_dist_bitvec_local_subcopy_contains(j, &bulk[r]) ==
+                    hvr_dist_bitvec_local_subcopy_contains(j, &copy));
+            assert(hvr_dist_bitvec_local_subcopy_contains(j, &bulk[r]) ==
+                    (coord0s[r] % 2 == 0 && j % 2 == 1));
+        }
+        hvr_dist_bitvec_local_subcopy_destroy(&vec, &bulk[r]);
+    }
+
+    shmem_barrier_all();
+
     hvr_dist_bitvec_t vec2;
     hvr_dist_bitvec_init(16000000, shmem_n_pes(), &vec2);
 
@@ -0,0 +1,124 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hvr_progress_queue.h"
+
+/*
+ * Checks that messages of varying lengths come out of a progress queue intact
+ * and in order, both when wrapping around the buffer on a single thread and
+ * with a concurrent producer and consumer.
+ */
+
+#define QUEUE_SIZE 256
+#define MAX_MSG_LEN 60
+#define N_SERIAL_MSGS 10000
+#define N_THREADED_MSGS 1000000
+
+static size_t msg_len_for(uint64_t seq) {
+    return sizeof(seq) + (seq * 7) % (MAX_MSG_LEN - sizeof(seq) + 1);
+}
+
+// Fills msg with a sequence number followed by bytes derived from it
+static size_t fill_msg(unsigned char *msg, uint64_t seq) {
+    const size_t len = msg_len_for(seq);
+    memcpy(msg, &seq, sizeof(seq));
+    for (size_t i = sizeof(seq); i < len; i++) {
+        msg[i] = (unsigned char)(seq + i);
+    }
+    return len;
+}
+
+static void check_msg(const unsigned char *msg, size_t len, uint64_t seq) {
+    uint64_t got_seq;
+    assert(len >= sizeof(got_seq));
+    memcpy(&got_seq, msg, sizeof(got_seq));
+    assert(got_seq == seq);
+    assert(len == msg_len_for(seq));
+    for (size_t i = sizeof(seq); i < len; i++) {
+        assert(msg[i] == (unsigned char)(seq + i));
+    }
+}
+
+static void *producer(void *user_data) {
+    hvr_progress_queue_t *q = (hvr_progress_queue_t *)user_data;
+    unsigned char msg[MAX_MSG_LEN];
+    for (uint64_t seq = 0; seq < N_THREADED_MSGS; seq++) {
+        const size_t len = fill_msg(msg, seq);
+        while (!hvr_progress_queue_push(msg, len, q)) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    hvr_progress_queue_t q;
+    hvr_progress_queue_init(&q, QUEUE_SIZE);
+    unsigned char msg[MAX_MSG_LEN];
+    size_t len;
+
+    assert(hvr_progress_queue_is_empty(&q));
+    assert(!hvr_progress_queue_pop(msg, sizeof(msg), &len, &q));
+
+    // Fill the queue until it refuses a message, then drain it
+    uint64_t n_pushed = 0;
+    while (hvr_progress_queue_has_space(msg_len_for(n_pushed), &q)) {
+        const size_t msg_len = fill_msg(msg, n_pushed);
+        assert(hvr_progress_queue_push(msg, msg_len, &q));
+        n_pushed++;
+    }
+    assert(n_pushed > 0);
+    fill_msg(msg, n_pushed);
+    assert(!hvr_progress_queue_push(msg, msg_len_for(n_pushed), &q));
+    for (uint64_t seq = 0; seq < n_pushed; seq++) {
+        assert(!hvr_progress_queue_is_empty(&q));
+        assert(hvr_progress_queue_pop(msg, sizeof(msg), &len, &q));
+        check_msg(msg, len, seq);
+    }
+    assert(hvr_progress_queue_is_empty(&q));
+
+    /*
+     * Keep a few messages in flight so that records regularly straddle the end
+     * of the buffer.
+     */
+    uint64_t n_popped = n_pushed;
+    while (n_popped < N_SERIAL_MSGS) {
+        while (n_pushed < N_SERIAL_MSGS && n_pushed - n_popped < 3) {
+            const size_t msg_len = fill_msg(msg, n_pushed);
+            assert(hvr_progress_queue_push(msg, msg_len, &q));
+            n_pushed++;
+        }
+        assert(hvr_progress_queue_pop(msg, sizeof(msg), &len, &q));
+        check_msg(msg, len, n_popped);
+        n_popped++;
+    }
+    assert(hvr_progress_queue_is_empty(&q));
+
+    hvr_progress_queue_destroy(&q);
+
+    // Concurrent producer and consumer
+    hvr_progress_queue_init(&q, QUEUE_SIZE);
+    pthread_t producer_pthread;
+    int err = pthread_create(&producer_pthread, NULL, producer, &q);
+    assert(err == 0);
+
+    for (uint64_t seq = 0; seq < N_THREADED_MSGS; seq++) {
+        while (!hvr_progress_queue_pop(msg, sizeof(msg), &len, &q)) {
+            sched_yield();
+        }
+        check_msg(msg, len, seq);
+    }
+
+    err = pthread_join(producer_pthread, NULL);
+    assert(err == 0);
+    assert(hvr_progress_queue_is_empty(&q));
+    hvr_progress_queue_destroy(&q);
+
+    printf("Success!\n");
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * Vertices on every PE move along a line for a few iterations and then stop,
+ * with edges between vertices no more than 1 apart. Every PE but PE 0 runs
+ * with HVR_IDLE_ITERATIONS, and a timeout long enough that only a message can
+ * end its wait, so those PEs go idle once their vertices stop. The final edges
+ * must still be those of the default mode (and of a brute force search). PE
+ * 0 keeps iterating and later asks to couple with PE 1, which must be woken
+ * by the request and join PE 0's cluster well before the time limit.
+ */
+
+#define N_PER_PE 16
+#define N_PARTITIONS 4
+#define PARTITION_WIDTH 4
+
+// Positions are multiples of 1/POS_SCALE in [0, LINE_LENGTH)
+#define POS_SCALE 8
+#define LINE_LENGTH (N_PARTITIONS * PARTITION_WIDTH)
+
+#define MOVE_ITERS 40
+#define COUPLE_AFTER_US 2000000ULL
+// How long PE 1 may take to join PE 0's cluster once it has been asked to
+#define MAX_WAKE_US 1000000ULL
+/*
+ * PE 1 runs only a few iterations after its vertices stop, where spinning
+ * through COUPLE_AFTER_US would take many thousands.
+ */
+#define MAX_IDLE_PE_ITERS 1000
+
+#define POS 0
+#define INDEX 1
+
+static int pe, npes;
+static unsigned long long start_time;
+// When and on which iteration should_terminate first saw a cluster of two
+static unsigned long long coupled_at_us = 0;
+static hvr_time_t coupled_at_iter = 0;
+
+// Position in units of 1/POS_SCALE of vertex index on PE owner at iter
+static int64_t position(int owner, int64_t index, hvr_time_t iter) {
+    const int64_t length = LINE_LENGTH * POS_SCALE;
+    const int64_t start = (owner * 37 + index * 11) % length;
+    const int64_t velocity = (owner + index) % 7 - 3;
+    const int64_t t = (iter < MOVE_ITERS ? iter : MOVE_ITERS);
+    return ((start + velocity * t) % length + length) % length;
+}
+
+// PE 0 never goes idle, so this is called on every one of its iterations
+static void start_time_step(hvr_vertex_iter_t *iter, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    if (pe == 0 && hvr_current_time_us() - start_time >= COUPLE_AFTER_US) {
+        hvr_set_insert(1, couple_with);
+    }
+}
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    const int64_t index = hvr_vertex_get_uint64(INDEX, vertex, ctx);
+    hvr_vertex_set(POS, (double)position(pe, index, ctx->iter) / POS_SCALE,
+            vertex, ctx);
+
+    if (ctx->iter < MOVE_ITERS) {
+        mark_for_processing(vertex, ctx);
+    }
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    unsigned n = 0;
+    if (partition > 0) {
+        interacting_partitions[n++] = partition - 1;
+    }
+    interacting_partitions[n++] = partition;
+    if (partition < N_PARTITIONS - 1) {
+        interacting_partitions[n++] = partition + 1;
+    }
+    *n_interacting_partitions = n;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return (hvr_partition_t)(hvr_vertex_get(POS, actor, ctx) /
+            PARTITION_WIDTH);
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    const double delta = hvr_vertex_get(POS, a, ctx) -
+        hvr_vertex_get(POS, b, ctx);
+    return (delta <= 1.0 && delta >= -1.0) ? BIDIRECTIONAL : NO_EDGE;
+}
+
+static int should_terminate(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *local_coupled_val, hvr_vertex_t *all_coupled_vals,
+        hvr_set_t *coupled_pes, int n_coupled_pes, int *updates_on_this_iter,
+        hvr_set_t *terminated_coupled_pes, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    if (n_coupled_pes == 2 && coupled_at_us == 0) {
+        coupled_at_us = hvr_current_time_us();
+        coupled_at_iter = ctx->iter;
+    }
+    return 0;
+}
+
+// Checks vert's edges against every vertex's final position
+static void check_edges(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    const int64_t pos = position(pe, hvr_vertex_get_uint64(INDEX, vert, ctx),
+            MOVE_ITERS);
+    unsigned expected = 0;
+    for (int owner = 0; owner < npes; owner++) {
+        for (int64_t index = 0; index < N_PER_PE; index++) {
+            const int64_t delta = position(owner, index, MOVE_ITERS) - pos;
+            if (delta <= POS_SCALE && delta >= -POS_SCALE) {
+                expected++;
+            }
+        }
+    }
+
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    unsigned n_neighbors = 0;
+    while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+        assert(should_have_edge(vert, neighbor, ctx) == BIDIRECTIONAL);
+        n_neighbors++;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    // The count includes the edge every vertex has with itself
+    if (n_neighbors != expected) {
+        fprintf(stderr, "PE %d: vertex at %f has %u edges, expected %u\n", pe,
+                hvr_vertex_get(POS, vert, ctx), n_neighbors, expected);
+        abort();
+    }
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 2) {
+        fprintf(stderr, "idle_wait_test requires at least 2 PEs\n");
+        shmem_finalize();
+        return 1;
+    }
+
+    if (pe != 0) {
+        setenv("HVR_IDLE_ITERATIONS", "5", 0);
+        setenv("HVR_IDLE_TIMEOUT_US", "60000000", 0);
+    }
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    for (unsigned i = 0; i < N_PER_PE; i++) {
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        hvr_vertex_set_uint64(INDEX, i, vert, ctx);
+        hvr_vertex_set(POS, (double)position(pe, i, 0) / POS_SCALE, vert, ctx);
+    }
+
+    hvr_init(N_PARTITIONS, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            start_time_step,
+            should_have_edge,
+            should_terminate,
+            5, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+
+    start_time = hvr_current_time_us();
+    hvr_body(ctx);
+
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    for (hvr_vertex_t *vert = hvr_vertex_iter_next(&iter); vert;
+            vert = hvr_vertex_iter_next(&iter)) {
+        check_edges(vert, ctx);
+    }
+
+    if (pe == 1) {
+        // PE 1 was idle until the request, and the request woke it
+        assert(coupled_at_us > 0);
+        assert(coupled_at_us - start_time < COUPLE_AFTER_US + MAX_WAKE_US);
+        assert(coupled_at_iter < MAX_IDLE_PE_ITERS);
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
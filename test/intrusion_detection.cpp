@@ -19,6 +19,7 @@
 #include <algorithm>
 
 #include <hoover.h>
+#include <hvr_edge_batch.h>
 #include <shmem_rw_lock.h>
 
 // #define VERBOSE
@@ -436,6 +437,19 @@ hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
     }
 }
 
+void should_have_edge_batch(const hvr_vertex_t *target,
+        const double *const *candidate_values, unsigned n_candidates,
+        hvr_edge_type_t *out_edges, hvr_ctx_t ctx) {
+    hvr_euclidean_edges_batch(target, candidate_values, n_candidates, 3,
+            distance_threshold, out_edges);
+}
+
+void search_key(const hvr_vertex_t *vert, double *out_key, hvr_ctx_t ctx) {
+    out_key[0] = hvr_vertex_get(0, vert, ctx);
+    out_key[1] = hvr_vertex_get(1, vert, ctx);
+    out_key[2] = hvr_vertex_get(2, vert, ctx);
+}
+
 // Assumes we already hold the write lock on best_patterns_lock for the local PE
 static void update_patterns_from(timestamped_pattern_count_t *tmp_buffer,
         int target_pe) {
@@ -1016,6 +1030,9 @@ int main(int argc, char **argv) {
             MAX_SUBGRAPH_VERTICES,
             1, // send_neighbor_updates_for_explicit_subs
             hvr_ctx);
+    hvr_declare_might_interact_pure(hvr_ctx);
+    hvr_set_edge_search_key(search_key, 3, distance_threshold, hvr_ctx);
+    hvr_set_should_have_edge_batch(should_have_edge_batch, hvr_ctx);
 
     best_patterns = (timestamped_pattern_count_t *)shmem_malloc(
             npes * sizeof(*best_patterns));
@@ -0,0 +1,166 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * Each PE has a target vertex and a waiter vertex in a partition of its own,
+ * so that no PE caches another's vertices. The waiter steps through a small
+ * state machine kept in its resume state: it waits on the next PE's target
+ * with hvr_vertex_await_mirror, which must only resume it once the target has
+ * been cached, then waits on a vertex that does not exist, which must resume
+ * it with HVR_MIRROR_MISSING, and finally yields for a few iterations in a
+ * row.
+ */
+
+#define LABEL 0
+#define IS_WAITER 1
+
+#define N_YIELDS 3
+
+// Waiter states
+#define START 0
+#define AWAITING_TARGET 1
+#define AWAITING_MISSING 2
+#define YIELDING 3
+#define DONE (YIELDING + N_YIELDS)
+
+static int pe, npes;
+static hvr_vertex_id_t target_id, missing_id;
+static hvr_time_t yield_iters[N_YIELDS];
+
+static uint64_t label_of(int owner) {
+    return owner * 100 + 7;
+}
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    if (!hvr_vertex_get_uint64(IS_WAITER, vertex, ctx)) {
+        return;
+    }
+
+    uint64_t *state = hvr_vertex_resume_state(vertex, ctx);
+    hvr_vertex_t *mirror;
+    hvr_mirror_status_t status;
+    switch (*state) {
+        case START:
+            status = hvr_vertex_await_mirror(vertex, target_id, &mirror, ctx);
+            assert(status == HVR_MIRROR_PENDING && mirror == NULL);
+            *state = AWAITING_TARGET;
+            break;
+        case AWAITING_TARGET:
+            // Only resumed once the target is here
+            status = hvr_vertex_await_mirror(vertex, target_id, &mirror, ctx);
+            assert(status == HVR_MIRROR_READY);
+            assert(mirror->id == target_id);
+            assert(hvr_vertex_get_uint64(LABEL, mirror, ctx) ==
+                    label_of((pe + 1) % npes));
+
+            status = hvr_vertex_await_mirror(vertex, missing_id, &mirror, ctx);
+            assert(status == HVR_MIRROR_PENDING && mirror == NULL);
+            *state = AWAITING_MISSING;
+            break;
+        case AWAITING_MISSING:
+            status = hvr_vertex_await_mirror(vertex, missing_id, &mirror, ctx);
+            assert(status == HVR_MIRROR_MISSING && mirror == NULL);
+            *state = YIELDING;
+            hvr_vertex_yield(vertex, ctx);
+            break;
+        default:
+            assert(*state >= YIELDING && *state < DONE);
+            yield_iters[*state - YIELDING] = ctx->iter;
+            *state += 1;
+            if (*state < DONE) {
+                hvr_vertex_yield(vertex, ctx);
+            }
+            break;
+    }
+}
+
+// Each PE's vertices live alone in their own partition
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = partition;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return VERTEX_ID_PE(actor->id);
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return NO_EDGE;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 2) {
+        fprintf(stderr, "mirror_await_test requires at least 2 PEs\n");
+        shmem_finalize();
+        return 1;
+    }
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    hvr_vertex_t *target = hvr_vertex_create(ctx);
+    hvr_vertex_set_uint64(LABEL, label_of(pe), target, ctx);
+    hvr_vertex_set_uint64(IS_WAITER, 0, target, ctx);
+
+    hvr_vertex_t *waiter = hvr_vertex_create(ctx);
+    hvr_vertex_set_uint64(IS_WAITER, 1, waiter, ctx);
+
+    // Every PE allocates its vertices from the same offsets
+    target_id = construct_vertex_id((pe + 1) % npes,
+            VERTEX_ID_OFFSET(target->id));
+    missing_id = construct_vertex_id((pe + 1) % npes,
+            VERTEX_ID_OFFSET(waiter->id) + 16);
+
+    hvr_init(npes, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            3, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+
+    hvr_body(ctx);
+
+    assert(*hvr_vertex_resume_state(waiter, ctx) == DONE);
+    assert(*hvr_vertex_resume_state(target, ctx) == START);
+    assert(ctx->n_mirror_awaits == 0);
+
+    // Yielding resumed the waiter on each of the following iterations
+    for (unsigned i = 1; i < N_YIELDS; i++) {
+        assert(yield_iters[i] == yield_iters[i - 1] + 1);
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
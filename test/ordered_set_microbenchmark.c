@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "hvr_avl_tree.h"
+#include "hvr_ordered_set.h"
+#include "hoover.h"
+
+/*
+ * Compares insert, find, and serialize throughput of hvr_avl_tree and
+ * hvr_ordered_set across a range of set sizes, holding the total number of
+ * keys stored constant.
+ */
+
+#define N_KEYS (1024 * 1024)
+#define N_REPEATS 10
+#define MAX_SET_SIZE 1024
+
+static const unsigned set_sizes[] = {1, 2, 4, 8, 16, 32, 64, 256, 1024};
+
+int main(int argc, char **argv) {
+    uint32_t *keys = (uint32_t *)malloc(N_KEYS * sizeof(*keys));
+    uint64_t *serialized = (uint64_t *)malloc(MAX_SET_SIZE *
+            sizeof(*serialized));
+    assert(keys && serialized);
+    for (unsigned i = 0; i < N_KEYS; i++) {
+        keys[i] = rand();
+    }
+
+    hvr_avl_node_allocator avl_allocator;
+    hvr_avl_node_allocator_init(&avl_allocator, 2 * N_KEYS, "N/A");
+    hvr_ordered_set_allocator_t set_allocator;
+    hvr_ordered_set_allocator_init(&set_allocator, 2 * N_KEYS, "N/A");
+
+    for (unsigned s = 0; s < sizeof(set_sizes) / sizeof(set_sizes[0]); s++) {
+        const unsigned set_size = set_sizes[s];
+        const unsigned n_sets = N_KEYS / set_size;
+
+        struct hvr_avl_node **avls = (struct hvr_avl_node **)malloc(
+                n_sets * sizeof(*avls));
+        hvr_ordered_set_node_t **sets = (hvr_ordered_set_node_t **)malloc(
+                n_sets * sizeof(*sets));
+        assert(avls && sets);
+        for (unsigned i = 0; i < n_sets; i++) {
+            avls[i] = nnil;
+            sets[i] = NULL;
+        }
+
+        unsigned long long start = hvr_current_time_us();
+        for (unsigned i = 0; i < N_KEYS; i++) {
+            hvr_avl_insert(&avls[i / set_size], keys[i], i, &avl_allocator);
+        }
+        const unsigned long long avl_insert = hvr_current_time_us() - start;
+
+        start = hvr_current_time_us();
+        for (unsigned i = 0; i < N_KEYS; i++) {
+            hvr_ordered_set_insert(&sets[i / set_size], keys[i], i,
+                    &set_allocator);
+        }
+        const unsigned long long set_insert = hvr_current_time_us() - start;
+
+        unsigned long long found = 0;
+        start = hvr_current_time_us();
+        for (int r = 0; r < N_REPEATS; r++) {
+            for (unsigned i = 0; i < N_KEYS; i++) {
+                found += (hvr_avl_find(avls[i / set_size], keys[i]) != nnil);
+            }
+        }
+        const unsigned long long avl_find = hvr_current_time_us() - start;
+
+        start = hvr_current_time_us();
+        for (int r = 0; r < N_REPEATS; r++) {
+            for (unsigned i = 0; i < N_KEYS; i++) {
+                found += (hvr_ordered_set_find(sets[i / set_size],
+                            keys[i]) != NULL);
+            }
+        }
+        const unsigned long long set_find = hvr_current_time_us() - start;
+
+        start = hvr_current_time_us();
+        for (int r = 0; r < N_REPEATS; r++) {
+            for (unsigned i = 0; i < n_sets; i++) {
+                found += hvr_avl_serialize(avls[i], serialized, MAX_SET_SIZE);
+            }
+        }
+        const unsigned long long avl_serialize = hvr_current_time_us() - start;
+
+        start = hvr_current_time_us();
+        for (int r = 0; r < N_REPEATS; r++) {
+            for (unsigned i = 0; i < n_sets; i++) {
+                found += hvr_ordered_set_serialize(sets[i], serialized,
+                        MAX_SET_SIZE);
+            }
+        }
+        const unsigned long long set_serialize = hvr_current_time_us() - start;
+
+        printf("set size = %4u | insert: avl %8.2f ms, ordered set %8.2f ms "
+                "| find: avl %8.2f ms, ordered set %8.2f ms | serialize: avl "
+                "%8.2f ms, ordered set %8.2f ms (%llu)\n", set_size,
+                (double)avl_insert / 1000.0, (double)set_insert / 1000.0,
+                (double)avl_find / 1000.0, (double)set_find / 1000.0,
+                (double)avl_serialize / 1000.0,
+                (double)set_serialize / 1000.0, found);
+
+        for (unsigned i = 0; i < n_sets; i++) {
+            hvr_avl_delete_all(avls[i], &avl_allocator);
+            hvr_ordered_set_delete_all(sets[i], &set_allocator);
+        }
+        free(avls);
+        free(sets);
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hvr_ordered_set.h"
+
+/*
+ * Randomly inserts into and deletes from a collection of ordered sets, checking
+ * them against a dense reference after every round. Then checks that memory
+ * freed by shrinking sets is reused when they grow back.
+ */
+
+#define N_SETS 64
+#define KEY_RANGE 4096
+#define N_ROUNDS 200
+#define OPS_PER_ROUND 4096
+#define N_MANY_SETS 16384
+
+static uint64_t reference[N_SETS][KEY_RANGE];
+static unsigned reference_size[N_SETS];
+
+static void check_set(hvr_ordered_set_node_t *set, unsigned s) {
+    assert(hvr_ordered_set_size(set) == reference_size[s]);
+
+    for (uint32_t k = 0; k < KEY_RANGE; k++) {
+        uint64_t *val = hvr_ordered_set_find(set, k);
+        if (reference[s][k]) {
+            assert(val && *val == reference[s][k]);
+        } else {
+            assert(val == NULL);
+        }
+    }
+
+    // Full iteration returns every key in ascending order
+    hvr_ordered_set_iter_t iter;
+    hvr_ordered_set_iter_init(&iter, set);
+    uint32_t key, prev_key = 0;
+    uint64_t val;
+    unsigned count = 0;
+    while (hvr_ordered_set_iter_next(&iter, &key, &val)) {
+        assert(key < KEY_RANGE && reference[s][key] == val);
+        assert(count == 0 || key > prev_key);
+        prev_key = key;
+        count++;
+    }
+    assert(count == reference_size[s]);
+
+    // Iteration from a start key skips exactly the keys below it
+    const uint32_t start = rand() % KEY_RANGE;
+    unsigned expected = 0;
+    for (uint32_t k = start; k < KEY_RANGE; k++) {
+        expected += (reference[s][k] != 0);
+    }
+    hvr_ordered_set_iter_init_from(&iter, set, start);
+    count = 0;
+    while (hvr_ordered_set_iter_next(&iter, &key, NULL)) {
+        assert(key >= start && reference[s][key]);
+        count++;
+    }
+    assert(count == expected);
+}
+
+int main(int argc, char **argv) {
+    hvr_ordered_set_allocator_t allocator;
+    hvr_ordered_set_allocator_init(&allocator, 4 * N_SETS * KEY_RANGE, "N/A");
+
+    hvr_ordered_set_node_t *sets[N_SETS];
+    memset(sets, 0x00, sizeof(sets));
+    memset(reference, 0x00, sizeof(reference));
+    memset(reference_size, 0x00, sizeof(reference_size));
+
+    srand(42);
+    for (unsigned r = 0; r < N_ROUNDS; r++) {
+        // Alternate between phases that mostly insert and mostly delete
+        const unsigned insert_percent = ((r / 20) % 2 == 0 ? 70 : 30);
+        for (unsigned op = 0; op < OPS_PER_ROUND; op++) {
+            const unsigned s = rand() % N_SETS;
+            // Skew some sets towards small key ranges to keep them small
+            const uint32_t k = rand() % (s % 4 == 0 ? 8 : KEY_RANGE);
+
+            if ((unsigned)(rand() % 100) < insert_percent) {
+                const uint64_t v = ((uint64_t)rand() << 1) | 1;
+                const int inserted = hvr_ordered_set_insert(&sets[s], k, v,
+                        &allocator);
+                assert(inserted == (reference[s][k] == 0));
+                if (inserted) {
+                    reference[s][k] = v;
+                    reference_size[s]++;
+                }
+            } else {
+                const int deleted = hvr_ordered_set_delete(&sets[s], k,
+                        &allocator);
+                assert(deleted == (reference[s][k] != 0));
+                if (deleted) {
+                    reference[s][k] = 0;
+                    reference_size[s]--;
+                }
+            }
+        }
+
+        for (unsigned s = 0; s < N_SETS; s++) {
+            check_set(sets[s], s);
+        }
+    }
+
+    for (unsigned s = 0; s < N_SETS; s++) {
+        hvr_ordered_set_delete_all(sets[s], &allocator);
+        sets[s] = NULL;
+    }
+    size_t allocated, used;
+    hvr_ordered_set_allocator_bytes_usage(&allocator, &allocated, &used);
+    assert(used == 0);
+
+    /*
+     * Fill many sets to a full node each, empty them, then refill them with
+     * fewer keys in smaller size classes. The refilled sets must fit in the
+     * memory already handed out.
+     */
+    static hvr_ordered_set_node_t *many_sets[N_MANY_SETS];
+    memset(many_sets, 0x00, sizeof(many_sets));
+    for (unsigned s = 0; s < N_MANY_SETS; s++) {
+        for (uint32_t k = 0; k < HVR_ORDERED_SET_FANOUT; k++) {
+            hvr_ordered_set_insert(&many_sets[s], k, 1, &allocator);
+        }
+    }
+    const size_t peak_bump = allocator.bump;
+    for (unsigned s = 0; s < N_MANY_SETS; s++) {
+        for (uint32_t k = 0; k < HVR_ORDERED_SET_FANOUT; k++) {
+            hvr_ordered_set_delete(&many_sets[s], k, &allocator);
+        }
+        assert(many_sets[s] == NULL);
+    }
+    for (unsigned s = 0; s < N_MANY_SETS; s++) {
+        const uint32_t nkeys = 1 + s % 4;
+        for (uint32_t k = 0; k < nkeys; k++) {
+            hvr_ordered_set_insert(&many_sets[s], k, 1, &allocator);
+        }
+    }
+    assert(allocator.bump <= peak_bump);
+
+    for (unsigned s = 0; s < N_MANY_SETS; s++) {
+        hvr_ordered_set_delete_all(many_sets[s], &allocator);
+    }
+    hvr_ordered_set_allocator_bytes_usage(&allocator, &allocated, &used);
+    assert(used == 0);
+
+    printf("Success!\n");
+
+    return 0;
+}
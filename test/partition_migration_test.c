@@ -0,0 +1,206 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <hoover.h>
+
+/*
+ * Each PE has one vertex, all of them in the same partition and close enough
+ * to each other to have edges between every pair. PE 0 then migrates its
+ * vertex to PE 1. The partition's other subscribers must drop their copy of
+ * the vertex under its old ID and pick it up under its new one, PE 1 must
+ * take it into its local partition list, and the producer registry must show
+ * PE 1 but no longer PE 0 producing the partition.
+ */
+
+/*
+ * Iterations are too short to give every PE time to cache PE 0's vertex before
+ * it migrates, so migrate after a fixed time instead.
+ */
+#define MIGRATE_AFTER_SECONDS 3
+
+#define LABEL 0
+
+static int pe, npes;
+static int migrated = 0;
+static time_t start_time;
+static hvr_vertex_id_t orig_id;
+// Set on PEs other than 0 and 1 once they have cached the vertex's old copy
+static int saw_old_copy = 0;
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    if (pe > 1 && hvr_get_vertex(orig_id, ctx)) {
+        saw_old_copy = 1;
+    }
+
+    // Keep being processed so that PEs keep checking for the old copy
+    mark_for_processing(vertex, ctx);
+}
+
+static void migration_policy(const hvr_pe_load_t *loads,
+        hvr_vertex_iter_t *iter, hvr_ctx_t ctx) {
+    if (pe != 0 || migrated ||
+            time(NULL) - start_time < MIGRATE_AFTER_SECONDS) {
+        return;
+    }
+
+    for (hvr_vertex_t *vert = hvr_vertex_iter_next(iter); vert;
+            vert = hvr_vertex_iter_next(iter)) {
+        int success = hvr_vertex_migrate(vert, 1, ctx);
+        assert(success);
+    }
+    migrated = 1;
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = 0;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return 0;
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return BIDIRECTIONAL;
+}
+
+/*
+ * Checks that vert has an edge to every other vertex, none of them under an ID
+ * on PE 0.
+ */
+static void check_edges(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    unsigned n_neighbors = 0;
+    while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+        assert(dir == BIDIRECTIONAL);
+        assert(VERTEX_ID_PE(neighbor->id) != 0);
+        // Every vertex also has an edge with itself
+        if (neighbor->id != vert->id) {
+            n_neighbors++;
+        }
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    if (n_neighbors != (unsigned)(npes - 1)) {
+        fprintf(stderr, "PE %d: vertex labelled %lu has %u edges, expected "
+                "%d\n", pe, (unsigned long)hvr_vertex_get_uint64(LABEL, vert,
+                    ctx), n_neighbors, npes - 1);
+        abort();
+    }
+}
+
+// Returns how many vertices are in the given partition list
+static unsigned count_partition_list(hvr_partition_list_t *lists) {
+    unsigned count = 0;
+    for (hvr_vertex_t *iter = hvr_partition_list_head(0, lists); iter;
+            iter = iter->next_in_partition) {
+        assert(VERTEX_ID_PE(iter->id) != 0);
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 3) {
+        if (pe == 0) {
+            fprintf(stderr, "partition_migration_test requires at least 3 "
+                    "PEs\n");
+        }
+        shmem_finalize();
+        return 1;
+    }
+
+    setenv("HVR_MIGRATION_INTERVAL", "10", 0);
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    hvr_vertex_t *vert = hvr_vertex_create(ctx);
+    hvr_vertex_set_uint64(LABEL, pe, vert, ctx);
+    orig_id = construct_vertex_id(0, VERTEX_ID_OFFSET(vert->id));
+
+    hvr_init(1, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            10, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+    hvr_set_migration_policy(migration_policy, ctx);
+
+    start_time = time(NULL);
+    hvr_body(ctx);
+
+    // PE 0's vertex now lives on PE 1, alongside PE 1's own
+    const unsigned expected_local = (pe == 0 ? 0 : (pe == 1 ? 2 : 1));
+    unsigned n_local = 0;
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    for (vert = hvr_vertex_iter_next(&iter); vert;
+            vert = hvr_vertex_iter_next(&iter)) {
+        check_edges(vert, ctx);
+        n_local++;
+    }
+    assert(n_local == expected_local);
+
+    // The local partition list moved with the vertex
+    assert(count_partition_list(&ctx->local_partition_lists) ==
+            expected_local);
+    if (pe > 1) {
+        // Subscribers dropped the old copy and cached the new one
+        assert(saw_old_copy);
+        assert(hvr_get_vertex(orig_id, ctx) == NULL);
+        assert(count_partition_list(&ctx->mirror_partition_lists) ==
+                (unsigned)(npes - 1));
+    }
+
+    shmem_barrier_all();
+
+    // The registry shows PE 1 producing the partition, and PE 0 no longer
+    hvr_dist_bitvec_local_subcopy_t producers;
+    hvr_dist_bitvec_local_subcopy_init(&ctx->partition_producers, &producers);
+    hvr_dist_bitvec_copy_locally(0, &ctx->partition_producers, &producers);
+    assert(!hvr_dist_bitvec_local_subcopy_contains(0, &producers));
+    for (int p = 1; p < npes; p++) {
+        assert(hvr_dist_bitvec_local_subcopy_contains(p, &producers));
+    }
+    hvr_dist_bitvec_local_subcopy_destroy(&ctx->partition_producers,
+            &producers);
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
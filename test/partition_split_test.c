@@ -0,0 +1,213 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * Vertices move along a line split into partitions of PARTITION_WIDTH, each of
+ * which has N_CHILDREN children of width 1, with edges between vertices no
+ * more than 1 apart. A low HVR_PARTITION_SPLIT_THRESHOLD splits partitions
+ * while vertices are still moving between children and partitions. Once they
+ * stop, every vertex must have exactly the edges a brute force search (or a
+ * run without refinement) finds, and the partitions must merge back into flat
+ * lists once they go cold.
+ */
+
+#define N_PER_PE 32
+#define N_PARTITIONS 4
+#define N_CHILDREN 4
+#define PARTITION_WIDTH N_CHILDREN
+
+// Positions are multiples of 1/POS_SCALE in [0, LINE_LENGTH)
+#define POS_SCALE 8
+#define LINE_LENGTH (N_PARTITIONS * PARTITION_WIDTH)
+
+#define MOVE_ITERS 200
+
+#define POS 0
+#define INDEX 1
+
+static int pe, npes;
+static int saw_split = 0;
+
+// Position in units of 1/POS_SCALE of vertex index on PE owner at iter
+static int64_t position(int owner, int64_t index, hvr_time_t iter) {
+    const int64_t length = LINE_LENGTH * POS_SCALE;
+    const int64_t start = (owner * 37 + index * 11) % length;
+    const int64_t velocity = (owner + index) % 7 - 3;
+    const int64_t t = (iter < MOVE_ITERS ? iter : MOVE_ITERS);
+    return ((start + velocity * t) % length + length) % length;
+}
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    const int64_t index = hvr_vertex_get_uint64(INDEX, vertex, ctx);
+    hvr_vertex_set(POS, (double)position(pe, index, ctx->iter) / POS_SCALE,
+            vertex, ctx);
+
+    for (hvr_partition_t p = 0; p < N_PARTITIONS; p++) {
+        if (hvr_partition_list_is_split(p, &ctx->local_partition_lists) ||
+                hvr_partition_list_is_split(p, &ctx->mirror_partition_lists)) {
+            saw_split = 1;
+        }
+    }
+
+    // Stop moving, so that partitions go cold and merge back
+    if (ctx->iter < MOVE_ITERS) {
+        mark_for_processing(vertex, ctx);
+    }
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    unsigned n = 0;
+    if (partition > 0) {
+        interacting_partitions[n++] = partition - 1;
+    }
+    interacting_partitions[n++] = partition;
+    if (partition < N_PARTITIONS - 1) {
+        interacting_partitions[n++] = partition + 1;
+    }
+    *n_interacting_partitions = n;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return (hvr_partition_t)(hvr_vertex_get(POS, actor, ctx) /
+            PARTITION_WIDTH);
+}
+
+static unsigned child_partition(const hvr_vertex_t *vert,
+        hvr_partition_t partition, hvr_ctx_t ctx) {
+    return (unsigned)hvr_vertex_get(POS, vert, ctx) - partition *
+        PARTITION_WIDTH;
+}
+
+static int children_might_interact(hvr_partition_t partition_a,
+        unsigned child_a, hvr_partition_t partition_b, unsigned child_b,
+        hvr_ctx_t ctx) {
+    const int64_t a = partition_a * PARTITION_WIDTH + child_a;
+    const int64_t b = partition_b * PARTITION_WIDTH + child_b;
+    return a - b <= 1 && b - a <= 1;
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    const double delta = hvr_vertex_get(POS, a, ctx) -
+        hvr_vertex_get(POS, b, ctx);
+    return (delta <= 1.0 && delta >= -1.0) ? BIDIRECTIONAL : NO_EDGE;
+}
+
+// Checks vert's edges against every vertex's final position
+static void check_edges(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    const int64_t pos = position(pe, hvr_vertex_get_uint64(INDEX, vert, ctx),
+            MOVE_ITERS);
+    unsigned expected = 0;
+    for (int owner = 0; owner < npes; owner++) {
+        for (int64_t index = 0; index < N_PER_PE; index++) {
+            const int64_t delta = position(owner, index, MOVE_ITERS) - pos;
+            if (delta <= POS_SCALE && delta >= -POS_SCALE) {
+                expected++;
+            }
+        }
+    }
+
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    unsigned n_neighbors = 0;
+    while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+        assert(should_have_edge(vert, neighbor, ctx) == BIDIRECTIONAL);
+        n_neighbors++;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    // The count includes the edge every vertex has with itself
+    if (n_neighbors != expected) {
+        fprintf(stderr, "PE %d: vertex at %f has %u edges, expected %u\n", pe,
+                hvr_vertex_get(POS, vert, ctx), n_neighbors, expected);
+        abort();
+    }
+}
+
+// Checks that l is flat again, returning how many vertices are in it
+static unsigned check_merged(hvr_partition_list_t *l) {
+    unsigned count = 0;
+    for (hvr_partition_t p = 0; p < N_PARTITIONS; p++) {
+        assert(!hvr_partition_list_is_split(p, l));
+        for (unsigned c = 0; c < N_CHILDREN; c++) {
+            assert(hvr_partition_list_child_head(p, c, l) == NULL);
+        }
+        for (hvr_vertex_t *iter = hvr_partition_list_head(p, l); iter;
+                iter = iter->next_in_partition) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    setenv("HVR_PARTITION_SPLIT_THRESHOLD", "4", 0);
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    for (unsigned i = 0; i < N_PER_PE; i++) {
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        hvr_vertex_set_uint64(INDEX, i, vert, ctx);
+        hvr_vertex_set(POS, (double)position(pe, i, 0) / POS_SCALE, vert, ctx);
+    }
+
+    hvr_init(N_PARTITIONS, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            6, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+    hvr_set_partition_refinement(N_CHILDREN, child_partition,
+            children_might_interact, ctx);
+
+    hvr_body(ctx);
+
+    assert(saw_split);
+
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    for (hvr_vertex_t *vert = hvr_vertex_iter_next(&iter); vert;
+            vert = hvr_vertex_iter_next(&iter)) {
+        check_edges(vert, ctx);
+    }
+
+    assert(check_merged(&ctx->local_partition_lists) == N_PER_PE);
+    check_merged(&ctx->mirror_partition_lists);
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
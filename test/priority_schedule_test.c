@@ -0,0 +1,132 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * Each PE's vertices are given their index as their priority, and at most
+ * MAX_UPDATES_PER_ITER of them are updated per iteration. Every vertex is
+ * updated once, except for the highest priority one, which asks to be updated
+ * again the first time around. Vertices must be updated in decreasing order of
+ * priority, MAX_UPDATES_PER_ITER per iteration, with the deferred vertices
+ * updated on the following iterations and the re-marked vertex jumping ahead
+ * of the lower priority vertices that were deferred.
+ */
+
+#define N_PER_PE 10
+#define MAX_UPDATES_PER_ITER 3
+
+#define INDEX 0
+
+// Indices of the vertices in the order in which they should be updated
+static const unsigned expected_order[] = {9, 8, 7, 9, 6, 5, 4, 3, 2, 1, 0};
+#define N_EXPECTED (sizeof(expected_order) / sizeof(expected_order[0]))
+
+static int pe, npes;
+
+static unsigned n_updates = 0;
+static unsigned updated_index[N_EXPECTED];
+static hvr_time_t updated_iter[N_EXPECTED];
+
+static unsigned vertex_priority(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    return (unsigned)hvr_vertex_get_uint64(INDEX, vert, ctx);
+}
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    const unsigned index = (unsigned)hvr_vertex_get_uint64(INDEX, vertex, ctx);
+    assert(n_updates < N_EXPECTED);
+    updated_index[n_updates] = index;
+    updated_iter[n_updates] = ctx->iter;
+    n_updates++;
+
+    if (index == N_PER_PE - 1 && n_updates == 1) {
+        mark_for_processing(vertex, ctx);
+    }
+}
+
+// Each PE's vertices live alone in their own partition
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = partition;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return pe;
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return NO_EDGE;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    for (unsigned i = 0; i < N_PER_PE; i++) {
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        hvr_vertex_set_uint64(INDEX, i, vert, ctx);
+    }
+
+    hvr_init(npes, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            2, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+    hvr_set_vertex_priority(vertex_priority, MAX_UPDATES_PER_ITER, ctx);
+
+    hvr_body(ctx);
+
+    if (n_updates != N_EXPECTED) {
+        fprintf(stderr, "PE %d: %u vertex updates, expected %u\n", pe,
+                n_updates, (unsigned)N_EXPECTED);
+        abort();
+    }
+
+    /*
+     * Updates come in priority order, MAX_UPDATES_PER_ITER to an iteration,
+     * with the deferred ones on the iterations right after.
+     */
+    for (unsigned i = 0; i < N_EXPECTED; i++) {
+        if (updated_index[i] != expected_order[i]) {
+            fprintf(stderr, "PE %d: update %u was of vertex %u, expected "
+                    "%u\n", pe, i, updated_index[i], expected_order[i]);
+            abort();
+        }
+        assert(updated_iter[i] == updated_iter[0] +
+                i / MAX_UPDATES_PER_ITER);
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
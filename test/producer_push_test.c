@@ -0,0 +1,153 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * With HVR_PUSH_PRODUCER_CHANGES, every PE but the last produces vertices in
+ * partition 0, and one of those producers leaves the simulation early. The
+ * last PE's vertex starts out alone in partition 1 and later moves into
+ * partition 0, subscribing to it long after its producers registered. It must
+ * then receive every vertex in partition 0, including the exited PE's.
+ */
+
+#define N_PER_PE 8
+
+#define EXIT_AFTER_US 1000000ULL
+#define SUBSCRIBE_AFTER_US 3000000ULL
+
+#define PARTITION 0
+
+static int pe, npes;
+static int subscriber, exiting_producer;
+static unsigned long long start_time;
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    if (pe == subscriber &&
+            hvr_current_time_us() - start_time >= SUBSCRIBE_AFTER_US) {
+        hvr_vertex_set_uint64(PARTITION, 0, vertex, ctx);
+    }
+
+    // Keep being processed so that the move above is not missed
+    mark_for_processing(vertex, ctx);
+}
+
+// Each partition only interacts with itself
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = partition;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return hvr_vertex_get_uint64(PARTITION, actor, ctx);
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return BIDIRECTIONAL;
+}
+
+static int should_terminate(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *local_coupled_val, hvr_vertex_t *all_coupled_vals,
+        hvr_set_t *coupled_pes, int n_coupled_pes, int *updates_on_this_iter,
+        hvr_set_t *terminated_coupled_pes, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    return pe == exiting_producer &&
+        hvr_current_time_us() - start_time >= EXIT_AFTER_US;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 3) {
+        if (pe == 0) {
+            fprintf(stderr, "producer_push_test requires at least 3 PEs\n");
+        }
+        shmem_finalize();
+        return 1;
+    }
+    subscriber = npes - 1;
+    // Not PE 0, which owns partition 0's registry row
+    exiting_producer = npes - 2;
+
+    setenv("HVR_PUSH_PRODUCER_CHANGES", "1", 0);
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    const unsigned n_local = (pe == subscriber ? 1 : N_PER_PE);
+    for (unsigned i = 0; i < n_local; i++) {
+        hvr_vertex_t *vert = hvr_vertex_create(ctx);
+        hvr_vertex_set_uint64(PARTITION, pe == subscriber ? 1 : 0, vert, ctx);
+    }
+
+    hvr_init(2, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            should_terminate,
+            8, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            0, // send_neighbor_updates_for_explicit_subs
+            ctx);
+
+    start_time = hvr_current_time_us();
+    hvr_body(ctx);
+
+    if (pe == subscriber) {
+        hvr_vertex_iter_t iter;
+        hvr_vertex_iter_init(&iter, ctx);
+        hvr_vertex_t *vert = hvr_vertex_iter_next(&iter);
+        assert(vert && hvr_vertex_iter_next(&iter) == NULL);
+        assert(hvr_vertex_get_uint64(PARTITION, vert, ctx) == 0);
+
+        // An edge with every producer's vertices, and one with itself
+        unsigned n_neighbors = 0;
+        hvr_neighbors_t neighbors;
+        hvr_get_neighbors(vert, &neighbors, ctx);
+        hvr_vertex_t *neighbor;
+        hvr_edge_type_t dir;
+        while (hvr_neighbors_next(&neighbors, &neighbor, &dir)) {
+            if (neighbor->id != vert->id) {
+                assert(VERTEX_ID_PE(neighbor->id) != subscriber);
+                n_neighbors++;
+            }
+        }
+        hvr_release_neighbors(&neighbors, ctx);
+
+        const unsigned expected = (npes - 1) * N_PER_PE;
+        if (n_neighbors != expected) {
+            fprintf(stderr, "PE %d: late subscriber has %u neighbors, "
+                    "expected %u\n", pe, n_neighbors, expected);
+            abort();
+        }
+    }
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}
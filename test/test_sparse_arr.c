@@ -6,7 +6,7 @@
 
 int main(int argc, char **argv) {
     hvr_sparse_arr_t arr;
-    hvr_sparse_arr_init(&arr, 2000);
+    hvr_sparse_arr_init(&arr, 2000, 200);
 
     assert(hvr_sparse_arr_contains(3, 3, &arr) == 0);
 
@@ -16,22 +16,71 @@ int main(int argc, char **argv) {
     assert(hvr_sparse_arr_contains(3, 4, &arr) == 0);
     assert(hvr_sparse_arr_contains(3, 1, &arr) == 0);
 
-    hvr_sparse_arr_insert(1500, 1500, &arr);
-    assert(hvr_sparse_arr_contains(1500, 1500, &arr) == 1);
+    hvr_sparse_arr_insert(1500, 150, &arr);
+    assert(hvr_sparse_arr_contains(1500, 150, &arr) == 1);
     assert(hvr_sparse_arr_contains(3, 3, &arr) == 1);
     assert(hvr_sparse_arr_contains(4, 4, &arr) == 0);
     assert(hvr_sparse_arr_contains(3, 4, &arr) == 0);
     assert(hvr_sparse_arr_contains(3, 1, &arr) == 0);
 
-    int *tmp_arr = NULL;
+    uint64_t *tmp_arr = NULL;
     unsigned len = hvr_sparse_arr_linearize_row(3, &tmp_arr, &arr);
     assert(len == 1);
     assert(tmp_arr[0] == 3);
+    hvr_sparse_arr_release_row(tmp_arr, &arr);
 
     hvr_sparse_arr_remove(3, 3, &arr);
     assert(hvr_sparse_arr_contains(3, 3, &arr) == 0);
     assert(hvr_sparse_arr_contains(4, 4, &arr) == 0);
 
+    /*
+     * Grow a single row through the inline, tree, and bitmap representations
+     * and back, checking its contents with the iterator along the way.
+     */
+    for (unsigned j = 0; j < 200; j += 2) {
+        hvr_sparse_arr_insert(7, j, &arr);
+        hvr_sparse_arr_insert(7, j, &arr);
+        assert(hvr_sparse_arr_row_length(7, &arr) == j / 2 + 1);
+
+        hvr_sparse_arr_row_iter_t iter;
+        hvr_sparse_arr_row_iter_init(&iter, 7, &arr);
+        unsigned val, count = 0;
+        while (hvr_sparse_arr_row_iter_next(&iter, &val)) {
+            assert(val % 2 == 0 && val <= j);
+            assert(hvr_sparse_arr_contains(7, val, &arr));
+            count++;
+        }
+        assert(count == j / 2 + 1);
+    }
+    assert(arr.segs[0]->seg_kind[7] == HVR_SPARSE_ARR_ROW_BITMAP);
+
+    for (unsigned j = 0; j < 200; j += 2) {
+        hvr_sparse_arr_remove(7, j, &arr);
+        assert(hvr_sparse_arr_contains(7, j, &arr) == 0);
+        assert(hvr_sparse_arr_row_length(7, &arr) == 99 - j / 2);
+    }
+    assert(arr.segs[0]->seg_kind[7] == HVR_SPARSE_ARR_ROW_INLINE);
+
+    // remove_value through the reverse index
+    hvr_sparse_arr_t rev;
+    hvr_sparse_arr_init(&rev, 5000, 16);
+    hvr_sparse_arr_enable_reverse_index(&rev);
+    assert(rev.reverse->set_allocator == rev.set_allocator);
+    for (unsigned i = 0; i < 5000; i += 7) {
+        hvr_sparse_arr_insert(i, i % 16, &rev);
+        hvr_sparse_arr_insert(i, 3, &rev);
+    }
+    hvr_sparse_arr_remove_row(14, &rev);
+    hvr_sparse_arr_remove_value(3, &rev);
+    for (unsigned i = 0; i < 5000; i += 7) {
+        assert(hvr_sparse_arr_contains(i, 3, &rev) == 0);
+        if (i != 14 && i % 16 != 3) {
+            assert(hvr_sparse_arr_contains(i, i % 16, &rev) == 1);
+        }
+    }
+    assert(hvr_sparse_arr_row_length(3, rev.reverse) == 0);
+    hvr_sparse_arr_destroy(&rev);
+
     printf("Success!\n");
 
     return 0;
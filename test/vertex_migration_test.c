@@ -0,0 +1,197 @@
+#include <shmem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <hoover.h>
+
+/*
+ * Each PE's vertex creates an explicit edge to the vertex on the next PE,
+ * forming a ring, and PE 0 then migrates its vertex to PE 1. The edges of the
+ * migrated vertex must follow it to its new ID, its old ID must forward to the
+ * new one, and no PE may still hold a copy of it under its old ID.
+ */
+
+#define CREATE_ITER 5
+#define MIGRATE_ITER 20
+
+#define LABEL 0
+#define PAYLOAD_BASE 100
+
+static int pe, npes;
+static int migrated = 0;
+// Offset of each PE's vertex before any migration
+static size_t home_offset;
+
+static void update_vertex(hvr_vertex_t *vertex, hvr_set_t *couple_with,
+        hvr_ctx_t ctx) {
+    /*
+     * PEs run at different paces, so the migrated vertex may reach its new
+     * owner before that PE's CREATE_ITER. Only vertices still on their own PE
+     * create edges.
+     */
+    const uint64_t label = hvr_vertex_get_uint64(LABEL, vertex, ctx);
+    if (ctx->iter == CREATE_ITER && VERTEX_ID_PE(vertex->id) == label) {
+        const hvr_vertex_id_t next = construct_vertex_id((label + 1) % npes,
+                home_offset);
+        hvr_create_edge_with_payload(vertex, next, BIDIRECTIONAL,
+                PAYLOAD_BASE + label, ctx);
+    }
+
+    // Keep being processed so that the iteration above is not missed
+    mark_for_processing(vertex, ctx);
+}
+
+static void migration_policy(const hvr_pe_load_t *loads,
+        hvr_vertex_iter_t *iter, hvr_ctx_t ctx) {
+    if (pe != 0 || migrated || ctx->iter < MIGRATE_ITER) {
+        return;
+    }
+
+    for (hvr_vertex_t *vert = hvr_vertex_iter_next(iter); vert;
+            vert = hvr_vertex_iter_next(iter)) {
+        int success = hvr_vertex_migrate(vert, 1, ctx);
+        assert(success);
+    }
+    migrated = 1;
+}
+
+static void might_interact(const hvr_partition_t partition,
+        hvr_partition_t *interacting_partitions,
+        unsigned *n_interacting_partitions,
+        unsigned interacting_partitions_capacity,
+        hvr_ctx_t ctx) {
+    interacting_partitions[0] = 0;
+    *n_interacting_partitions = 1;
+}
+
+void update_coupled_val(hvr_vertex_iter_t *iter, hvr_ctx_t ctx,
+        hvr_vertex_t *out_coupled_metric, uint64_t n_msgs_recvd_this_iter,
+        uint64_t n_msgs_sent_this_iter, uint64_t n_msgs_recvd_total,
+        uint64_t n_msgs_sent_total) {
+    hvr_vertex_set_uint64(0, 0, out_coupled_metric, ctx);
+}
+
+// Vertices with explicit edges must not be in a partition
+hvr_partition_t actor_to_partition(const hvr_vertex_t *actor, hvr_ctx_t ctx) {
+    return HVR_INVALID_PARTITION;
+}
+
+hvr_edge_type_t should_have_edge(const hvr_vertex_t *a, const hvr_vertex_t *b,
+        hvr_ctx_t ctx) {
+    return NO_EDGE;
+}
+
+/*
+ * Checks that vert has edges to the vertices labelled before and after it in
+ * the ring, with the payloads they were created with, and none to vertices
+ * still owned by PE 0. Returns the ID of its neighbor labelled 0, if any.
+ */
+static hvr_vertex_id_t check_edges(hvr_vertex_t *vert, hvr_ctx_t ctx) {
+    const uint64_t label = hvr_vertex_get_uint64(LABEL, vert, ctx);
+    const uint64_t prev = (label + npes - 1) % npes;
+    const uint64_t next = (label + 1) % npes;
+    hvr_vertex_id_t label_0_id = HVR_INVALID_VERTEX_ID;
+
+    hvr_neighbors_t neighbors;
+    hvr_get_neighbors(vert, &neighbors, ctx);
+
+    hvr_vertex_t *neighbor;
+    hvr_edge_type_t dir;
+    hvr_edge_payload_t payload;
+    unsigned n_neighbors = 0;
+    while (hvr_neighbors_next_with_payload(&neighbors, &neighbor, &dir,
+                &payload)) {
+        const uint64_t neighbor_label = hvr_vertex_get_uint64(LABEL, neighbor,
+                ctx);
+        assert(dir == BIDIRECTIONAL);
+        assert(VERTEX_ID_PE(neighbor->id) != 0);
+        if (neighbor_label == next) {
+            assert(payload == PAYLOAD_BASE + label);
+        } else {
+            assert(neighbor_label == prev);
+            assert(payload == PAYLOAD_BASE + prev);
+        }
+        if (neighbor_label == 0) {
+            label_0_id = neighbor->id;
+        }
+        n_neighbors++;
+    }
+    hvr_release_neighbors(&neighbors, ctx);
+
+    if (n_neighbors != 2) {
+        fprintf(stderr, "PE %d: vertex labelled %lu has %u edges, expected "
+                "2\n", pe, (unsigned long)label, n_neighbors);
+        abort();
+    }
+    return label_0_id;
+}
+
+int main(int argc, char **argv) {
+    shmem_init();
+    pe = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    if (npes < 3) {
+        if (pe == 0) {
+            fprintf(stderr, "vertex_migration_test requires at least 3 PEs\n");
+        }
+        shmem_finalize();
+        return 1;
+    }
+
+    setenv("HVR_MIGRATION_INTERVAL", "10", 0);
+
+    hvr_ctx_t ctx;
+    hvr_ctx_create(&ctx);
+
+    hvr_vertex_t *vert = hvr_vertex_create(ctx);
+    hvr_vertex_set_uint64(LABEL, pe, vert, ctx);
+    home_offset = VERTEX_ID_OFFSET(vert->id);
+    const hvr_vertex_id_t orig_id = construct_vertex_id(0, home_offset);
+
+    hvr_init(1, // # partitions
+            update_vertex,
+            might_interact,
+            update_coupled_val,
+            actor_to_partition,
+            NULL, // start_time_step
+            should_have_edge,
+            NULL, // should_terminate
+            10, // max_elapsed_seconds
+            1, // max_graph_traverse_depth
+            1, // send_neighbor_updates_for_explicit_subs
+            ctx);
+    hvr_set_migration_policy(migration_policy, ctx);
+
+    hvr_body(ctx);
+
+    // PE 0's vertex now lives on PE 1, alongside PE 1's own
+    unsigned n_local = 0;
+    hvr_vertex_id_t label_0_id = HVR_INVALID_VERTEX_ID;
+    hvr_vertex_iter_t iter;
+    hvr_vertex_iter_init(&iter, ctx);
+    for (vert = hvr_vertex_iter_next(&iter); vert;
+            vert = hvr_vertex_iter_next(&iter)) {
+        hvr_vertex_id_t found = check_edges(vert, ctx);
+        if (found != HVR_INVALID_VERTEX_ID) {
+            label_0_id = found;
+        }
+        n_local++;
+    }
+    assert(n_local == (pe == 0 ? 0 : (pe == 1 ? 2 : 1)));
+
+    // Only PEs with a vertex next to the migrated one know its new ID
+    const hvr_vertex_id_t resolved = hvr_resolve_vertex_id(orig_id, ctx);
+    assert(VERTEX_ID_PE(resolved) == 1);
+    assert(label_0_id == HVR_INVALID_VERTEX_ID || label_0_id == resolved);
+    assert(hvr_get_vertex(orig_id, ctx) == NULL);
+
+    hvr_finalize(ctx);
+
+    shmem_finalize();
+
+    if (pe == 0) {
+        printf("Success\n");
+    }
+
+    return 0;
+}